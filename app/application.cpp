@@ -47,6 +47,7 @@
 #include "spriteimage.h"
 #include "spriteimageprovider.h"
 #include "swatchmodel.h"
+#include "texturecanvaspaneitem.h"
 #include "texturedfillparameters.h"
 #include "texturedfillpreviewitem.h"
 #include "tile.h"
@@ -100,6 +101,7 @@ Application::Application(int &argc, char **argv, const QString &applicationName)
     qmlRegisterType<Splitter>();
     qmlRegisterType<Swatch>();
     qmlRegisterType<SwatchModel>("App", 1, 0, "SwatchModel");
+    qmlRegisterType<TextureCanvasPaneItem>("App", 1, 0, "TextureCanvasPaneItem");
     qmlRegisterType<TexturedFillPreviewItem>("App", 1, 0, "TexturedFillPreviewItem");
     qmlRegisterType<TileCanvas>();
     qmlRegisterType<TileCanvas>("App", 1, 0, "TileCanvas");
@@ -71,8 +71,10 @@ Panel {
 
                 SpriteImage {
                     id: spriteImage
+                    objectName: "animationPanelSpriteImage"
                     project: root.project
                     animationPlayback: root.animationPlayback
+                    canvas: root.canvas
                     scale: animationPlayback ? animationPlayback.scale : 1.0
                     smooth: false
                     anchors.centerIn: parent
@@ -51,21 +51,45 @@ Repeater {
         The Z value of each child is shown in the lower left corner.
     */
     
-    CanvasPaneItem {
+    Item {
         id: paneItem
         objectName: canvas.objectName + "PaneItem" + index
-        canvas: root.canvas
-        pane: canvas.paneAt(index)
-        paneIndex: index
         anchors.fill: parent
         visible: index === 0 || canvas.splitScreen
-        
+
+        readonly property CanvasPane pane: canvas.paneAt(index)
+        readonly property int paneIndex: index
+
         Rectangle {
             x: index === 0 ? 0 : Math.floor(parent.width - width)
             width: Math.floor(paneItem.pane.size * parent.width)
             height: parent.height
             color: CanvasColours.backgroundColour
-            z: -1
+        }
+
+        Loader {
+            anchors.fill: parent
+            sourceComponent: settings.textureCanvasRenderingEnabled ? texturePaneItemComponent : paintedPaneItemComponent
+        }
+
+        Component {
+            id: paintedPaneItemComponent
+
+            CanvasPaneItem {
+                canvas: root.canvas
+                pane: paneItem.pane
+                paneIndex: paneItem.paneIndex
+            }
+        }
+
+        Component {
+            id: texturePaneItemComponent
+
+            TextureCanvasPaneItem {
+                canvas: root.canvas
+                pane: paneItem.pane
+                paneIndex: paneItem.paneIndex
+            }
         }
     }
 }
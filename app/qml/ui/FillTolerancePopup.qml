@@ -0,0 +1,36 @@
+import QtQuick 2.6
+import QtQuick.Controls 2.0
+
+import App 1.0
+
+Popup {
+    objectName: "fillTolerancePopup"
+    modal: true
+    dim: false
+    focus: true
+
+    property ImageCanvas canvas
+
+    contentItem: Slider {
+        id: fillToleranceSlider
+        objectName: "fillToleranceSlider"
+        from: 0
+        to: 255
+        stepSize: 1
+
+        onValueChanged: if (canvas) canvas.fillTolerance = value
+
+        Binding {
+            target: fillToleranceSlider
+            property: "value"
+            value: canvas ? canvas.fillTolerance : 0
+            when: canvas
+        }
+
+        ToolTip {
+            parent: fillToleranceSlider.handle
+            visible: fillToleranceSlider.pressed
+            text: fillToleranceSlider.valueAt(fillToleranceSlider.position).toFixed(0)
+        }
+    }
+}
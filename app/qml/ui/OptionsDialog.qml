@@ -27,6 +27,9 @@ Dialog {
         settings.alwaysShowCrosshair = alwaysShowCrosshairCheckBox.checked
         settings.fpsVisible = showFpsCheckBox.checked
         settings.windowOpacity = windowOpacitySlider.value
+        settings.undoMemoryBudget = undoMemoryBudgetSpinBox.value
+        settings.undoSpillEnabled = undoSpillCheckBox.checked
+        settings.textureCanvasRenderingEnabled = textureCanvasRenderingCheckBox.checked
 
         for (var i = 0; i < shortcutModel.count; ++i) {
             var row = shortcutModel.get(i)
@@ -45,6 +48,9 @@ Dialog {
         showFpsCheckBox.checked = settings.fpsVisible
         alwaysShowCrosshairCheckBox.checked = settings.alwaysShowCrosshair
         windowOpacitySlider.value = settings.windowOpacity
+        undoMemoryBudgetSpinBox.value = settings.undoMemoryBudget
+        undoSpillCheckBox.checked = settings.undoSpillEnabled
+        textureCanvasRenderingCheckBox.checked = settings.textureCanvasRenderingEnabled
 
         for (var i = 0; i < shortcutModel.count; ++i) {
             var row = shortcutModel.get(i)
@@ -237,6 +243,51 @@ Dialog {
                         ToolTip.visible: hovered
                         ToolTip.delay: toolTipDelay
                     }
+
+                    Label {
+                        text: qsTr("Undo memory budget (MB)")
+                    }
+                    SpinBox {
+                        id: undoMemoryBudgetSpinBox
+                        objectName: "undoMemoryBudgetSpinBox"
+                        from: 16
+                        to: 16384
+                        stepSize: 16
+                        editable: true
+                        value: settings.undoMemoryBudget
+
+                        ToolTip.text: qsTr("Older undo history is compressed to stay within this limit, and dropped only if that's not enough")
+                        ToolTip.visible: hovered
+                        ToolTip.delay: toolTipDelay
+                    }
+
+                    Label {
+                        text: qsTr("Move undo history to disk")
+                    }
+                    CheckBox {
+                        id: undoSpillCheckBox
+                        objectName: "undoSpillCheckBox"
+                        leftPadding: 0
+                        checked: settings.undoSpillEnabled
+
+                        ToolTip.text: qsTr("When compression isn't enough to stay within the undo memory budget, move older undo history to a temporary file instead of dropping it")
+                        ToolTip.visible: hovered
+                        ToolTip.delay: toolTipDelay
+                    }
+
+                    Label {
+                        text: qsTr("Render canvas as texture (experimental)")
+                    }
+                    CheckBox {
+                        id: textureCanvasRenderingCheckBox
+                        objectName: "textureCanvasRenderingCheckBox"
+                        leftPadding: 0
+                        checked: settings.textureCanvasRenderingEnabled
+
+                        ToolTip.text: qsTr("Keeps the image as a texture that only needs to be partially updated when drawing, and panning and zooming don't require it to be redrawn")
+                        ToolTip.visible: hovered
+                        ToolTip.delay: toolTipDelay
+                    }
                 }
             }
         }
@@ -214,6 +214,23 @@ Pane {
             Layout.fillWidth: true
         }
 
+        Label {
+            id: undoMemoryLabel
+            objectName: "undoMemoryLabel"
+            text: {
+                if (!project)
+                    return "";
+
+                var megabytes = 1024 * 1024;
+                return qsTr("Undo: %1 MB (peak %2 MB)")
+                    .arg((project.undoMemoryUsage / megabytes).toFixed(1))
+                    .arg((project.peakUndoMemoryUsage / megabytes).toFixed(1));
+            }
+            visible: project && project.peakUndoMemoryUsage > 0
+
+            Layout.rightMargin: 6
+        }
+
         ZoomIndicator {
             objectName: "firstPaneZoomIndicator"
             pane: canvas ? canvas.firstPane : null
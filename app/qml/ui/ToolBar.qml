@@ -341,6 +341,26 @@ ToolBar {
             }
         }
 
+        Ui.IconToolButton {
+            id: fillToleranceButton
+            objectName: "fillToleranceButton"
+            text: "\uf042"
+            hoverEnabled: true
+            visible: isImageProject
+
+            ToolTip.text: qsTr("Change how different a colour can be from the target colour and still be filled")
+            ToolTip.visible: hovered && !fillTolerancePopup.visible
+
+            onClicked: fillTolerancePopup.visible = !fillTolerancePopup.visible
+
+            FillTolerancePopup {
+                id: fillTolerancePopup
+                x: parent.width / 2 - width / 2
+                y: parent.height
+                canvas: root.canvas
+            }
+        }
+
         ToolSeparator {
             id: toolSeparator
         }
@@ -26,7 +26,7 @@
 Q_LOGGING_CATEGORY(lcAddGuideCommand, "app.undo.addGuideCommand")
 
 AddGuideCommand::AddGuideCommand(Project *project, const Guide &guide, QUndoCommand *parent) :
-    QUndoCommand(parent),
+    UndoCommand(parent),
     mProject(project),
     mGuide(guide)
 {
@@ -21,14 +21,14 @@
 #define ADDGUIDECOMMAND_H
 
 #include <QDebug>
-#include <QUndoCommand>
 
 #include "guide.h"
 #include "slate-global.h"
+#include "undocommand.h"
 
 class Project;
 
-class SLATE_EXPORT AddGuideCommand : public QUndoCommand
+class SLATE_EXPORT AddGuideCommand : public UndoCommand
 {
 public:
     AddGuideCommand(Project *project, const Guide &guide, QUndoCommand *parent = nullptr);
@@ -27,7 +27,7 @@
 Q_LOGGING_CATEGORY(lcAddLayerCommand, "app.undo.addLayerCommand")
 
 AddLayerCommand::AddLayerCommand(LayeredImageProject *project, ImageLayer *layer, int index, QUndoCommand *parent) :
-    QUndoCommand(parent),
+    UndoCommand(parent),
     mProject(project),
     mIndex(index),
     mLayer(layer),
@@ -57,6 +57,12 @@ int AddLayerCommand::id() const
     return -1;
 }
 
+qint64 AddLayerCommand::byteSize() const
+{
+    // The layer is only owned by us (and hence only costs us memory) while it's not in the project.
+    return mLayerGuard ? mLayerGuard->image()->sizeInBytes() : 0;
+}
+
 QDebug operator<<(QDebug debug, const AddLayerCommand *command)
 {
     debug.nospace() << "(AddLayerCommand index=" << command->mIndex
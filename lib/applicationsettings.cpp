@@ -405,6 +405,63 @@ void ApplicationSettings::setCheckerColour2(const QColor &colour)
     emit checkerColour2Changed();
 }
 
+int ApplicationSettings::defaultUndoMemoryBudget() const
+{
+    return 512;
+}
+
+int ApplicationSettings::undoMemoryBudget() const
+{
+    return contains("undoMemoryBudget") ? value("undoMemoryBudget").toInt() : defaultUndoMemoryBudget();
+}
+
+void ApplicationSettings::setUndoMemoryBudget(int megabytes)
+{
+    if (megabytes == undoMemoryBudget())
+        return;
+
+    setValue("undoMemoryBudget", megabytes);
+    emit undoMemoryBudgetChanged();
+}
+
+bool ApplicationSettings::defaultUndoSpillEnabled() const
+{
+    return false;
+}
+
+bool ApplicationSettings::isUndoSpillEnabled() const
+{
+    return contains("undoSpillEnabled") ? value("undoSpillEnabled").toBool() : defaultUndoSpillEnabled();
+}
+
+void ApplicationSettings::setUndoSpillEnabled(bool undoSpillEnabled)
+{
+    if (undoSpillEnabled == isUndoSpillEnabled())
+        return;
+
+    setValue("undoSpillEnabled", undoSpillEnabled);
+    emit undoSpillEnabledChanged();
+}
+
+bool ApplicationSettings::defaultTextureCanvasRenderingEnabled() const
+{
+    return false;
+}
+
+bool ApplicationSettings::isTextureCanvasRenderingEnabled() const
+{
+    return contains("textureCanvasRenderingEnabled") ? value("textureCanvasRenderingEnabled").toBool() : defaultTextureCanvasRenderingEnabled();
+}
+
+void ApplicationSettings::setTextureCanvasRenderingEnabled(bool textureCanvasRenderingEnabled)
+{
+    if (textureCanvasRenderingEnabled == isTextureCanvasRenderingEnabled())
+        return;
+
+    setValue("textureCanvasRenderingEnabled", textureCanvasRenderingEnabled);
+    emit textureCanvasRenderingEnabledChanged();
+}
+
 void ApplicationSettings::resetShortcutsToDefaults()
 {
     static QVector<QString> allShortcuts;
@@ -50,6 +50,9 @@ class SLATE_EXPORT ApplicationSettings : public QSettings
     Q_PROPERTY(qreal windowOpacity READ windowOpacity WRITE setWindowOpacity NOTIFY windowOpacityChanged)
     Q_PROPERTY(QColor checkerColour1 READ checkerColour1 WRITE setCheckerColour1 NOTIFY checkerColour1Changed)
     Q_PROPERTY(QColor checkerColour2 READ checkerColour2 WRITE setCheckerColour2 NOTIFY checkerColour2Changed)
+    Q_PROPERTY(int undoMemoryBudget READ undoMemoryBudget WRITE setUndoMemoryBudget NOTIFY undoMemoryBudgetChanged)
+    Q_PROPERTY(bool undoSpillEnabled READ isUndoSpillEnabled WRITE setUndoSpillEnabled NOTIFY undoSpillEnabledChanged)
+    Q_PROPERTY(bool textureCanvasRenderingEnabled READ isTextureCanvasRenderingEnabled WRITE setTextureCanvasRenderingEnabled NOTIFY textureCanvasRenderingEnabledChanged)
 
     Q_PROPERTY(QString quitShortcut READ quitShortcut WRITE setQuitShortcut NOTIFY quitShortcutChanged)
     Q_PROPERTY(QString newShortcut READ newShortcut WRITE setNewShortcut NOTIFY newShortcutChanged)
@@ -152,6 +155,19 @@ public:
     QColor checkerColour2() const;
     void setCheckerColour2(const QColor &colour);
 
+    // In megabytes.
+    int defaultUndoMemoryBudget() const;
+    int undoMemoryBudget() const;
+    void setUndoMemoryBudget(int megabytes);
+
+    bool defaultUndoSpillEnabled() const;
+    bool isUndoSpillEnabled() const;
+    void setUndoSpillEnabled(bool undoSpillEnabled);
+
+    bool defaultTextureCanvasRenderingEnabled() const;
+    bool isTextureCanvasRenderingEnabled() const;
+    void setTextureCanvasRenderingEnabled(bool textureCanvasRenderingEnabled);
+
     Q_INVOKABLE void resetShortcutsToDefaults();
 
     QString defaultQuitShortcut() const;
@@ -321,6 +337,9 @@ signals:
     void windowOpacityChanged();
     void checkerColour1Changed();
     void checkerColour2Changed();
+    void undoMemoryBudgetChanged();
+    void undoSpillEnabledChanged();
+    void textureCanvasRenderingEnabledChanged();
 
     void quitShortcutChanged();
     void newShortcutChanged();
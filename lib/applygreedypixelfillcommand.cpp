@@ -26,27 +26,40 @@
 
 Q_LOGGING_CATEGORY(lcApplyGreedyPixelFillCommand, "app.undo.applyGreedyPixelFillCommand")
 
-ApplyGreedyPixelFillCommand::ApplyGreedyPixelFillCommand(ImageCanvas *canvas, int layerIndex, const QImage &previousImage,
-    const QImage &newImage, QUndoCommand *parent) :
-    QUndoCommand(parent),
+ApplyGreedyPixelFillCommand::ApplyGreedyPixelFillCommand(ImageCanvas *canvas, int layerIndex, const QColor &targetColour,
+    int tolerance, const QColor &colour, const TexturedFillParameters *texturedFillParameters, quint32 seed,
+    QUndoCommand *parent) :
+    UndoCommand(parent),
     mCanvas(canvas),
     mLayerIndex(layerIndex),
-    mPreviousImage(previousImage),
-    mNewImage(newImage)
+    mTargetColour(targetColour),
+    mTolerance(tolerance),
+    mColour(colour),
+    mTexturedFillColourProvider(texturedFillParameters ? new TexturedFillColourProvider(*texturedFillParameters, seed) : nullptr)
 {
+    const QImage *image = canvas->imageForLayerAt(layerIndex);
+    mArea = imageGreedyPixelFillMask(*image, image->rect(), targetColour, tolerance).dirtyRect();
+    mPreviousImage = UndoImage(image->copy(mArea));
+
     qCDebug(lcApplyGreedyPixelFillCommand) << "constructed" << this;
 }
 
 void ApplyGreedyPixelFillCommand::undo()
 {
     qCDebug(lcApplyGreedyPixelFillCommand) << "undoing" << this;
-    mCanvas->replaceImage(mLayerIndex, mPreviousImage);
+    if (isDiscarded() || isSkipped())
+        return;
+
+    mCanvas->replacePortionOfImage(mLayerIndex, mArea, mPreviousImage.image());
 }
 
 void ApplyGreedyPixelFillCommand::redo()
 {
     qCDebug(lcApplyGreedyPixelFillCommand) << "redoing" << this;
-    mCanvas->replaceImage(mLayerIndex, mNewImage);
+    if (isDiscarded() || isSkipped())
+        return;
+
+    mCanvas->applyGreedyPixelFillTool(mLayerIndex, mTargetColour, mTolerance, mColour, mTexturedFillColourProvider.data());
 }
 
 int ApplyGreedyPixelFillCommand::id() const
@@ -54,10 +67,25 @@ int ApplyGreedyPixelFillCommand::id() const
     return -1;
 }
 
+bool ApplyGreedyPixelFillCommand::changesOnlyImages() const
+{
+    return true;
+}
+
+QVector<UndoImage*> ApplyGreedyPixelFillCommand::imagePayloads()
+{
+    return { &mPreviousImage };
+}
+
 QDebug operator<<(QDebug debug, const ApplyGreedyPixelFillCommand *command)
 {
     debug.nospace() << "(ApplyGreedyPixelFillCommand"
         << " layerIndex=" << command->mLayerIndex
+        << " area=" << command->mArea
+        << " targetColour=" << command->mTargetColour
+        << " tolerance=" << command->mTolerance
+        << " colour=" << command->mColour
+        << " seed=" << (command->mTexturedFillColourProvider ? command->mTexturedFillColourProvider->seed() : 0u)
         << ")";
     return debug.space();
 }
@@ -22,30 +22,47 @@
 
 #include <QDebug>
 #include <QImage>
-#include <QUndoCommand>
+#include <QScopedPointer>
 
+#include "fillalgorithms.h"
 #include "slate-global.h"
+#include "undocommand.h"
+#include "undoimage.h"
 
 class ImageCanvas;
+class TexturedFillParameters;
 
-class SLATE_EXPORT ApplyGreedyPixelFillCommand : public QUndoCommand
+class SLATE_EXPORT ApplyGreedyPixelFillCommand : public UndoCommand
 {
 public:
-    ApplyGreedyPixelFillCommand(ImageCanvas *canvas, int layerIndex,const QImage &previousImage,
-        const QImage &newImage, QUndoCommand *parent = nullptr);
+    // If texturedFillParameters is non-null, the fill is textured using seed,
+    // so that redoing it produces exactly the same pixels each time.
+    ApplyGreedyPixelFillCommand(ImageCanvas *canvas, int layerIndex, const QColor &targetColour, int tolerance,
+        const QColor &colour, const TexturedFillParameters *texturedFillParameters = nullptr, quint32 seed = 0,
+        QUndoCommand *parent = nullptr);
 
     void undo() override;
     void redo() override;
 
     int id() const override;
+    bool changesOnlyImages() const override;
+
+protected:
+    QVector<UndoImage*> imagePayloads() override;
 
 private:
     friend QDebug operator<<(QDebug debug, const ApplyGreedyPixelFillCommand *command);
 
     ImageCanvas *mCanvas;
     int mLayerIndex;
-    QImage mPreviousImage;
-    QImage mNewImage;
+    // Greedy fills can touch pixels anywhere in the layer, but usually
+    // a much smaller area than the layer itself needs to be kept for undoing.
+    QRect mArea;
+    UndoImage mPreviousImage;
+    QColor mTargetColour;
+    int mTolerance;
+    QColor mColour;
+    QScopedPointer<TexturedFillColourProvider> mTexturedFillColourProvider;
 };
 
 #endif // APPLYGREEDYPIXELFILLCOMMAND_H
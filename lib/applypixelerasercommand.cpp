@@ -25,32 +25,26 @@
 
 Q_LOGGING_CATEGORY(lcApplyPixelEraserCommand, "app.undo.applyPixelEraserCommand")
 
-ApplyPixelEraserCommand::ApplyPixelEraserCommand(ImageCanvas *canvas, int layerIndex, const QVector<QPoint> &scenePositions,
-    const QVector<QColor> &previousColours, QUndoCommand *parent) :
-    QUndoCommand(parent),
+ApplyPixelEraserCommand::ApplyPixelEraserCommand(ImageCanvas *canvas, int layerIndex, const PixelSpans &previousPixels,
+    QUndoCommand *parent) :
+    UndoCommand(parent),
     mCanvas(canvas),
-    mLayerIndex(layerIndex)
+    mLayerIndex(layerIndex),
+    mPreviousPixels(previousPixels)
 {
-    mScenePositions = scenePositions;
-    mPreviousColours = previousColours;
-
     qCDebug(lcApplyPixelEraserCommand) << "constructed" << this;
 }
 
 void ApplyPixelEraserCommand::undo()
 {
     qCDebug(lcApplyPixelEraserCommand) << "undoing" << this;
-    for (int i = 0; i < mScenePositions.size(); ++i) {
-        mCanvas->applyPixelPenTool(mLayerIndex, mScenePositions.at(i), mPreviousColours.at(i));
-    }
+    mCanvas->restorePixelSpans(mLayerIndex, mPreviousPixels);
 }
 
 void ApplyPixelEraserCommand::redo()
 {
     qCDebug(lcApplyPixelEraserCommand) << "redoing" << this;
-    for (int i = 0; i < mScenePositions.size(); ++i) {
-        mCanvas->applyPixelPenTool(mLayerIndex, mScenePositions.at(i), QColor(Qt::transparent));
-    }
+    mCanvas->applyPixelSpans(mLayerIndex, mPreviousPixels, QColor(Qt::transparent));
 }
 
 int ApplyPixelEraserCommand::id() const
@@ -58,6 +52,11 @@ int ApplyPixelEraserCommand::id() const
     return ApplyPixelEraserCommandId;
 }
 
+qint64 ApplyPixelEraserCommand::byteSize() const
+{
+    return mPreviousPixels.byteSize();
+}
+
 bool ApplyPixelEraserCommand::mergeWith(const QUndoCommand *other)
 {
     const ApplyPixelEraserCommand *otherCommand = dynamic_cast<const ApplyPixelEraserCommand*>(other);
@@ -66,14 +65,13 @@ bool ApplyPixelEraserCommand::mergeWith(const QUndoCommand *other)
     }
 
     // Duplicate pixel; we can just discard the other command.
-    if (otherCommand->mScenePositions.size() == 1 && mScenePositions.contains(otherCommand->mScenePositions.first())) {
+    if (otherCommand->mPreviousPixels.pixelCount() == 1 && mPreviousPixels.contains(otherCommand->mPreviousPixels.lastPosition())) {
         return true;
     }
 
-    // A unique pixel that we haven't touched yet; add it.
+    // Pixels that we haven't necessarily touched yet; add them.
     qCDebug(lcApplyPixelEraserCommand) << "\nmerging:\n    " << otherCommand << "\nwith:\n    " << this;
-    mScenePositions.append(otherCommand->mScenePositions);
-    mPreviousColours.append(otherCommand->mPreviousColours);
+    mPreviousPixels.append(otherCommand->mPreviousPixels);
     return true;
 }
 
@@ -81,8 +79,7 @@ QDebug operator<<(QDebug debug, const ApplyPixelEraserCommand *command)
 {
     debug.nospace() << "(ApplyPixelEraserCommand"
         << " layerIndex=" << command->mLayerIndex
-        << ", scenePositions=" << command->mScenePositions
-        << ", previousColours=" << command->mPreviousColours
+        << ", previousPixels=" << command->mPreviousPixels
         << ")";
     return debug.space();
 }
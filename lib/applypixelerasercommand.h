@@ -20,19 +20,17 @@
 #ifndef APPLYPIXELERASERCOMMAND_H
 #define APPLYPIXELERASERCOMMAND_H
 
-#include <QColor>
 #include <QDebug>
-#include <QPoint>
-#include <QVector>
-#include <QUndoCommand>
 
 #include "imagecanvas.h"
+#include "pixelspans.h"
 #include "slate-global.h"
+#include "undocommand.h"
 
-class SLATE_EXPORT ApplyPixelEraserCommand : public QUndoCommand
+class SLATE_EXPORT ApplyPixelEraserCommand : public UndoCommand
 {
 public:
-    ApplyPixelEraserCommand(ImageCanvas *canvas, int layerIndex, const QVector<QPoint> &scenePositions, const QVector<QColor> &previousColours,
+    ApplyPixelEraserCommand(ImageCanvas *canvas, int layerIndex, const PixelSpans &previousPixels,
         QUndoCommand *parent = nullptr);
 
     void undo() override;
@@ -41,13 +39,15 @@ public:
     int id() const override;
     bool mergeWith(const QUndoCommand *other) override;
 
+    qint64 byteSize() const override;
+
 private:
     friend QDebug operator<<(QDebug debug, const ApplyPixelEraserCommand *command);
 
     ImageCanvas *mCanvas;
     int mLayerIndex;
-    QVector<QPoint> mScenePositions;
-    QVector<QColor> mPreviousColours;
+    // The scene positions of the pixels and their colours before they were erased.
+    PixelSpans mPreviousPixels;
 };
 
 
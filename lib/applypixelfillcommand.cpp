@@ -25,13 +25,16 @@
 
 Q_LOGGING_CATEGORY(lcApplyPixelFillCommand, "app.undo.applyPixelFillCommand")
 
-ApplyPixelFillCommand::ApplyPixelFillCommand(ImageCanvas *canvas, int layerIndex,
-    const QImage &previousImage, const QImage &newImage, QUndoCommand *parent) :
-    QUndoCommand(parent),
+ApplyPixelFillCommand::ApplyPixelFillCommand(ImageCanvas *canvas, int layerIndex, const FillMask &mask,
+    const QColor &colour, const TexturedFillParameters *texturedFillParameters, quint32 seed, QUndoCommand *parent) :
+    UndoCommand(parent),
     mCanvas(canvas),
     mLayerIndex(layerIndex),
-    mPreviousImage(previousImage),
-    mNewImage(newImage)
+    mArea(mask.dirtyRect()),
+    mPreviousImage(canvas->imageForLayerAt(layerIndex)->copy(mArea)),
+    mMask(mask.croppedToDirtyRect()),
+    mColour(colour),
+    mTexturedFillColourProvider(texturedFillParameters ? new TexturedFillColourProvider(*texturedFillParameters, seed) : nullptr)
 {
     qCDebug(lcApplyPixelFillCommand) << "constructed" << this;
 }
@@ -39,13 +42,19 @@ ApplyPixelFillCommand::ApplyPixelFillCommand(ImageCanvas *canvas, int layerIndex
 void ApplyPixelFillCommand::undo()
 {
     qCDebug(lcApplyPixelFillCommand) << "undoing" << this;
-    mCanvas->replaceImage(mLayerIndex, mPreviousImage);
+    if (isDiscarded() || isSkipped())
+        return;
+
+    mCanvas->replacePortionOfImage(mLayerIndex, mArea, mPreviousImage.image());
 }
 
 void ApplyPixelFillCommand::redo()
 {
     qCDebug(lcApplyPixelFillCommand) << "redoing" << this;
-    mCanvas->replaceImage(mLayerIndex, mNewImage);
+    if (isDiscarded() || isSkipped())
+        return;
+
+    mCanvas->applyPixelFillTool(mLayerIndex, mMask, mColour, mTexturedFillColourProvider.data());
 }
 
 int ApplyPixelFillCommand::id() const
@@ -53,10 +62,28 @@ int ApplyPixelFillCommand::id() const
     return -1;
 }
 
+bool ApplyPixelFillCommand::changesOnlyImages() const
+{
+    return true;
+}
+
+qint64 ApplyPixelFillCommand::byteSize() const
+{
+    return UndoCommand::byteSize() + mMask.byteSize();
+}
+
+QVector<UndoImage*> ApplyPixelFillCommand::imagePayloads()
+{
+    return { &mPreviousImage };
+}
+
 QDebug operator<<(QDebug debug, const ApplyPixelFillCommand *command)
 {
     debug.nospace() << "(ApplyPixelFillCommand"
         << " layerIndex=" << command->mLayerIndex
+        << " area=" << command->mArea
+        << " colour=" << command->mColour
+        << " seed=" << (command->mTexturedFillColourProvider ? command->mTexturedFillColourProvider->seed() : 0u)
         << ")";
     return debug.space();
 }
@@ -22,30 +22,47 @@
 
 #include <QDebug>
 #include <QImage>
-#include <QUndoCommand>
+#include <QScopedPointer>
 
+#include "fillalgorithms.h"
 #include "slate-global.h"
+#include "undocommand.h"
+#include "undoimage.h"
 
 class ImageCanvas;
+class TexturedFillParameters;
 
-class SLATE_EXPORT ApplyPixelFillCommand : public QUndoCommand
+class SLATE_EXPORT ApplyPixelFillCommand : public UndoCommand
 {
 public:
-    ApplyPixelFillCommand(ImageCanvas *canvas, int layerIndex, const QImage &previousImage,
-        const QImage &newImage, QUndoCommand *parent = nullptr);
+    // If texturedFillParameters is non-null, the fill is textured using seed,
+    // so that redoing it produces exactly the same pixels each time.
+    ApplyPixelFillCommand(ImageCanvas *canvas, int layerIndex, const FillMask &mask, const QColor &colour,
+        const TexturedFillParameters *texturedFillParameters = nullptr, quint32 seed = 0,
+        QUndoCommand *parent = nullptr);
 
     void undo() override;
     void redo() override;
 
     int id() const override;
 
+    qint64 byteSize() const override;
+    bool changesOnlyImages() const override;
+
+protected:
+    QVector<UndoImage*> imagePayloads() override;
+
 private:
     friend QDebug operator<<(QDebug debug, const ApplyPixelFillCommand *command);
 
     ImageCanvas *mCanvas;
     int mLayerIndex;
-    QImage mPreviousImage;
-    QImage mNewImage;
+    // The bounding rect of the filled pixels; only this part of the layer is kept for undoing.
+    QRect mArea;
+    UndoImage mPreviousImage;
+    FillMask mMask;
+    QColor mColour;
+    QScopedPointer<TexturedFillColourProvider> mTexturedFillColourProvider;
 };
 
 #endif // APPLYPIXELFILLCOMMAND_H
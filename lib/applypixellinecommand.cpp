@@ -27,17 +27,23 @@
 
 Q_LOGGING_CATEGORY(lcApplyPixelLineCommand, "app.undo.applyPixelLineCommand")
 
+static const int strokeBlockSize = 64;
+
+static quint64 strokeBlockKey(int blockX, int blockY)
+{
+    return (quint64(quint32(blockY)) << 32) | quint32(blockX);
+}
+
 // The undo command for lines needs the project image before and after
 // the line was drawn on it.
 ApplyPixelLineCommand::ApplyPixelLineCommand(ImageCanvas *canvas, int layerIndex, QImage &currentProjectImage, const QPointF point1, const QPointF point2,
         const QPointF &newLastPixelPenReleaseScenePos, const QPointF &oldLastPixelPenReleaseScenePos,
         const QPainter::CompositionMode mode, QUndoCommand *parent) :
-    QUndoCommand(parent),
+    UndoCommand(parent),
     mCanvas(canvas),
     mLayerIndex(layerIndex),
     mNewLastPixelPenReleaseScenePos(newLastPixelPenReleaseScenePos),
-    mOldLastPixelPenReleaseScenePos(oldLastPixelPenReleaseScenePos),
-    subImageDatas()
+    mOldLastPixelPenReleaseScenePos(oldLastPixelPenReleaseScenePos)
 {
     const QRect lineRect = mCanvas->normalisedLineRect(point1, point2);
     const QList<ImageCanvas::SubImage> subImages = canvas->subImagesInBounds(lineRect);
@@ -45,12 +51,25 @@ ApplyPixelLineCommand::ApplyPixelLineCommand(ImageCanvas *canvas, int layerIndex
         // subimage-space to scene-space offset
         const QPoint offset = subImage.bounds.topLeft() - subImage.offset;
         // line rect offset to scene space and clipped to subimage bounds
-        const QRect subImageLineRect = subImage.bounds.intersected(lineRect.translated(offset));
-
-        SubImageData subImageData;
-        subImageData.subImage = subImage;
-        subImageData.lineRect = subImageLineRect;
-        subImageData.imageWithoutLine = currentProjectImage.copy(subImageLineRect);
+        const QRect subImageLineRect = subImage.bounds.intersected(lineRect.translated(offset))
+            .intersected(currentProjectImage.rect());
+        if (subImageLineRect.isEmpty())
+            continue;
+
+        // Store the blocks that the line is about to touch before drawing it.
+        for (int blockY = subImageLineRect.top() / strokeBlockSize; blockY <= subImageLineRect.bottom() / strokeBlockSize; ++blockY) {
+            for (int blockX = subImageLineRect.left() / strokeBlockSize; blockX <= subImageLineRect.right() / strokeBlockSize; ++blockX) {
+                const quint64 key = strokeBlockKey(blockX, blockY);
+                if (mBlocks.contains(key))
+                    continue;
+
+                StrokeBlock block;
+                block.rect = QRect(blockX * strokeBlockSize, blockY * strokeBlockSize, strokeBlockSize, strokeBlockSize)
+                    .intersected(currentProjectImage.rect());
+                block.imageWithoutStroke = currentProjectImage.copy(block.rect);
+                mBlocks.insert(key, block);
+            }
+        }
 
         QPainter painter(&currentProjectImage);
         // Clip drawing to subimage
@@ -58,11 +77,11 @@ ApplyPixelLineCommand::ApplyPixelLineCommand(ImageCanvas *canvas, int layerIndex
         // Draw line with offset to subimage
         mCanvas->drawLine(&painter, point1 + offset, point2 + offset, mode);
         painter.end();
-
-        subImageData.imageWithLine = currentProjectImage.copy(subImageLineRect);
-        subImageDatas.append(subImageData);
     }
 
+    for (StrokeBlock &block : mBlocks)
+        block.imageWithStroke = currentProjectImage.copy(block.rect);
+
     qCDebug(lcApplyPixelLineCommand) << "constructed" << this;
 }
 
@@ -74,16 +93,22 @@ ApplyPixelLineCommand::~ApplyPixelLineCommand()
 void ApplyPixelLineCommand::undo()
 {
     qCDebug(lcApplyPixelLineCommand) << "undoing" << this;
-    for (auto const &subImageData : subImageDatas) {
-        mCanvas->applyPixelLineTool(mLayerIndex, subImageData.imageWithoutLine, subImageData.lineRect, mOldLastPixelPenReleaseScenePos);
+    if (isDiscarded() || isSkipped())
+        return;
+
+    for (auto const &block : qAsConst(mBlocks)) {
+        mCanvas->applyPixelLineTool(mLayerIndex, block.imageWithoutStroke.image(), block.rect, mOldLastPixelPenReleaseScenePos);
     }
 }
 
 void ApplyPixelLineCommand::redo()
 {
     qCDebug(lcApplyPixelLineCommand) << "redoing" << this;
-    for (auto const &subImageData : subImageDatas) {
-        mCanvas->applyPixelLineTool(mLayerIndex, subImageData.imageWithLine, subImageData.lineRect, mNewLastPixelPenReleaseScenePos);
+    if (isDiscarded() || isSkipped())
+        return;
+
+    for (auto const &block : qAsConst(mBlocks)) {
+        mCanvas->applyPixelLineTool(mLayerIndex, block.imageWithStroke.image(), block.rect, mNewLastPixelPenReleaseScenePos);
     }
 }
 
@@ -92,16 +117,49 @@ int ApplyPixelLineCommand::id() const
     return ApplyPixelLineCommandId;
 }
 
-bool ApplyPixelLineCommand::mergeWith(const QUndoCommand *)
+bool ApplyPixelLineCommand::changesOnlyImages() const
 {
-    return false;
+    return true;
+}
+
+bool ApplyPixelLineCommand::mergeWith(const QUndoCommand *other)
+{
+    // QUndoStack only tries to merge commands within the same macro,
+    // so we don't need to worry about merging two separate strokes.
+    const ApplyPixelLineCommand *otherCommand = dynamic_cast<const ApplyPixelLineCommand*>(other);
+    if (!otherCommand || otherCommand->mCanvas != mCanvas || otherCommand->mLayerIndex != mLayerIndex)
+        return false;
+
+    for (auto it = otherCommand->mBlocks.constBegin(); it != otherCommand->mBlocks.constEnd(); ++it) {
+        auto existingBlock = mBlocks.find(it.key());
+        if (existingBlock == mBlocks.end()) {
+            // The stroke hadn't touched this block yet, so the other command has its original pixels.
+            mBlocks.insert(it.key(), it.value());
+        } else {
+            existingBlock->imageWithStroke = it->imageWithStroke;
+        }
+    }
+
+    mNewLastPixelPenReleaseScenePos = otherCommand->mNewLastPixelPenReleaseScenePos;
+    return true;
+}
+
+QVector<UndoImage*> ApplyPixelLineCommand::imagePayloads()
+{
+    QVector<UndoImage*> images;
+    images.reserve(mBlocks.size() * 2);
+    for (StrokeBlock &block : mBlocks) {
+        images.append(&block.imageWithoutStroke);
+        images.append(&block.imageWithStroke);
+    }
+    return images;
 }
 
 QDebug operator<<(QDebug debug, const ApplyPixelLineCommand *command)
 {
     debug.nospace() << "(ApplyPixelLineCommand"
         << " layerIndex=" << command->mLayerIndex
-//        << ", lineRect" << command->mLineRect
+        << ", blocks=" << command->mBlocks.size()
         << ", newLastPixelPenReleaseScenePos=" << command->mNewLastPixelPenReleaseScenePos
         << ", oldLastPixelPenReleaseScenePos=" << command->mOldLastPixelPenReleaseScenePos
         << ")";
@@ -21,13 +21,19 @@
 #define APPLYPIXELLINECOMMAND_H
 
 #include <QDebug>
+#include <QHash>
+#include <QImage>
 #include <QPointF>
-#include <QUndoCommand>
 
 #include "imagecanvas.h"
 #include "slate-global.h"
+#include "undocommand.h"
+#include "undoimage.h"
 
-class SLATE_EXPORT ApplyPixelLineCommand : public QUndoCommand
+// Each segment of a stroke creates one of these commands, but consecutive segments
+// (which all belong to the same press-to-release macro) are merged into the first one,
+// so that a whole stroke ends up as a single command.
+class SLATE_EXPORT ApplyPixelLineCommand : public UndoCommand
 {
 public:
     ApplyPixelLineCommand(ImageCanvas *canvas, int layerIndex, QImage &currentProjectImage, const QPointF point1, const QPointF point2,
@@ -40,6 +46,10 @@ public:
 
     int id() const override;
     bool mergeWith(const QUndoCommand *other) override;
+    bool changesOnlyImages() const override;
+
+protected:
+    QVector<UndoImage*> imagePayloads() override;
 
 private:
     friend QDebug operator<<(QDebug debug, const ApplyPixelLineCommand *command);
@@ -49,13 +59,15 @@ private:
     QPointF mNewLastPixelPenReleaseScenePos;
     QPointF mOldLastPixelPenReleaseScenePos;
 
-    struct SubImageData {
-        ImageCanvas::SubImage subImage;
-        QRect lineRect;
-        QImage imageWithoutLine;
-        QImage imageWithLine;
+    // The image is divided into fixed-size blocks, and the stroke only stores the ones it touches.
+    // A block's pixels from before the stroke are stored once, when the stroke first touches it,
+    // and the pixels from after the stroke are updated as later segments are merged in.
+    struct StrokeBlock {
+        QRect rect;
+        UndoImage imageWithoutStroke;
+        UndoImage imageWithStroke;
     };
-    QList<SubImageData> subImageDatas;
+    QHash<quint64, StrokeBlock> mBlocks;
 };
 
 
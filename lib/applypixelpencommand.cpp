@@ -25,33 +25,27 @@
 
 Q_LOGGING_CATEGORY(lcApplyPixelPenCommand, "app.undo.applyPixelPenCommand")
 
-ApplyPixelPenCommand::ApplyPixelPenCommand(ImageCanvas *canvas, int layerIndex, const QVector<QPoint> &scenePositions,
-    const QVector<QColor> &previousColours, const QColor &colour, QUndoCommand *parent) :
-    QUndoCommand(parent),
+ApplyPixelPenCommand::ApplyPixelPenCommand(ImageCanvas *canvas, int layerIndex, const PixelSpans &previousPixels,
+    const QColor &colour, QUndoCommand *parent) :
+    UndoCommand(parent),
     mCanvas(canvas),
     mLayerIndex(layerIndex),
+    mPreviousPixels(previousPixels),
     mColour(colour)
 {
-    mScenePositions = scenePositions;
-    mPreviousColours = previousColours;
-
     qCDebug(lcApplyPixelPenCommand) << "constructed" << this;
 }
 
 void ApplyPixelPenCommand::undo()
 {
     qCDebug(lcApplyPixelPenCommand) << "undoing" << this;
-    for (int i = 0; i < mScenePositions.size(); ++i) {
-        mCanvas->applyPixelPenTool(mLayerIndex, mScenePositions.at(i), mPreviousColours.at(i), i == mScenePositions.size() - 1);
-    }
+    mCanvas->restorePixelSpans(mLayerIndex, mPreviousPixels, true);
 }
 
 void ApplyPixelPenCommand::redo()
 {
     qCDebug(lcApplyPixelPenCommand) << "redoing" << this;
-    for (int i = 0; i < mScenePositions.size(); ++i) {
-        mCanvas->applyPixelPenTool(mLayerIndex, mScenePositions.at(i), mColour, i == mScenePositions.size() - 1);
-    }
+    mCanvas->applyPixelSpans(mLayerIndex, mPreviousPixels, mColour, true);
 }
 
 int ApplyPixelPenCommand::id() const
@@ -59,6 +53,11 @@ int ApplyPixelPenCommand::id() const
     return ApplyPixelPenCommandId;
 }
 
+qint64 ApplyPixelPenCommand::byteSize() const
+{
+    return mPreviousPixels.byteSize();
+}
+
 bool ApplyPixelPenCommand::mergeWith(const QUndoCommand *other)
 {
     const ApplyPixelPenCommand *otherCommand = dynamic_cast<const ApplyPixelPenCommand*>(other);
@@ -71,7 +70,7 @@ bool ApplyPixelPenCommand::mergeWith(const QUndoCommand *other)
     }
 
     // Duplicate scene positions; we can just discard the other command.
-    if (otherCommand->mScenePositions == mScenePositions) {
+    if (otherCommand->mPreviousPixels.hasSamePositions(mPreviousPixels)) {
         qCDebug(lcApplyPixelPenCommand) << "merging duplicate pixel pen commands";
         return true;
     }
@@ -81,8 +80,7 @@ bool ApplyPixelPenCommand::mergeWith(const QUndoCommand *other)
 
 QDebug operator<<(QDebug debug, const ApplyPixelPenCommand *command)
 {
-    debug.nospace() << "(ApplyPixelPenCommand scenePositions=" << command->mScenePositions
-        << ", previousColours=" << command->mPreviousColours
+    debug.nospace() << "(ApplyPixelPenCommand previousPixels=" << command->mPreviousPixels
         << ", colour=" << command->mColour
         << ")";
     return debug.space();
@@ -22,17 +22,16 @@
 
 #include <QColor>
 #include <QDebug>
-#include <QPoint>
-#include <QVector>
-#include <QUndoCommand>
 
 #include "imagecanvas.h"
+#include "pixelspans.h"
 #include "slate-global.h"
+#include "undocommand.h"
 
-class SLATE_EXPORT ApplyPixelPenCommand : public QUndoCommand
+class SLATE_EXPORT ApplyPixelPenCommand : public UndoCommand
 {
 public:
-    ApplyPixelPenCommand(ImageCanvas *canvas, int layerIndex, const QVector<QPoint> &scenePositions, const QVector<QColor> &previousColours,
+    ApplyPixelPenCommand(ImageCanvas *canvas, int layerIndex, const PixelSpans &previousPixels,
         const QColor &colour, QUndoCommand *parent = nullptr);
 
     void undo() override;
@@ -41,13 +40,15 @@ public:
     int id() const override;
     bool mergeWith(const QUndoCommand *other) override;
 
+    qint64 byteSize() const override;
+
 private:
     friend QDebug operator<<(QDebug debug, const ApplyPixelPenCommand *command);
 
     ImageCanvas *mCanvas;
     int mLayerIndex;
-    QVector<QPoint> mScenePositions;
-    QVector<QColor> mPreviousColours;
+    // The scene positions of the pixels and their colours before the pen was applied.
+    PixelSpans mPreviousPixels;
     QColor mColour;
 };
 
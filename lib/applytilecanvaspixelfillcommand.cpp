@@ -26,32 +26,27 @@
 
 Q_LOGGING_CATEGORY(lcApplyTileCanvasPixelFillCommand, "app.undo.applyTileCanvasPixelFillCommand")
 
-ApplyTileCanvasPixelFillCommand::ApplyTileCanvasPixelFillCommand(TileCanvas *canvas, const QVector<QPoint> &scenePositions,
+ApplyTileCanvasPixelFillCommand::ApplyTileCanvasPixelFillCommand(TileCanvas *canvas, const FillMask &mask,
     const QColor &previousColour, const QColor &colour, QUndoCommand *parent) :
-    QUndoCommand(parent),
+    UndoCommand(parent),
     mCanvas(canvas),
+    mMask(mask),
+    mPreviousColour(previousColour),
     mColour(colour)
 {
-    mScenePositions = scenePositions;
-    mPreviousColour = previousColour;
-
     qCDebug(lcApplyTileCanvasPixelFillCommand) << "constructed" << this;
 }
 
 void ApplyTileCanvasPixelFillCommand::undo()
 {
     qCDebug(lcApplyTileCanvasPixelFillCommand) << "undoing" << this;
-    for (int i = 0; i < mScenePositions.size(); ++i) {
-        mCanvas->applyPixelPenTool(-1, mScenePositions.at(i), mPreviousColour);
-    }
+    mCanvas->applyPixelFillTool(mMask, mPreviousColour);
 }
 
 void ApplyTileCanvasPixelFillCommand::redo()
 {
     qCDebug(lcApplyTileCanvasPixelFillCommand) << "redoing" << this;
-    for (int i = 0; i < mScenePositions.size(); ++i) {
-        mCanvas->applyPixelPenTool(-1, mScenePositions.at(i), mColour);
-    }
+    mCanvas->applyPixelFillTool(mMask, mColour);
 }
 
 int ApplyTileCanvasPixelFillCommand::id() const
@@ -59,10 +54,15 @@ int ApplyTileCanvasPixelFillCommand::id() const
     return -1;
 }
 
+qint64 ApplyTileCanvasPixelFillCommand::byteSize() const
+{
+    return mMask.byteSize();
+}
+
 QDebug operator<<(QDebug debug, const ApplyTileCanvasPixelFillCommand *command)
 {
-    debug.nospace() << "(ApplyTileCanvasPixelFillCommand scenePositions=" << command->mScenePositions
-        << ", previousColours=" << command->mPreviousColour
+    debug.nospace() << "(ApplyTileCanvasPixelFillCommand dirtyRect=" << command->mMask.dirtyRect()
+        << ", previousColour=" << command->mPreviousColour
         << ", colour=" << command->mColour
         << ")";
     return debug.space();
@@ -22,18 +22,17 @@
 
 #include <QColor>
 #include <QDebug>
-#include <QPoint>
-#include <QUndoCommand>
-#include <QVector>
 
+#include "fillalgorithms.h"
 #include "slate-global.h"
+#include "undocommand.h"
 
 class TileCanvas;
 
-class SLATE_EXPORT ApplyTileCanvasPixelFillCommand : public QUndoCommand
+class SLATE_EXPORT ApplyTileCanvasPixelFillCommand : public UndoCommand
 {
 public:
-    ApplyTileCanvasPixelFillCommand(TileCanvas *canvas, const QVector<QPoint> &scenePositions, const QColor &previousColour,
+    ApplyTileCanvasPixelFillCommand(TileCanvas *canvas, const FillMask &mask, const QColor &previousColour,
         const QColor &colour, QUndoCommand *parent = nullptr);
 
     void undo() override;
@@ -41,11 +40,13 @@ public:
 
     int id() const override;
 
+    qint64 byteSize() const override;
+
 private:
     friend QDebug operator<<(QDebug debug, const ApplyTileCanvasPixelFillCommand *command);
 
     TileCanvas *mCanvas;
-    QVector<QPoint> mScenePositions;
+    FillMask mMask;
     QColor mPreviousColour;
     QColor mColour;
 };
@@ -28,7 +28,7 @@ Q_LOGGING_CATEGORY(lcApplyTileEraserCommand, "app.undo.applyTileEraserCommand")
 
 ApplyTileEraserCommand::ApplyTileEraserCommand(TileCanvas *canvas, const QPoint &tilePos,
     int previousId, QUndoCommand *parent) :
-    QUndoCommand(parent),
+    UndoCommand(parent),
     mCanvas(canvas)
 {
     mTilePositions.append(tilePos);
@@ -58,6 +58,11 @@ int ApplyTileEraserCommand::id() const
     return ApplyTileEraserCommandId;
 }
 
+qint64 ApplyTileEraserCommand::byteSize() const
+{
+    return mTilePositions.size() * qint64(sizeof(QPoint)) + mPreviousIds.size() * qint64(sizeof(int));
+}
+
 bool ApplyTileEraserCommand::mergeWith(const QUndoCommand *other)
 {
     const ApplyTileEraserCommand *otherCommand = dynamic_cast<const ApplyTileEraserCommand*>(other);
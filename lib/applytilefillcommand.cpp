@@ -25,33 +25,27 @@
 
 Q_LOGGING_CATEGORY(lcApplyTileFillCommand, "app.undo.applyTileFillCommand")
 
-ApplyTileFillCommand::ApplyTileFillCommand(TileCanvas *canvas, const QVector<QPoint> &tilePositions,
+ApplyTileFillCommand::ApplyTileFillCommand(TileCanvas *canvas, const QVector<TileFillRun> &tileRuns,
     int previousTile, int tile, QUndoCommand *parent) :
-    QUndoCommand(parent),
+    UndoCommand(parent),
     mCanvas(canvas),
+    mTileRuns(tileRuns),
     mPreviousTile(previousTile),
     mTile(tile)
 {
-    mTilePositions = tilePositions;
-    mPreviousTile = previousTile;
-
     qCDebug(lcApplyTileFillCommand) << "constructed" << this;
 }
 
 void ApplyTileFillCommand::undo()
 {
     qCDebug(lcApplyTileFillCommand) << "undoing" << this;
-    for (int i = 0; i < mTilePositions.size(); ++i) {
-        mCanvas->applyTilePenTool(mTilePositions.at(i), mPreviousTile);
-    }
+    mCanvas->applyTileFillTool(mTileRuns, mPreviousTile);
 }
 
 void ApplyTileFillCommand::redo()
 {
     qCDebug(lcApplyTileFillCommand) << "redoing" << this;
-    for (int i = 0; i < mTilePositions.size(); ++i) {
-        mCanvas->applyTilePenTool(mTilePositions.at(i), mTile);
-    }
+    mCanvas->applyTileFillTool(mTileRuns, mTile);
 }
 
 int ApplyTileFillCommand::id() const
@@ -59,6 +53,11 @@ int ApplyTileFillCommand::id() const
     return ApplyTileFillCommandId;
 }
 
+qint64 ApplyTileFillCommand::byteSize() const
+{
+    return mTileRuns.size() * qint64(sizeof(TileFillRun));
+}
+
 bool ApplyTileFillCommand::mergeWith(const QUndoCommand *)
 {
     return false;
@@ -66,7 +65,7 @@ bool ApplyTileFillCommand::mergeWith(const QUndoCommand *)
 
 QDebug operator<<(QDebug debug, const ApplyTileFillCommand *command)
 {
-    debug.nospace() << "(ApplyTileFillCommand scenePositions=" << command->mTilePositions
+    debug.nospace() << "(ApplyTileFillCommand tileRuns=" << command->mTileRuns.size()
         << ", previousTile=" << command->mPreviousTile
         << ", tile=" << command->mTile
         << ")";
@@ -24,15 +24,16 @@
 #include <QDebug>
 #include <QPoint>
 #include <QVector>
-#include <QUndoCommand>
 
+#include "fillalgorithms.h"
 #include "slate-global.h"
 #include "tilecanvas.h"
+#include "undocommand.h"
 
-class SLATE_EXPORT ApplyTileFillCommand : public QUndoCommand
+class SLATE_EXPORT ApplyTileFillCommand : public UndoCommand
 {
 public:
-    ApplyTileFillCommand(TileCanvas *canvas, const QVector<QPoint> &tilePositions, int previousTile,
+    ApplyTileFillCommand(TileCanvas *canvas, const QVector<TileFillRun> &tileRuns, int previousTile,
         int tile, QUndoCommand *parent = nullptr);
 
     void undo() override;
@@ -41,11 +42,13 @@ public:
     int id() const override;
     bool mergeWith(const QUndoCommand *other) override;
 
+    qint64 byteSize() const override;
+
 private:
     friend QDebug operator<<(QDebug debug, const ApplyTileFillCommand *command);
 
     TileCanvas *mCanvas;
-    QVector<QPoint> mTilePositions;
+    QVector<TileFillRun> mTileRuns;
     int mPreviousTile;
     int mTile;
 };
@@ -27,7 +27,7 @@ Q_LOGGING_CATEGORY(lcApplyTilePenCommand, "app.undo.applyTilePenCommand")
 
 ApplyTilePenCommand::ApplyTilePenCommand(TileCanvas *canvas, const QPoint &tilePos,
     int previousId, int id, QUndoCommand *parent) :
-    QUndoCommand(parent),
+    UndoCommand(parent),
     mCanvas(canvas),
     mId(id)
 {
@@ -58,6 +58,11 @@ int ApplyTilePenCommand::id() const
     return ApplyTilePenCommandId;
 }
 
+qint64 ApplyTilePenCommand::byteSize() const
+{
+    return mTilePositions.size() * qint64(sizeof(QPoint)) + mPreviousIds.size() * qint64(sizeof(int));
+}
+
 bool ApplyTilePenCommand::mergeWith(const QUndoCommand *other)
 {
     const ApplyTilePenCommand *otherCommand = dynamic_cast<const ApplyTilePenCommand*>(other);
@@ -24,12 +24,12 @@
 #include <QDebug>
 #include <QPoint>
 #include <QVector>
-#include <QUndoCommand>
 
 #include "slate-global.h"
 #include "tilecanvas.h"
+#include "undocommand.h"
 
-class SLATE_EXPORT ApplyTilePenCommand : public QUndoCommand
+class SLATE_EXPORT ApplyTilePenCommand : public UndoCommand
 {
 public:
     ApplyTilePenCommand(TileCanvas *canvas, const QPoint &tilePos, int previousId,
@@ -41,6 +41,8 @@ public:
     int id() const override;
     bool mergeWith(const QUndoCommand *other) override;
 
+    qint64 byteSize() const override;
+
 private:
     friend QDebug operator<<(QDebug debug, const ApplyTilePenCommand *command);
 
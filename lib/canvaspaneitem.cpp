@@ -95,7 +95,8 @@ void CanvasPaneItem::setPaneIndex(int paneIndex)
 
 void CanvasPaneItem::itemChange(QQuickItem::ItemChange change, const QQuickItem::ItemChangeData &value)
 {
-    if (change == ItemVisibleHasChanged) {
+    // The canvas may not have been set yet if we're being created by a Loader.
+    if (change == ItemVisibleHasChanged && mCanvas) {
         if (value.boolValue)
             connectToCanvas();
         else
@@ -115,12 +116,21 @@ void CanvasPaneItem::disconnectFromCanvas()
     mCanvas->disconnect(this);
 }
 
-void CanvasPaneItem::onContentPaintRequested(int paneIndex)
+void CanvasPaneItem::onContentPaintRequested(int paneIndex, const QRect &sceneArea)
 {
-    if (paneIndex == -1 || paneIndex == mPaneIndex) {
-        // Only schedule a re-paint if we were the pane it was requested for.
+    // Only schedule a re-paint if we were the pane it was requested for.
+    if (paneIndex != -1 && paneIndex != mPaneIndex)
+        return;
+
+    if (sceneArea.isNull() || !mPane) {
         update();
+        return;
     }
+
+    // Map the area to our coordinates in the same way that PaneDrawingHelper does when painting.
+    const int zoomLevel = mPane->integerZoomLevel();
+    const QRect zoomedArea(sceneArea.topLeft() * zoomLevel, sceneArea.size() * zoomLevel);
+    update(zoomedArea.translated(PaneDrawingHelper::paneTranslation(mCanvas, mPane, mPaneIndex)));
 }
 
 void CanvasPaneItem::paint(QPainter *painter)
@@ -135,7 +145,29 @@ void CanvasPaneItem::paint(QPainter *painter)
     const QSize zoomedCanvasSize = mPane->zoomedSize(mCanvas->currentProjectImage()->size());
     painter->drawTiledPixmap(0, 0, zoomedCanvasSize.width(), zoomedCanvasSize.height(), mCanvas->mCheckerPixmap);
 
-    const QImage image = mCanvas->contentImage();
-    const QSize zoomedImageSize = mPane->zoomedSize(image.size());
-    painter->drawImage(QRectF(QPointF(0, 0), zoomedImageSize), image, QRectF(0, 0, image.width(), image.height()));
+    // Only draw the part of the image that's within the area being repainted,
+    // which is often a tiny part of it; see onContentPaintRequested().
+    const QImage image = mCanvas->baseContentImage();
+    const int zoomLevel = mPane->integerZoomLevel();
+    const QRectF exposedArea = painter->clipBoundingRect();
+    const QRect sourceRect = image.rect() & QRectF(exposedArea.topLeft() / zoomLevel,
+        exposedArea.size() / zoomLevel).toAlignedRect();
+    if (sourceRect.isEmpty())
+        return;
+
+    const QRect targetRect(sourceRect.topLeft() * zoomLevel, sourceRect.size() * zoomLevel);
+    painter->drawImage(targetRect, image, sourceRect);
+
+    // Overlays replace the content beneath them, so redraw the checkered pixmap there first.
+    const QVector<ImageCanvas::ContentOverlay> overlays = mCanvas->contentOverlays();
+    for (const ImageCanvas::ContentOverlay &overlay : overlays) {
+        const QRect overlayTargetRect(overlay.sceneArea.topLeft() * zoomLevel, overlay.sceneArea.size() * zoomLevel);
+        if (!overlayTargetRect.intersects(exposedArea.toAlignedRect()))
+            continue;
+
+        const QPixmap &checkerPixmap = mCanvas->mCheckerPixmap;
+        painter->drawTiledPixmap(overlayTargetRect, checkerPixmap, QPoint(
+            overlayTargetRect.x() % checkerPixmap.width(), overlayTargetRect.y() % checkerPixmap.height()));
+        painter->drawImage(overlayTargetRect, overlay.image);
+    }
 }
@@ -63,7 +63,7 @@ protected:
     void disconnectFromCanvas();
 
 protected slots:
-    void onContentPaintRequested(int paneIndex);
+    void onContentPaintRequested(int paneIndex, const QRect &sceneArea);
 
 protected:
     ImageCanvas *mCanvas = nullptr;
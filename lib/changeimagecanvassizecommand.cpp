@@ -27,7 +27,7 @@ Q_LOGGING_CATEGORY(lcChangeImageCanvasSizeCommand, "app.undo.changeImageCanvasSi
 
 ChangeImageCanvasSizeCommand::ChangeImageCanvasSizeCommand(ImageProject *project, const QImage &previousImage,
     const QImage &newImage, QUndoCommand *parent) :
-    QUndoCommand(parent),
+    UndoCommand(parent),
     mProject(project),
     mPreviousImage(previousImage),
     mNewImage(newImage)
@@ -38,13 +38,19 @@ ChangeImageCanvasSizeCommand::ChangeImageCanvasSizeCommand(ImageProject *project
 void ChangeImageCanvasSizeCommand::undo()
 {
     qCDebug(lcChangeImageCanvasSizeCommand) << "undoing" << this;
-    mProject->doSetCanvasSize(mPreviousImage);
+    if (isDiscarded() || isSkipped())
+        return;
+
+    mProject->doSetCanvasSize(mPreviousImage.image());
 }
 
 void ChangeImageCanvasSizeCommand::redo()
 {
     qCDebug(lcChangeImageCanvasSizeCommand) << "redoing" << this;
-    mProject->doSetCanvasSize(mNewImage);
+    if (isDiscarded() || isSkipped())
+        return;
+
+    mProject->doSetCanvasSize(mNewImage.image());
 }
 
 int ChangeImageCanvasSizeCommand::id() const
@@ -52,6 +58,16 @@ int ChangeImageCanvasSizeCommand::id() const
     return -1;
 }
 
+bool ChangeImageCanvasSizeCommand::changesOnlyImages() const
+{
+    return true;
+}
+
+QVector<UndoImage*> ChangeImageCanvasSizeCommand::imagePayloads()
+{
+    return { &mPreviousImage, &mNewImage };
+}
+
 QDebug operator<<(QDebug debug, const ChangeImageCanvasSizeCommand *command)
 {
     debug.nospace() << "(ChangeImageCanvasSizeCommand new size=" << command->mNewImage.size()
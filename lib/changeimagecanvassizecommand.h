@@ -22,13 +22,14 @@
 
 #include <QDebug>
 #include <QImage>
-#include <QUndoCommand>
 
 #include "slate-global.h"
+#include "undocommand.h"
+#include "undoimage.h"
 
 class ImageProject;
 
-class SLATE_EXPORT ChangeImageCanvasSizeCommand : public QUndoCommand
+class SLATE_EXPORT ChangeImageCanvasSizeCommand : public UndoCommand
 {
 public:
     ChangeImageCanvasSizeCommand(ImageProject *project, const QImage &previousImage, const QImage &newImage,
@@ -38,13 +39,17 @@ public:
     void redo() override;
 
     int id() const override;
+    bool changesOnlyImages() const override;
+
+protected:
+    QVector<UndoImage*> imagePayloads() override;
 
 private:
     friend QDebug operator<<(QDebug debug, const ChangeImageCanvasSizeCommand *command);
 
     ImageProject *mProject;
-    QImage mPreviousImage;
-    QImage mNewImage;
+    UndoImage mPreviousImage;
+    UndoImage mNewImage;
 };
 
 #endif // CHANGEIMAGECANVASSIZECOMMAND_H
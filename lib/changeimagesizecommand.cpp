@@ -27,7 +27,7 @@ Q_LOGGING_CATEGORY(lcChangeImageSizeCommand, "app.undo.ChangeImageSizeCommand")
 
 ChangeImageSizeCommand::ChangeImageSizeCommand(ImageProject *project, const QImage &previousImage,
     const QImage &newImage, QUndoCommand *parent) :
-    QUndoCommand(parent),
+    UndoCommand(parent),
     mProject(project),
     mPreviousImage(previousImage),
     mNewImage(newImage)
@@ -38,13 +38,19 @@ ChangeImageSizeCommand::ChangeImageSizeCommand(ImageProject *project, const QIma
 void ChangeImageSizeCommand::undo()
 {
     qCDebug(lcChangeImageSizeCommand) << "undoing" << this;
-    mProject->doSetImageSize(mPreviousImage);
+    if (isDiscarded() || isSkipped())
+        return;
+
+    mProject->doSetImageSize(mPreviousImage.image());
 }
 
 void ChangeImageSizeCommand::redo()
 {
     qCDebug(lcChangeImageSizeCommand) << "redoing" << this;
-    mProject->doSetImageSize(mNewImage);
+    if (isDiscarded() || isSkipped())
+        return;
+
+    mProject->doSetImageSize(mNewImage.image());
 }
 
 int ChangeImageSizeCommand::id() const
@@ -52,6 +58,16 @@ int ChangeImageSizeCommand::id() const
     return -1;
 }
 
+bool ChangeImageSizeCommand::changesOnlyImages() const
+{
+    return true;
+}
+
+QVector<UndoImage*> ChangeImageSizeCommand::imagePayloads()
+{
+    return { &mPreviousImage, &mNewImage };
+}
+
 QDebug operator<<(QDebug debug, const ChangeImageSizeCommand *command)
 {
     debug.nospace() << "(ChangeImageSizeCommand new size=" << command->mNewImage.size()
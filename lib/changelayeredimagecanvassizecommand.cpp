@@ -20,31 +20,65 @@
 #include "changelayeredimagecanvassizecommand.h"
 
 #include <QLoggingCategory>
+#include <QRegion>
 
+#include "imagelayer.h"
 #include "layeredimageproject.h"
+#include "utils.h"
 
 Q_LOGGING_CATEGORY(lcChangeLayeredImageCanvasSizeCommand, "app.undo.changeLayeredImageCanvasSizeCommand")
 
 ChangeLayeredImageCanvasSizeCommand::ChangeLayeredImageCanvasSizeCommand(LayeredImageProject *project,
-    const QVector<QImage> &previousImages, const QVector<QImage> &newImages, QUndoCommand *parent) :
-    QUndoCommand(parent),
+    const QSize &previousSize, const QSize &newSize, QUndoCommand *parent) :
+    UndoCommand(parent),
     mProject(project),
-    mPreviousImages(previousImages),
-    mNewImages(newImages)
+    mPreviousSize(previousSize),
+    mNewSize(newSize)
 {
+    // Growing the canvas doesn't lose any pixels, so there's nothing to store.
+    const QRegion croppedRegion = QRegion(QRect(QPoint(0, 0), previousSize))
+        .subtracted(QRegion(QRect(QPoint(0, 0), newSize)));
+    for (const QRect &rect : croppedRegion)
+        mCroppedRects.append(rect);
+
+    for (int i = 0; i < project->layerCount(); ++i) {
+        const QImage *layerImage = project->layerAt(i)->image();
+        for (const QRect &rect : qAsConst(mCroppedRects))
+            mCroppedImages.append(layerImage->copy(rect));
+    }
+
     qCDebug(lcChangeLayeredImageCanvasSizeCommand) << "constructed" << this;
 }
 
 void ChangeLayeredImageCanvasSizeCommand::undo()
 {
     qCDebug(lcChangeLayeredImageCanvasSizeCommand) << "undoing" << this;
-    mProject->doSetCanvasSize(mPreviousImages);
+    if (isDiscarded() || isSkipped())
+        return;
+
+    QVector<QImage> images = mProject->layerImages();
+    for (int i = 0; i < images.size(); ++i) {
+        // Pixels outside of the current canvas are filled with transparency by copy().
+        QImage image = images.at(i).copy(QRect(QPoint(0, 0), mPreviousSize));
+        for (int rectIndex = 0; rectIndex < mCroppedRects.size(); ++rectIndex) {
+            const UndoImage &croppedImage = mCroppedImages.at(i * mCroppedRects.size() + rectIndex);
+            Utils::replacePortionOfImage(&image, mCroppedRects.at(rectIndex), croppedImage.image());
+        }
+        images[i] = image;
+    }
+    mProject->doSetCanvasSize(images);
 }
 
 void ChangeLayeredImageCanvasSizeCommand::redo()
 {
     qCDebug(lcChangeLayeredImageCanvasSizeCommand) << "redoing" << this;
-    mProject->doSetCanvasSize(mNewImages);
+    if (isDiscarded() || isSkipped())
+        return;
+
+    QVector<QImage> images = mProject->layerImages();
+    for (QImage &image : images)
+        image = image.copy(QRect(QPoint(0, 0), mNewSize));
+    mProject->doSetCanvasSize(images);
 }
 
 int ChangeLayeredImageCanvasSizeCommand::id() const
@@ -52,8 +86,25 @@ int ChangeLayeredImageCanvasSizeCommand::id() const
     return -1;
 }
 
-QDebug operator<<(QDebug debug, const ChangeLayeredImageCanvasSizeCommand *)
+bool ChangeLayeredImageCanvasSizeCommand::changesOnlyImages() const
+{
+    return true;
+}
+
+QVector<UndoImage*> ChangeLayeredImageCanvasSizeCommand::imagePayloads()
+{
+    QVector<UndoImage*> images;
+    for (UndoImage &image : mCroppedImages)
+        images.append(&image);
+    return images;
+}
+
+QDebug operator<<(QDebug debug, const ChangeLayeredImageCanvasSizeCommand *command)
 {
-    debug.nospace() << "(ChangeLayeredImageCanvasSizeCommand)";
+    debug.nospace() << "(ChangeLayeredImageCanvasSizeCommand"
+        << " previousSize=" << command->mPreviousSize
+        << " newSize=" << command->mNewSize
+        << " croppedRects=" << command->mCroppedRects
+        << ")";
     return debug.space();
 }
@@ -21,31 +21,43 @@
 #define CHANGELAYEREDIMAGECANVASSIZECOMMAND_H
 
 #include <QDebug>
-#include <QImage>
-#include <QUndoCommand>
+#include <QRect>
+#include <QSize>
 #include <QVector>
 
 #include "slate-global.h"
+#include "undocommand.h"
+#include "undoimage.h"
 
 class LayeredImageProject;
 
-class SLATE_EXPORT ChangeLayeredImageCanvasSizeCommand : public QUndoCommand
+// Rather than storing every layer before and after the change, only the sizes
+// and the pixels that are cropped off when shrinking the canvas are stored.
+class SLATE_EXPORT ChangeLayeredImageCanvasSizeCommand : public UndoCommand
 {
 public:
-    ChangeLayeredImageCanvasSizeCommand(LayeredImageProject *project, const QVector<QImage> &previousImages,
-        const QVector<QImage> &newImages, QUndoCommand *parent = nullptr);
+    ChangeLayeredImageCanvasSizeCommand(LayeredImageProject *project, const QSize &previousSize,
+        const QSize &newSize, QUndoCommand *parent = nullptr);
 
     void undo() override;
     void redo() override;
 
     int id() const override;
+    bool changesOnlyImages() const override;
+
+protected:
+    QVector<UndoImage*> imagePayloads() override;
 
 private:
     friend QDebug operator<<(QDebug debug, const ChangeLayeredImageCanvasSizeCommand *command);
 
     LayeredImageProject *mProject;
-    QVector<QImage> mPreviousImages;
-    QVector<QImage> mNewImages;
+    QSize mPreviousSize;
+    QSize mNewSize;
+    // The areas of the previous canvas that are outside of the new one.
+    QVector<QRect> mCroppedRects;
+    // The pixels in each of mCroppedRects, for each layer.
+    QVector<UndoImage> mCroppedImages;
 };
 
 #endif // CHANGELAYEREDIMAGECANVASSIZECOMMAND_H
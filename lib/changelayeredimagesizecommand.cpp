@@ -27,10 +27,10 @@ Q_LOGGING_CATEGORY(lcChangeLayeredImageSizeCommand, "app.undo.changeLayeredImage
 
 ChangeLayeredImageSizeCommand::ChangeLayeredImageSizeCommand(LayeredImageProject *project,
     const QVector<QImage> &previousImages, const QVector<QImage> &newImages, QUndoCommand *parent) :
-    QUndoCommand(parent),
+    UndoCommand(parent),
     mProject(project),
-    mPreviousImages(previousImages),
-    mNewImages(newImages)
+    mPreviousImages(UndoImage::fromImages(previousImages)),
+    mNewImages(UndoImage::fromImages(newImages))
 {
     qCDebug(lcChangeLayeredImageSizeCommand) << "constructed" << this;
 }
@@ -38,13 +38,19 @@ ChangeLayeredImageSizeCommand::ChangeLayeredImageSizeCommand(LayeredImageProject
 void ChangeLayeredImageSizeCommand::undo()
 {
     qCDebug(lcChangeLayeredImageSizeCommand) << "undoing" << this;
-    mProject->doSetImageSize(mPreviousImages);
+    if (isDiscarded() || isSkipped())
+        return;
+
+    mProject->doSetImageSize(UndoImage::toImages(mPreviousImages));
 }
 
 void ChangeLayeredImageSizeCommand::redo()
 {
     qCDebug(lcChangeLayeredImageSizeCommand) << "redoing" << this;
-    mProject->doSetImageSize(mNewImages);
+    if (isDiscarded() || isSkipped())
+        return;
+
+    mProject->doSetImageSize(UndoImage::toImages(mNewImages));
 }
 
 int ChangeLayeredImageSizeCommand::id() const
@@ -52,6 +58,21 @@ int ChangeLayeredImageSizeCommand::id() const
     return -1;
 }
 
+bool ChangeLayeredImageSizeCommand::changesOnlyImages() const
+{
+    return true;
+}
+
+QVector<UndoImage*> ChangeLayeredImageSizeCommand::imagePayloads()
+{
+    QVector<UndoImage*> images;
+    for (UndoImage &image : mPreviousImages)
+        images.append(&image);
+    for (UndoImage &image : mNewImages)
+        images.append(&image);
+    return images;
+}
+
 QDebug operator<<(QDebug debug, const ChangeLayeredImageSizeCommand *)
 {
     debug.nospace() << "(ChangeLayeredImageSizeCommand)";
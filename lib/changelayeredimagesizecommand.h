@@ -22,14 +22,15 @@
 
 #include <QDebug>
 #include <QImage>
-#include <QUndoCommand>
 #include <QVector>
 
 #include "slate-global.h"
+#include "undocommand.h"
+#include "undoimage.h"
 
 class LayeredImageProject;
 
-class SLATE_EXPORT ChangeLayeredImageSizeCommand : public QUndoCommand
+class SLATE_EXPORT ChangeLayeredImageSizeCommand : public UndoCommand
 {
 public:
     ChangeLayeredImageSizeCommand(LayeredImageProject *project, const QVector<QImage> &previousImages,
@@ -39,13 +40,17 @@ public:
     void redo() override;
 
     int id() const override;
+    bool changesOnlyImages() const override;
+
+protected:
+    QVector<UndoImage*> imagePayloads() override;
 
 private:
     friend QDebug operator<<(QDebug debug, const ChangeLayeredImageSizeCommand *command);
 
     LayeredImageProject *mProject;
-    QVector<QImage> mPreviousImages;
-    QVector<QImage> mNewImages;
+    QVector<UndoImage> mPreviousImages;
+    QVector<UndoImage> mNewImages;
 };
 
 #endif // CHANGELAYEREDIMAGESIZECOMMAND_H
@@ -28,7 +28,7 @@ Q_LOGGING_CATEGORY(lcChangeLayerNameCommand, "app.undo.changeLayerNameCommand")
 
 ChangeLayerNameCommand::ChangeLayerNameCommand(LayeredImageProject *project, int layerIndex, const QString &previousName,
     const QString &newName, QUndoCommand *parent) :
-    QUndoCommand(parent),
+    UndoCommand(parent),
     mProject(project),
     mLayerIndex(layerIndex),
     mPreviousName(previousName),
@@ -54,6 +54,11 @@ int ChangeLayerNameCommand::id() const
     return -1;
 }
 
+qint64 ChangeLayerNameCommand::byteSize() const
+{
+    return (mPreviousName.size() + mNewName.size()) * qint64(sizeof(QChar));
+}
+
 QDebug operator<<(QDebug debug, const ChangeLayerNameCommand *command)
 {
     debug.nospace() << "(ChangeLayerNameCommand layerIndex=" << command->mLayerIndex
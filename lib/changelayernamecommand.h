@@ -21,14 +21,14 @@
 #define CHANGELAYERNAMECOMMAND_H
 
 #include <QDebug>
-#include <QUndoCommand>
 
 #include "changelayernamecommand.h"
 #include "slate-global.h"
+#include "undocommand.h"
 
 class LayeredImageProject;
 
-class SLATE_EXPORT ChangeLayerNameCommand : public QUndoCommand
+class SLATE_EXPORT ChangeLayerNameCommand : public UndoCommand
 {
 public:
     ChangeLayerNameCommand(LayeredImageProject *project, int layerIndex, const QString &previousName,
@@ -39,6 +39,8 @@ public:
 
     int id() const override;
 
+    qint64 byteSize() const override;
+
 private:
     friend QDebug operator<<(QDebug debug, const ChangeLayerNameCommand *command);
 
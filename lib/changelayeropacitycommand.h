@@ -21,13 +21,13 @@
 #define CHANGELAYEROPACITYCOMMAND_H
 
 #include <QDebug>
-#include <QUndoCommand>
 
 #include "slate-global.h"
+#include "undocommand.h"
 
 class LayeredImageProject;
 
-class SLATE_EXPORT ChangeLayerOpacityCommand : public QUndoCommand
+class SLATE_EXPORT ChangeLayerOpacityCommand : public UndoCommand
 {
 public:
     ChangeLayerOpacityCommand(LayeredImageProject *project, int layerIndex, qreal previousOpacity,
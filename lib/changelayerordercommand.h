@@ -22,14 +22,14 @@
 
 #include <QDebug>
 #include <QSize>
-#include <QUndoCommand>
 #include <QVector>
 
 #include "slate-global.h"
+#include "undocommand.h"
 
 class LayeredImageProject;
 
-class SLATE_EXPORT ChangeLayerOrderCommand : public QUndoCommand
+class SLATE_EXPORT ChangeLayerOrderCommand : public UndoCommand
 {
 public:
     ChangeLayerOrderCommand(LayeredImageProject *project, int previousIndex, int newIndex,
@@ -21,13 +21,13 @@
 #define CHANGELAYERVISIBLECOMMAND_H
 
 #include <QDebug>
-#include <QUndoCommand>
 
 #include "slate-global.h"
+#include "undocommand.h"
 
 class LayeredImageProject;
 
-class SLATE_EXPORT ChangeLayerVisibleCommand : public QUndoCommand
+class SLATE_EXPORT ChangeLayerVisibleCommand : public UndoCommand
 {
 public:
     ChangeLayerVisibleCommand(LayeredImageProject *project, int layerIndex, bool previousVisible,
@@ -27,7 +27,7 @@ Q_LOGGING_CATEGORY(lcChangeTileCanvasSizeCommand, "app.undo.changeTileCanvasSize
 
 ChangeTileCanvasSizeCommand::ChangeTileCanvasSizeCommand(TilesetProject *project, const QSize &previousSize,
     const QSize &size, QUndoCommand *parent) :
-    QUndoCommand(parent),
+    UndoCommand(parent),
     mProject(project),
     mPreviousSize(previousSize),
     mSize(size)
@@ -54,6 +54,11 @@ int ChangeTileCanvasSizeCommand::id() const
     return -1;
 }
 
+qint64 ChangeTileCanvasSizeCommand::byteSize() const
+{
+    return mPreviousTiles.size() * qint64(sizeof(int));
+}
+
 QDebug operator<<(QDebug debug, const ChangeTileCanvasSizeCommand *command)
 {
     debug.nospace() << "(ChangeTileCanvasSizeCommand size=" << command->mSize
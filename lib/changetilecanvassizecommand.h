@@ -23,13 +23,13 @@
 #include <QDebug>
 #include <QSize>
 #include <QVector>
-#include <QUndoCommand>
 
 #include "slate-global.h"
+#include "undocommand.h"
 
 class TilesetProject;
 
-class SLATE_EXPORT ChangeTileCanvasSizeCommand : public QUndoCommand
+class SLATE_EXPORT ChangeTileCanvasSizeCommand : public UndoCommand
 {
 public:
     ChangeTileCanvasSizeCommand(TilesetProject *project, const QSize &previousSize, const QSize &size,
@@ -40,6 +40,8 @@ public:
 
     int id() const override;
 
+    qint64 byteSize() const override;
+
 private:
     friend QDebug operator<<(QDebug debug, const ChangeTileCanvasSizeCommand *command);
 
@@ -26,7 +26,7 @@
 Q_LOGGING_CATEGORY(lcDeleteGuideCommand, "app.undo.deleteGuideCommand")
 
 DeleteGuideCommand::DeleteGuideCommand(Project *project, const Guide &guide, QUndoCommand *parent) :
-    QUndoCommand(parent),
+    UndoCommand(parent),
     mProject(project),
     mGuide(guide)
 {
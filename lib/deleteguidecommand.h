@@ -21,14 +21,14 @@
 #define DELETEGUIDECOMMAND_H
 
 #include <QDebug>
-#include <QUndoCommand>
 
 #include "guide.h"
 #include "slate-global.h"
+#include "undocommand.h"
 
 class Project;
 
-class SLATE_EXPORT DeleteGuideCommand : public QUndoCommand
+class SLATE_EXPORT DeleteGuideCommand : public UndoCommand
 {
 public:
     DeleteGuideCommand(Project *project, const Guide &guide, QUndoCommand *parent = nullptr);
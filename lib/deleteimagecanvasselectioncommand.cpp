@@ -26,7 +26,7 @@ Q_LOGGING_CATEGORY(lcDeleteImageCanvasSelectionCommand, "app.undo.deleteImageCan
 
 DeleteImageCanvasSelectionCommand::DeleteImageCanvasSelectionCommand(ImageCanvas *canvas, int layerIndex,
         const QRect &area, QUndoCommand *parent) :
-    QUndoCommand(parent),
+    UndoCommand(parent),
     mCanvas(canvas),
     mLayerIndex(layerIndex),
     mDeletedArea(area),
@@ -38,12 +38,18 @@ DeleteImageCanvasSelectionCommand::DeleteImageCanvasSelectionCommand(ImageCanvas
 void DeleteImageCanvasSelectionCommand::undo()
 {
     qCDebug(lcDeleteImageCanvasSelectionCommand) << "undoing" << this;
-    mCanvas->paintImageOntoPortionOfImage(mLayerIndex, mDeletedArea, mDeletedAreaImagePortion);
+    if (isDiscarded() || isSkipped())
+        return;
+
+    mCanvas->paintImageOntoPortionOfImage(mLayerIndex, mDeletedArea, mDeletedAreaImagePortion.image());
 }
 
 void DeleteImageCanvasSelectionCommand::redo()
 {
     qCDebug(lcDeleteImageCanvasSelectionCommand) << "redoing" << this;
+    if (isDiscarded() || isSkipped())
+        return;
+
     mCanvas->erasePortionOfImage(mLayerIndex, mDeletedArea);
     // This matches what mspaint does; deleting a selection also causes the selection to be cleared.
     mCanvas->clearSelection();
@@ -54,6 +60,16 @@ int DeleteImageCanvasSelectionCommand::id() const
     return -1;
 }
 
+bool DeleteImageCanvasSelectionCommand::changesOnlyImages() const
+{
+    return true;
+}
+
+QVector<UndoImage*> DeleteImageCanvasSelectionCommand::imagePayloads()
+{
+    return { &mDeletedAreaImagePortion };
+}
+
 QDebug operator<<(QDebug debug, const DeleteImageCanvasSelectionCommand *command)
 {
     debug.nospace() << "(DeleteImageCanvasSelectionCommand area=" << command->mDeletedArea
@@ -23,13 +23,14 @@
 #include <QDebug>
 #include <QImage>
 #include <QRect>
-#include <QUndoCommand>
 
 #include "slate-global.h"
+#include "undocommand.h"
+#include "undoimage.h"
 
 class ImageCanvas;
 
-class SLATE_EXPORT DeleteImageCanvasSelectionCommand : public QUndoCommand
+class SLATE_EXPORT DeleteImageCanvasSelectionCommand : public UndoCommand
 {
 public:
     DeleteImageCanvasSelectionCommand(ImageCanvas *canvas, int layerIndex, const QRect &area,
@@ -39,6 +40,10 @@ public:
     void redo() override;
 
     int id() const override;
+    bool changesOnlyImages() const override;
+
+protected:
+    QVector<UndoImage*> imagePayloads() override;
 
 private:
     friend QDebug operator<<(QDebug debug, const DeleteImageCanvasSelectionCommand *command);
@@ -47,7 +52,7 @@ private:
     int mLayerIndex;
     QRect mDeletedArea;
     // The portion of the image under the selection before it was deleted.
-    QImage mDeletedAreaImagePortion;
+    UndoImage mDeletedAreaImagePortion;
 };
 
 #endif // DELETEIMAGECANVASSELECTIONCOMMAND_H
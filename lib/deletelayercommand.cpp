@@ -27,7 +27,7 @@
 Q_LOGGING_CATEGORY(lcDeleteLayerCommand, "app.undo.deleteLayerCommand")
 
 DeleteLayerCommand::DeleteLayerCommand(LayeredImageProject *project, int index, QUndoCommand *parent) :
-    QUndoCommand(parent),
+    UndoCommand(parent),
     mProject(project),
     mIndex(index),
     mLayer(project->layerAt(index))
@@ -56,6 +56,12 @@ int DeleteLayerCommand::id() const
     return -1;
 }
 
+qint64 DeleteLayerCommand::byteSize() const
+{
+    // The layer is only owned by us (and hence only costs us memory) while it's not in the project.
+    return mLayerGuard ? mLayerGuard->image()->sizeInBytes() : 0;
+}
+
 QDebug operator<<(QDebug debug, const DeleteLayerCommand *command)
 {
     debug.nospace() << "(DeleteLayerCommand index=" << command->mIndex
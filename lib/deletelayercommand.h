@@ -22,14 +22,14 @@
 
 #include <QDebug>
 #include <QScopedPointer>
-#include <QUndoCommand>
 
 #include "slate-global.h"
+#include "undocommand.h"
 
 class ImageLayer;
 class LayeredImageProject;
 
-class SLATE_EXPORT DeleteLayerCommand : public QUndoCommand
+class SLATE_EXPORT DeleteLayerCommand : public UndoCommand
 {
 public:
     DeleteLayerCommand(LayeredImageProject *project, int index, QUndoCommand *parent = nullptr);
@@ -39,6 +39,8 @@ public:
 
     int id() const override;
 
+    qint64 byteSize() const override;
+
 private:
     friend QDebug operator<<(QDebug debug, const DeleteLayerCommand *command);
 
@@ -28,7 +28,7 @@ Q_LOGGING_CATEGORY(lcDuplicateLayerCommand, "app.undo.duplicateLayerCommand")
 
 DuplicateLayerCommand::DuplicateLayerCommand(LayeredImageProject *project,
         int layerIndex, ImageLayer *layer, QUndoCommand *parent) :
-    QUndoCommand(parent),
+    UndoCommand(parent),
     mProject(project),
     mLayerIndex(layerIndex),
     mLayer(layer),
@@ -58,6 +58,12 @@ int DuplicateLayerCommand::id() const
     return -1;
 }
 
+qint64 DuplicateLayerCommand::byteSize() const
+{
+    // The layer is only owned by us (and hence only costs us memory) while it's not in the project.
+    return mLayerGuard ? mLayerGuard->image()->sizeInBytes() : 0;
+}
+
 QDebug operator<<(QDebug debug, const DuplicateLayerCommand *command)
 {
     debug.nospace() << "(DuplicateLayerCommand sourceIndex=" << command->mLayerIndex
@@ -23,14 +23,14 @@
 #include <QDebug>
 #include <QImage>
 #include <QScopedPointer>
-#include <QUndoCommand>
 
 #include "slate-global.h"
+#include "undocommand.h"
 
 class ImageLayer;
 class LayeredImageProject;
 
-class SLATE_EXPORT DuplicateLayerCommand : public QUndoCommand
+class SLATE_EXPORT DuplicateLayerCommand : public UndoCommand
 {
 public:
     DuplicateLayerCommand(LayeredImageProject *project,
@@ -41,6 +41,8 @@ public:
 
     int id() const override;
 
+    qint64 byteSize() const override;
+
 private:
     friend QDebug operator<<(QDebug debug, const DuplicateLayerCommand *command);
 
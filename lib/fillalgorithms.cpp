@@ -19,398 +19,541 @@
 
 #include "fillalgorithms.h"
 
+#include <algorithm>
+
 #include <QDebug>
 #include <QColor>
 #include <QImage>
 #include <QLoggingCategory>
 #include <QRandomGenerator>
-#include <QQueue>
+#include <QStack>
+#include <QVarLengthArray>
+#include <QThread>
+#include <QtConcurrentMap>
 
+#include "pixelkernels.h"
 #include "texturedfillparameters.h"
 #include "tile.h"
+#include "tileset.h"
 #include "tilesetproject.h"
 
 Q_LOGGING_CATEGORY(lcPixelFloodFill, "app.pixelFloodFill")
 Q_LOGGING_CATEGORY(lcTileFloodFill, "app.tileFloodFill")
 
-uint qHash(const QPoint &point, uint seed)
+// Greedy fills of areas with at least this many pixels have their rows split across threads.
+static const int greedyFillThreadingThreshold = 512 * 512;
+
+FillMask::FillMask() :
+    mWordsPerLine(0),
+    mCount(0)
 {
-    return qHash(point.x() ^ seed) ^ point.y();
 }
 
-QColor FillColourProvider::colour(const QColor &baseColour) const
+FillMask::FillMask(const QRect &bounds) :
+    mBounds(bounds),
+    mWordsPerLine(bounds.isEmpty() ? 0 : (bounds.width() + 31) / 32),
+    mCount(0),
+    mBits(mWordsPerLine * qMax(0, bounds.height()), 0)
 {
-    return baseColour;
 }
 
-// https://en.wikipedia.org/wiki/Flood_fill#Alternative_implementations
-// "[...] use a loop for the west and east directions as an optimization to avoid the overhead of stack or queue management."
-QVector<QPoint> imagePixelFloodFill(const QImage *image, const QPoint &startPos, const QColor &targetColour,
-    const QColor &replacementColour)
+bool FillMask::isNull() const
 {
-    qCDebug(lcPixelFloodFill) << "attempting to fill starting with pixel at" << startPos << "...";
+    return mBits.isEmpty();
+}
 
-    QSet<QPoint> filledPositions;
-    const QRect imageBounds(0, 0, image->width(), image->height());
-    if (!imageBounds.contains(startPos)) {
-        return QVector<QPoint>();
-    }
+bool FillMask::isEmpty() const
+{
+    return mCount == 0;
+}
 
-    if (image->pixelColor(startPos) == replacementColour) {
-        // The pixel at startPos is already the colour that we want to replace it with.
-        return QVector<QPoint>();
-    }
+QRect FillMask::bounds() const
+{
+    return mBounds;
+}
 
-    if (image->pixelColor(startPos) != targetColour) {
-        return QVector<QPoint>();
-    }
+QRect FillMask::dirtyRect() const
+{
+    return mDirtyRect;
+}
 
-    QQueue<QPoint> queue;
-    queue.append(startPos);
-    filledPositions.insert(startPos);
-
-    for (int i = 0; i < queue.size(); ++i) {
-        QPoint node = queue.at(i);
-        QPoint west = node;
-        QPoint east = node;
-
-        while (1) {
-            QPoint newWest = west - QPoint(1, 0);
-            if (imageBounds.contains(newWest) && !filledPositions.contains(newWest) && image->pixelColor(newWest) == targetColour) {
-                west = newWest;
-            } else {
-                break;
-            }
-        }
+int FillMask::count() const
+{
+    return mCount;
+}
 
-        while (1) {
-            QPoint newEast = east + QPoint(1, 0);
-            if (imageBounds.contains(newEast) && !filledPositions.contains(newEast) && image->pixelColor(newEast) == targetColour) {
-                east = newEast;
-            } else {
-                break;
-            }
-        }
+qint64 FillMask::byteSize() const
+{
+    return mBits.size() * qint64(sizeof(quint32));
+}
 
-        for (int x = west.x(); x <= east.x(); ++x) {
-            const QPoint n = QPoint(x, node.y());
-            // This avoids startPos being added twice.
-            if (!filledPositions.contains(n)) {
-                queue.append(n);
-                filledPositions.insert(n);
-            }
+bool FillMask::testBit(int x, int y) const
+{
+    Q_ASSERT(mBounds.contains(x, y));
+    const int localX = x - mBounds.x();
+    const quint32 word = mBits.constData()[(y - mBounds.y()) * mWordsPerLine + (localX >> 5)];
+    return word & (1u << (localX & 31));
+}
 
-            const QPoint north(n - QPoint(0, 1));
-            if (imageBounds.contains(north) && !filledPositions.contains(north) && image->pixelColor(north) == targetColour) {
-                queue.append(north);
-                filledPositions.insert(north);
-            }
+FillMask FillMask::croppedToDirtyRect() const
+{
+    FillMask croppedMask(mDirtyRect);
+    forEachSpan([&](int y, int startX, int endX) {
+        croppedMask.setSpan(y, startX, endX);
+    });
+    return croppedMask;
+}
 
-            const QPoint south(n + QPoint(0, 1));
-            if (imageBounds.contains(south) && !filledPositions.contains(south) && image->pixelColor(south) == targetColour) {
-                queue.append(south);
-                filledPositions.insert(south);
-            }
-        }
+void FillMask::setSpan(int y, int startX, int endX)
+{
+    Q_ASSERT(mBounds.contains(startX, y) && mBounds.contains(endX, y) && startX <= endX);
+    quint32 *line = mBits.data() + (y - mBounds.y()) * mWordsPerLine;
+    const int localStartX = startX - mBounds.x();
+    const int localEndX = endX - mBounds.x();
+    const int firstWord = localStartX >> 5;
+    const int lastWord = localEndX >> 5;
+    const quint32 firstWordMask = ~0u << (localStartX & 31);
+    const quint32 lastWordMask = ~0u >> (31 - (localEndX & 31));
+    if (firstWord == lastWord) {
+        line[firstWord] |= firstWordMask & lastWordMask;
+    } else {
+        line[firstWord] |= firstWordMask;
+        for (int word = firstWord + 1; word < lastWord; ++word)
+            line[word] = ~0u;
+        line[lastWord] |= lastWordMask;
     }
 
-    // Converting from QSet => QVector manually is better than the alternative
-    // QSet => QList => QVector, since QSet offers no API for conversion to QVector:
-    // https://bugreports.qt.io/browse/QTBUG-71067
-    QVector<QPoint> filledPositionsVector;
-    filledPositionsVector.reserve(filledPositions.size());
-    for (const QPoint point : qAsConst(filledPositions))
-        filledPositionsVector.append(point);
-
-    qCDebug(lcPixelFloodFill) << "... filled" << filledPositionsVector.size() << "pixels.";
-    return filledPositionsVector;
+    mCount += endX - startX + 1;
+    mDirtyRect |= QRect(startX, y, endX - startX + 1, 1);
 }
 
-QImage imagePixelFloodFill2(const QImage *image, const QPoint &startPos, const QColor &targetColour,
-    const QColor &replacementColour, const FillColourProvider &fillColourProvider)
+int FillMask::findBit(int y, int fromX, int toX, bool set) const
 {
-    qCDebug(lcPixelFloodFill) << "attempting to fill starting with pixel at" << startPos << "...";
-
-    QImage filledImage = *image;
-    const QRect imageBounds(0, 0, filledImage.width(), filledImage.height());
-    if (!imageBounds.contains(startPos)) {
-        return QImage();
-    }
+    const quint32 *line = mBits.constData() + (y - mBounds.y()) * mWordsPerLine;
+    // Words that are entirely the opposite of what we're looking for can be skipped in one go.
+    const quint32 skippableWord = set ? 0u : ~0u;
+    int localX = fromX - mBounds.x();
+    const int localToX = toX - mBounds.x();
+    while (localX <= localToX) {
+        const quint32 word = line[localX >> 5];
+        if ((localX & 31) == 0 && word == skippableWord) {
+            localX += 32;
+            continue;
+        }
 
-    if (filledImage.pixelColor(startPos) == replacementColour) {
-        // The pixel at startPos is already the colour that we want to replace it with.
-        return QImage();
+        if (bool(word & (1u << (localX & 31))) == set)
+            return localX + mBounds.x();
+        ++localX;
     }
+    return toX + 1;
+}
 
-    if (filledImage.pixelColor(startPos) != targetColour)
-        return QImage();
-
-    QQueue<QPoint> queue;
-    queue.append(startPos);
-    // TODO: use image to track filled positions instead
-    QSet<QPoint> filledPositions;
-    filledPositions.insert(startPos);
-    filledImage.setPixelColor(startPos, fillColourProvider.colour(replacementColour));
-
-    for (int i = 0; i < queue.size(); ++i) {
-        QPoint node = queue.at(i);
-        QPoint west = node;
-        QPoint east = node;
-
-        while (1) {
-            QPoint newWest = west - QPoint(1, 0);
-            if (imageBounds.contains(newWest) && !filledPositions.contains(newWest) && image->pixelColor(newWest) == targetColour) {
-                west = newWest;
-            } else {
-                break;
-            }
-        }
+namespace {
 
-        while (1) {
-            QPoint newEast = east + QPoint(1, 0);
-            if (imageBounds.contains(newEast) && !filledPositions.contains(newEast) && image->pixelColor(newEast) == targetColour) {
-                east = newEast;
-            } else {
-                break;
-            }
-        }
+// The formats whose pixels can be read and written directly as QRgb values.
+bool isDirectlyFillable(QImage::Format format)
+{
+    return format == QImage::Format_ARGB32
+        || format == QImage::Format_ARGB32_Premultiplied
+        || format == QImage::Format_RGB32;
+}
 
-        for (int x = west.x(); x <= east.x(); ++x) {
-            const QPoint n = QPoint(x, node.y());
-            // This avoids startPos being added twice.
-            if (!filledPositions.contains(n)) {
-                queue.append(n);
-                filledPositions.insert(n);
-                filledImage.setPixelColor(n, fillColourProvider.colour(replacementColour));
-            }
+// Returns the raw pixel value that QImage::setPixelColor() would store for colour,
+// so that pixels can be compared without converting each of them to QColor.
+QRgb toPixel(const QColor &colour, QImage::Format format)
+{
+    QImage pixelImage(1, 1, format);
+    pixelImage.setPixelColor(0, 0, colour);
+    return *reinterpret_cast<const QRgb*>(pixelImage.constScanLine(0));
+}
 
-            const QPoint north(n - QPoint(0, 1));
-            if (imageBounds.contains(north) && !filledPositions.contains(north) && image->pixelColor(north) == targetColour) {
-                queue.append(north);
-                filledPositions.insert(north);
-                filledImage.setPixelColor(north, fillColourProvider.colour(replacementColour));
-            }
+inline const QRgb *constLineAt(const QImage &image, int y)
+{
+    return reinterpret_cast<const QRgb*>(image.constBits() + y * image.bytesPerLine());
+}
 
-            const QPoint south(n + QPoint(0, 1));
-            if (imageBounds.contains(south) && !filledPositions.contains(south) && image->pixelColor(south) == targetColour) {
-                queue.append(south);
-                filledPositions.insert(south);
-                filledImage.setPixelColor(south, fillColourProvider.colour(replacementColour));
+// https://en.wikipedia.org/wiki/Flood_fill#Scanline_fill
+// Each seed is expanded to the full horizontal span of matching positions,
+// and then one seed is pushed for every run of matching positions above and below that span.
+// The mask doubles as the set of visited positions, so no position is ever tested twice
+// once it has been filled.
+//
+// find(y, fromX, toX, matching) returns the first x from fromX to toX whose position matches
+// (or, if matching is false, doesn't match), or toX + 1 if there is none.
+// It's only called for positions within bounds.
+template<typename FindFunction>
+FillMask scanlineFloodFill(const QRect &bounds, const QPoint &startPos, FindFunction find)
+{
+    FillMask mask(bounds);
+    if (find(startPos.y(), startPos.x(), startPos.x(), true) != startPos.x())
+        return mask;
+
+    QStack<QPoint> seeds;
+    seeds.push(startPos);
+
+    while (!seeds.isEmpty()) {
+        const QPoint seed = seeds.pop();
+        const int y = seed.y();
+        if (mask.testBit(seed.x(), y))
+            continue;
+
+        // No need to check the mask here: if any position in this run was
+        // already filled, the seed would have been filled along with it.
+        int west = seed.x();
+        while (west > bounds.left() && find(y, west - 1, west - 1, true) == west - 1)
+            --west;
+
+        const int east = find(y, seed.x(), bounds.right(), false) - 1;
+
+        mask.setSpan(y, west, east);
+
+        for (int adjacentY = y - 1; adjacentY <= y + 1; adjacentY += 2) {
+            if (adjacentY < bounds.top() || adjacentY > bounds.bottom())
+                continue;
+
+            // Runs always get filled in their entirety, so a run is either
+            // completely filled already or not at all, and only its first position needs checking.
+            int x = find(adjacentY, west, east, true);
+            while (x <= east) {
+                if (!mask.testBit(x, adjacentY))
+                    seeds.push(QPoint(x, adjacentY));
+                const int runEnd = find(adjacentY, x, east, false);
+                x = runEnd > east ? runEnd : find(adjacentY, runEnd, east, true);
             }
         }
     }
 
-    qCDebug(lcPixelFloodFill) << "... filled" << filledPositions.size() << "pixels.";
-    return filledImage;
+    return mask;
+}
+
 }
 
-QVector<QPoint> imageGreedyPixelFill(const QImage *image, const QPoint &startPos, const QColor &targetColour, const QColor &replacementColour)
+FillColourProvider::FillColourProvider() :
+    mPixel(0)
 {
-    QVector<QPoint> filledPositions;
-    const QRect imageBounds(0, 0, image->width(), image->height());
-    if (!imageBounds.contains(startPos)) {
-        return filledPositions;
-    }
+}
 
-    if (image->pixelColor(startPos) == replacementColour) {
-        // The pixel at startPos is already the colour that we want to replace it with.
-        return filledPositions;
-    }
+FillColourProvider::~FillColourProvider()
+{
+}
 
-    for (int y = 0; y < image->height(); ++y) {
-        for (int x = 0; x < image->width(); ++x) {
-            if (image->pixelColor(x, y) == targetColour) {
-                filledPositions.append(QPoint(x, y));
-            }
-        }
-    }
+void FillColourProvider::begin(const QColor &baseColour, QImage::Format format)
+{
+    mPixel = toPixel(baseColour, format);
+}
 
-    return filledPositions;
+void FillColourProvider::fillSpan(QRgb *pixels, int count)
+{
+    std::fill(pixels, pixels + count, mPixel);
 }
 
-QImage imageGreedyPixelFill2(const QImage *image, const QPoint &startPos, const QColor &targetColour,
-    const QColor &replacementColour, const FillColourProvider &fillColourProvider)
+namespace {
+
+// The same conversion as QColor::fromHslF(), minus the validation and the 16 bit storage.
+inline float hueToChannel(float temp1, float temp2, float hue)
 {
-    const QRect imageBounds(0, 0, image->width(), image->height());
-    if (!imageBounds.contains(startPos))
-        return QImage();
+    if (hue < 0.0f)
+        hue += 1.0f;
+    else if (hue > 1.0f)
+        hue -= 1.0f;
+
+    if (hue * 6.0f < 1.0f)
+        return temp1 + (temp2 - temp1) * hue * 6.0f;
+    if (hue * 2.0f < 1.0f)
+        return temp2;
+    if (hue * 3.0f < 2.0f)
+        return temp1 + (temp2 - temp1) * (2.0f / 3.0f - hue) * 6.0f;
+    return temp1;
+}
 
-    if (image->pixelColor(startPos) == replacementColour) {
-        // The pixel at startPos is already the colour that we want to replace it with.
-        return QImage();
+inline QRgb hslToRgb(float hue, float saturation, float lightness, int alpha)
+{
+    if (hue < 0.0f || saturation == 0.0f) {
+        // Achromatic.
+        const int grey = qRound(lightness * 255.0f);
+        return qRgba(grey, grey, grey, alpha);
     }
 
-    QImage filledImage(*image);
-    for (int y = 0; y < image->height(); ++y) {
-        for (int x = 0; x < image->width(); ++x) {
-            if (image->pixelColor(x, y) == targetColour) {
-                filledImage.setPixelColor(x, y, fillColourProvider.colour(replacementColour));
-            }
-        }
-    }
-    return filledImage;
+    const float temp2 = lightness < 0.5f
+        ? lightness * (1.0f + saturation) : lightness + saturation - lightness * saturation;
+    const float temp1 = 2.0f * lightness - temp2;
+    return qRgba(qRound(hueToChannel(temp1, temp2, hue + 1.0f / 3.0f) * 255.0f),
+        qRound(hueToChannel(temp1, temp2, hue) * 255.0f),
+        qRound(hueToChannel(temp1, temp2, hue - 1.0f / 3.0f) * 255.0f),
+        alpha);
 }
 
-qreal toRange(qreal randomNumber, qreal min, qreal max)
+// Maps a random 32 bit value to the range [0, 1).
+inline float toUnitRange(quint32 randomNumber)
 {
-    return randomNumber * (max - min) + min;
+    return float(randomNumber >> 8) * (1.0f / 16777216.0f);
+}
+
 }
 
-class TextureFillColourProvider : public FillColourProvider
+TexturedFillColourProvider::TexturedFillColourProvider(const TexturedFillParameters &parameters, quint32 seed) :
+    mSeed(seed),
+    mBaseHue(0),
+    mBaseSaturation(0),
+    mBaseLightness(0),
+    mBaseAlpha(255),
+    mPremultiply(false)
 {
-public:
-    TextureFillColourProvider(const TexturedFillParameters &parameters) :
-        mParameters(parameters)
-    {
+    const TexturedFillParameter *sourceParameters[] = {
+        parameters.hue(), parameters.saturation(), parameters.lightness()
+    };
+    Variance *variances[] = { &mHueVariance, &mSaturationVariance, &mLightnessVariance };
+    for (int i = 0; i < 3; ++i) {
+        variances[i]->enabled = sourceParameters[i]->isEnabled();
+        variances[i]->lowerBound = float(sourceParameters[i]->varianceLowerBound());
+        variances[i]->range = float(sourceParameters[i]->varianceUpperBound() - sourceParameters[i]->varianceLowerBound());
     }
+}
 
-    QColor colour(const QColor &baseColour) const override
-    {
-        const auto randomGen = QRandomGenerator::global();
+quint32 TexturedFillColourProvider::seed() const
+{
+    return mSeed;
+}
 
-        const QColor baseColourAsHsl = baseColour.toHsl();
+void TexturedFillColourProvider::begin(const QColor &baseColour, QImage::Format format)
+{
+    FillColourProvider::begin(baseColour, format);
 
-        qreal hue = baseColourAsHsl.hslHueF();
-        if (mParameters.hue()->isEnabled()) {
-            const qreal variance = toRange(randomGen->generateDouble(),
-                mParameters.hue()->varianceLowerBound(), mParameters.hue()->varianceUpperBound());
-            hue = qBound(0.0, hue + variance, 1.0);
-        }
+    mRandomGenerator.seed(mSeed);
+
+    const QColor baseColourAsHsl = baseColour.toHsl();
+    mBaseHue = float(baseColourAsHsl.hslHueF());
+    mBaseSaturation = float(baseColourAsHsl.hslSaturationF());
+    mBaseLightness = float(baseColourAsHsl.lightnessF());
+    mBaseAlpha = baseColour.alpha();
+    mPremultiply = format == QImage::Format_ARGB32_Premultiplied;
+}
+
+void TexturedFillColourProvider::fillSpan(QRgb *pixels, int count)
+{
+    const int randomNumbersPerPixel = int(mHueVariance.enabled) + int(mSaturationVariance.enabled)
+        + int(mLightnessVariance.enabled);
+    if (randomNumbersPerPixel == 0) {
+        FillColourProvider::fillSpan(pixels, count);
+        return;
+    }
+
+    // Generate the random numbers for the whole span in one go rather than one at a time.
+    QVarLengthArray<quint32, 1024> randomNumbers(count * randomNumbersPerPixel);
+    mRandomGenerator.fillRange(randomNumbers.data(), randomNumbers.size());
+    const quint32 *randomNumber = randomNumbers.constData();
 
-        qreal saturation = baseColourAsHsl.hslSaturationF();
-        if (mParameters.saturation()->isEnabled()) {
-            const qreal variance = toRange(randomGen->generateDouble(),
-                mParameters.saturation()->varianceLowerBound(), mParameters.saturation()->varianceUpperBound());
-            saturation = qBound(0.0, saturation + variance, 1.0);
+    for (int i = 0; i < count; ++i) {
+        float hue = mBaseHue;
+        if (mHueVariance.enabled)
+            hue = qBound(0.0f, hue + mHueVariance.lowerBound + toUnitRange(*randomNumber++) * mHueVariance.range, 1.0f);
+
+        float saturation = mBaseSaturation;
+        if (mSaturationVariance.enabled) {
+            saturation = qBound(0.0f, saturation + mSaturationVariance.lowerBound
+                + toUnitRange(*randomNumber++) * mSaturationVariance.range, 1.0f);
         }
 
-        qreal lightness = baseColourAsHsl.lightnessF();
-        if (mParameters.lightness()->isEnabled()) {
-            const qreal variance = toRange(randomGen->generateDouble(),
-                mParameters.lightness()->varianceLowerBound(), mParameters.lightness()->varianceUpperBound());
-            lightness = qBound(0.0, lightness + variance, 1.0);
+        float lightness = mBaseLightness;
+        if (mLightnessVariance.enabled) {
+            lightness = qBound(0.0f, lightness + mLightnessVariance.lowerBound
+                + toUnitRange(*randomNumber++) * mLightnessVariance.range, 1.0f);
         }
 
-        const QColor newColour(QColor::fromHslF(hue, saturation, lightness));
-        return newColour;
+        const QRgb pixel = hslToRgb(hue, saturation, lightness, mBaseAlpha);
+        pixels[i] = mPremultiply ? qPremultiply(pixel) : pixel;
     }
+}
 
-    const TexturedFillParameters &mParameters;
-};
-
-QImage texturedFill(const QImage *image, const QPoint &startPos, const QColor &targetColour,
-    const QColor &replacementColour, const TexturedFillParameters &parameters)
+FillMask imagePixelFloodFillMask(const QImage &image, const QRect &bounds, const QPoint &startPos,
+    const QColor &targetColour, int tolerance)
 {
-    return imagePixelFloodFill2(image, startPos, targetColour, replacementColour, TextureFillColourProvider(parameters));
+    const QRect fillBounds = bounds.intersected(image.rect());
+    if (!fillBounds.contains(startPos))
+        return FillMask();
+
+    const QImage pixels = isDirectlyFillable(image.format())
+        ? image : image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    const QRgb targetPixel = toPixel(targetColour, pixels.format());
+
+    return scanlineFloodFill(fillBounds, startPos, [&](int y, int fromX, int toX, bool matching) {
+        const QRgb *line = constLineAt(pixels, y);
+        return fromX + PixelKernels::findPixel(line + fromX, toX - fromX + 1, targetPixel, tolerance, matching);
+    });
 }
 
-QImage greedyTexturedFill(const QImage *image, const QPoint &startPos, const QColor &targetColour,
-    const QColor &replacementColour, const TexturedFillParameters &parameters)
+FillMask imageGreedyPixelFillMask(const QImage &image, const QRect &bounds, const QColor &targetColour,
+    int tolerance)
 {
-    return imageGreedyPixelFill2(image, startPos, targetColour, replacementColour, TextureFillColourProvider(parameters));
+    const QRect fillBounds = bounds.intersected(image.rect());
+    if (fillBounds.isEmpty())
+        return FillMask();
+
+    const QImage pixels = isDirectlyFillable(image.format())
+        ? image : image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    const QRgb targetPixel = toPixel(targetColour, pixels.format());
+
+    FillMask mask(fillBounds);
+    const int left = fillBounds.left();
+    const int width = fillBounds.width();
+    for (int y = fillBounds.top(); y <= fillBounds.bottom(); ++y) {
+        const QRgb *line = constLineAt(pixels, y) + left;
+        int x = PixelKernels::findPixel(line, width, targetPixel, tolerance, true);
+        while (x < width) {
+            const int endX = x + PixelKernels::findPixel(line + x, width - x, targetPixel, tolerance, false);
+            mask.setSpan(y, left + x, left + endX - 1);
+            x = endX + PixelKernels::findPixel(line + endX, width - endX, targetPixel, tolerance, true);
+        }
+    }
+
+    return mask;
 }
 
-// TODO: convert these to non-recursive algorithms as above
-void tilesetPixelFloodFill(const Tile *tile, const QPoint &pos, const QColor &targetColour,
-    const QColor &replacementColour, QVector<QPoint> &filledPositions)
+QRect imageGreedyPixelFillInPlace(QImage *image, const QRect &bounds, const QColor &targetColour,
+    const QColor &replacementColour, int tolerance)
 {
-    qCDebug(lcPixelFloodFill) << "attempting to fill pixel at" << pos << "...";
+    const QRect fillBounds = bounds.intersected(image->rect());
+    if (fillBounds.isEmpty())
+        return QRect();
 
-    if (filledPositions.contains(pos)) {
-        // This tile has already been filled (would this ever happen?)
-        qCDebug(lcPixelFloodFill) << "already filled";
-        return;
-    }
+    const QImage::Format originalFormat = image->format();
+    if (!isDirectlyFillable(originalFormat))
+        *image = image->convertToFormat(QImage::Format_ARGB32_Premultiplied);
 
-    if (tile->pixelColor(pos) == replacementColour) {
-        qCDebug(lcPixelFloodFill) << "hit the same colour as replacement colour; returning";
-        return;
-    }
+    const QRgb targetPixel = toPixel(targetColour, image->format());
+    const QRgb replacementPixel = toPixel(replacementColour, image->format());
+    uchar *bits = image->bits();
+    const int bytesPerLine = image->bytesPerLine();
+
+    struct RowBand
+    {
+        int top;
+        int bottom;
+        QRect dirtyRect;
+    };
+
+    const int bandCount = fillBounds.width() * fillBounds.height() >= greedyFillThreadingThreshold
+        ? qBound(1, QThread::idealThreadCount(), fillBounds.height()) : 1;
+    const int rowsPerBand = (fillBounds.height() + bandCount - 1) / bandCount;
+    QVector<RowBand> bands;
+    for (int top = fillBounds.top(); top <= fillBounds.bottom(); top += rowsPerBand)
+        bands.append({ top, qMin(top + rowsPerBand - 1, fillBounds.bottom()), QRect() });
+
+    // Each band only touches its own rows, so they can be filled concurrently.
+    auto fillBand = [=](RowBand &band) {
+        for (int y = band.top; y <= band.bottom; ++y) {
+            QRgb *line = reinterpret_cast<QRgb*>(bits + y * bytesPerLine) + fillBounds.left();
+            int firstIndex = 0;
+            int lastIndex = 0;
+            const int replaced = PixelKernels::replacePixels(line, fillBounds.width(), targetPixel, tolerance,
+                replacementPixel, &firstIndex, &lastIndex);
+            if (replaced > 0)
+                band.dirtyRect |= QRect(fillBounds.left() + firstIndex, y, lastIndex - firstIndex + 1, 1);
+        }
+    };
+
+    if (bands.size() == 1)
+        fillBand(bands.first());
+    else
+        QtConcurrent::blockingMap(bands, fillBand);
+
+    QRect dirtyRect;
+    for (const RowBand &band : qAsConst(bands))
+        dirtyRect |= band.dirtyRect;
+
+    if (image->format() != originalFormat)
+        *image = image->convertToFormat(originalFormat);
 
-    if (tile->pixelColor(pos) != targetColour) {
-        qCDebug(lcPixelFloodFill) << "hit a different colour; returning";
+    return dirtyRect;
+}
+
+void applyFillMask(QImage *image, const FillMask &mask, const QColor &replacementColour,
+    FillColourProvider *fillColourProvider)
+{
+    if (mask.isEmpty())
         return;
-    }
 
-    qCDebug(lcPixelFloodFill) << "filling!";
-    filledPositions.append(pos);
+    const QImage::Format originalFormat = image->format();
+    if (!isDirectlyFillable(originalFormat))
+        *image = image->convertToFormat(QImage::Format_ARGB32_Premultiplied);
 
-    const QRect tileBounds(0, 0, tile->sourceRect().width(), tile->sourceRect().height());
-    const QPoint north = pos - QPoint(0, 1);
-    const QPoint south = pos + QPoint(0, 1);
-    const QPoint east = pos + QPoint(1, 0);
-    const QPoint west = pos - QPoint(1, 0);
+    FillColourProvider solidColourProvider;
+    FillColourProvider *provider = fillColourProvider ? fillColourProvider : &solidColourProvider;
+    provider->begin(replacementColour, image->format());
 
-    if (tileBounds.contains(north)) {
-        tilesetPixelFloodFill(tile, north, targetColour, replacementColour, filledPositions);
-    } else {
-        qCDebug(lcPixelFloodFill) << north << "is out of bounds" << "( tileBounds =" << tileBounds << ")";
-    }
-    if (tileBounds.contains(south)) {
-        tilesetPixelFloodFill(tile, south, targetColour, replacementColour, filledPositions);
-    } else {
-        qCDebug(lcPixelFloodFill) << south << "is out of bounds" << "( tileBounds =" << tileBounds << ")";
-    }
-    if (tileBounds.contains(east)) {
-        tilesetPixelFloodFill(tile, east, targetColour, replacementColour, filledPositions);
-    } else {
-        qCDebug(lcPixelFloodFill) << east << "is out of bounds" << "( tileBounds =" << tileBounds << ")";
-    }
-    if (tileBounds.contains(west)) {
-        tilesetPixelFloodFill(tile, west, targetColour, replacementColour, filledPositions);
-    } else {
-        qCDebug(lcPixelFloodFill) << west << "is out of bounds" << "( tileBounds =" << tileBounds << ")";
-    }
+    uchar *bits = image->bits();
+    const int bytesPerLine = image->bytesPerLine();
+    mask.forEachSpan([&](int y, int startX, int endX) {
+        QRgb *line = reinterpret_cast<QRgb*>(bits + y * bytesPerLine);
+        provider->fillSpan(line + startX, endX - startX + 1);
+    });
+
+    if (image->format() != originalFormat)
+        *image = image->convertToFormat(originalFormat);
 }
 
-void tilesetTileFloodFill(const TilesetProject *project, const Tile *tile, const QPoint &tilePos,
-    int targetTile, int replacementTile, QVector<QPoint> &filledTilePositions)
+FillMask tilesetPixelFloodFill(const Tile *tile, const QPoint &pos, const QColor &targetColour)
 {
-    qCDebug(lcTileFloodFill) << "attempting to fill pixel at" << tilePos << "...";
+    qCDebug(lcPixelFloodFill) << "attempting to fill starting with pixel at" << pos << "in tile" << tile << "...";
 
-    if (filledTilePositions.contains(tilePos)) {
-        // This tile has already been filled (would this ever happen?)
-        qCDebug(lcTileFloodFill) << "already filled";
-        return;
-    }
+    const Tileset *tileset = tile->tileset();
+    if (!tileset)
+        return FillMask();
 
-    const int tileIdAtTilePos = project->tileIdAtTilePos(tilePos);
-    if (tileIdAtTilePos == replacementTile) {
-        qCDebug(lcTileFloodFill) << "hit the same tile as replacement tile; returning";
-        return;
-    }
+    const QRect sourceRect = tile->sourceRect();
+    const FillMask mask = imagePixelFloodFillMask(*tileset->image(), sourceRect, sourceRect.topLeft() + pos, targetColour);
+    qCDebug(lcPixelFloodFill) << "... filled" << mask.count() << "pixels within" << mask.dirtyRect();
+    return mask;
+}
 
-    if (tileIdAtTilePos != targetTile) {
-        qCDebug(lcTileFloodFill) << "hit a different colour; returning";
-        return;
-    }
+FillMask tilesetGreedyPixelFill(const Tile *tile, const QColor &targetColour)
+{
+    const Tileset *tileset = tile->tileset();
+    if (!tileset)
+        return FillMask();
 
-    qCDebug(lcTileFloodFill) << "filling!";
-    filledTilePositions.append(tilePos);
+    return imageGreedyPixelFillMask(*tileset->image(), tile->sourceRect(), targetColour);
+}
 
-    const QPoint north = tilePos - QPoint(0, 1);
-    const QPoint south = tilePos + QPoint(0, 1);
-    const QPoint east = tilePos + QPoint(1, 0);
-    const QPoint west = tilePos - QPoint(1, 0);
+QVector<TileFillRun> tilesetTileFloodFill(const TilesetProject *project, const QPoint &startTilePos,
+    int targetTile, int replacementTile)
+{
+    qCDebug(lcTileFloodFill) << "attempting to fill starting with tile at" << startTilePos << "...";
 
-    if (project->isTilePosWithinBounds(north)) {
-        tilesetTileFloodFill(project, tile, north, targetTile, replacementTile, filledTilePositions);
-    } else {
-        qCDebug(lcTileFloodFill) << north << "is out of bounds";
-    }
-    if (project->isTilePosWithinBounds(south)) {
-        tilesetTileFloodFill(project, tile, south, targetTile, replacementTile, filledTilePositions);
-    } else {
-        qCDebug(lcTileFloodFill) << south << "is out of bounds";
-    }
-    if (project->isTilePosWithinBounds(east)) {
-        tilesetTileFloodFill(project, tile, east, targetTile, replacementTile, filledTilePositions);
-    } else {
-        qCDebug(lcTileFloodFill) << east << "is out of bounds";
-    }
-    if (project->isTilePosWithinBounds(west)) {
-        tilesetTileFloodFill(project, tile, west, targetTile, replacementTile, filledTilePositions);
-    } else {
-        qCDebug(lcTileFloodFill) << west << "is out of bounds";
+    QVector<TileFillRun> runs;
+    if (!project->isTilePosWithinBounds(startTilePos))
+        return runs;
+
+    const int startTile = project->tileIdAtTilePos(startTilePos);
+    if (startTile == replacementTile) {
+        // The tile at startTilePos is already the tile that we want to replace it with.
+        return runs;
     }
+
+    if (startTile != targetTile)
+        return runs;
+
+    // Read the ids directly rather than going through tileIdAtTilePos() for every tile.
+    const QVector<int> tiles = project->tiles();
+    const int *tileIds = tiles.constData();
+    const int tilesWide = project->tilesWide();
+    const QRect tileBounds(0, 0, tilesWide, project->tilesHigh());
+    const FillMask mask = scanlineFloodFill(tileBounds, startTilePos, [=](int y, int fromX, int toX, bool matching) {
+        const int *line = tileIds + y * tilesWide;
+        int x = fromX;
+        while (x <= toX && (line[x] == targetTile) != matching)
+            ++x;
+        return x;
+    });
+
+    mask.forEachSpan([&](int y, int startX, int endX) {
+        TileFillRun run;
+        run.x = startX;
+        run.y = y;
+        run.length = endX - startX + 1;
+        runs.append(run);
+    });
+
+    qCDebug(lcTileFloodFill) << "... filled" << mask.count() << "tiles in" << runs.size() << "runs.";
+    return runs;
 }
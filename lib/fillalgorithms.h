@@ -20,46 +20,164 @@
 #ifndef FILLALGORITHMS_H
 #define FILLALGORITHMS_H
 
+#include <QImage>
+#include <QRandomGenerator>
+#include <QRect>
+#include <QVector>
+
+#include "slate-global.h"
+
 class QColor;
-class QImage;
 class QPoint;
-template <typename T>
-class QVector;
 
 class TexturedFillParameters;
 class TilesetProject;
 class Tile;
 
-class FillColourProvider
+// Generates the pixels that a fill writes, one horizontal span at a time.
+// The base class writes replacementColour to every pixel.
+class SLATE_EXPORT FillColourProvider
 {
 public:
-    virtual QColor colour(const QColor &baseColour) const;
+    FillColourProvider();
+    virtual ~FillColourProvider();
+
+    // Called once before a fill writes any spans to an image with the given format.
+    virtual void begin(const QColor &baseColour, QImage::Format format);
+    // Writes count pixels (in the format passed to begin()) to pixels.
+    virtual void fillSpan(QRgb *pixels, int count);
+
+private:
+    QRgb mPixel;
 };
 
-QVector<QPoint> imagePixelFloodFill(const QImage *image, const QPoint &startPos, const QColor &targetColour,
-    const QColor &replacementColour);
+// Varies the hue, saturation and lightness of each pixel according to a set of TexturedFillParameters.
+// The variance comes from a generator that is reseeded with seed() in begin(),
+// so filling the same pixels with the same provider always produces the same result.
+class SLATE_EXPORT TexturedFillColourProvider : public FillColourProvider
+{
+public:
+    TexturedFillColourProvider(const TexturedFillParameters &parameters, quint32 seed);
+
+    quint32 seed() const;
+
+    void begin(const QColor &baseColour, QImage::Format format) override;
+    void fillSpan(QRgb *pixels, int count) override;
+
+private:
+    struct Variance
+    {
+        bool enabled;
+        float lowerBound;
+        float range;
+    };
+
+    // A copy of the parameters, so that they can't be changed out from under an undo command.
+    Variance mHueVariance;
+    Variance mSaturationVariance;
+    Variance mLightnessVariance;
+    quint32 mSeed;
+
+    QRandomGenerator mRandomGenerator;
+    float mBaseHue;
+    float mBaseSaturation;
+    float mBaseLightness;
+    int mBaseAlpha;
+    bool mPremultiply;
+};
 
-// TODO: replace imagePixelFloodFill() with this eventually
-QImage imagePixelFloodFill2(const QImage *image, const QPoint &startPos, const QColor &targetColour,
-    const QColor &replacementColour, const FillColourProvider &fillColourProvider = FillColourProvider());
+// Records which pixels within bounds() were filled, using one bit per pixel.
+// Positions are in image coordinates, not relative to bounds().
+class SLATE_EXPORT FillMask
+{
+public:
+    FillMask();
+    explicit FillMask(const QRect &bounds);
+
+    bool isNull() const;
+    bool isEmpty() const;
+
+    QRect bounds() const;
+    // The bounding rect of every pixel that has been set.
+    QRect dirtyRect() const;
+    int count() const;
+    // The number of bytes used to store the bits.
+    qint64 byteSize() const;
+
+    bool testBit(int x, int y) const;
+    // Returns a copy of this mask whose bounds are its dirty rect,
+    // which uses less memory when only a small part of the bounds is set.
+    FillMask croppedToDirtyRect() const;
+
+    // Sets every bit from startX to endX (inclusive) on the line y.
+    // The bits must not already be set.
+    void setSpan(int y, int startX, int endX);
+
+    // Calls function(y, startX, endX) for each horizontal run of set bits.
+    template<typename Function>
+    void forEachSpan(Function function) const
+    {
+        for (int y = mDirtyRect.top(); y <= mDirtyRect.bottom(); ++y) {
+            int x = findBit(y, mDirtyRect.left(), mDirtyRect.right(), true);
+            while (x <= mDirtyRect.right()) {
+                const int endX = findBit(y, x, mDirtyRect.right(), false) - 1;
+                function(y, x, endX);
+                x = findBit(y, endX + 1, mDirtyRect.right(), true);
+            }
+        }
+    }
+
+private:
+    // Returns the first x from fromX to toX whose bit matches set, or toX + 1 if there is none.
+    int findBit(int y, int fromX, int toX, bool set) const;
+
+    QRect mBounds;
+    QRect mDirtyRect;
+    int mWordsPerLine;
+    int mCount;
+    QVector<quint32> mBits;
+};
+
+// Pixels match targetColour if none of their channels differ from it by more than tolerance (0 to 255);
+// see PixelKernels::findPixel().
+
+// Returns the pixels connected to startPos (and within bounds) that match targetColour.
+FillMask imagePixelFloodFillMask(const QImage &image, const QRect &bounds, const QPoint &startPos,
+    const QColor &targetColour, int tolerance = 0);
 
-QVector<QPoint> imageGreedyPixelFill(const QImage *image, const QPoint &startPos, const QColor &targetColour,
-    const QColor &replacementColour);
+// Returns every pixel within bounds that matches targetColour.
+FillMask imageGreedyPixelFillMask(const QImage &image, const QRect &bounds, const QColor &targetColour,
+    int tolerance = 0);
 
-// TODO: replace imagePixelFloodFill() with this eventually
-QImage imageGreedyPixelFill2(const QImage *image, const QPoint &startPos, const QColor &targetColour,
-    const QColor &replacementColour, const FillColourProvider &fillColourProvider = FillColourProvider());
+// Replaces every pixel within bounds that matches targetColour with replacementColour,
+// and returns the bounding rect of the pixels that were replaced.
+// Large areas are split into bands of rows that are filled on separate threads.
+QRect imageGreedyPixelFillInPlace(QImage *image, const QRect &bounds, const QColor &targetColour,
+    const QColor &replacementColour, int tolerance = 0);
 
-QImage texturedFill(const QImage *image, const QPoint &startPos,
-    const QColor &targetColour, const QColor &replacementColour, const TexturedFillParameters &parameters);
+// Writes the pixels from fillColourProvider into each span of image that is set in mask.
+// If fillColourProvider is null, every pixel is set to replacementColour.
+void applyFillMask(QImage *image, const FillMask &mask, const QColor &replacementColour,
+    FillColourProvider *fillColourProvider = nullptr);
 
-QImage greedyTexturedFill(const QImage *image, const QPoint &startPos,
-    const QColor &targetColour, const QColor &replacementColour, const TexturedFillParameters &parameters);
+// Returns the pixels connected to pos (which is relative to the tile) that are targetColour.
+// The fill is limited to the tile's area of the tileset image, and the mask is in tileset image coordinates.
+FillMask tilesetPixelFloodFill(const Tile *tile, const QPoint &pos, const QColor &targetColour);
 
-void tilesetPixelFloodFill(const Tile *tile, const QPoint &pos, const QColor &targetColour,
-    const QColor &replacementColour, QVector<QPoint> &filledPositions);
+// Returns every pixel in the tile's area of the tileset image that is targetColour.
+FillMask tilesetGreedyPixelFill(const Tile *tile, const QColor &targetColour);
+
+// A horizontal run of length tiles, starting at the tile position (x, y).
+struct TileFillRun
+{
+    int x;
+    int y;
+    int length;
+};
+Q_DECLARE_TYPEINFO(TileFillRun, Q_PRIMITIVE_TYPE);
 
-void tilesetTileFloodFill(const TilesetProject *project, const Tile *tile, const QPoint &tilePos, int targetTile,
-    int replacementTile, QVector<QPoint> &filledTilePositions);
+// Returns the runs of tiles connected to startTilePos that are targetTile.
+QVector<TileFillRun> tilesetTileFloodFill(const TilesetProject *project, const QPoint &startTilePos,
+    int targetTile, int replacementTile);
 
 #endif // FILLALGORITHMS_H
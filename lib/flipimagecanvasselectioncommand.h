@@ -22,13 +22,13 @@
 
 #include <QDebug>
 #include <QRect>
-#include <QUndoCommand>
 
 #include "slate-global.h"
+#include "undocommand.h"
 
 class ImageCanvas;
 
-class SLATE_EXPORT FlipImageCanvasSelectionCommand : public QUndoCommand
+class SLATE_EXPORT FlipImageCanvasSelectionCommand : public UndoCommand
 {
 public:
     FlipImageCanvasSelectionCommand(ImageCanvas *canvas, const QRect &area,
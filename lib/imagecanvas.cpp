@@ -27,6 +27,9 @@
 #include <QPainter>
 #include <QQmlEngine>
 #include <QQuickWindow>
+#include <QRandomGenerator>
+#include <QVarLengthArray>
+#include <QtConcurrentRun>
 #include <QtMath>
 
 #include "addguidecommand.h"
@@ -100,6 +103,7 @@ ImageCanvas::ImageCanvas() :
     mLastFillToolUsed(FillTool),
     mToolSize(1),
     mMaxToolSize(100),
+    mFillTolerance(0),
     mPenForegroundColour(Qt::black),
     mPenBackgroundColour(Qt::white),
     mPotentiallySelecting(false),
@@ -107,6 +111,11 @@ ImageCanvas::ImageCanvas() :
     mMovingSelection(false),
     mIsSelectionFromPaste(false),
     mConfirmingSelectionModification(false),
+    mHslAdjustmentRunning(false),
+    mHslAdjustmentPending(false),
+    mPendingHue(0),
+    mPendingSaturation(0),
+    mPendingLightness(0),
     mSelectionCursorGuide(nullptr),
     mLastSelectionModification(NoSelectionModification),
     mHasModifiedSelection(false),
@@ -170,6 +179,7 @@ ImageCanvas::ImageCanvas() :
     connect(&mSecondPane, SIGNAL(zoomLevelChanged()), this, SLOT(onZoomLevelChanged()));
     connect(&mSecondPane, SIGNAL(integerOffsetChanged()), this, SLOT(onPaneintegerOffsetChanged()));
     connect(&mSecondPane, SIGNAL(sizeChanged()), this, SLOT(onPaneSizeChanged()));
+    connect(&mHslAdjustmentWatcher, SIGNAL(finished()), this, SLOT(onHslAdjustmentFinished()));
     connect(&mSplitter, SIGNAL(positionChanged()), this, SLOT(onSplitterPositionChanged()));
 
     recreateCheckerImage();
@@ -527,6 +537,21 @@ int ImageCanvas::maxToolSize() const
     return mMaxToolSize;
 }
 
+int ImageCanvas::fillTolerance() const
+{
+    return mFillTolerance;
+}
+
+void ImageCanvas::setFillTolerance(int fillTolerance)
+{
+    const int clamped = qBound(0, fillTolerance, 255);
+    if (clamped == mFillTolerance)
+        return;
+
+    mFillTolerance = clamped;
+    emit fillToleranceChanged();
+}
+
 QColor ImageCanvas::penForegroundColour() const
 {
     return mPenForegroundColour;
@@ -876,6 +901,10 @@ void ImageCanvas::connectSignals()
     connect(mProject, SIGNAL(projectCreated()), this, SLOT(requestContentPaint()));
     connect(mProject, SIGNAL(projectClosed()), this, SLOT(reset()));
     connect(mProject, SIGNAL(sizeChanged()), this, SLOT(requestContentPaint()));
+    connect(mProject, SIGNAL(projectCreated()), this, SLOT(onProjectContentReplaced()));
+    connect(mProject, SIGNAL(sizeChanged()), this, SLOT(onProjectContentReplaced()));
+    connect(mProject, SIGNAL(contentsReplaced()), this, SLOT(requestContentPaint()));
+    connect(mProject, SIGNAL(contentsReplaced()), this, SLOT(onProjectContentReplaced()));
     connect(mProject, SIGNAL(guidesChanged()), this, SLOT(onGuidesChanged()));
     connect(mProject, SIGNAL(readyForWritingToJson(QJsonObject*)),
         this, SLOT(onReadyForWritingToJson(QJsonObject*)));
@@ -893,6 +922,10 @@ void ImageCanvas::disconnectSignals()
     mProject->disconnect(SIGNAL(projectCreated()), this, SLOT(requestContentPaint()));
     mProject->disconnect(SIGNAL(projectClosed()), this, SLOT(reset()));
     mProject->disconnect(SIGNAL(sizeChanged()), this, SLOT(requestContentPaint()));
+    mProject->disconnect(SIGNAL(projectCreated()), this, SLOT(onProjectContentReplaced()));
+    mProject->disconnect(SIGNAL(sizeChanged()), this, SLOT(onProjectContentReplaced()));
+    mProject->disconnect(SIGNAL(contentsReplaced()), this, SLOT(requestContentPaint()));
+    mProject->disconnect(SIGNAL(contentsReplaced()), this, SLOT(onProjectContentReplaced()));
     mProject->disconnect(SIGNAL(guidesChanged()), this, SLOT(onGuidesChanged()));
     mProject->disconnect(SIGNAL(readyForWritingToJson(QJsonObject*)),
         this, SLOT(onReadyForWritingToJson(QJsonObject*)));
@@ -944,6 +977,8 @@ void ImageCanvas::geometryChanged(const QRectF &newGeometry, const QRectF &oldGe
     QQuickItem::geometryChanged(newGeometry, oldGeometry);
 
     centrePanes();
+    // Centring may not change the offsets, but the visible area still depends on our size.
+    updateVisibleSceneArea();
     resizeRulers();
     resizeChildren();
 
@@ -986,24 +1021,116 @@ int ImageCanvas::currentLayerIndex() const
 
 QImage ImageCanvas::contentImage()
 {
-    mCachedContentImage = getContentImage();
-    return mCachedContentImage;
+    // Make sure that what we return reflects the latest adjustment,
+    // rather than whatever the worker thread has gotten through so far.
+    if (isAdjustingImage())
+        finishPendingHslAdjustment();
+
+    QImage image = getContentImage();
+    const QVector<ContentOverlay> overlays = contentOverlays();
+    if (overlays.isEmpty())
+        return image;
+
+    QPainter painter(&image);
+    painter.setCompositionMode(QPainter::CompositionMode_Source);
+    for (const ContentOverlay &overlay : overlays)
+        painter.drawImage(overlay.sceneArea.topLeft(), overlay.image);
+    return image;
+}
+
+QImage ImageCanvas::baseContentImage()
+{
+    return getContentImage();
 }
 
 QImage ImageCanvas::getContentImage()
 {
-    QImage image = !shouldDrawSelectionPreviewImage() ? *currentProjectImage() : mSelectionPreviewImage;
-    // Draw the pixel-pen-line indicator over the content.
+    // Previews (the pixel-pen-line indicator and selection modifications) are drawn separately;
+    // see contentOverlays().
+    return *currentProjectImage();
+}
+
+QVector<ImageCanvas::ContentOverlay> ImageCanvas::contentOverlays()
+{
+    QVector<ContentOverlay> overlays;
+
+    const QVector<QRect> selectionAreas = selectionPreviewAreas();
+    for (const QRect &selectionArea : selectionAreas) {
+        // The selection preview is drawn by getContentAreaImage() itself, so there's nothing else to do.
+        const QImage selectionImage = getContentAreaImage(selectionArea, [](QPainter *) {});
+        if (!selectionImage.isNull())
+            overlays.append(ContentOverlay{selectionArea, selectionImage});
+        mSelectionPreviewRegion += selectionArea;
+    }
+
     if (isLineVisible()) {
-        QPainter linePainter(&image);
-        // Draw the line on top of what has already been painted using a special composition mode.
-        // This ensures that e.g. a translucent red overwrites whatever pixels it
-        // lies on, rather than blending with them.
-        drawLine(&linePainter, linePoint1(), linePoint2(), QPainter::CompositionMode_Source);
+        const QRect lineArea = normalisedLineRect(linePoint1(), linePoint2()) & currentProjectImage()->rect();
+        if (!lineArea.isEmpty()) {
+            const QImage lineImage = getContentAreaImage(lineArea, [=](QPainter *painter) {
+                // Draw the line on top of what has already been painted using a special composition mode.
+                // This ensures that e.g. a translucent red overwrites whatever pixels it
+                // lies on, rather than blending with them.
+                drawLine(painter, linePoint1(), linePoint2(), QPainter::CompositionMode_Source);
+            });
+            if (!lineImage.isNull())
+                overlays.append(ContentOverlay{lineArea, lineImage});
+        }
+        // Remember everywhere that we've drawn it, so that it can be erased.
+        mLinePreviewArea |= lineArea;
     }
+
+    // Used for setCursorPixelColour().
+    mCachedContentOverlays = overlays;
+    return overlays;
+}
+
+QImage ImageCanvas::getContentAreaImage(const QRect &sceneArea, const std::function<void(QPainter*)> &modifyCurrentLayer)
+{
+    QImage image = currentProjectImage()->copy(sceneArea);
+    QPainter painter(&image);
+    painter.translate(-sceneArea.topLeft());
+    if (shouldDrawSelectionPreviewImage() && !mSelectionContents.isNull())
+        drawSelectionPreview(&painter);
+    modifyCurrentLayer(&painter);
     return image;
 }
 
+// The areas of the current layer that the selection preview changes.
+QVector<QRect> ImageCanvas::selectionPreviewAreas() const
+{
+    QVector<QRect> areas;
+    if (!shouldDrawSelectionPreviewImage() || mSelectionContents.isNull())
+        return areas;
+
+    const QRect imageBounds = currentProjectImage()->rect();
+    if (!mIsSelectionFromPaste) {
+        const QRect sourceArea = mSelectionAreaBeforeFirstModification & imageBounds;
+        if (!sourceArea.isEmpty())
+            areas.append(sourceArea);
+    }
+
+    const QRect targetArea = QRect(mSelectionArea.topLeft(), mSelectionContents.size()) & imageBounds;
+    if (!targetArea.isEmpty() && !areas.contains(targetArea))
+        areas.append(targetArea);
+    return areas;
+}
+
+void ImageCanvas::drawSelectionPreview(QPainter *painter) const
+{
+    if (!mIsSelectionFromPaste) {
+        // Only if the selection wasn't pasted should we erase the area left behind.
+        painter->save();
+        painter->setCompositionMode(QPainter::CompositionMode_Clear);
+        painter->fillRect(mSelectionAreaBeforeFirstModification, Qt::transparent);
+        painter->restore();
+    }
+
+    // Then, draw the dragged contents at their new location.
+    // Doing this last ensures that the drag contents are painted over the transparency,
+    // and not the other way around.
+    painter->drawImage(mSelectionArea.topLeft(), mSelectionContents);
+}
+
 void ImageCanvas::drawLine(QPainter *painter, QPointF point1, QPointF point2, const QPainter::CompositionMode mode) const
 {
     painter->save();
@@ -1296,10 +1423,9 @@ void ImageCanvas::beginSelectionMove()
         mSelectionAreaBeforeFirstModification = mSelectionArea;
         mSelectionContents = currentProjectImage()->copy(mSelectionAreaBeforeFirstModification);
         // Technically we don't need to call this until the selection has actually moved,
-        // but updateCursorPos() calls pixelColor() on the result of contentImage(), which will be an invalid
-        // image until we've updated the selection preview image (since shouldDrawSelectionPreviewImage() will
-        // return true due to mMovingSelection being true).
-        updateSelectionPreviewImage(SelectionMove);
+        // but shouldDrawSelectionPreviewImage() now returns true due to mMovingSelection being true,
+        // so make sure that the preview is painted as soon as possible.
+        updateSelectionPreview(SelectionMove);
     }
 }
 
@@ -1330,27 +1456,16 @@ void ImageCanvas::updateSelectionArea()
     setSelectionArea(newSelectionArea);
 }
 
-void ImageCanvas::updateSelectionPreviewImage(SelectionModification reason)
+// The preview is composited on demand over just the areas that it affects (see contentOverlays()),
+// so all we need to do here is get those areas (and the ones it used to cover) repainted.
+// The current layer's pixels aren't touched until confirmSelectionModification().
+void ImageCanvas::updateSelectionPreview(SelectionModification reason)
 {
-    qCDebug(lcImageCanvasSelectionPreviewImage) << "updating selection preview image due to" << reason;
+    qCDebug(lcImageCanvasSelectionPreviewImage) << "updating selection preview due to" << reason
+        << "- selection contents:" << mSelectionContents << "selection area:" << mSelectionArea
+        << "is from paste:" << mIsSelectionFromPaste;
 
-    if (!mIsSelectionFromPaste) {
-        // Only if the selection wasn't pasted should we erase the area left behind.
-        mSelectionPreviewImage = Utils::erasePortionOfImage(*currentProjectImage(), mSelectionAreaBeforeFirstModification);
-        qCDebug(lcImageCanvasSelectionPreviewImage) << "... selection is not from paste; erasing area left behind"
-            << "- new selection preview image:" << mSelectionPreviewImage;
-    } else {
-        mSelectionPreviewImage = *currentProjectImage();
-        qCDebug(lcImageCanvasSelectionPreviewImage) << "... selection is from a paste; not touching existing canvas content"
-            << "- new selection preview image:" << mSelectionPreviewImage;
-    }
-
-    // Then, move the dragged contents to their new location.
-    // Doing this last ensures that the drag contents are painted over the transparency,
-    // and not the other way around.
-    qCDebug(lcImageCanvasSelectionPreviewImage) << "painting selection contents" << mSelectionContents
-       << "within selection area" << mSelectionArea << "over top of current project image" << mSelectionPreviewImage;
-    mSelectionPreviewImage = Utils::paintImageOntoPortionOfImage(mSelectionPreviewImage, mSelectionArea, mSelectionContents);
+    requestSelectionPreviewPaint();
 }
 
 void ImageCanvas::moveSelectionArea()
@@ -1363,11 +1478,9 @@ void ImageCanvas::moveSelectionArea()
     setSelectionArea(boundSelectionArea(newSelectionArea));
 
     // TODO: move this to be second-last once all tests are passing
-    updateSelectionPreviewImage(SelectionMove);
+    updateSelectionPreview(SelectionMove);
 
     setLastSelectionModification(SelectionMove);
-
-    requestContentPaint();
 }
 
 void ImageCanvas::moveSelectionAreaBy(const QPoint &pixelDistance)
@@ -1381,15 +1494,12 @@ void ImageCanvas::moveSelectionAreaBy(const QPoint &pixelDistance)
     setSelectionArea(boundSelectionArea(newSelectionArea));
 
     // see TODO in the function above
-    updateSelectionPreviewImage(SelectionMove);
+    updateSelectionPreview(SelectionMove);
 
     setLastSelectionModification(SelectionMove);
 
     setMovingSelection(false);
     mLastValidSelectionArea = mSelectionArea;
-
-    // setSelectionArea() should do this anyway, but just in case..
-    requestContentPaint();
 }
 
 void ImageCanvas::confirmSelectionModification()
@@ -1471,10 +1581,11 @@ void ImageCanvas::clearSelection()
     mSelectionAreaBeforeFirstModification = QRect(0, 0, 0, 0);
     mSelectionAreaBeforeLastMove = QRect(0, 0, 0, 0);
     mLastValidSelectionArea = QRect(0, 0, 0, 0);
-    mSelectionPreviewImage = QImage();
     mSelectionContents = QImage();
     setLastSelectionModification(NoSelectionModification);
     setHasModifiedSelection(false);
+    // Erase the preview, if there was one.
+    requestSelectionPreviewPaint();
 }
 
 void ImageCanvas::clearOrConfirmSelection()
@@ -1712,6 +1823,7 @@ void ImageCanvas::reset()
     // don't really need to be reset each time:
     // - tool
     // - toolSize
+    // - fillTolerance
 
     requestContentPaint();
 }
@@ -1753,7 +1865,7 @@ void ImageCanvas::flipSelection(Qt::Orientation orientation)
         mProject->endMacro();
     } else {
         mSelectionContents = mSelectionContents.mirrored(orientation == Qt::Horizontal, orientation == Qt::Vertical);
-        updateSelectionPreviewImage(SelectionFlip);
+        updateSelectionPreview(SelectionFlip);
         requestContentPaint();
     }
 }
@@ -1793,7 +1905,7 @@ void ImageCanvas::rotateSelection(int angle)
 
     setLastSelectionModification(SelectionRotate);
 
-    updateSelectionPreviewImage(SelectionRotate);
+    updateSelectionPreview(SelectionRotate);
     requestContentPaint();
 }
 
@@ -1850,16 +1962,82 @@ void ImageCanvas::modifySelectionHsl(qreal hue, qreal saturation, qreal lightnes
     qCDebug(lcImageCanvasSelection).nospace() << "modifying HSL of selection"
         << mSelectionArea << " with h=" << hue << " s=" << saturation << " l=" << lightness;
 
+    // The adjustment is done on a worker thread so that the dialog's controls stay responsive.
+    // Only one is done at a time; if one is already underway, this request is started once it's done,
+    // unless it has been superseded by another one by then, in which case it's dropped.
+    mPendingHue = hue;
+    mPendingSaturation = saturation;
+    mPendingLightness = lightness;
+    mHslAdjustmentPending = true;
+    if (!mHslAdjustmentRunning)
+        startHslAdjustment();
+}
+
+void ImageCanvas::startHslAdjustment()
+{
+    mHslAdjustmentPending = false;
+    mHslAdjustmentRunning = true;
+
     // Copy the original so we don't just modify the result of the last adjustment (if any).
-    mSelectionContents = mSelectionContentsBeforeImageAdjustment;
+    const QImage originalSelectionContents = mSelectionContentsBeforeImageAdjustment;
+    const qreal hue = mPendingHue;
+    const qreal saturation = mPendingSaturation;
+    const qreal lightness = mPendingLightness;
+    mHslAdjustmentWatcher.setFuture(QtConcurrent::run([=]() -> QImage {
+        QImage selectionContents = originalSelectionContents;
+        Utils::modifyHsl(selectionContents, hue, saturation, lightness);
+        return selectionContents;
+    }));
+}
 
-    Utils::modifyHsl(mSelectionContents, hue, saturation, lightness);
+void ImageCanvas::onHslAdjustmentFinished()
+{
+    // finishPendingHslAdjustment() or cancelPendingHslAdjustment() may have beaten us to it.
+    if (!mHslAdjustmentRunning)
+        return;
+
+    mHslAdjustmentRunning = false;
+    applyHslAdjustment(mHslAdjustmentWatcher.result());
+
+    if (mHslAdjustmentPending)
+        startHslAdjustment();
+}
+
+void ImageCanvas::applyHslAdjustment(const QImage &adjustedSelectionContents)
+{
+    mSelectionContents = adjustedSelectionContents;
 
     // Set this so that the check in shouldDrawSelectionPreviewImage() evaluates to true.
     setLastSelectionModification(SelectionHsl);
 
-    updateSelectionPreviewImage(SelectionHsl);
-    requestContentPaint();
+    updateSelectionPreview(SelectionHsl);
+}
+
+// Blocks until mSelectionContents reflects the most recent call to modifySelectionHsl().
+void ImageCanvas::finishPendingHslAdjustment()
+{
+    if (mHslAdjustmentRunning) {
+        mHslAdjustmentWatcher.waitForFinished();
+        mHslAdjustmentRunning = false;
+        if (!mHslAdjustmentPending)
+            applyHslAdjustment(mHslAdjustmentWatcher.result());
+    }
+
+    if (mHslAdjustmentPending) {
+        // No point handing it off to the worker thread only to wait for it.
+        mHslAdjustmentPending = false;
+        QImage selectionContents = mSelectionContentsBeforeImageAdjustment;
+        Utils::modifyHsl(selectionContents, mPendingHue, mPendingSaturation, mPendingLightness);
+        applyHslAdjustment(selectionContents);
+    }
+}
+
+void ImageCanvas::cancelPendingHslAdjustment()
+{
+    // Any adjustment that's still running on the worker thread only operates on copies,
+    // so there's no need to wait for it; its result will just be ignored.
+    mHslAdjustmentPending = false;
+    mHslAdjustmentRunning = false;
 }
 
 void ImageCanvas::endModifyingSelectionHsl(AdjustmentAction adjustmentAction)
@@ -1867,13 +2045,15 @@ void ImageCanvas::endModifyingSelectionHsl(AdjustmentAction adjustmentAction)
     qCDebug(lcImageCanvasSelection) << "ended modification of selection's HSL";
 
     if (adjustmentAction == RollbackAdjustment) {
+        cancelPendingHslAdjustment();
         mSelectionContents = mSelectionContentsBeforeImageAdjustment;
         setLastSelectionModification(mLastSelectionModificationBeforeImageAdjustment);
-        updateSelectionPreviewImage(SelectionHsl);
+        updateSelectionPreview(SelectionHsl);
         requestContentPaint();
     } else {
-        // Commit the adjustments. We don't need to request a repaint
-        // since nothing has changed since the last one.
+        // Commit the adjustments. finishPendingHslAdjustment() requests a repaint
+        // if the latest adjustment hadn't been applied yet.
+        finishPendingHslAdjustment();
         setLastSelectionModification(SelectionHsl);
     }
 
@@ -1943,7 +2123,7 @@ void ImageCanvas::paste()
 
     // moveSelectionArea() does this for us when we're moving, but for the initial
     // paste, we must do it ourselves.
-    updateSelectionPreviewImage(SelectionPaste);
+    updateSelectionPreview(SelectionPaste);
 
     requestContentPaint();
 }
@@ -1973,81 +2153,60 @@ void ImageCanvas::cycleFillTools()
     setTool(mLastFillToolUsed == FillTool ? TexturedFillTool : FillTool);
 }
 
-ImageCanvas::PixelCandidateData ImageCanvas::penEraserPixelCandidates(Tool tool) const
+PixelSpans ImageCanvas::penEraserPixelCandidates(Tool tool) const
 {
-    PixelCandidateData candidateData;
+    PixelSpans candidates;
 
     QPoint topLeft(qRound(mCursorSceneFX - mToolSize / 2.0), qRound(mCursorSceneFY - mToolSize / 2.0));
     topLeft = clampToImageBounds(topLeft);
     QPoint bottomRight(qRound(mCursorSceneFX + mToolSize / 2.0), qRound(mCursorSceneFY + mToolSize / 2.0));
     bottomRight = clampToImageBounds(bottomRight);
-    QPoint scenePos(topLeft);
-    for (; scenePos.y() < bottomRight.y(); ++scenePos.ry()) {
-        for (scenePos.rx() = topLeft.x(); scenePos.x() < bottomRight.x(); ++scenePos.rx()) {
-            const QColor previousColour = currentProjectImage()->pixelColor(scenePos);
-            // Let the pen tool draw over the same colour, as the line tool requires
-            // a press point to start from, which we don't get if we make this a no-op.
-            if (tool == PenTool || (tool == EraserTool && previousColour != QColor(Qt::transparent))) {
-                candidateData.scenePositions.append(scenePos);
-                candidateData.previousColours.append(previousColour);
-            }
+    const int width = bottomRight.x() - topLeft.x();
+    if (width <= 0)
+        return candidates;
+
+    const QImage *image = currentProjectImage();
+    QVarLengthArray<QRgb, 256> row(width);
+    for (int y = topLeft.y(); y < bottomRight.y(); ++y) {
+        PixelSpans::readPixels(*image, y, topLeft.x(), width, row.data());
+
+        // Let the pen tool draw over the same colour, as the line tool requires
+        // a press point to start from, which we don't get if we make this a no-op.
+        if (tool == PenTool) {
+            candidates.append(y, topLeft.x(), row.constData(), width);
+            continue;
         }
-    }
-
-    return candidateData;
-}
-
-QImage ImageCanvas::fillPixels() const
-{
-    const QPoint scenePos = QPoint(mCursorSceneX, mCursorSceneY);
-    if (!isWithinImage(scenePos))
-        return QImage();
 
-    const QColor previousColour = currentProjectImage()->pixelColor(scenePos);
-    // Don't do anything if the colours are the same.
-    if (previousColour == penColour())
-        return QImage();
-
-    return imagePixelFloodFill2(currentProjectImage(), scenePos, previousColour, penColour());
-}
-
-QImage ImageCanvas::greedyFillPixels() const
-{
-    const QPoint scenePos = QPoint(mCursorSceneX, mCursorSceneY);
-    if (!isWithinImage(scenePos))
-        return QImage();
-
-    const QColor previousColour = currentProjectImage()->pixelColor(scenePos);
-    if (previousColour == penColour())
-        return QImage();
-
-    return imageGreedyPixelFill2(currentProjectImage(), scenePos, previousColour, penColour());
-}
-
-QImage ImageCanvas::texturedFillPixels() const
-{
-    const QPoint scenePos = QPoint(mCursorSceneX, mCursorSceneY);
-    if (!isWithinImage(scenePos))
-        return QImage();
-
-    const QColor previousColour = currentProjectImage()->pixelColor(scenePos);
-    if (previousColour == penColour())
-        return QImage();
+        // Erasing transparent pixels has no effect, so skip over them.
+        int x = 0;
+        while (x < width) {
+            while (x < width && row[x] == 0)
+                ++x;
+            const int startX = x;
+            while (x < width && row[x] != 0)
+                ++x;
+            candidates.append(y, topLeft.x() + startX, row.constData() + startX, x - startX);
+        }
+    }
 
-    return texturedFill(currentProjectImage(), scenePos, previousColour, penColour(), mTexturedFillParameters);
+    return candidates;
 }
 
-QImage ImageCanvas::greedyTexturedFillPixels() const
+// Returns the colour of the pixel under the cursor if it can be filled with the pen colour,
+// or an invalid colour if there's nothing to fill.
+QColor ImageCanvas::fillTargetColour() const
 {
     const QPoint scenePos = QPoint(mCursorSceneX, mCursorSceneY);
     if (!isWithinImage(scenePos))
-        return QImage();
+        return QColor();
 
     const QColor previousColour = currentProjectImage()->pixelColor(scenePos);
-    if (previousColour == penColour())
-        return QImage();
+    // Don't do anything if the colours are the same, unless
+    // there could be other pixels within the tolerance to fill.
+    if (previousColour == penColour() && mFillTolerance == 0)
+        return QColor();
 
-    return greedyTexturedFill(currentProjectImage(), scenePos, previousColour, penColour(), mTexturedFillParameters);
+    return previousColour;
 }
 
 void ImageCanvas::applyCurrentTool()
@@ -2079,47 +2238,32 @@ void ImageCanvas::applyCurrentTool()
             mPressScenePositionF, mLastPixelPenPressScenePositionF, QPainter::CompositionMode_Clear));
         break;
     }
-    case FillTool: {
-        if (!mShiftPressed) {
-            const QImage filledImage = fillPixels();
-            if (filledImage.isNull())
-                return;
+    case FillTool:
+    case TexturedFillTool: {
+        const QColor previousColour = fillTargetColour();
+        if (!previousColour.isValid())
+            return;
 
-            mProject->beginMacro(QLatin1String("PixelFillTool"));
-            mProject->addChange(new ApplyPixelFillCommand(this, mProject->currentLayerIndex(),
-                *currentProjectImage(), filledImage));
-            // TODO: see if the tests pass with these added
-            // mProject->endMacro();
-        } else {
-            const QImage filledImage = greedyFillPixels();
-            if (filledImage.isNull())
-                return;
+        // Textured fills get their own seed so that redoing them produces the same texture.
+        const bool textured = mTool == TexturedFillTool;
+        const TexturedFillParameters *texturedFillParameters = textured ? &mTexturedFillParameters : nullptr;
+        const quint32 seed = textured ? QRandomGenerator::global()->generate() : 0;
 
-            mProject->beginMacro(QLatin1String("GreedyPixelFillTool"));
-            mProject->addChange(new ApplyGreedyPixelFillCommand(this, mProject->currentLayerIndex(),
-                *currentProjectImage(), filledImage));
-            // mProject->endMacro();
-        }
-        break;
-    }
-    case TexturedFillTool: {
         if (!mShiftPressed) {
-            const QImage filledImage = texturedFillPixels();
-            if (filledImage.isNull())
+            const FillMask mask = imagePixelFloodFillMask(*currentProjectImage(), currentProjectImage()->rect(),
+                QPoint(mCursorSceneX, mCursorSceneY), previousColour, mFillTolerance);
+            if (mask.isEmpty())
                 return;
 
-            mProject->beginMacro(QLatin1String("PixelTexturedFillTool"));
+            mProject->beginMacro(textured ? QLatin1String("PixelTexturedFillTool") : QLatin1String("PixelFillTool"));
             mProject->addChange(new ApplyPixelFillCommand(this, mProject->currentLayerIndex(),
-                *currentProjectImage(), filledImage));
+                mask, penColour(), texturedFillParameters, seed));
+            // TODO: see if the tests pass with these added
             // mProject->endMacro();
         } else {
-            const QImage filledImage = greedyFillPixels();
-            if (filledImage.isNull())
-                return;
-
-            mProject->beginMacro(QLatin1String("GreedyPixelTexturedFillTool"));
+            mProject->beginMacro(textured ? QLatin1String("GreedyPixelTexturedFillTool") : QLatin1String("GreedyPixelFillTool"));
             mProject->addChange(new ApplyGreedyPixelFillCommand(this, mProject->currentLayerIndex(),
-                *currentProjectImage(), filledImage));
+                previousColour, mFillTolerance, penColour(), texturedFillParameters, seed));
             // mProject->endMacro();
         }
         break;
@@ -2132,41 +2276,96 @@ void ImageCanvas::applyCurrentTool()
 // This function actually operates on the image.
 void ImageCanvas::applyPixelPenTool(int layerIndex, const QPoint &scenePos, const QColor &colour, bool markAsLastRelease)
 {
-    imageForLayerAt(layerIndex)->setPixelColor(scenePos, colour);
+    QImage *image = imageForLayerAt(layerIndex);
+    const qint64 cacheKeyBeforeChange = image->cacheKey();
+    image->setPixelColor(scenePos, colour);
     if (markAsLastRelease)
         mLastPixelPenPressScenePosition = scenePos;
-    requestContentPaint();
+    layerImageAreaChanged(layerIndex, QRect(scenePos, QSize(1, 1)), cacheKeyBeforeChange);
+}
+
+void ImageCanvas::applyPixelSpans(int layerIndex, const PixelSpans &spans, const QColor &colour, bool markAsLastRelease)
+{
+    QImage *image = imageForLayerAt(layerIndex);
+    const qint64 cacheKeyBeforeChange = image->cacheKey();
+    const QRgb rgba = colour.rgba();
+    for (const PixelSpans::Span &span : spans.spans())
+        PixelSpans::fillPixels(image, span.y, span.x, span.length, rgba);
+    if (markAsLastRelease && !spans.isEmpty())
+        mLastPixelPenPressScenePosition = spans.lastPosition();
+    layerImageAreaChanged(layerIndex, spans.bounds(), cacheKeyBeforeChange);
+}
+
+void ImageCanvas::restorePixelSpans(int layerIndex, const PixelSpans &spans, bool markAsLastRelease)
+{
+    QImage *image = imageForLayerAt(layerIndex);
+    const qint64 cacheKeyBeforeChange = image->cacheKey();
+    const QVector<PixelSpans::Span> &spanList = spans.spans();
+    for (auto it = spanList.crbegin(); it != spanList.crend(); ++it)
+        PixelSpans::writePixels(image, it->y, it->x, it->length, spans.colours(*it));
+    if (markAsLastRelease && !spans.isEmpty())
+        mLastPixelPenPressScenePosition = spans.lastPosition();
+    layerImageAreaChanged(layerIndex, spans.bounds(), cacheKeyBeforeChange);
 }
 
 void ImageCanvas::applyPixelLineTool(int layerIndex, const QImage &lineImage, const QRect &lineRect,
     const QPointF &lastPixelPenReleaseScenePosition)
 {
     mLastPixelPenPressScenePositionF = lastPixelPenReleaseScenePosition;
-    QPainter painter(imageForLayerAt(layerIndex));
+    QImage *image = imageForLayerAt(layerIndex);
+    const qint64 cacheKeyBeforeChange = image->cacheKey();
+    QPainter painter(image);
     painter.setCompositionMode(QPainter::CompositionMode_Source);
     painter.drawImage(lineRect, lineImage);
+    painter.end();
+    layerImageAreaChanged(layerIndex, lineRect, cacheKeyBeforeChange);
+}
+
+void ImageCanvas::applyPixelFillTool(int layerIndex, const FillMask &mask, const QColor &colour,
+    FillColourProvider *fillColourProvider)
+{
+    QImage *image = imageForLayerAt(layerIndex);
+    const qint64 cacheKeyBeforeChange = image->cacheKey();
+    applyFillMask(image, mask, colour, fillColourProvider);
+    layerImageAreaChanged(layerIndex, mask.bounds(), cacheKeyBeforeChange);
+}
+
+void ImageCanvas::applyGreedyPixelFillTool(int layerIndex, const QColor &targetColour, int tolerance,
+    const QColor &colour, FillColourProvider *fillColourProvider)
+{
+    QImage *image = imageForLayerAt(layerIndex);
+    if (!fillColourProvider) {
+        imageGreedyPixelFillInPlace(image, image->rect(), targetColour, colour, tolerance);
+    } else {
+        const FillMask mask = imageGreedyPixelFillMask(*image, image->rect(), targetColour, tolerance);
+        applyFillMask(image, mask, colour, fillColourProvider);
+    }
     requestContentPaint();
+    emit contentChanged(QRect());
 }
 
 void ImageCanvas::paintImageOntoPortionOfImage(int layerIndex, const QRect &portion, const QImage &replacementImage)
 {
     QImage *image = imageForLayerAt(layerIndex);
-    *image = Utils::paintImageOntoPortionOfImage(*image, portion, replacementImage);
-    requestContentPaint();
+    const qint64 cacheKeyBeforeChange = image->cacheKey();
+    const QRect changedArea = Utils::paintImageOntoPortionOfImage(image, portion, replacementImage);
+    layerImageAreaChanged(layerIndex, changedArea, cacheKeyBeforeChange);
 }
 
 void ImageCanvas::replacePortionOfImage(int layerIndex, const QRect &portion, const QImage &replacementImage)
 {
     QImage *image = imageForLayerAt(layerIndex);
-    *image = Utils::replacePortionOfImage(*image, portion, replacementImage);
-    requestContentPaint();
+    const qint64 cacheKeyBeforeChange = image->cacheKey();
+    const QRect changedArea = Utils::replacePortionOfImage(image, portion, replacementImage);
+    layerImageAreaChanged(layerIndex, changedArea, cacheKeyBeforeChange);
 }
 
 void ImageCanvas::erasePortionOfImage(int layerIndex, const QRect &portion)
 {
     QImage *image = imageForLayerAt(layerIndex);
-    *image = Utils::erasePortionOfImage(*image, portion);
-    requestContentPaint();
+    const qint64 cacheKeyBeforeChange = image->cacheKey();
+    const QRect changedArea = Utils::erasePortionOfImage(image, portion);
+    layerImageAreaChanged(layerIndex, changedArea, cacheKeyBeforeChange);
 }
 
 void ImageCanvas::replaceImage(int layerIndex, const QImage &replacementImage)
@@ -2175,6 +2374,7 @@ void ImageCanvas::replaceImage(int layerIndex, const QImage &replacementImage)
     QImage *image = imageForLayerAt(layerIndex);
     *image = replacementImage;
     requestContentPaint();
+    emit contentChanged(QRect());
 }
 
 void ImageCanvas::doFlipSelection(int layerIndex, const QRect &area, Qt::Orientation orientation)
@@ -2187,17 +2387,23 @@ void ImageCanvas::doFlipSelection(int layerIndex, const QRect &area, Qt::Orienta
 
 QRect ImageCanvas::doRotateSelection(int layerIndex, const QRect &area, int angle)
 {
-    QImage *image = imageForLayerAt(layerIndex);
     QRect rotatedArea;
-    *image = Utils::rotateAreaWithinImage(*image, area, angle, rotatedArea);
+    const QImage rotatedImagePortion = Utils::rotateAreaWithinImage(*imageForLayerAt(layerIndex), area, angle, rotatedArea);
+    erasePortionOfImage(layerIndex, area);
+    paintImageOntoPortionOfImage(layerIndex, rotatedArea, rotatedImagePortion);
     // Only update the selection area when the commands are being created for the first time,
     // not when they're being undone and redone.
     if (mHasSelection)
         setSelectionArea(rotatedArea);
-    requestContentPaint();
     return area.united(rotatedArea);
 }
 
+void ImageCanvas::layerImageAreaChanged(int, const QRect &sceneArea, qint64)
+{
+    requestContentAreaPaint(sceneArea);
+    emit contentChanged(sceneArea);
+}
+
 QPointF ImageCanvas::linePoint1() const
 {
     return mLastPixelPenPressScenePositionF;
@@ -2254,15 +2460,23 @@ void ImageCanvas::updateCursorPos(const QPoint &eventPos)
     setCursorSceneX(mCursorSceneFX);
     setCursorSceneY(mCursorSceneFY);
 
+    // Don't hold on to this, as it shares its data with the project's image(s),
+    // and that would cause them to be detached (copied) the next time they're modified.
+    const QImage contentImage = getContentImage();
     if (mCursorSceneX < 0 || mCursorSceneX >= mProject->widthInPixels()
         || mCursorSceneY < 0 || mCursorSceneY >= mProject->heightInPixels()
-        // The cached contents can be null for some reason during tests; probably because
-        // the canvas gets events before it has rendered. No big deal, it wouldn't be visible yet anyway.
-        || mCachedContentImage.isNull()) {
+        // The content can be null e.g. if a layered image project has no layers yet.
+        || contentImage.isNull()) {
         setCursorPixelColour(QColor(Qt::black));
     } else {
         const QPoint cursorScenePos = QPoint(mCursorSceneX, mCursorSceneY);
-        setCursorPixelColour(mCachedContentImage.pixelColor(cursorScenePos));
+        QColor colour = contentImage.pixelColor(cursorScenePos);
+        // Previews are drawn over the content, so check them too; the last one wins.
+        for (const ContentOverlay &overlay : qAsConst(mCachedContentOverlays)) {
+            if (overlay.sceneArea.contains(cursorScenePos))
+                colour = overlay.image.pixelColor(cursorScenePos - overlay.sceneArea.topLeft());
+        }
+        setCursorPixelColour(colour);
     }
 
     const bool cursorScenePosChanged = mCursorSceneX != oldCursorSceneX || mCursorSceneY != oldCursorSceneY;
@@ -2300,17 +2514,57 @@ void ImageCanvas::onLoadedChanged()
     updateWindowCursorShape();
 }
 
+void ImageCanvas::onProjectContentReplaced()
+{
+    emit contentChanged(QRect());
+}
+
 void ImageCanvas::requestContentPaint()
 {
     // It's nice to be able to debug where a paint request comes from;
     // that's the only reason that these functions are slots and the signal isn't
     // just emitted immediately instead.
-    emit contentPaintRequested(-1);
+    emit contentPaintRequested(-1, QRect());
 }
 
 void ImageCanvas::requestPaneContentPaint(int paneIndex)
 {
-    emit contentPaintRequested(paneIndex);
+    emit contentPaintRequested(paneIndex, QRect());
+}
+
+void ImageCanvas::requestContentAreaPaint(const QRect &sceneArea)
+{
+    if (sceneArea.isEmpty())
+        return;
+
+    emit contentPaintRequested(-1, sceneArea);
+}
+
+void ImageCanvas::requestLinePreviewPaint()
+{
+    const QRect lineArea = isLineVisible() ? normalisedLineRect(linePoint1(), linePoint2()) : QRect();
+    const QRect areaToPaint = lineArea | mLinePreviewArea;
+    mLinePreviewArea = lineArea;
+    if (areaToPaint.isEmpty())
+        return;
+
+    emit contentPaintRequested(-1, areaToPaint);
+}
+
+void ImageCanvas::requestSelectionPreviewPaint()
+{
+    QRegion regionToPaint = mSelectionPreviewRegion;
+    mSelectionPreviewRegion = QRegion();
+    const QVector<QRect> selectionAreas = selectionPreviewAreas();
+    for (const QRect &selectionArea : selectionAreas) {
+        regionToPaint += selectionArea;
+        mSelectionPreviewRegion += selectionArea;
+    }
+
+    // The source and target areas can be far apart, so paint them separately
+    // rather than painting everything in between.
+    for (const QRect &rect : regionToPaint)
+        emit contentPaintRequested(-1, rect);
 }
 
 void ImageCanvas::updateWindowCursorShape()
@@ -2829,7 +3083,7 @@ void ImageCanvas::hoverMoveEvent(QHoverEvent *event)
     updateWindowCursorShape();
 
     if (mTool == PenTool && mShiftPressed)
-        requestContentPaint();
+        requestLinePreviewPaint();
 }
 
 void ImageCanvas::hoverLeaveEvent(QHoverEvent *event)
@@ -2968,7 +3222,7 @@ void ImageCanvas::undo()
             // to be done this way, because we want to behave like mspsaint, where pressing Ctrl+Z
             // with a modified selection will undo *all* modifications done to the selection since it was created.
             // Since we have special undo behaviour, we can't use the undo framework for all of it, and so
-            // we store the temporary state in mSelectionContents (which is displayed via mSelectionPreviewImage).
+            // we store the temporary state in mSelectionContents (which is displayed via contentOverlays()).
             // See the undo shortcut in Shortcuts.qml for more info.
             mProject->undoStack()->undo();
 //            requestContentPaint();
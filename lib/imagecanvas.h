@@ -21,17 +21,22 @@
 #define IMAGECANVAS_H
 
 #include <QBasicTimer>
+#include <QFutureWatcher>
 #include <QObject>
 #include <QLoggingCategory>
 #include <QPixmap>
 #include <QQuickItem>
+#include <QRegion>
 #include <QStack>
 #include <QTimerEvent>
 #include <QUndoStack>
 #include <QWheelEvent>
 #include <QPainter>
 
+#include <functional>
+
 #include "canvaspane.h"
+#include "pixelspans.h"
 #include "ruler.h"
 #include "selectionitem.h"
 #include "slate-global.h"
@@ -41,6 +46,8 @@
 Q_DECLARE_LOGGING_CATEGORY(lcImageCanvas)
 Q_DECLARE_LOGGING_CATEGORY(lcImageCanvasLifecycle)
 
+class FillColourProvider;
+class FillMask;
 class Guide;
 class GuidesItem;
 class ImageProject;
@@ -82,6 +89,7 @@ class SLATE_EXPORT ImageCanvas : public QQuickItem
     Q_PROPERTY(Tool lastFillToolUsed READ lastFillToolUsed NOTIFY lastFillToolUsedChanged)
     Q_PROPERTY(int toolSize READ toolSize WRITE setToolSize NOTIFY toolSizeChanged)
     Q_PROPERTY(int maxToolSize READ maxToolSize CONSTANT)
+    Q_PROPERTY(int fillTolerance READ fillTolerance WRITE setFillTolerance NOTIFY fillToleranceChanged)
     Q_PROPERTY(ToolShape toolShape READ toolShape WRITE setToolShape NOTIFY toolShapeChanged)
     Q_PROPERTY(QColor penForegroundColour READ penForegroundColour WRITE setPenForegroundColour NOTIFY penForegroundColourChanged)
     Q_PROPERTY(QColor penBackgroundColour READ penBackgroundColour WRITE setPenBackgroundColour NOTIFY penBackgroundColourChanged)
@@ -212,6 +220,8 @@ public:
     int toolSize() const;
     void setToolSize(int toolSize);
     int maxToolSize() const;
+    int fillTolerance() const;
+    void setFillTolerance(int fillTolerance);
 
     QColor penForegroundColour() const;
     void setPenForegroundColour(const QColor &penForegroundColour);
@@ -248,17 +258,31 @@ public:
 
     virtual QList<SubImage> subImagesInBounds(const QRect &bounds) const;
 
-    // Essentially currentProjectImage() for regular image canvas, but may return a
-    // preview image if there is a selection active. For layered image canvases, this
-    // should return all layers flattened into one image, or the same flattened image
-    // as part of a selection preview image.
+    // Essentially currentProjectImage() for regular image canvas, but with any previews
+    // (e.g. of a selection that is being modified) drawn over it. For layered image canvases,
+    // this returns all layers flattened into one image, with the same previews.
     //
-    // This function calls getContentImage() and caches the result so that we have
-    // cheap lookup of pixel data, which is useful for e.g. mCursorPixelColour.
+    // This is expensive, as it copies the whole image; panes draw baseContentImage() and
+    // contentOverlays() instead.
     //
     // Public for auto test access.
     QImage contentImage();
 
+    // The content without any previews; what panes draw beneath contentOverlays().
+    // This is a shallow copy, so callers shouldn't hold on to it.
+    QImage baseContentImage();
+
+    struct ContentOverlay {
+        // The area of the scene that image replaces.
+        QRect sceneArea;
+        QImage image;
+    };
+
+    // Previews (e.g. of the pixel-pen-line) that panes should draw over contentImage(),
+    // replacing the content within their area. Only the area that each one
+    // covers needs to be copied and composited, instead of the whole image.
+    QVector<ContentOverlay> contentOverlays();
+
     Q_INVOKABLE void undo();
 
     // The image that is currently being drawn on. For regular image canvases, this is
@@ -316,6 +340,7 @@ signals:
     void toolShapeChanged();
     void lastFillToolUsedChanged();
     void toolSizeChanged();
+    void fillToleranceChanged();
     void penForegroundColourChanged();
     void penBackgroundColourChanged();
     void hasBlankCursorChanged();
@@ -331,8 +356,13 @@ signals:
     // Used to signal CanvasPaneItem classes that they should redraw,
     // instead of them having to connect to lots of specific signals.
     // paneIndex is the index of the pane that should be redrawn,
-    // or -1 for all panes.
-    void contentPaintRequested(int paneIndex);
+    // or -1 for all panes. sceneArea is the area of the scene that
+    // changed, or a null rect if the whole pane should be redrawn.
+    void contentPaintRequested(int paneIndex, const QRect &sceneArea);
+    // Emitted when the pixels within sceneArea of the project's content have changed,
+    // or with a null rect if any of it may have. Unlike contentPaintRequested(),
+    // this isn't emitted for things that are only drawn on top of the content, like previews.
+    void contentChanged(const QRect &sceneArea);
 
     void errorOccurred(const QString &errorMessage);
 
@@ -356,6 +386,7 @@ public slots:
 protected slots:
     virtual void reset();
     virtual void onLoadedChanged();
+    void onProjectContentReplaced();
 
     // Requests both panes to be repainted. Most operations
     // (like the user drawing pixels) require both panes to be redrawn,
@@ -363,6 +394,13 @@ protected slots:
     // requestPaneContentPaint() and pass a specific index.
     void requestContentPaint();
     void requestPaneContentPaint(int paneIndex);
+    // Requests that only the given area of the scene is repainted in both panes.
+    // This is much cheaper than repainting everything when e.g. a single pixel has changed.
+    void requestContentAreaPaint(const QRect &sceneArea);
+    // Requests that the area covered by the pixel-pen-line preview (before and after it changed) is repainted.
+    void requestLinePreviewPaint();
+    // Likewise, but for the areas covered by the preview of a selection that is being modified.
+    void requestSelectionPreviewPaint();
     void updateWindowCursorShape();
     void onZoomLevelChanged();
     void onPaneintegerOffsetChanged();
@@ -372,6 +410,7 @@ protected slots:
     void onReadyForWritingToJson(QJsonObject* projectJson);
     void onAboutToBeginMacro(const QString &macroText);
     void recreateCheckerImage();
+    void onHslAdjustmentFinished();
 
 protected:
     void componentComplete() override;
@@ -389,26 +428,30 @@ protected:
     friend class FlipImageCanvasSelectionCommand;
     friend class PasteImageCanvasCommand;
 
-    struct PixelCandidateData
-    {
-        QVector<QPoint> scenePositions;
-        QVector<QColor> previousColours;
-    };
-    virtual PixelCandidateData penEraserPixelCandidates(Tool tool) const;
-    QImage fillPixels() const;
-    QImage greedyFillPixels() const;
-    QImage texturedFillPixels() const;
-    QImage greedyTexturedFillPixels() const;
+    // The pixels under the cursor that the tool would affect, along with their current colours.
+    virtual PixelSpans penEraserPixelCandidates(Tool tool) const;
+    QColor fillTargetColour() const;
 
     virtual void applyCurrentTool();
     virtual void applyPixelPenTool(int layerIndex, const QPoint &scenePos, const QColor &colour, bool markAsLastRelease = false);
+    // Sets every pixel in spans to colour.
+    virtual void applyPixelSpans(int layerIndex, const PixelSpans &spans, const QColor &colour, bool markAsLastRelease = false);
+    // Sets every pixel in spans back to its colour in spans. Later spans are restored first,
+    // so that a pixel that appears more than once ends up with its earliest colour.
+    virtual void restorePixelSpans(int layerIndex, const PixelSpans &spans, bool markAsLastRelease = false);
     virtual void applyPixelLineTool(int layerIndex, const QImage &lineImage, const QRect &lineRect, const QPointF &lastPixelPenReleaseScenePosition);
+    void applyPixelFillTool(int layerIndex, const FillMask &mask, const QColor &colour, FillColourProvider *fillColourProvider);
+    void applyGreedyPixelFillTool(int layerIndex, const QColor &targetColour, int tolerance, const QColor &colour,
+        FillColourProvider *fillColourProvider);
     void paintImageOntoPortionOfImage(int layerIndex, const QRect &portion, const QImage &replacementImage);
     void replacePortionOfImage(int layerIndex, const QRect &portion, const QImage &replacementImage);
     void erasePortionOfImage(int layerIndex, const QRect &portion);
     virtual void replaceImage(int layerIndex, const QImage &replacementImage);
     void doFlipSelection(int layerIndex, const QRect &area, Qt::Orientation orientation);
     QRect doRotateSelection(int layerIndex, const QRect &area, int angle);
+    // Called after the pixels within sceneArea of a layer's image have been changed.
+    // cacheKeyBeforeChange is the image's QImage::cacheKey() from before it was changed.
+    virtual void layerImageAreaChanged(int layerIndex, const QRect &sceneArea, qint64 cacheKeyBeforeChange);
 
     QPointF linePoint1() const;
     QPointF linePoint2() const;
@@ -433,6 +476,9 @@ protected:
     CanvasPane *hoveredPane(const QPoint &pos);
     QPoint eventPosRelativeToCurrentPane(const QPoint &pos);
     virtual QImage getContentImage();
+    // Returns the content within sceneArea as it would look if modifyCurrentLayer
+    // was called with a painter on the current layer's image.
+    virtual QImage getContentAreaImage(const QRect &sceneArea, const std::function<void(QPainter*)> &modifyCurrentLayer);
     void drawLine(QPainter *painter, QPointF point1, QPointF point2, const QPainter::CompositionMode mode) const;
     void centrePanes(bool respectSceneCentred = true);
     enum ResetPaneSizePolicy {
@@ -465,7 +511,7 @@ protected:
     void beginSelectionMove();
     void updateOrMoveSelectionArea();
     void updateSelectionArea();
-    void updateSelectionPreviewImage(SelectionModification reason = NoSelectionModification);
+    void updateSelectionPreview(SelectionModification reason = NoSelectionModification);
     void moveSelectionArea();
     void moveSelectionAreaBy(const QPoint &pixelDistance);
     void confirmSelectionModification();
@@ -477,6 +523,8 @@ protected:
     void setMovingSelection(bool movingSelection);
     bool cursorOverSelection() const;
     bool shouldDrawSelectionPreviewImage() const;
+    QVector<QRect> selectionPreviewAreas() const;
+    void drawSelectionPreview(QPainter *painter) const;
     bool shouldDrawSelectionCursorGuide() const;
     void updateSelectionCursorGuideVisibility();
     void confirmPasteSelection();
@@ -484,6 +532,10 @@ protected:
     void panWithSelectionIfAtEdge(SelectionPanReason reason);
     void setLastSelectionModification(SelectionModification selectionModification);
     void setHasModifiedSelection(bool hasModifiedSelection);
+    void startHslAdjustment();
+    void applyHslAdjustment(const QImage &adjustedSelectionContents);
+    void finishPendingHslAdjustment();
+    void cancelPendingHslAdjustment();
 
     void setAltPressed(bool altPressed);
 
@@ -516,6 +568,7 @@ private:
 
 protected:
     friend class CanvasPaneItem;
+    friend class TextureCanvasPaneItem;
     friend class TileCanvasPaneItem;
 
     // The background colour of the entire pane.
@@ -547,7 +600,9 @@ protected:
     SelectionItem *mSelectionItem;
 
     // Used for setCursorPixelColour().
-    QImage mCachedContentImage;
+    QVector<ContentOverlay> mCachedContentOverlays;
+    // The area that the pixel-pen-line preview covered when it was last requested to be painted.
+    QRect mLinePreviewArea;
 
     // The position of the cursor in view coordinates.
     int mCursorX;
@@ -582,6 +637,8 @@ protected:
     Tool mLastFillToolUsed;
     int mToolSize;
     int mMaxToolSize;
+    // How far (0 to 255) each channel of a pixel can be from the target colour for fills to include it.
+    int mFillTolerance;
     QColor mPenForegroundColour;
     QColor mPenBackgroundColour;
 
@@ -611,12 +668,18 @@ protected:
     QRect mLastValidSelectionArea;
     // The image contents of the selection.
     QImage mSelectionContents;
-    // The entire image as it would look if the selection (that is currently being dragged)
-    // was dropped where it is now.
-    QImage mSelectionPreviewImage;
+    // The areas that the selection preview covered when it was last painted.
+    QRegion mSelectionPreviewRegion;
     // See the definition of beginModifyingSelectionHsl() for info.
     QImage mSelectionContentsBeforeImageAdjustment;
     SelectionModification mLastSelectionModificationBeforeImageAdjustment;
+    // See the definition of modifySelectionHsl() for info.
+    QFutureWatcher<QImage> mHslAdjustmentWatcher;
+    bool mHslAdjustmentRunning;
+    bool mHslAdjustmentPending;
+    qreal mPendingHue;
+    qreal mPendingSaturation;
+    qreal mPendingLightness;
     QBasicTimer mSelectionEdgePanTimer;
     SelectionCursorGuide *mSelectionCursorGuide;
     // The type of the last modification that was done to the selection.
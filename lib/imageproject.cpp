@@ -118,6 +118,7 @@ void ImageProject::doClose()
     mUsingTempImage = false;
     setUrl(QUrl());
     mUndoStack.clear();
+    clearUndoCheckpoints();
     mUsingAnimation = false;
     mAnimationPlayback.reset();
     emit projectClosed();
@@ -185,6 +186,19 @@ Project::Type ImageProject::type() const
     return ImageType;
 }
 
+QVector<QImage*> ImageProject::undoCheckpointImages()
+{
+    return QVector<QImage*>() << &mImage;
+}
+
+void ImageProject::undoCheckpointRestored(const QSize &previousSize)
+{
+    if (size() != previousSize)
+        emit sizeChanged();
+
+    emit contentsReplaced();
+}
+
 void ImageProject::doSetCanvasSize(const QImage &newImage)
 {
     doSetImageSize(newImage);
@@ -66,6 +66,9 @@ protected:
     void doClose() override;
     void doSaveAs(const QUrl &url) override;
 
+    QVector<QImage*> undoCheckpointImages() override;
+    void undoCheckpointRestored(const QSize &previousSize) override;
+
 private:
     friend class ChangeImageCanvasSizeCommand;
     friend class ChangeImageSizeCommand;
@@ -0,0 +1,143 @@
+/*
+    Copyright 2018, Mitch Curtis
+
+    This file is part of Slate.
+
+    Slate is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Slate is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Slate. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "layercompositor.h"
+
+#include <QLoggingCategory>
+#include <QPainter>
+
+Q_LOGGING_CATEGORY(lcLayerCompositor, "app.layerCompositor")
+
+LayerCompositor::LayerCompositor(int blockSize) :
+    mBlockSize(blockSize),
+    mBlocksWide(0),
+    mBlocksHigh(0),
+    mAllDirty(true),
+    mLastRecompositedBlockCount(0)
+{
+    Q_ASSERT(mBlockSize > 0);
+}
+
+int LayerCompositor::blockSize() const
+{
+    return mBlockSize;
+}
+
+void LayerCompositor::markDirty(const QImage *image, const QRect &area, qint64 cacheKeyBeforeChange)
+{
+    markBlocksDirty(area);
+
+    // Only changes that we know the area of can be composited
+    // block by block; see composite().
+    auto it = mCacheKeys.find(image);
+    if (it == mCacheKeys.end())
+        return;
+
+    // Updating the key would hide earlier changes that we weren't told about.
+    if (it.value() != cacheKeyBeforeChange) {
+        qCDebug(lcLayerCompositor) << "image" << image << "changed without its area being marked dirty";
+        markAllDirty();
+    }
+    it.value() = image->cacheKey();
+}
+
+void LayerCompositor::markAllDirty()
+{
+    mAllDirty = true;
+}
+
+QImage LayerCompositor::composite(const QVector<const QImage*> &images, const QSize &size)
+{
+    if (size != mComposite.size() || images != mImages) {
+        mAllDirty = true;
+    } else {
+        // The image was modified without us being told where.
+        for (const QImage *image : images) {
+            if (mCacheKeys.value(image) != image->cacheKey()) {
+                qCDebug(lcLayerCompositor) << "image" << image << "changed without its area being marked dirty";
+                mAllDirty = true;
+                break;
+            }
+        }
+    }
+
+    if (mAllDirty) {
+        if (size != mComposite.size()) {
+            mComposite = QImage(size, QImage::Format_ARGB32_Premultiplied);
+            mBlocksWide = (size.width() + mBlockSize - 1) / mBlockSize;
+            mBlocksHigh = (size.height() + mBlockSize - 1) / mBlockSize;
+        }
+        mDirtyBlocks.fill(true, mBlocksWide * mBlocksHigh);
+        mAllDirty = false;
+    }
+
+    mImages = images;
+    mCacheKeys.clear();
+    for (const QImage *image : images)
+        mCacheKeys.insert(image, image->cacheKey());
+
+    mLastRecompositedBlockCount = 0;
+    if (!mDirtyBlocks.contains(true))
+        return mComposite;
+
+    QPainter painter(&mComposite);
+    for (int blockY = 0; blockY < mBlocksHigh; ++blockY) {
+        for (int blockX = 0; blockX < mBlocksWide; ++blockX) {
+            bool &dirty = mDirtyBlocks[blockY * mBlocksWide + blockX];
+            if (!dirty)
+                continue;
+
+            const QRect blockRect = QRect(blockX * mBlockSize, blockY * mBlockSize,
+                mBlockSize, mBlockSize) & mComposite.rect();
+            painter.setCompositionMode(QPainter::CompositionMode_Source);
+            painter.fillRect(blockRect, Qt::transparent);
+            painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+            for (const QImage *image : images)
+                painter.drawImage(blockRect.topLeft(), *image, blockRect);
+
+            dirty = false;
+            ++mLastRecompositedBlockCount;
+        }
+    }
+
+    qCDebug(lcLayerCompositor) << "recomposited" << mLastRecompositedBlockCount << "of"
+        << mDirtyBlocks.size() << "blocks";
+    return mComposite;
+}
+
+int LayerCompositor::lastRecompositedBlockCount() const
+{
+    return mLastRecompositedBlockCount;
+}
+
+void LayerCompositor::markBlocksDirty(const QRect &area)
+{
+    const QRect boundedArea = area & QRect(0, 0, mBlocksWide * mBlockSize, mBlocksHigh * mBlockSize);
+    if (boundedArea.isEmpty())
+        return;
+
+    const int firstBlockX = boundedArea.left() / mBlockSize;
+    const int lastBlockX = boundedArea.right() / mBlockSize;
+    const int firstBlockY = boundedArea.top() / mBlockSize;
+    const int lastBlockY = boundedArea.bottom() / mBlockSize;
+    for (int blockY = firstBlockY; blockY <= lastBlockY; ++blockY) {
+        for (int blockX = firstBlockX; blockX <= lastBlockX; ++blockX)
+            mDirtyBlocks[blockY * mBlocksWide + blockX] = true;
+    }
+}
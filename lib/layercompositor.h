@@ -0,0 +1,73 @@
+/*
+    Copyright 2018, Mitch Curtis
+
+    This file is part of Slate.
+
+    Slate is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Slate is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Slate. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LAYERCOMPOSITOR_H
+#define LAYERCOMPOSITOR_H
+
+#include <QHash>
+#include <QImage>
+#include <QRect>
+#include <QVector>
+
+#include "slate-global.h"
+
+// Keeps a persistent composite of a set of layer images. The composite is
+// split into fixed-size blocks, and only the blocks that have changed since
+// the last call to composite() are recomposited.
+//
+// As a safety net, images that change without markDirty() being called
+// are detected via QImage::cacheKey(), and cause everything to be recomposited.
+class SLATE_EXPORT LayerCompositor
+{
+public:
+    explicit LayerCompositor(int blockSize = 128);
+
+    int blockSize() const;
+
+    // Records that area of image has changed. This should be called after the
+    // image has been modified, and before the next call to composite().
+    // cacheKeyBeforeChange is the image's cacheKey() from before it was modified;
+    // if it had already changed since we last saw it, everything is recomposited.
+    void markDirty(const QImage *image, const QRect &area, qint64 cacheKeyBeforeChange);
+    void markAllDirty();
+
+    // Returns the composite of images, which are drawn in order,
+    // so the first is at the bottom.
+    QImage composite(const QVector<const QImage*> &images, const QSize &size);
+
+    // The number of blocks that were recomposited by the last call to composite().
+    int lastRecompositedBlockCount() const;
+
+private:
+    void markBlocksDirty(const QRect &area);
+
+    int mBlockSize;
+    QImage mComposite;
+    // The images as of the last composite, so that changes to the set can be detected.
+    QVector<const QImage*> mImages;
+    // The cache key of each image as of the last composite or markDirty().
+    QHash<const QImage*, qint64> mCacheKeys;
+    QVector<bool> mDirtyBlocks;
+    int mBlocksWide;
+    int mBlocksHigh;
+    bool mAllDirty;
+    int mLastRecompositedBlockCount;
+};
+
+#endif // LAYERCOMPOSITOR_H
@@ -26,7 +26,8 @@
 #include "layeredimageproject.h"
 
 LayeredImageCanvas::LayeredImageCanvas() :
-    mLayeredImageProject(nullptr)
+    mLayeredImageProject(nullptr),
+    mLayerCompositesValid(false)
 {
     qCDebug(lcImageCanvasLifecycle) << "constructing LayeredImageCanvas" << this;
 }
@@ -42,7 +43,9 @@ void LayeredImageCanvas::onPostLayerAdded(int index)
     // TODO: could we move these to LayeredImageProject and save a few connections?
     connect(layer, &ImageLayer::visibleChanged, this, &LayeredImageCanvas::onLayerVisibleChanged);
     connect(layer, &ImageLayer::opacityChanged, this, &LayeredImageCanvas::onLayerOpacityChanged);
+    invalidateLayerComposites();
     requestContentPaint();
+    emit contentChanged(QRect());
 }
 
 void LayeredImageCanvas::onPreLayerRemoved(int index)
@@ -54,22 +57,37 @@ void LayeredImageCanvas::onPreLayerRemoved(int index)
 
 void LayeredImageCanvas::onPostLayerRemoved()
 {
+    invalidateLayerComposites();
     requestContentPaint();
+    emit contentChanged(QRect());
 }
 
 void LayeredImageCanvas::onPostLayerMoved()
 {
+    invalidateLayerComposites();
     requestContentPaint();
+    emit contentChanged(QRect());
 }
 
 void LayeredImageCanvas::onPostLayerImageChanged()
 {
+    invalidateLayerComposites();
     requestContentPaint();
+    emit contentChanged(QRect());
+}
+
+void LayeredImageCanvas::onContentsMoved()
+{
+    invalidateLayerComposites();
+    requestContentPaint();
+    emit contentChanged(QRect());
 }
 
 void LayeredImageCanvas::onLayerVisibleChanged()
 {
+    invalidateLayerComposites();
     requestContentPaint();
+    emit contentChanged(QRect());
 
     ImageLayer *layer = qobject_cast<ImageLayer*>(sender());
     if (layer == mLayeredImageProject->currentLayer())
@@ -81,8 +99,11 @@ void LayeredImageCanvas::onLayerOpacityChanged()
     ImageLayer *layer = qobject_cast<ImageLayer*>(sender());
     Q_ASSERT(layer);
     // We don't care about opacity changes of invisible layers.
-    if (layer->isVisible())
+    if (layer->isVisible()) {
+        invalidateLayerComposites();
         requestContentPaint();
+        emit contentChanged(QRect());
+    }
 }
 
 void LayeredImageCanvas::onPreCurrentLayerChanged()
@@ -98,9 +119,15 @@ void LayeredImageCanvas::onPreCurrentLayerChanged()
 
 void LayeredImageCanvas::onPostCurrentLayerChanged()
 {
+    invalidateLayerComposites();
     updateWindowCursorShape();
 }
 
+void LayeredImageCanvas::invalidateLayerComposites()
+{
+    mLayerCompositesValid = false;
+}
+
 void LayeredImageCanvas::connectSignals()
 {
     ImageCanvas::connectSignals();
@@ -115,7 +142,9 @@ void LayeredImageCanvas::connectSignals()
     connect(mLayeredImageProject, &LayeredImageProject::postLayerImageChanged, this, &LayeredImageCanvas::onPostLayerImageChanged);
     connect(mLayeredImageProject, &LayeredImageProject::preCurrentLayerChanged, this, &LayeredImageCanvas::onPreCurrentLayerChanged);
     connect(mLayeredImageProject, &LayeredImageProject::postCurrentLayerChanged, this, &LayeredImageCanvas::onPostCurrentLayerChanged);
-    connect(mLayeredImageProject, &LayeredImageProject::contentsMoved, this, &LayeredImageCanvas::requestContentPaint);
+    connect(mLayeredImageProject, &LayeredImageProject::contentsMoved, this, &LayeredImageCanvas::onContentsMoved);
+    connect(mLayeredImageProject, &LayeredImageProject::sizeChanged, this, &LayeredImageCanvas::invalidateLayerComposites);
+    invalidateLayerComposites();
 
     // Connect to all existing layers, as onPostLayerAdded() won't get called for them automatically.
     for (int i = 0; i < mLayeredImageProject->layerCount(); ++i) {
@@ -134,7 +163,8 @@ void LayeredImageCanvas::disconnectSignals()
     disconnect(mLayeredImageProject, &LayeredImageProject::postLayerImageChanged, this, &LayeredImageCanvas::onPostLayerImageChanged);
     disconnect(mLayeredImageProject, &LayeredImageProject::preCurrentLayerChanged, this, &LayeredImageCanvas::onPreCurrentLayerChanged);
     disconnect(mLayeredImageProject, &LayeredImageProject::postCurrentLayerChanged, this, &LayeredImageCanvas::onPostCurrentLayerChanged);
-    disconnect(mLayeredImageProject, &LayeredImageProject::contentsMoved, this, &LayeredImageCanvas::requestContentPaint);
+    disconnect(mLayeredImageProject, &LayeredImageProject::contentsMoved, this, &LayeredImageCanvas::onContentsMoved);
+    disconnect(mLayeredImageProject, &LayeredImageProject::sizeChanged, this, &LayeredImageCanvas::invalidateLayerComposites);
 
     mLayeredImageProject = nullptr;
 }
@@ -151,6 +181,10 @@ const QImage *LayeredImageCanvas::currentProjectImage() const
 
 QImage *LayeredImageCanvas::imageForLayerAt(int layerIndex)
 {
+    // The caller is likely about to modify the image, and if it's
+    // not the current layer's, it's part of one of the composites.
+    if (layerIndex != mLayeredImageProject->currentLayerIndex())
+        invalidateLayerComposites();
     return mLayeredImageProject->layerAt(layerIndex)->image();
 }
 
@@ -161,28 +195,78 @@ int LayeredImageCanvas::currentLayerIndex() const
 
 QImage LayeredImageCanvas::getContentImage()
 {
-    return mLayeredImageProject->flattenedImage([=](int index) {
-        QImage layerImage;
-        if (index == mLayeredImageProject->currentLayerIndex()) {
-            if (shouldDrawSelectionPreviewImage()) {
-                layerImage = mSelectionPreviewImage;
-            } else if (isLineVisible()) {
-                layerImage = *mLayeredImageProject->currentLayer()->image();
-                QPainter linePainter(&layerImage);
-                // Draw the line on top of what has already been painted using a special composition mode.
-                // This ensures that e.g. a translucent red overwrites whatever pixels it
-                // lies on, rather than blending with them.
-                drawLine(&linePainter, linePoint1(), linePoint2(), QPainter::CompositionMode_Source);
-            }
-        }
-        return layerImage;
-    });
+    const ImageLayer *currentLayer = mLayeredImageProject->currentLayer();
+    if (!currentLayer)
+        return QImage();
+
+    // The project keeps the flattened image up to date block by block, which is as cheap as it gets.
+    // Previews (the pixel-pen-line indicator and selection modifications) are drawn separately;
+    // see contentOverlays().
+    return mLayeredImageProject->exportedImage();
+}
+
+QImage LayeredImageCanvas::getContentAreaImage(const QRect &sceneArea, const std::function<void(QPainter*)> &modifyCurrentLayer)
+{
+    const ImageLayer *currentLayer = mLayeredImageProject->currentLayer();
+    if (!currentLayer)
+        return QImage();
+
+    updateLayerComposites();
+
+    QImage image(sceneArea.size(), QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::transparent);
+
+    QPainter painter(&image);
+    painter.drawImage(QPoint(0, 0), mLayersBelowImage, sceneArea);
+    if (currentLayer->isVisible() && !qFuzzyIsNull(currentLayer->opacity()))
+        painter.drawImage(QPoint(0, 0), ImageCanvas::getContentAreaImage(sceneArea, modifyCurrentLayer));
+    painter.drawImage(QPoint(0, 0), mLayersAboveImage, sceneArea);
+    return image;
+}
+
+void LayeredImageCanvas::updateLayerComposites()
+{
+    if (mLayerCompositesValid && mLayersBelowImage.size() == mLayeredImageProject->size())
+        return;
+
+    // Layers are stored from the top down.
+    const int currentIndex = mLayeredImageProject->currentLayerIndex();
+    mLayersBelowImage = compositeLayers(currentIndex + 1, mLayeredImageProject->layerCount() - 1);
+    mLayersAboveImage = compositeLayers(0, currentIndex - 1);
+    mLayerCompositesValid = true;
+}
+
+QImage LayeredImageCanvas::compositeLayers(int fromIndex, int toIndex) const
+{
+    QImage image(mLayeredImageProject->size(), QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::transparent);
+
+    QPainter painter(&image);
+    // Work backwards from the last layer so that it gets drawn at the "bottom",
+    // as LayeredImageProject::flattenedImage() does.
+    for (int i = toIndex; i >= fromIndex; --i) {
+        const ImageLayer *layer = mLayeredImageProject->layerAt(i);
+        if (!layer->isVisible() || qFuzzyIsNull(layer->opacity()))
+            continue;
+
+        painter.drawImage(0, 0, *layer->image());
+    }
+    return image;
 }
 
 void LayeredImageCanvas::replaceImage(int layerIndex, const QImage &replacementImage)
 {
+    if (layerIndex != mLayeredImageProject->currentLayerIndex())
+        invalidateLayerComposites();
     *mLayeredImageProject->layerAt(layerIndex)->image() = replacementImage;
     requestContentPaint();
+    emit contentChanged(QRect());
+}
+
+void LayeredImageCanvas::layerImageAreaChanged(int layerIndex, const QRect &sceneArea, qint64 cacheKeyBeforeChange)
+{
+    mLayeredImageProject->markLayerImageAreaChanged(layerIndex, sceneArea, cacheKeyBeforeChange);
+    ImageCanvas::layerImageAreaChanged(layerIndex, sceneArea, cacheKeyBeforeChange);
 }
 
 bool LayeredImageCanvas::areToolsForbidden() const
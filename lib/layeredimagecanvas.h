@@ -44,10 +44,12 @@ protected slots:
     void onPostLayerRemoved();
     void onPostLayerMoved();
     void onPostLayerImageChanged();
+    void onContentsMoved();
     void onLayerVisibleChanged();
     void onLayerOpacityChanged();
     void onPreCurrentLayerChanged();
     void onPostCurrentLayerChanged();
+    void invalidateLayerComposites();
 
 protected:
     void connectSignals() override;
@@ -57,13 +59,24 @@ protected:
     QImage *imageForLayerAt(int layerIndex) override;
     int currentLayerIndex() const override;
     QImage getContentImage() override;
+    QImage getContentAreaImage(const QRect &sceneArea, const std::function<void(QPainter*)> &modifyCurrentLayer) override;
 
     void replaceImage(int layerIndex, const QImage &replacementImage) override;
+    void layerImageAreaChanged(int layerIndex, const QRect &sceneArea, qint64 cacheKeyBeforeChange) override;
 
     bool areToolsForbidden() const override;
 
 private:
+    void updateLayerComposites();
+    QImage compositeLayers(int fromIndex, int toIndex) const;
+
     LayeredImageProject *mLayeredImageProject;
+    // Composites of the layers below and above the current layer. Only the current
+    // layer usually changes while drawing, so caching these means that painting
+    // only has to blend three images, regardless of how many layers there are.
+    QImage mLayersBelowImage;
+    QImage mLayersAboveImage;
+    bool mLayerCompositesValid;
 };
 
 #endif // LAYEREDIMAGECANVAS_H
@@ -112,17 +112,8 @@ void LayeredImageProject::setSize(const QSize &newSize)
     if (newSize == size())
         return;
 
-    QVector<QImage> previousImages;
-    QVector<QImage> newImages;
-    foreach (ImageLayer *layer, mLayers) {
-        previousImages.append(*layer->image());
-
-        const QImage resized = layer->image()->copy(0, 0, newSize.width(), newSize.height());
-        newImages.append(resized);
-    }
-
     beginMacro(QLatin1String("ChangeLayeredImageCanvasSize"));
-    addChange(new ChangeLayeredImageCanvasSizeCommand(this, previousImages, newImages));
+    addChange(new ChangeLayeredImageCanvasSizeCommand(this, size(), newSize));
     endMacro();
 }
 
@@ -314,7 +305,21 @@ QHash<QString, QImage> LayeredImageProject::flattenedImages() const
 
 QImage LayeredImageProject::exportedImage() const
 {
-    return flattenedImage();
+    // This gives the same result as flattenedImage().
+    QVector<const QImage*> images;
+    images.reserve(mLayers.size());
+    for (int i = mLayers.size() - 1; i >= 0; --i) {
+        const ImageLayer *layer = mLayers.at(i);
+        if (layer->isVisible() && !qFuzzyIsNull(layer->opacity()))
+            images.append(layer->image());
+    }
+    return mCompositor.composite(images, size());
+}
+
+void LayeredImageProject::markLayerImageAreaChanged(int layerIndex, const QRect &area, qint64 cacheKeyBeforeChange)
+{
+    Q_ASSERT(isValidIndex(layerIndex));
+    mCompositor.markDirty(mLayers.at(layerIndex)->image(), area, cacheKeyBeforeChange);
 }
 
 bool LayeredImageProject::isAutoExportEnabled() const
@@ -490,6 +495,7 @@ void LayeredImageProject::doClose()
 
     setUrl(QUrl());
     mUndoStack.clear();
+    clearUndoCheckpoints();
     mLayersCreated = 0;
     mAutoExportEnabled = false;
     mUsingAnimation = false;
@@ -651,30 +657,8 @@ void LayeredImageProject::moveContents(int x, int y, bool onlyVisibleContents)
     if (x == 0 && y == 0)
         return;
 
-    QVector<QImage> previousImages;
-    QVector<QImage> newImages;
-    foreach (ImageLayer *layer, mLayers) {
-        const QImage oldImage = *layer->image();
-        previousImages.append(oldImage);
-
-        if (onlyVisibleContents && !layer->isVisible()) {
-            // This is lazy and inefficient (we could e.g. store a null QImage),
-            // but it avoids adding more code paths elsewhere.
-            newImages.append(oldImage);
-        } else {
-            QImage translated(size(), QImage::Format_ARGB32_Premultiplied);
-            translated.fill(Qt::transparent);
-
-            QPainter painter(&translated);
-            painter.drawImage(x, y, oldImage);
-            painter.end();
-
-            newImages.append(translated);
-        }
-    }
-
     beginMacro(QLatin1String("MoveLayeredImageContents"));
-    addChange(new MoveLayeredImageContentsCommand(this, previousImages, newImages));
+    addChange(new MoveLayeredImageContentsCommand(this, x, y, onlyVisibleContents));
     endMacro();
 }
 
@@ -780,11 +764,37 @@ bool LayeredImageProject::isValidIndex(int index) const
     return index >= 0 && index < mLayers.size();
 }
 
+QVector<QImage> LayeredImageProject::layerImages() const
+{
+    QVector<QImage> images;
+    images.reserve(mLayers.size());
+    for (const ImageLayer *layer : mLayers)
+        images.append(*layer->image());
+    return images;
+}
+
 Project::Type LayeredImageProject::type() const
 {
     return LayeredImageType;
 }
 
+QVector<QImage*> LayeredImageProject::undoCheckpointImages()
+{
+    QVector<QImage*> images;
+    images.reserve(mLayers.size());
+    for (ImageLayer *layer : qAsConst(mLayers))
+        images.append(layer->image());
+    return images;
+}
+
+void LayeredImageProject::undoCheckpointRestored(const QSize &previousSize)
+{
+    if (size() != previousSize)
+        emit sizeChanged();
+
+    emit postLayerImageChanged();
+}
+
 void LayeredImageProject::doSetCanvasSize(const QVector<QImage> &newImages)
 {
     doSetImageSize(newImages);
@@ -24,6 +24,7 @@
 #include <QImage>
 
 #include "animationplayback.h"
+#include "layercompositor.h"
 #include "project.h"
 #include "slate-global.h"
 
@@ -62,7 +63,12 @@ public:
     QImage flattenedImage(std::function<QImage(int)> layerSubstituteFunction = nullptr) const;
     QImage flattenedImage(int fromIndex, int toIndex, std::function<QImage(int)> layerSubstituteFunction = nullptr) const;
     QHash<QString, QImage> flattenedImages() const;
+    // Returns the flattened image, which is kept up to date incrementally;
+    // see markLayerImageAreaChanged().
     QImage exportedImage() const override;
+    // Lets the project know that area of the given layer's image has changed,
+    // so that only that area of the flattened image needs to be recomposited.
+    void markLayerImageAreaChanged(int layerIndex, const QRect &area, qint64 cacheKeyBeforeChange);
 
     bool isAutoExportEnabled() const;
     void setAutoExportEnabled(bool autoExportEnabled);
@@ -120,6 +126,9 @@ protected:
     void doClose() override;
     void doSaveAs(const QUrl &url) override;
 
+    QVector<QImage*> undoCheckpointImages() override;
+    void undoCheckpointRestored(const QSize &previousSize) override;
+
 private:
     friend class AddLayerCommand;
     friend class ChangeLayeredImageCanvasSizeCommand;
@@ -135,6 +144,9 @@ private:
 
     bool isValidIndex(int index) const;
 
+    // The image of each layer, from the bottom up.
+    QVector<QImage> layerImages() const;
+
     void doSetCanvasSize(const QVector<QImage> &newImages);
     void doSetImageSize(const QVector<QImage> &newImages);
 
@@ -162,6 +174,8 @@ private:
     bool mHasUsedAnimation;
     AnimationPlayback mAnimationPlayback;
     qreal mLayerListViewContentY;
+    // Updated on demand by exportedImage(), which is const.
+    mutable LayerCompositor mCompositor;
 };
 
 #endif // LAYEREDIMAGEPROJECT_H
@@ -29,7 +29,7 @@ Q_LOGGING_CATEGORY(lcMergeLayersCommand, "app.undo.mergeLayersCommand")
 MergeLayersCommand::MergeLayersCommand(LayeredImageProject *project,
         int sourceIndex, ImageLayer *sourceLayer, int targetIndex, ImageLayer *targetLayer,
     QUndoCommand *parent) :
-    QUndoCommand(parent),
+    UndoCommand(parent),
     mProject(project),
     mSourceIndex(sourceIndex),
     mSourceLayer(sourceLayer),
@@ -43,15 +43,21 @@ MergeLayersCommand::MergeLayersCommand(LayeredImageProject *project,
 void MergeLayersCommand::undo()
 {
     qCDebug(lcMergeLayersCommand) << "undoing" << this;
+    if (isDiscarded())
+        return;
+
     // Restore the source layer..
     mProject->addLayer(mSourceLayerGuard.take(), mSourceIndex);
     // .. and then restore the target layer.
-    mProject->setLayerImage(mTargetIndex, mPreviousTargetLayerImage);
+    mProject->setLayerImage(mTargetIndex, mPreviousTargetLayerImage.image());
 }
 
 void MergeLayersCommand::redo()
 {
     qCDebug(lcMergeLayersCommand) << "redoing" << this;
+    if (isDiscarded())
+        return;
+
     mProject->mergeLayers(mSourceIndex, mTargetIndex);
     // The source layer loses its QObject parent, so manage it to prevent leaks.
     mSourceLayerGuard.reset(mSourceLayer);
@@ -62,6 +68,11 @@ int MergeLayersCommand::id() const
     return -1;
 }
 
+QVector<UndoImage*> MergeLayersCommand::imagePayloads()
+{
+    return { &mPreviousTargetLayerImage };
+}
+
 QDebug operator<<(QDebug debug, const MergeLayersCommand *command)
 {
     debug.nospace() << "(MergeLayersCommand sourceIndex=" << command->mSourceIndex
@@ -23,14 +23,15 @@
 #include <QDebug>
 #include <QImage>
 #include <QScopedPointer>
-#include <QUndoCommand>
 
 #include "slate-global.h"
+#include "undocommand.h"
+#include "undoimage.h"
 
 class ImageLayer;
 class LayeredImageProject;
 
-class SLATE_EXPORT MergeLayersCommand : public QUndoCommand
+class SLATE_EXPORT MergeLayersCommand : public UndoCommand
 {
 public:
     MergeLayersCommand(LayeredImageProject *project,
@@ -42,6 +43,9 @@ public:
 
     int id() const override;
 
+protected:
+    QVector<UndoImage*> imagePayloads() override;
+
 private:
     friend QDebug operator<<(QDebug debug, const MergeLayersCommand *command);
 
@@ -51,7 +55,7 @@ private:
     QScopedPointer<ImageLayer> mSourceLayerGuard;
     int mTargetIndex;
     ImageLayer *mTargetLayer;
-    QImage mPreviousTargetLayerImage;
+    UndoImage mPreviousTargetLayerImage;
 };
 
 #endif // MERGELAYERSCOMMAND_H
@@ -39,7 +39,7 @@ ModifyImageCanvasSelectionCommand::ModifyImageCanvasSelectionCommand(ImageCanvas
         const QRect &targetArea, const QImage &targetAreaImageBeforeModification,
         const QImage &targetAreaImageAfterModification,
         bool fromPaste, const QImage &pasteContents, QUndoCommand *parent) :
-    QUndoCommand(parent),
+    UndoCommand(parent),
     mCanvas(canvas),
     mLayerIndex(layerIndex),
     mModification(modification),
@@ -57,19 +57,22 @@ ModifyImageCanvasSelectionCommand::ModifyImageCanvasSelectionCommand(ImageCanvas
 
 void ModifyImageCanvasSelectionCommand::undo()
 {
+    if (isDiscarded())
+        return;
+
     if (mFromPaste) {
         qCDebug(lcModifyImageCanvasSelectionCommand) << "undoing" << this << "- painting original/source/previous area"
             << mSourceArea << "of canvas with paste contents" << mPasteContents << "...";
-        mCanvas->paintImageOntoPortionOfImage(mLayerIndex, mSourceArea, mPasteContents);
+        mCanvas->paintImageOntoPortionOfImage(mLayerIndex, mSourceArea, mPasteContents.image());
     } else {
         qCDebug(lcModifyImageCanvasSelectionCommand) << "undoing" << this << "- painting original/source/previous area"
             << mSourceArea << "of canvas with" << mSouceAreaImage << "...";
-        mCanvas->paintImageOntoPortionOfImage(mLayerIndex, mSourceArea, mSouceAreaImage);
+        mCanvas->paintImageOntoPortionOfImage(mLayerIndex, mSourceArea, mSouceAreaImage.image());
     }
 
     qCDebug(lcModifyImageCanvasSelectionCommand) << "... and replacing new/destination/undone area"
         << mTargetArea << "of canvas with" << mTargetAreaImageBeforeModification << "...";
-    mCanvas->replacePortionOfImage(mLayerIndex, mTargetArea, mTargetAreaImageBeforeModification);
+    mCanvas->replacePortionOfImage(mLayerIndex, mTargetArea, mTargetAreaImageBeforeModification.image());
     // This matches what mspaint does; undoing a selection move causes the selection to be cleared.
     mCanvas->clearSelection();
 }
@@ -77,17 +80,20 @@ void ModifyImageCanvasSelectionCommand::undo()
 void ModifyImageCanvasSelectionCommand::redo()
 {
     qCDebug(lcModifyImageCanvasSelectionCommand) << "redoing" << this;
+    if (isDiscarded())
+        return;
+
     if (!mFromPaste)
         mCanvas->erasePortionOfImage(mLayerIndex, mSourceArea);
     else if (mUsed) {
         // It is a paste and it has been redone already (moving contents that haven't been applied
         // to the canvas), so redoing it now means that we should apply the paste contents,
         // and not the previous area image portion.
-        mCanvas->paintImageOntoPortionOfImage(mLayerIndex, mSourceArea, mSouceAreaImage);
+        mCanvas->paintImageOntoPortionOfImage(mLayerIndex, mSourceArea, mSouceAreaImage.image());
     }
 
     mCanvas->paintImageOntoPortionOfImage(mLayerIndex, mTargetArea,
-        mFromPaste ? mPasteContents : mTargetAreaImageAfterModification);
+        mFromPaste ? mPasteContents.image() : mTargetAreaImageAfterModification.image());
 
     mUsed = true;
 }
@@ -97,6 +103,12 @@ int ModifyImageCanvasSelectionCommand::id() const
     return -1;
 }
 
+QVector<UndoImage*> ModifyImageCanvasSelectionCommand::imagePayloads()
+{
+    return { &mSouceAreaImage, &mTargetAreaImageBeforeModification,
+        &mTargetAreaImageAfterModification, &mPasteContents };
+}
+
 QDebug operator<<(QDebug debug, const ModifyImageCanvasSelectionCommand *command)
 {
     debug.nospace() << "(modifyImageCanvasSelectionCommand"
@@ -23,12 +23,13 @@
 #include <QDebug>
 #include <QImage>
 #include <QRect>
-#include <QUndoCommand>
 
 #include "imagecanvas.h"
 #include "slate-global.h"
+#include "undocommand.h"
+#include "undoimage.h"
 
-class SLATE_EXPORT ModifyImageCanvasSelectionCommand : public QUndoCommand
+class SLATE_EXPORT ModifyImageCanvasSelectionCommand : public UndoCommand
 {
 public:
     ModifyImageCanvasSelectionCommand(ImageCanvas *canvas, int layerIndex,
@@ -43,6 +44,9 @@ public:
 
     int id() const override;
 
+protected:
+    QVector<UndoImage*> imagePayloads() override;
+
 private:
     friend QDebug operator<<(QDebug debug, const ModifyImageCanvasSelectionCommand *command);
 
@@ -53,14 +57,14 @@ private:
     // The area that the selection started off at.
     QRect mSourceArea;
     // The portion of the image under the selection before the selection was moved.
-    QImage mSouceAreaImage;
+    UndoImage mSouceAreaImage;
     // The area that the selection finished at, due to moving, rotating, etc.
     QRect mTargetArea;
     // The portion of the image under the destination area, after the selection was moved.
-    QImage mTargetAreaImageBeforeModification;
-    QImage mTargetAreaImageAfterModification;
+    UndoImage mTargetAreaImageBeforeModification;
+    UndoImage mTargetAreaImageAfterModification;
     bool mFromPaste;
-    QImage mPasteContents;
+    UndoImage mPasteContents;
     bool mUsed;
 };
 
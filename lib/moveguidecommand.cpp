@@ -26,7 +26,7 @@
 Q_LOGGING_CATEGORY(lcMoveGuideCommand, "app.undo.moveGuideCommand")
 
 MoveGuideCommand::MoveGuideCommand(Project *project, const Guide &guide, int newPosition, QUndoCommand *parent) :
-    QUndoCommand(parent),
+    UndoCommand(parent),
     mProject(project),
     mGuide(guide),
     mPreviousPosition(guide.position()),
@@ -20,31 +20,80 @@
 #include "movelayeredimagecontentscommand.h"
 
 #include <QLoggingCategory>
+#include <QPainter>
+#include <QRegion>
 
+#include "imagelayer.h"
 #include "layeredimageproject.h"
+#include "utils.h"
 
 Q_LOGGING_CATEGORY(lcMoveLayeredImageContentsCommand, "app.undo.moveLayeredImageContentsCommand")
 
+static QImage translatedImage(const QImage &image, const QPoint &offset)
+{
+    QImage translated(image.size(), QImage::Format_ARGB32_Premultiplied);
+    translated.fill(Qt::transparent);
+
+    QPainter painter(&translated);
+    painter.drawImage(offset, image);
+    painter.end();
+    return translated;
+}
+
 MoveLayeredImageContentsCommand::MoveLayeredImageContentsCommand(LayeredImageProject *project,
-    const QVector<QImage> &previousImages, const QVector<QImage> &newImages, QUndoCommand *parent) :
-    QUndoCommand(parent),
+    int xDistance, int yDistance, bool onlyVisibleContents, QUndoCommand *parent) :
+    UndoCommand(parent),
     mProject(project),
-    mPreviousImages(previousImages),
-    mNewImages(newImages)
+    mOffset(xDistance, yDistance),
+    mOnlyVisibleContents(onlyVisibleContents)
 {
+    const QRect bounds(QPoint(0, 0), project->size());
+    const QRegion croppedRegion = QRegion(bounds).subtracted(QRegion(bounds.translated(-mOffset)));
+    for (const QRect &rect : croppedRegion)
+        mCroppedRects.append(rect);
+
+    for (int i = 0; i < project->layerCount(); ++i) {
+        const ImageLayer *layer = project->layerAt(i);
+        if (onlyVisibleContents && !layer->isVisible())
+            continue;
+
+        mLayerIndices.append(i);
+        for (const QRect &rect : qAsConst(mCroppedRects))
+            mCroppedImages.append(layer->image()->copy(rect));
+    }
+
     qCDebug(lcMoveLayeredImageContentsCommand) << "constructed" << this;
 }
 
 void MoveLayeredImageContentsCommand::undo()
 {
     qCDebug(lcMoveLayeredImageContentsCommand) << "undoing" << this;
-    mProject->doMoveContents(mPreviousImages);
+    if (isDiscarded() || isSkipped())
+        return;
+
+    QVector<QImage> images = mProject->layerImages();
+    for (int i = 0; i < mLayerIndices.size(); ++i) {
+        const int layerIndex = mLayerIndices.at(i);
+        QImage image = translatedImage(images.at(layerIndex), -mOffset);
+        for (int rectIndex = 0; rectIndex < mCroppedRects.size(); ++rectIndex) {
+            const UndoImage &croppedImage = mCroppedImages.at(i * mCroppedRects.size() + rectIndex);
+            Utils::replacePortionOfImage(&image, mCroppedRects.at(rectIndex), croppedImage.image());
+        }
+        images[layerIndex] = image;
+    }
+    mProject->doMoveContents(images);
 }
 
 void MoveLayeredImageContentsCommand::redo()
 {
     qCDebug(lcMoveLayeredImageContentsCommand) << "redoing" << this;
-    mProject->doMoveContents(mNewImages);
+    if (isDiscarded() || isSkipped())
+        return;
+
+    QVector<QImage> images = mProject->layerImages();
+    for (const int layerIndex : qAsConst(mLayerIndices))
+        images[layerIndex] = translatedImage(images.at(layerIndex), mOffset);
+    mProject->doMoveContents(images);
 }
 
 int MoveLayeredImageContentsCommand::id() const
@@ -52,8 +101,26 @@ int MoveLayeredImageContentsCommand::id() const
     return -1;
 }
 
-QDebug operator<<(QDebug debug, const MoveLayeredImageContentsCommand *)
+bool MoveLayeredImageContentsCommand::changesOnlyImages() const
+{
+    return true;
+}
+
+QVector<UndoImage*> MoveLayeredImageContentsCommand::imagePayloads()
+{
+    QVector<UndoImage*> images;
+    for (UndoImage &image : mCroppedImages)
+        images.append(&image);
+    return images;
+}
+
+QDebug operator<<(QDebug debug, const MoveLayeredImageContentsCommand *command)
 {
-    debug.nospace() << "(MoveLayeredImageContentsCommand)";
+    debug.nospace() << "(MoveLayeredImageContentsCommand"
+        << " offset=" << command->mOffset
+        << " onlyVisibleContents=" << command->mOnlyVisibleContents
+        << " layerIndices=" << command->mLayerIndices
+        << " croppedRects=" << command->mCroppedRects
+        << ")";
     return debug.space();
 }
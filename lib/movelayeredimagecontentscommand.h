@@ -21,31 +21,45 @@
 #define MOVELAYEREDIMAGECONTENTSCOMMAND_H
 
 #include <QDebug>
-#include <QImage>
-#include <QUndoCommand>
+#include <QPoint>
+#include <QRect>
 #include <QVector>
 
 #include "slate-global.h"
+#include "undocommand.h"
+#include "undoimage.h"
 
 class LayeredImageProject;
 
-class SLATE_EXPORT MoveLayeredImageContentsCommand : public QUndoCommand
+// Rather than storing every layer before and after the move, only the offset
+// and the pixels that are moved off the canvas (and would otherwise be lost) are stored.
+class SLATE_EXPORT MoveLayeredImageContentsCommand : public UndoCommand
 {
 public:
-    MoveLayeredImageContentsCommand(LayeredImageProject *project, const QVector<QImage> &previousImages,
-        const QVector<QImage> &newImages, QUndoCommand *parent = nullptr);
+    MoveLayeredImageContentsCommand(LayeredImageProject *project, int xDistance, int yDistance,
+        bool onlyVisibleContents, QUndoCommand *parent = nullptr);
 
     void undo() override;
     void redo() override;
 
     int id() const override;
+    bool changesOnlyImages() const override;
+
+protected:
+    QVector<UndoImage*> imagePayloads() override;
 
 private:
     friend QDebug operator<<(QDebug debug, const MoveLayeredImageContentsCommand *command);
 
     LayeredImageProject *mProject;
-    QVector<QImage> mPreviousImages;
-    QVector<QImage> mNewImages;
+    QPoint mOffset;
+    bool mOnlyVisibleContents;
+    // The indices of the layers that are moved.
+    QVector<int> mLayerIndices;
+    // The areas of the canvas (before the move) whose pixels end up outside of it.
+    QVector<QRect> mCroppedRects;
+    // The pixels in each of mCroppedRects, for each moved layer.
+    QVector<UndoImage> mCroppedImages;
 };
 
 #endif // MOVELAYEREDIMAGECONTENTSCOMMAND_H
@@ -30,18 +30,16 @@ PaneDrawingHelper::PaneDrawingHelper(const ImageCanvas *canvas, QPainter *painte
 {
     mPainter->save();
 
-    QPoint translateDistance;
-    if (mPaneIndex == 1) {
-        translateDistance.rx() = mCanvas->width() * mCanvas->firstPane()->size();
-    }
-    translateDistance += mPane->integerOffset();
+    const QPoint translateDistance = paneTranslation(mCanvas, mPane, mPaneIndex);
     painter->translate(translateDistance);
 
+    // Intersect rather than replace the clip so that items
+    // that only repaint part of themselves stay within that part.
     const int paneWidth = mCanvas->width() * mPane->size();
     if (paneIndex == 0)
-        painter->setClipRect(-translateDistance.x(), -translateDistance.y(), paneWidth, mCanvas->height());
+        painter->setClipRect(-translateDistance.x(), -translateDistance.y(), paneWidth, mCanvas->height(), Qt::IntersectClip);
     else
-        painter->setClipRect(-pane->integerOffset().x(), -pane->integerOffset().y(), paneWidth, mCanvas->height());
+        painter->setClipRect(-pane->integerOffset().x(), -pane->integerOffset().y(), paneWidth, mCanvas->height(), Qt::IntersectClip);
 }
 
 PaneDrawingHelper::~PaneDrawingHelper()
@@ -68,3 +66,13 @@ int PaneDrawingHelper::paneIndex() const
 {
     return mPaneIndex;
 }
+
+QPoint PaneDrawingHelper::paneTranslation(const ImageCanvas *canvas, const CanvasPane *pane, int paneIndex)
+{
+    QPoint translateDistance;
+    if (paneIndex == 1) {
+        translateDistance.rx() = canvas->width() * canvas->firstPane()->size();
+    }
+    translateDistance += pane->integerOffset();
+    return translateDistance;
+}
@@ -39,6 +39,10 @@ public:
     const CanvasPane *pane() const;
     int paneIndex() const;
 
+    // The distance that the painter is translated by for the given pane,
+    // which maps zoomed scene coordinates to item coordinates.
+    static QPoint paneTranslation(const ImageCanvas *canvas, const CanvasPane *pane, int paneIndex);
+
 private:
     const ImageCanvas *mCanvas;
     QPainter *mPainter;
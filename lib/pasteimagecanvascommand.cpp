@@ -26,7 +26,7 @@ Q_LOGGING_CATEGORY(lcPasteImageCanvasCommand, "app.undo.pasteImageCanvasCommand"
 
 PasteImageCanvasCommand::PasteImageCanvasCommand(ImageCanvas *canvas, int layerIndex, const QImage &image,
     const QPoint &position, QUndoCommand *parent) :
-    QUndoCommand(parent),
+    UndoCommand(parent),
     mCanvas(canvas),
     mLayerIndex(layerIndex),
     mNewImage(image),
@@ -40,18 +40,24 @@ PasteImageCanvasCommand::PasteImageCanvasCommand(ImageCanvas *canvas, int layerI
 void PasteImageCanvasCommand::undo()
 {
     qCDebug(lcPasteImageCanvasCommand) << "undoing" << this;
-    mCanvas->replacePortionOfImage(mLayerIndex, mArea, mPreviousImage);
+    if (isDiscarded())
+        return;
+
+    mCanvas->replacePortionOfImage(mLayerIndex, mArea, mPreviousImage.image());
     mCanvas->clearSelection();
 }
 
 void PasteImageCanvasCommand::redo()
 {
+    if (isDiscarded())
+        return;
+
     if (mUsed) {
         qCDebug(lcPasteImageCanvasCommand) << "redoing" << this;
         // ImageCanvas handles everything for us for the initial paste,
         // as we need a selection area on that occasion. However,
         // for every other redo and undo, we can do the following.
-        mCanvas->paintImageOntoPortionOfImage(mLayerIndex, mArea, mNewImage);
+        mCanvas->paintImageOntoPortionOfImage(mLayerIndex, mArea, mNewImage.image());
         mCanvas->clearSelection();
     } else {
         // Although this special-casing might seem odd, the whole thing allows
@@ -68,6 +74,11 @@ int PasteImageCanvasCommand::id() const
     return -1;
 }
 
+QVector<UndoImage*> PasteImageCanvasCommand::imagePayloads()
+{
+    return { &mNewImage, &mPreviousImage };
+}
+
 QDebug operator<<(QDebug debug, const PasteImageCanvasCommand &command)
 {
     debug.nospace() << "(PasteImageCanvasCommand area=" << command.mArea
@@ -23,13 +23,14 @@
 #include <QDebug>
 #include <QImage>
 #include <QRect>
-#include <QUndoCommand>
 
 #include "slate-global.h"
+#include "undocommand.h"
+#include "undoimage.h"
 
 class ImageCanvas;
 
-class SLATE_EXPORT PasteImageCanvasCommand : public QUndoCommand
+class SLATE_EXPORT PasteImageCanvasCommand : public UndoCommand
 {
 public:
     PasteImageCanvasCommand(ImageCanvas *canvas, int layerIndex, const QImage &image, const QPoint &position,
@@ -40,13 +41,16 @@ public:
 
     int id() const override;
 
+protected:
+    QVector<UndoImage*> imagePayloads() override;
+
 private:
     friend QDebug operator<<(QDebug debug, const PasteImageCanvasCommand &command);
 
     ImageCanvas *mCanvas;
     int mLayerIndex;
-    QImage mNewImage;
-    QImage mPreviousImage;
+    UndoImage mNewImage;
+    UndoImage mPreviousImage;
     QRect mArea;
 
     bool mUsed;
@@ -0,0 +1,355 @@
+/*
+    Copyright 2018, Mitch Curtis
+
+    This file is part of Slate.
+
+    Slate is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Slate is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Slate. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "pixelkernels.h"
+
+#include <QLoggingCategory>
+#include <QtAlgorithms>
+
+// SSE2 is part of the baseline for x86-64, and is assumed to be available
+// on 32-bit x86 only if the compiler has been told that it may use it.
+#if defined(Q_PROCESSOR_X86_64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SLATE_X86_KERNELS
+#include <immintrin.h>
+#if defined(Q_CC_MSVC)
+#include <intrin.h>
+// MSVC allows AVX2 intrinsics to be used in any function.
+#define SLATE_TARGET_AVX2
+#else
+// Compile the AVX2 kernels for AVX2 without requiring -mavx2 for the whole library;
+// they're only ever called after checking that the CPU supports them.
+#define SLATE_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+Q_LOGGING_CATEGORY(lcPixelKernels, "app.pixelKernels")
+
+namespace {
+
+struct ReplaceResult
+{
+    ReplaceResult() : replaced(0), firstIndex(-1), lastIndex(-1) {}
+
+    void add(int index, quint32 matchMask)
+    {
+        replaced += qPopulationCount(matchMask);
+        if (firstIndex == -1)
+            firstIndex = index + qCountTrailingZeroBits(matchMask);
+        lastIndex = index + 31 - qCountLeadingZeroBits(matchMask);
+    }
+
+    int replaced;
+    int firstIndex;
+    int lastIndex;
+};
+
+// Whether pixel is within tolerance of target in every channel.
+// When Exact is true, tolerance is ignored and the pixels must be identical.
+template<bool Exact>
+inline bool pixelMatches(QRgb pixel, QRgb target, int tolerance)
+{
+    if (Exact)
+        return pixel == target;
+
+    return qAbs(qRed(pixel) - qRed(target)) <= tolerance
+        && qAbs(qGreen(pixel) - qGreen(target)) <= tolerance
+        && qAbs(qBlue(pixel) - qBlue(target)) <= tolerance
+        && qAbs(qAlpha(pixel) - qAlpha(target)) <= tolerance;
+}
+
+template<bool Exact>
+int findPixelScalar(const QRgb *pixels, int count, QRgb target, int tolerance, bool matching)
+{
+    for (int i = 0; i < count; ++i) {
+        if (pixelMatches<Exact>(pixels[i], target, tolerance) == matching)
+            return i;
+    }
+    return count;
+}
+
+// Replaces pixels from the index from onwards; used for the tails of the vectorized kernels.
+template<bool Exact>
+void replacePixelsFrom(QRgb *pixels, int from, int count, QRgb target, int tolerance, QRgb replacement,
+    ReplaceResult &result)
+{
+    for (int i = from; i < count; ++i) {
+        if (pixelMatches<Exact>(pixels[i], target, tolerance)) {
+            pixels[i] = replacement;
+            result.add(i, 1);
+        }
+    }
+}
+
+template<bool Exact>
+int replacePixelsScalar(QRgb *pixels, int count, QRgb target, int tolerance, QRgb replacement, ReplaceResult &result)
+{
+    replacePixelsFrom<Exact>(pixels, 0, count, target, tolerance, replacement, result);
+    return result.replaced;
+}
+
+#ifdef SLATE_X86_KERNELS
+// Returns all ones in each 32-bit lane of block that matches targetVector.
+// The tolerance test takes the absolute difference of each channel with two saturating subtractions,
+// and then checks that no channel's difference is left over after subtracting the tolerance.
+template<bool Exact>
+inline __m128i matchesSse2(__m128i block, __m128i targetVector, __m128i toleranceVector)
+{
+    if (Exact)
+        return _mm_cmpeq_epi32(block, targetVector);
+
+    const __m128i difference = _mm_or_si128(_mm_subs_epu8(block, targetVector), _mm_subs_epu8(targetVector, block));
+    return _mm_cmpeq_epi32(_mm_subs_epu8(difference, toleranceVector), _mm_setzero_si128());
+}
+
+template<bool Exact>
+int findPixelSse2(const QRgb *pixels, int count, QRgb target, int tolerance, bool matching)
+{
+    const __m128i targetVector = _mm_set1_epi32(int(target));
+    const __m128i toleranceVector = _mm_set1_epi8(char(tolerance));
+    const int flipMask = matching ? 0 : 0xf;
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + i));
+        const __m128i matches = matchesSse2<Exact>(block, targetVector, toleranceVector);
+        const int matchMask = _mm_movemask_ps(_mm_castsi128_ps(matches)) ^ flipMask;
+        if (matchMask)
+            return i + qCountTrailingZeroBits(quint32(matchMask));
+    }
+    return i + findPixelScalar<Exact>(pixels + i, count - i, target, tolerance, matching);
+}
+
+template<bool Exact>
+int replacePixelsSse2(QRgb *pixels, int count, QRgb target, int tolerance, QRgb replacement, ReplaceResult &result)
+{
+    const __m128i targetVector = _mm_set1_epi32(int(target));
+    const __m128i toleranceVector = _mm_set1_epi8(char(tolerance));
+    const __m128i replacementVector = _mm_set1_epi32(int(replacement));
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i *blockPointer = reinterpret_cast<__m128i*>(pixels + i);
+        const __m128i block = _mm_loadu_si128(blockPointer);
+        const __m128i matches = matchesSse2<Exact>(block, targetVector, toleranceVector);
+        const int matchMask = _mm_movemask_ps(_mm_castsi128_ps(matches));
+        if (!matchMask)
+            continue;
+
+        // SSE2 has no blend instruction, so select between the two with and/andnot/or.
+        const __m128i blended = _mm_or_si128(_mm_and_si128(matches, replacementVector),
+            _mm_andnot_si128(matches, block));
+        _mm_storeu_si128(blockPointer, blended);
+        result.add(i, quint32(matchMask));
+    }
+    replacePixelsFrom<Exact>(pixels, i, count, target, tolerance, replacement, result);
+    return result.replaced;
+}
+
+template<bool Exact>
+SLATE_TARGET_AVX2 inline __m256i matchesAvx2(__m256i block, __m256i targetVector, __m256i toleranceVector)
+{
+    if (Exact)
+        return _mm256_cmpeq_epi32(block, targetVector);
+
+    const __m256i difference = _mm256_or_si256(_mm256_subs_epu8(block, targetVector),
+        _mm256_subs_epu8(targetVector, block));
+    return _mm256_cmpeq_epi32(_mm256_subs_epu8(difference, toleranceVector), _mm256_setzero_si256());
+}
+
+template<bool Exact>
+SLATE_TARGET_AVX2 int findPixelAvx2(const QRgb *pixels, int count, QRgb target, int tolerance, bool matching)
+{
+    const __m256i targetVector = _mm256_set1_epi32(int(target));
+    const __m256i toleranceVector = _mm256_set1_epi8(char(tolerance));
+    const int flipMask = matching ? 0 : 0xff;
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pixels + i));
+        const __m256i matches = matchesAvx2<Exact>(block, targetVector, toleranceVector);
+        const int matchMask = _mm256_movemask_ps(_mm256_castsi256_ps(matches)) ^ flipMask;
+        if (matchMask)
+            return i + qCountTrailingZeroBits(quint32(matchMask));
+    }
+    return i + findPixelScalar<Exact>(pixels + i, count - i, target, tolerance, matching);
+}
+
+template<bool Exact>
+SLATE_TARGET_AVX2 int replacePixelsAvx2(QRgb *pixels, int count, QRgb target, int tolerance, QRgb replacement,
+    ReplaceResult &result)
+{
+    const __m256i targetVector = _mm256_set1_epi32(int(target));
+    const __m256i toleranceVector = _mm256_set1_epi8(char(tolerance));
+    const __m256i replacementVector = _mm256_set1_epi32(int(replacement));
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i *blockPointer = reinterpret_cast<__m256i*>(pixels + i);
+        const __m256i block = _mm256_loadu_si256(blockPointer);
+        const __m256i matches = matchesAvx2<Exact>(block, targetVector, toleranceVector);
+        const int matchMask = _mm256_movemask_ps(_mm256_castsi256_ps(matches));
+        if (!matchMask)
+            continue;
+
+        _mm256_storeu_si256(blockPointer, _mm256_blendv_epi8(block, replacementVector, matches));
+        result.add(i, quint32(matchMask));
+    }
+    replacePixelsFrom<Exact>(pixels, i, count, target, tolerance, replacement, result);
+    return result.replaced;
+}
+
+bool cpuSupportsAvx2()
+{
+#if defined(Q_CC_MSVC)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+
+    // The OS also has to save the AVX registers on context switches.
+    __cpuid(info, 1);
+    const bool hasOsxsave = info[2] & (1 << 27);
+    const bool hasAvx = info[2] & (1 << 28);
+    if (!hasOsxsave || !hasAvx || (_xgetbv(0) & 0x6) != 0x6)
+        return false;
+
+    __cpuidex(info, 7, 0);
+    return info[1] & (1 << 5);
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+typedef int (*FindPixelFunction)(const QRgb *pixels, int count, QRgb target, int tolerance, bool matching);
+typedef int (*ReplacePixelsFunction)(QRgb *pixels, int count, QRgb target, int tolerance, QRgb replacement,
+    ReplaceResult &result);
+
+// Each kernel has an exact variant and a tolerance variant, since
+// a single comparison is noticeably cheaper than the distance test.
+struct Kernels
+{
+    PixelKernels::InstructionSet instructionSet;
+    FindPixelFunction findPixel[2];
+    ReplacePixelsFunction replacePixels[2];
+};
+
+bool isSupported(PixelKernels::InstructionSet instructionSet)
+{
+    switch (instructionSet) {
+    case PixelKernels::ScalarInstructionSet:
+        return true;
+#ifdef SLATE_X86_KERNELS
+    case PixelKernels::Sse2InstructionSet:
+        return true;
+    case PixelKernels::Avx2InstructionSet:
+        return cpuSupportsAvx2();
+#else
+    case PixelKernels::Sse2InstructionSet:
+    case PixelKernels::Avx2InstructionSet:
+        return false;
+#endif
+    }
+    return false;
+}
+
+// Assumes that instructionSet is supported.
+Kernels kernelsFor(PixelKernels::InstructionSet instructionSet)
+{
+    Kernels kernels;
+    kernels.instructionSet = instructionSet;
+    switch (instructionSet) {
+#ifdef SLATE_X86_KERNELS
+    case PixelKernels::Avx2InstructionSet:
+        kernels.findPixel[0] = findPixelAvx2<true>;
+        kernels.findPixel[1] = findPixelAvx2<false>;
+        kernels.replacePixels[0] = replacePixelsAvx2<true>;
+        kernels.replacePixels[1] = replacePixelsAvx2<false>;
+        break;
+    case PixelKernels::Sse2InstructionSet:
+        kernels.findPixel[0] = findPixelSse2<true>;
+        kernels.findPixel[1] = findPixelSse2<false>;
+        kernels.replacePixels[0] = replacePixelsSse2<true>;
+        kernels.replacePixels[1] = replacePixelsSse2<false>;
+        break;
+#endif
+    default:
+        kernels.instructionSet = PixelKernels::ScalarInstructionSet;
+        kernels.findPixel[0] = findPixelScalar<true>;
+        kernels.findPixel[1] = findPixelScalar<false>;
+        kernels.replacePixels[0] = replacePixelsScalar<true>;
+        kernels.replacePixels[1] = replacePixelsScalar<false>;
+        break;
+    }
+    return kernels;
+}
+
+Kernels selectKernels()
+{
+    PixelKernels::InstructionSet best = PixelKernels::ScalarInstructionSet;
+    if (isSupported(PixelKernels::Avx2InstructionSet))
+        best = PixelKernels::Avx2InstructionSet;
+    else if (isSupported(PixelKernels::Sse2InstructionSet))
+        best = PixelKernels::Sse2InstructionSet;
+
+    qCDebug(lcPixelKernels) << "using instruction set" << best;
+    return kernelsFor(best);
+}
+
+Kernels &kernels()
+{
+    static Kernels selectedKernels = selectKernels();
+    return selectedKernels;
+}
+
+}
+
+PixelKernels::InstructionSet PixelKernels::instructionSet()
+{
+    return kernels().instructionSet;
+}
+
+bool PixelKernels::isInstructionSetSupported(InstructionSet instructionSet)
+{
+    return isSupported(instructionSet);
+}
+
+bool PixelKernels::setInstructionSet(InstructionSet instructionSet)
+{
+    if (!isSupported(instructionSet))
+        return false;
+
+    qCDebug(lcPixelKernels) << "switching to instruction set" << instructionSet;
+    kernels() = kernelsFor(instructionSet);
+    return true;
+}
+
+int PixelKernels::findPixel(const QRgb *pixels, int count, QRgb target, int tolerance, bool matching)
+{
+    return kernels().findPixel[tolerance > 0](pixels, count, target, tolerance, matching);
+}
+
+int PixelKernels::replacePixels(QRgb *pixels, int count, QRgb target, int tolerance, QRgb replacement,
+    int *firstIndex, int *lastIndex)
+{
+    ReplaceResult result;
+    kernels().replacePixels[tolerance > 0](pixels, count, target, tolerance, replacement, result);
+    if (result.replaced > 0) {
+        *firstIndex = result.firstIndex;
+        *lastIndex = result.lastIndex;
+    }
+    return result.replaced;
+}
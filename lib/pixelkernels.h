@@ -0,0 +1,58 @@
+/*
+    Copyright 2018, Mitch Curtis
+
+    This file is part of Slate.
+
+    Slate is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Slate is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Slate. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PIXELKERNELS_H
+#define PIXELKERNELS_H
+
+#include <QColor>
+
+// Low-level operations on runs of 32-bit pixels.
+// Each function uses the fastest implementation that the CPU supports,
+// which is determined once at runtime: AVX2, SSE2, or plain C++.
+namespace PixelKernels {
+    enum InstructionSet {
+        ScalarInstructionSet,
+        Sse2InstructionSet,
+        Avx2InstructionSet
+    };
+
+    InstructionSet instructionSet();
+    bool isInstructionSetSupported(InstructionSet instructionSet);
+
+    // Forces the given implementation to be used, e.g. so that tests can cover each of them.
+    // Returns false (and changes nothing) if the CPU doesn't support it.
+    // Must not be called while any of the other functions are in use.
+    bool setInstructionSet(InstructionSet instructionSet);
+
+    // A pixel matches target if none of its channels differ from target's by more than tolerance,
+    // which ranges from 0 (the pixels must be identical) to 255 (every pixel matches).
+    // Channels are compared as they're stored, so for premultiplied pixels the comparison is premultiplied too.
+
+    // Returns the index of the first of the count pixels that matches target
+    // (or, if matching is false, that doesn't), or count if there is none.
+    int findPixel(const QRgb *pixels, int count, QRgb target, int tolerance, bool matching);
+
+    // Replaces each of the count pixels that matches target with replacement,
+    // and returns how many were replaced. If any were, firstIndex and lastIndex
+    // are set to the indices of the first and last of them.
+    int replacePixels(QRgb *pixels, int count, QRgb target, int tolerance, QRgb replacement,
+        int *firstIndex, int *lastIndex);
+}
+
+#endif // PIXELKERNELS_H
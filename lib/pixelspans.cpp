@@ -0,0 +1,204 @@
+/*
+    Copyright 2018, Mitch Curtis
+
+    This file is part of Slate.
+
+    Slate is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Slate is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Slate. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "pixelspans.h"
+
+#include <algorithm>
+
+bool PixelSpans::isEmpty() const
+{
+    return mSpans.isEmpty();
+}
+
+int PixelSpans::pixelCount() const
+{
+    return mColours.size();
+}
+
+const QVector<PixelSpans::Span> &PixelSpans::spans() const
+{
+    return mSpans;
+}
+
+const QRgb *PixelSpans::colours(const Span &span) const
+{
+    return mColours.constData() + span.colourIndex;
+}
+
+void PixelSpans::append(int y, int x, const QRgb *colours, int length)
+{
+    if (length <= 0)
+        return;
+
+    if (!mSpans.isEmpty()) {
+        Span &lastSpan = mSpans.last();
+        if (lastSpan.y == y && lastSpan.x + lastSpan.length == x) {
+            lastSpan.length += length;
+            appendColours(colours, length);
+            return;
+        }
+    }
+
+    const Span span = { y, x, length, mColours.size() };
+    mSpans.append(span);
+    appendColours(colours, length);
+}
+
+void PixelSpans::append(const PixelSpans &other)
+{
+    for (const Span &span : other.mSpans)
+        append(span.y, span.x, other.colours(span), span.length);
+}
+
+bool PixelSpans::contains(const QPoint &pos) const
+{
+    for (const Span &span : mSpans) {
+        if (span.y == pos.y() && pos.x() >= span.x && pos.x() < span.x + span.length)
+            return true;
+    }
+    return false;
+}
+
+QPoint PixelSpans::lastPosition() const
+{
+    if (mSpans.isEmpty())
+        return QPoint();
+
+    const Span &lastSpan = mSpans.last();
+    return QPoint(lastSpan.x + lastSpan.length - 1, lastSpan.y);
+}
+
+QRect PixelSpans::bounds() const
+{
+    QRect bounds;
+    for (const Span &span : mSpans)
+        bounds |= QRect(span.x, span.y, span.length, 1);
+    return bounds;
+}
+
+bool PixelSpans::hasSamePositions(const PixelSpans &other) const
+{
+    if (mSpans.size() != other.mSpans.size())
+        return false;
+
+    return std::equal(mSpans.constBegin(), mSpans.constEnd(), other.mSpans.constBegin(), [](const Span &a, const Span &b) {
+        return a.y == b.y && a.x == b.x && a.length == b.length;
+    });
+}
+
+qint64 PixelSpans::byteSize() const
+{
+    return mSpans.size() * qint64(sizeof(Span)) + mColours.size() * qint64(sizeof(QRgb));
+}
+
+void PixelSpans::readPixels(const QImage &image, int y, int x, int length, QRgb *pixels)
+{
+    switch (image.format()) {
+    case QImage::Format_ARGB32_Premultiplied: {
+        const QRgb *scanLine = reinterpret_cast<const QRgb*>(image.constScanLine(y)) + x;
+        for (int i = 0; i < length; ++i)
+            pixels[i] = qUnpremultiply(scanLine[i]);
+        break;
+    }
+    case QImage::Format_ARGB32: {
+        const QRgb *scanLine = reinterpret_cast<const QRgb*>(image.constScanLine(y)) + x;
+        std::copy(scanLine, scanLine + length, pixels);
+        break;
+    }
+    case QImage::Format_RGB32: {
+        const QRgb *scanLine = reinterpret_cast<const QRgb*>(image.constScanLine(y)) + x;
+        for (int i = 0; i < length; ++i)
+            pixels[i] = scanLine[i] | 0xff000000;
+        break;
+    }
+    default:
+        for (int i = 0; i < length; ++i)
+            pixels[i] = image.pixel(x + i, y);
+        break;
+    }
+}
+
+void PixelSpans::writePixels(QImage *image, int y, int x, int length, const QRgb *pixels)
+{
+    switch (image->format()) {
+    case QImage::Format_ARGB32_Premultiplied: {
+        QRgb *scanLine = reinterpret_cast<QRgb*>(image->scanLine(y)) + x;
+        for (int i = 0; i < length; ++i)
+            scanLine[i] = qPremultiply(pixels[i]);
+        break;
+    }
+    case QImage::Format_ARGB32: {
+        QRgb *scanLine = reinterpret_cast<QRgb*>(image->scanLine(y)) + x;
+        std::copy(pixels, pixels + length, scanLine);
+        break;
+    }
+    case QImage::Format_RGB32: {
+        QRgb *scanLine = reinterpret_cast<QRgb*>(image->scanLine(y)) + x;
+        for (int i = 0; i < length; ++i)
+            scanLine[i] = pixels[i] | 0xff000000;
+        break;
+    }
+    default:
+        for (int i = 0; i < length; ++i)
+            image->setPixel(x + i, y, pixels[i]);
+        break;
+    }
+}
+
+void PixelSpans::fillPixels(QImage *image, int y, int x, int length, QRgb colour)
+{
+    switch (image->format()) {
+    case QImage::Format_ARGB32_Premultiplied: {
+        QRgb *scanLine = reinterpret_cast<QRgb*>(image->scanLine(y)) + x;
+        std::fill(scanLine, scanLine + length, qPremultiply(colour));
+        break;
+    }
+    case QImage::Format_ARGB32: {
+        QRgb *scanLine = reinterpret_cast<QRgb*>(image->scanLine(y)) + x;
+        std::fill(scanLine, scanLine + length, colour);
+        break;
+    }
+    case QImage::Format_RGB32: {
+        QRgb *scanLine = reinterpret_cast<QRgb*>(image->scanLine(y)) + x;
+        std::fill(scanLine, scanLine + length, colour | 0xff000000);
+        break;
+    }
+    default:
+        for (int i = 0; i < length; ++i)
+            image->setPixel(x + i, y, colour);
+        break;
+    }
+}
+
+void PixelSpans::appendColours(const QRgb *colours, int length)
+{
+    const int colourIndex = mColours.size();
+    mColours.resize(colourIndex + length);
+    std::copy(colours, colours + length, mColours.begin() + colourIndex);
+}
+
+QDebug operator<<(QDebug debug, const PixelSpans &spans)
+{
+    QDebugStateSaver saver(debug);
+    debug.nospace() << "(PixelSpans spans=" << spans.spans().size()
+        << " pixels=" << spans.pixelCount()
+        << " lastPosition=" << spans.lastPosition()
+        << ")";
+    return debug;
+}
@@ -0,0 +1,80 @@
+/*
+    Copyright 2018, Mitch Curtis
+
+    This file is part of Slate.
+
+    Slate is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Slate is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Slate. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PIXELSPANS_H
+#define PIXELSPANS_H
+
+#include <QDebug>
+#include <QImage>
+#include <QPoint>
+#include <QRect>
+#include <QVector>
+
+#include "slate-global.h"
+
+// A set of pixels stored as horizontal runs, along with a colour for each pixel.
+// Each span is a row, the x at which it starts and its length, and the colours
+// of all spans are stored contiguously as non-premultiplied ARGB values.
+class SLATE_EXPORT PixelSpans
+{
+public:
+    struct Span
+    {
+        int y;
+        int x;
+        int length;
+        // The index of the span's first colour.
+        int colourIndex;
+    };
+
+    bool isEmpty() const;
+    int pixelCount() const;
+    const QVector<Span> &spans() const;
+    const QRgb *colours(const Span &span) const;
+
+    // Appends length pixels starting at x on row y. If they continue on from the last span, they're merged into it.
+    void append(int y, int x, const QRgb *colours, int length);
+    void append(const PixelSpans &other);
+
+    bool contains(const QPoint &pos) const;
+    QPoint lastPosition() const;
+    // The smallest rect that contains every span.
+    QRect bounds() const;
+    bool hasSamePositions(const PixelSpans &other) const;
+
+    qint64 byteSize() const;
+
+    // Reads length pixels starting at (x, y) as non-premultiplied ARGB.
+    // Scanlines are accessed directly for the common 32-bit formats.
+    static void readPixels(const QImage &image, int y, int x, int length, QRgb *pixels);
+    // The opposite of readPixels().
+    static void writePixels(QImage *image, int y, int x, int length, const QRgb *pixels);
+    // Sets length pixels starting at (x, y) to the non-premultiplied ARGB colour.
+    static void fillPixels(QImage *image, int y, int x, int length, QRgb colour);
+
+private:
+    void appendColours(const QRgb *colours, int length);
+
+    QVector<Span> mSpans;
+    QVector<QRgb> mColours;
+};
+
+SLATE_EXPORT QDebug operator<<(QDebug debug, const PixelSpans &spans);
+
+#endif // PIXELSPANS_H
@@ -19,6 +19,9 @@
 
 #include "project.h"
 
+#include <algorithm>
+#include <functional>
+
 #include <QDateTime>
 #include <QImage>
 #include <QJsonArray>
@@ -28,18 +31,30 @@
 #include <QMetaEnum>
 
 #include "applicationsettings.h"
+#include "undocommand.h"
+#include "undoswapfile.h"
 
 Q_LOGGING_CATEGORY(lcProject, "app.project")
 Q_LOGGING_CATEGORY(lcProjectLifecycle, "app.project.lifecycle")
+Q_LOGGING_CATEGORY(lcProjectUndoMemory, "app.project.undoMemory")
 
 Project::Project() :
     mSettings(nullptr),
     mFromNew(false),
     mUsingTempImage(false),
+    mUndoMemoryUsage(0),
+    mPeakUndoMemoryUsage(0),
+    mReportedUndoMemoryUsage(0),
+    mMeasuredUndoIndex(0),
+    mMacroUndoIndex(0),
+    mAddingChange(false),
     mComposingMacro(false),
     mHadUnsavedChangesBeforeMacroBegan(false)
 {
     connect(&mUndoStack, SIGNAL(cleanChanged(bool)), this, SIGNAL(unsavedChangesChanged()));
+    // Undoing and redoing can change how much memory commands use (e.g. by taking
+    // ownership of a layer), and clearing the stack releases it all.
+    connect(&mUndoStack, &QUndoStack::indexChanged, this, &Project::onUndoIndexChanged);
 }
 
 Project::Type Project::type() const
@@ -383,7 +398,18 @@ void Project::setSettings(ApplicationSettings *settings)
     if (settings == mSettings)
         return;
 
+    if (mSettings) {
+        disconnect(mSettings, &ApplicationSettings::undoMemoryBudgetChanged, this, &Project::enforceUndoMemoryBudget);
+        disconnect(mSettings, &ApplicationSettings::undoMemoryBudgetChanged, this, &Project::updateUndoMemoryUsage);
+    }
+
     mSettings = settings;
+
+    if (mSettings) {
+        connect(mSettings, &ApplicationSettings::undoMemoryBudgetChanged, this, &Project::enforceUndoMemoryBudget);
+        connect(mSettings, &ApplicationSettings::undoMemoryBudgetChanged, this, &Project::updateUndoMemoryUsage);
+    }
+
     emit settingsChanged();
 }
 
@@ -509,6 +535,7 @@ void Project::beginMacro(const QString &text)
     qCDebug(lcProject) << "beginning macro" << text;
 
     mHadUnsavedChangesBeforeMacroBegan = hasUnsavedChanges();
+    mMacroUndoIndex = mUndoStack.index();
     mUndoStack.beginMacro(text);
     setComposingMacro(true, text);
 }
@@ -523,6 +550,13 @@ void Project::endMacro()
     // This handles the emission of the canSaveChanged signal.
     setComposingMacro(false);
 
+    // Beginning the macro removed any commands that could have been redone.
+    measureUndoCommandsFrom(mMacroUndoIndex);
+    remeasureSharedUndoImages();
+    updateUndoCheckpoints();
+    enforceUndoMemoryBudget();
+    updateUndoMemoryUsage();
+
     // It's not enough to rely on the cleanChanged signal to cause
     // our unchangedChangesSignal to be called, because cleanChanged
     // apparently does not get emitted when a macro ends. So, we do it ourselves here.
@@ -543,17 +577,550 @@ QDebug operator<<(QDebug debug, const QUndoCommand *command)
 void Project::addChange(QUndoCommand *undoCommand)
 {
     qCDebug(lcProject) << "adding change" << undoCommand;
+    const int index = mUndoStack.index();
+    mAddingChange = true;
     mUndoStack.push(undoCommand);
+    mAddingChange = false;
+
+    // Commands added to a macro are accounted for when it ends.
+    if (!isComposingMacro()) {
+        // Any commands that could have been redone are gone, and the command was
+        // either added after the one at the top of the stack or merged into it.
+        measureUndoCommandsFrom(index - 1);
+        remeasureSharedUndoImages();
+        updateUndoCheckpoints();
+        enforceUndoMemoryBudget();
+        updateUndoMemoryUsage();
+    }
 }
 
 void Project::clearChanges()
 {
     const bool hadUnsavedChanges = hasUnsavedChanges();
 
-    mUndoStack.setIndex(mUndoStack.cleanIndex());
+    setUndoIndex(mUndoStack.cleanIndex());
     mHadUnsavedChangesBeforeMacroBegan = false;
+    resetUndoMemoryUsage();
 
     if (hasUnsavedChanges() != hadUnsavedChanges) {
         emit unsavedChangesChanged();
     }
 }
+
+namespace {
+
+// A checkpoint is made every this many commands.
+const int undoCheckpointInterval = 16;
+// The oldest checkpoints are removed beyond this many.
+const int maxUndoCheckpoints = 8;
+
+// Calls function() for the given command and each of its descendants that are UndoCommands.
+template<typename Function>
+void forEachUndoCommand(const QUndoCommand *command, Function function)
+{
+    // QUndoStack only gives out const pointers, but the commands are ours to compress.
+    UndoCommand *undoCommand = dynamic_cast<UndoCommand*>(const_cast<QUndoCommand*>(command));
+    if (undoCommand)
+        function(undoCommand);
+
+    for (int i = 0; i < command->childCount(); ++i)
+        forEachUndoCommand(command->child(i), function);
+}
+
+QSet<qint64> imageCacheKeys(const QVector<QImage*> &images)
+{
+    QSet<qint64> cacheKeys;
+    cacheKeys.reserve(images.size());
+    for (const QImage *image : images)
+        cacheKeys.insert(image->cacheKey());
+    return cacheKeys;
+}
+
+qint64 imagesByteSize(const QVector<QImage*> &images)
+{
+    qint64 byteSize = 0;
+    for (const QImage *image : images)
+        byteSize += image->sizeInBytes();
+    return byteSize;
+}
+
+// Checkpoints share their images with the project's, so an image only costs
+// anything once the project's has been edited and no longer shares its data.
+// The project's images are identified by projectImageCacheKeys rather than through
+// the pointers in images, as the layers that those belong to could have been deleted since.
+qint64 undoCheckpointByteSize(const QVector<QPair<QImage*, QImage>> &images, const QSet<qint64> &projectImageCacheKeys)
+{
+    qint64 byteSize = 0;
+    for (const auto &image : images) {
+        if (!projectImageCacheKeys.contains(image.second.cacheKey()))
+            byteSize += image.second.sizeInBytes();
+    }
+    return byteSize;
+}
+
+// Images that share their data with the project's don't use any memory of their own
+// (e.g. a resize command's new image right after it's been redone), so they aren't counted.
+// If sharesImages is non-null, it's set to whether there were any.
+qint64 undoCommandByteSize(const QUndoCommand *command, const QSet<qint64> &projectImageCacheKeys,
+    bool *sharesImages = nullptr)
+{
+    qint64 byteSize = 0;
+    qint64 sharedByteSize = 0;
+    forEachUndoCommand(command, [&](UndoCommand *undoCommand) {
+        byteSize += undoCommand->byteSize();
+        sharedByteSize += undoCommand->sharedImageByteSize(projectImageCacheKeys);
+    });
+    if (sharesImages)
+        *sharesImages = sharedByteSize > 0;
+    return byteSize - sharedByteSize;
+}
+
+}
+
+// Returns 0 if there's no budget.
+qint64 Project::undoMemoryBudgetInBytes() const
+{
+    if (!mSettings || mSettings->undoMemoryBudget() <= 0)
+        return 0;
+
+    return qint64(mSettings->undoMemoryBudget()) * 1024 * 1024;
+}
+
+qint64 Project::undoMemoryUsage() const
+{
+    return mUndoMemoryUsage;
+}
+
+qint64 Project::peakUndoMemoryUsage() const
+{
+    return mPeakUndoMemoryUsage;
+}
+
+QVariantList Project::undoMemoryBreakdown() const
+{
+    const QSet<qint64> cacheKeys = projectImageCacheKeys();
+    QVariantList breakdown;
+    for (int i = 0; i < mUndoStack.count(); ++i) {
+        const QUndoCommand *command = mUndoStack.command(i);
+        QVariantMap map;
+        map.insert(QLatin1String("text"), command->text());
+        map.insert(QLatin1String("byteSize"), undoCommandByteSize(command, cacheKeys));
+        breakdown.append(map);
+    }
+    return breakdown;
+}
+
+void Project::enforceUndoMemoryBudget()
+{
+    const qint64 budget = undoMemoryBudgetInBytes();
+    if (budget <= 0 || isComposingMacro())
+        return;
+
+    qint64 &usage = mUndoMemoryUsage;
+    if (usage <= budget)
+        return;
+
+    qCDebug(lcProjectUndoMemory) << "undo history uses" << usage << "bytes; budget is" << budget;
+
+    // Checkpoints only make jumping through the history faster, so they go first, oldest first.
+    // Those that still share all of their images with the project don't cost anything, so they can stay.
+    for (int i = 0; i < mUndoCheckpoints.size() && usage > budget; ) {
+        if (mUndoCheckpoints.at(i).byteSize > 0)
+            removeUndoCheckpoint(i);
+        else
+            ++i;
+    }
+    if (usage <= budget) {
+        qCDebug(lcProjectUndoMemory) << "removed undo checkpoints; undo history now uses" << usage << "bytes";
+        return;
+    }
+
+    // Shrink the commands furthest from the current index first, as they're
+    // the least likely to be undone or redone any time soon. Those are at
+    // the ends of the stack, so work inwards from both ends, preferring older commands.
+    const int index = mUndoStack.index();
+    QVector<int> commandIndices;
+    commandIndices.reserve(mUndoStack.count());
+    for (int older = 0, newer = mUndoStack.count() - 1; older <= newer; ) {
+        if (index - 1 - older >= newer - index)
+            commandIndices.append(older++);
+        else
+            commandIndices.append(newer--);
+    }
+
+    // Images that are shared with the project's aren't counted, and shrinking them wouldn't
+    // free anything, so they're left alone.
+    const QSet<qint64> cacheKeys = projectImageCacheKeys();
+    const auto commandByteSize = [&](const UndoCommand *command) {
+        return command->byteSize() - command->sharedImageByteSize(cacheKeys);
+    };
+
+    // Returns true once usage is within the budget.
+    const auto shrinkCommands = [&](const std::function<void(UndoCommand*)> &shrink) -> bool {
+        for (const int commandIndex : qAsConst(commandIndices)) {
+            qint64 &commandUsage = mUndoCommandMemoryUsages[commandIndex].byteSize;
+            forEachUndoCommand(mUndoStack.command(commandIndex), [&](UndoCommand *command) {
+                const qint64 sizeBeforeShrinking = commandByteSize(command);
+                shrink(command);
+                const qint64 freedBytes = sizeBeforeShrinking - commandByteSize(command);
+                usage -= freedBytes;
+                commandUsage -= freedBytes;
+            });
+
+            if (usage <= budget)
+                return true;
+        }
+        return false;
+    };
+
+    if (shrinkCommands([&](UndoCommand *command) { command->compress(cacheKeys); })) {
+        qCDebug(lcProjectUndoMemory) << "compressed undo history down to" << usage << "bytes";
+        return;
+    }
+
+    // If compression wasn't enough, move the history to disk, if allowed.
+    if (mSettings->isUndoSpillEnabled() && mTempDir.isValid()) {
+        if (!mUndoSwapFile)
+            mUndoSwapFile.reset(new UndoSwapFile(mTempDir.filePath(QLatin1String("undo.swap"))));
+
+        if (mUndoSwapFile->isOpen()
+                && shrinkCommands([&](UndoCommand *command) { command->spill(mUndoSwapFile, cacheKeys); })) {
+            qCDebug(lcProjectUndoMemory) << "moved undo history to" << mUndoSwapFile->fileName()
+                << "- it now uses" << usage << "bytes of memory and" << mUndoSwapFile->usedBytes() << "bytes on disk";
+            return;
+        }
+    }
+
+    // Nothing else worked, so drop the oldest history. Only a contiguous run
+    // of commands from the bottom of the stack can be dropped, as each command
+    // relies on the ones before it having been applied. The most recent command is always kept.
+    // Obsolete commands are removed by QUndoStack when it reaches them instead of being undone.
+    int droppedCommandCount = 0;
+    for (int commandIndex = 0; commandIndex < index - 1 && usage > budget; ++commandIndex) {
+        QUndoCommand *command = const_cast<QUndoCommand*>(mUndoStack.command(commandIndex));
+        if (command->isObsolete())
+            continue;
+
+        qint64 &commandUsage = mUndoCommandMemoryUsages[commandIndex].byteSize;
+        forEachUndoCommand(command, [&](UndoCommand *undoCommand) {
+            const qint64 sizeBeforeDiscarding = commandByteSize(undoCommand);
+            undoCommand->discard();
+            const qint64 freedBytes = sizeBeforeDiscarding - commandByteSize(undoCommand);
+            usage -= freedBytes;
+            commandUsage -= freedBytes;
+        });
+        command->setObsolete(true);
+        droppedCommandCount = commandIndex + 1;
+    }
+
+    // Checkpoints within the dropped history can no longer be reached.
+    for (int i = mUndoCheckpoints.size() - 1; i >= 0; --i) {
+        if (mUndoCheckpoints.at(i).index < droppedCommandCount)
+            removeUndoCheckpoint(i);
+    }
+
+    qCDebug(lcProjectUndoMemory) << "dropped old undo history; it now uses" << usage << "bytes";
+}
+
+void Project::onUndoIndexChanged()
+{
+    // Pushed commands and macros are measured by addChange() and endMacro().
+    if (mAddingChange || isComposingMacro())
+        return;
+
+    if (mUndoCommandMemoryUsages.size() != mUndoStack.count())
+        forgetRemovedUndoCommands();
+
+    // Undoing and redoing can change how much memory commands use (e.g. by taking
+    // ownership of a layer), so the commands that were passed over are measured again.
+    const int index = mUndoStack.index();
+    remeasureUndoCommands(qMin(mMeasuredUndoIndex, index), qMax(mMeasuredUndoIndex, index));
+    mMeasuredUndoIndex = index;
+    remeasureSharedUndoImages();
+
+    updateUndoMemoryUsage();
+}
+
+// Stops tracking the commands from index onwards and measures the ones that are there now.
+void Project::measureUndoCommandsFrom(int index)
+{
+    index = qBound(0, index, mUndoCommandMemoryUsages.size());
+    while (mUndoCommandMemoryUsages.size() > index)
+        mUndoMemoryUsage -= mUndoCommandMemoryUsages.takeLast().byteSize;
+
+    const QSet<qint64> cacheKeys = projectImageCacheKeys();
+    for (int i = index; i < mUndoStack.count(); ++i) {
+        UndoCommandMemoryUsage commandUsage;
+        commandUsage.command = mUndoStack.command(i);
+        commandUsage.byteSize = undoCommandByteSize(commandUsage.command, cacheKeys, &commandUsage.sharesProjectImages);
+        mUndoCommandMemoryUsages.append(commandUsage);
+        mUndoMemoryUsage += commandUsage.byteSize;
+    }
+
+    mMeasuredUndoIndex = mUndoStack.index();
+}
+
+void Project::remeasureUndoCommands(int fromIndex, int toIndex)
+{
+    toIndex = qMin(toIndex, mUndoCommandMemoryUsages.size());
+    if (fromIndex >= toIndex)
+        return;
+
+    const QSet<qint64> cacheKeys = projectImageCacheKeys();
+    for (int i = fromIndex; i < toIndex; ++i)
+        remeasureUndoCommand(i, cacheKeys);
+}
+
+void Project::remeasureUndoCommand(int index, const QSet<qint64> &projectImageCacheKeys)
+{
+    UndoCommandMemoryUsage &commandUsage = mUndoCommandMemoryUsages[index];
+    const qint64 byteSize = undoCommandByteSize(commandUsage.command, projectImageCacheKeys,
+        &commandUsage.sharesProjectImages);
+    mUndoMemoryUsage += byteSize - commandUsage.byteSize;
+    commandUsage.byteSize = byteSize;
+}
+
+// QUndoStack deletes obsolete commands when it reaches them, and clear() deletes
+// all of them. Commands are never inserted below the top of the stack, so the
+// ones that are still there can be matched up with the ones that we know about in order.
+void Project::forgetRemovedUndoCommands()
+{
+    int index = 0;
+    for (int i = 0; i < mUndoCommandMemoryUsages.size(); ) {
+        if (index < mUndoStack.count() && mUndoStack.command(index) == mUndoCommandMemoryUsages.at(i).command) {
+            ++index;
+            ++i;
+        } else {
+            mUndoMemoryUsage -= mUndoCommandMemoryUsages.at(i).byteSize;
+            mUndoCommandMemoryUsages.removeAt(i);
+        }
+    }
+
+    // Indices past the removed commands have moved down.
+    mMeasuredUndoIndex = qMin(mMeasuredUndoIndex, mUndoCommandMemoryUsages.size());
+}
+
+void Project::resetUndoMemoryUsage()
+{
+    mUndoCommandMemoryUsages.clear();
+    mUndoMemoryUsage = 0;
+    for (const UndoCheckpoint &checkpoint : qAsConst(mUndoCheckpoints))
+        mUndoMemoryUsage += checkpoint.byteSize;
+    remeasureSharedUndoImages();
+    measureUndoCommandsFrom(0);
+    updateUndoMemoryUsage();
+}
+
+void Project::updateUndoMemoryUsage()
+{
+    // Commands added to a macro are accounted for when it ends.
+    if (isComposingMacro())
+        return;
+
+    const qint64 usage = mUndoMemoryUsage;
+    // Start afresh when the history is cleared, e.g. when a project is closed.
+    const qint64 peakUsage = mUndoStack.count() > 0 ? qMax(mPeakUndoMemoryUsage, usage) : usage;
+    if (peakUsage == mPeakUndoMemoryUsage && usage == mReportedUndoMemoryUsage)
+        return;
+
+    mReportedUndoMemoryUsage = usage;
+    mPeakUndoMemoryUsage = peakUsage;
+
+    qCDebug(lcProjectUndoMemory) << "undo history uses" << usage << "bytes; peak is" << peakUsage << "bytes";
+    if (lcProjectUndoMemory().isDebugEnabled()) {
+        const QVariantList breakdown = undoMemoryBreakdown();
+        for (int i = 0; i < breakdown.size(); ++i) {
+            const QVariantMap map = breakdown.at(i).toMap();
+            qCDebug(lcProjectUndoMemory).nospace() << "    " << i << ": " << map.value(QLatin1String("text")).toString()
+                << " - " << map.value(QLatin1String("byteSize")).toLongLong() << " bytes";
+        }
+    }
+
+    emit undoMemoryUsageChanged();
+}
+
+void Project::setUndoIndex(int index)
+{
+    if (isComposingMacro())
+        return;
+
+    index = qBound(0, index, mUndoStack.count());
+    const int currentIndex = mUndoStack.index();
+    if (index == currentIndex)
+        return;
+
+    // Find the checkpoint closest to the index, if it's closer than the current index.
+    const UndoCheckpoint *checkpoint = nullptr;
+    int distance = qAbs(index - currentIndex);
+    for (const UndoCheckpoint &candidate : qAsConst(mUndoCheckpoints)) {
+        const int candidateDistance = qAbs(index - candidate.index);
+        if (candidateDistance < distance && candidate.index <= mUndoStack.count()
+                && mUndoStack.command(candidate.index - 1) == candidate.previousCommand) {
+            checkpoint = &candidate;
+            distance = candidateDistance;
+        }
+    }
+
+    if (checkpoint) {
+        // Obsolete commands are removed by QUndoStack as it reaches them,
+        // which would move the checkpoint to a different index.
+        const int firstIndex = qMin(qMin(index, currentIndex), checkpoint->index);
+        const int lastIndex = qMax(qMax(index, currentIndex), checkpoint->index);
+        for (int i = firstIndex; i < lastIndex; ++i) {
+            if (mUndoStack.command(i)->isObsolete()) {
+                checkpoint = nullptr;
+                break;
+            }
+        }
+    }
+
+    if (!checkpoint) {
+        mUndoStack.setIndex(index);
+        return;
+    }
+
+    qCDebug(lcProject) << "moving from undo index" << currentIndex << "to" << index
+        << "via checkpoint at" << checkpoint->index;
+
+    // The images are about to be replaced, so there's no point in changing them
+    // on the way to the checkpoint; only the other commands need to be replayed.
+    const int checkpointIndex = checkpoint->index;
+    const QVector<QPair<QImage*, QImage>> images = checkpoint->images;
+    const QSize previousSize = size();
+    const int firstSkippedIndex = qMin(currentIndex, checkpointIndex);
+    const int lastSkippedIndex = qMax(currentIndex, checkpointIndex);
+    setImageCommandsSkipped(firstSkippedIndex, lastSkippedIndex, true);
+    mUndoStack.setIndex(checkpointIndex);
+
+    // The images belong to the project's layers, which could have been added or removed
+    // since the checkpoint was made. If the images at the checkpoint aren't the same ones,
+    // go back to where we started (the images were never touched) and replay everything instead.
+    const QVector<QImage*> imagesAtCheckpoint = undoCheckpointImages();
+    bool sameImages = imagesAtCheckpoint.size() == images.size();
+    for (int i = 0; sameImages && i < images.size(); ++i)
+        sameImages = imagesAtCheckpoint.contains(images.at(i).first);
+    if (!sameImages) {
+        qCDebug(lcProject) << "images at undo checkpoint" << checkpointIndex << "have changed; not using it";
+        mUndoStack.setIndex(currentIndex);
+        setImageCommandsSkipped(firstSkippedIndex, lastSkippedIndex, false);
+        for (int i = 0; i < mUndoCheckpoints.size(); ++i) {
+            if (mUndoCheckpoints.at(i).index == checkpointIndex) {
+                removeUndoCheckpoint(i);
+                break;
+            }
+        }
+        mUndoStack.setIndex(index);
+        return;
+    }
+
+    setImageCommandsSkipped(firstSkippedIndex, lastSkippedIndex, false);
+
+    for (const auto &image : images)
+        *image.first = image.second;
+    undoCheckpointRestored(previousSize);
+
+    mUndoStack.setIndex(index);
+    // The restored images are shared with the checkpoint again.
+    remeasureSharedUndoImages();
+    updateUndoMemoryUsage();
+}
+
+QVector<QImage*> Project::undoCheckpointImages()
+{
+    return QVector<QImage*>();
+}
+
+void Project::undoCheckpointRestored(const QSize &)
+{
+}
+
+void Project::updateUndoCheckpoints()
+{
+    const int index = mUndoStack.index();
+
+    // The command at the top of the stack has just been pushed (or merged with), so
+    // any checkpoints that were made after the command that was there before are out of date.
+    for (int i = mUndoCheckpoints.size() - 1; i >= 0; --i) {
+        if (mUndoCheckpoints.at(i).index >= index)
+            removeUndoCheckpoint(i);
+    }
+
+    const int lastCheckpointIndex = !mUndoCheckpoints.isEmpty() ? mUndoCheckpoints.last().index : 0;
+    if (index - lastCheckpointIndex < undoCheckpointInterval)
+        return;
+
+    const QVector<QImage*> images = undoCheckpointImages();
+    if (images.isEmpty())
+        return;
+
+    // Once the images have been edited, the checkpoint would be the first thing
+    // to go to get back within the budget, so don't bother making it.
+    const qint64 budget = undoMemoryBudgetInBytes();
+    if (budget > 0 && imagesByteSize(images) > budget) {
+        qCDebug(lcProject) << "not making undo checkpoint at index" << index << "as the images are larger than the budget";
+        return;
+    }
+
+    UndoCheckpoint checkpoint;
+    checkpoint.index = index;
+    checkpoint.previousCommand = mUndoStack.command(index - 1);
+    // The images are shared with the project's until they're edited, so this costs nothing
+    // up front, and only the images that are actually edited afterwards are ever copied.
+    checkpoint.byteSize = 0;
+    checkpoint.images.reserve(images.size());
+    for (QImage *image : images)
+        checkpoint.images.append(qMakePair(image, *image));
+    mUndoCheckpoints.append(checkpoint);
+
+    if (mUndoCheckpoints.size() > maxUndoCheckpoints)
+        removeUndoCheckpoint(0);
+
+    qCDebug(lcProject) << "made undo checkpoint at index" << index;
+}
+
+void Project::removeUndoCheckpoint(int index)
+{
+    mUndoMemoryUsage -= mUndoCheckpoints.at(index).byteSize;
+    mUndoCheckpoints.removeAt(index);
+}
+
+// Editing the project's images in place detaches them from the checkpoints and commands
+// that share them, which is when their copies start using memory, so this should be called after each change.
+void Project::remeasureSharedUndoImages()
+{
+    const QSet<qint64> cacheKeys = projectImageCacheKeys();
+    for (UndoCheckpoint &checkpoint : mUndoCheckpoints) {
+        const qint64 byteSize = undoCheckpointByteSize(checkpoint.images, cacheKeys);
+        mUndoMemoryUsage += byteSize - checkpoint.byteSize;
+        checkpoint.byteSize = byteSize;
+    }
+
+    for (int i = 0; i < mUndoCommandMemoryUsages.size(); ++i) {
+        if (mUndoCommandMemoryUsages.at(i).sharesProjectImages)
+            remeasureUndoCommand(i, cacheKeys);
+    }
+}
+
+QSet<qint64> Project::projectImageCacheKeys() const
+{
+    // undoCheckpointImages() isn't const because the images are restored through it;
+    // nothing is modified here.
+    return imageCacheKeys(const_cast<Project*>(this)->undoCheckpointImages());
+}
+
+void Project::clearUndoCheckpoints()
+{
+    while (!mUndoCheckpoints.isEmpty())
+        removeUndoCheckpoint(mUndoCheckpoints.size() - 1);
+    updateUndoMemoryUsage();
+}
+
+void Project::setImageCommandsSkipped(int fromIndex, int toIndex, bool skipped)
+{
+    for (int i = fromIndex; i < toIndex; ++i) {
+        forEachUndoCommand(mUndoStack.command(i), [=](UndoCommand *command) {
+            if (command->changesOnlyImages())
+                command->setSkipped(skipped);
+        });
+    }
+}
@@ -24,9 +24,14 @@
 #include <QJsonObject>
 #include <QLoggingCategory>
 #include <QObject>
+#include <QPair>
+#include <QSet>
+#include <QSharedPointer>
 #include <QSize>
 #include <QTemporaryDir>
 #include <QUrl>
+#include <QVariant>
+#include <QVector>
 
 #include <QUndoStack>
 
@@ -36,8 +41,10 @@
 
 Q_DECLARE_LOGGING_CATEGORY(lcProject)
 Q_DECLARE_LOGGING_CATEGORY(lcProjectLifecycle)
+Q_DECLARE_LOGGING_CATEGORY(lcProjectUndoMemory)
 
 class ApplicationSettings;
+class UndoSwapFile;
 
 class SLATE_EXPORT Project : public QObject
 {
@@ -53,6 +60,9 @@ class SLATE_EXPORT Project : public QObject
     Q_PROPERTY(QString displayUrl READ displayUrl NOTIFY urlChanged)
     Q_PROPERTY(QSize size READ size WRITE setSize NOTIFY sizeChanged)
     Q_PROPERTY(QUndoStack *undoStack READ undoStack CONSTANT)
+    Q_PROPERTY(qint64 undoMemoryUsage READ undoMemoryUsage NOTIFY undoMemoryUsageChanged)
+    Q_PROPERTY(qint64 peakUndoMemoryUsage READ peakUndoMemoryUsage NOTIFY undoMemoryUsageChanged)
+    Q_PROPERTY(QVariantList undoMemoryBreakdown READ undoMemoryBreakdown NOTIFY undoMemoryUsageChanged)
     Q_PROPERTY(ApplicationSettings *settings READ settings WRITE setSettings NOTIFY settingsChanged)
     Q_PROPERTY(Swatch *swatch READ swatch CONSTANT)
 
@@ -110,6 +120,17 @@ public:
     void endMacro();
     void addChange(QUndoCommand *undoCommand);
     void clearChanges();
+    // The approximate number of bytes of memory used by the undo history.
+    qint64 undoMemoryUsage() const;
+    // The highest undoMemoryUsage() has been since the history was last cleared.
+    qint64 peakUndoMemoryUsage() const;
+    // A map for each command in the undo stack, from the bottom up,
+    // with "text" and "byteSize" keys.
+    QVariantList undoMemoryBreakdown() const;
+    // Undoes or redoes commands until the undo stack is at the given index.
+    // When there's a checkpoint closer to the index than the current one,
+    // its images are restored so that only the commands after it need to be replayed.
+    Q_INVOKABLE void setUndoIndex(int index);
 
     ApplicationSettings *settings() const;
     void setSettings(ApplicationSettings *settings);
@@ -134,11 +155,15 @@ signals:
     void canSaveChanged();
     void urlChanged();
     void sizeChanged();
+    // Emitted when the contents are replaced without any more specific signal
+    // being emitted, e.g. when the images are restored from an undo checkpoint.
+    void contentsReplaced();
     void errorOccurred(const QString &errorMessage);
     void settingsChanged();
     void guidesChanged();
     void readyForWritingToJson(QJsonObject *projectJson);
     void aboutToBeginMacro(const QString &text);
+    void undoMemoryUsageChanged();
 
 public slots:
     void load(const QUrl &url);
@@ -174,6 +199,29 @@ protected:
 
     bool readPaintNetSwatch(QFile &file);
 
+    void enforceUndoMemoryBudget();
+    void onUndoIndexChanged();
+    void measureUndoCommandsFrom(int index);
+    void remeasureUndoCommands(int fromIndex, int toIndex);
+    void remeasureUndoCommand(int index, const QSet<qint64> &projectImageCacheKeys);
+    void forgetRemovedUndoCommands();
+    void resetUndoMemoryUsage();
+    void updateUndoMemoryUsage();
+    qint64 undoMemoryBudgetInBytes() const;
+
+    // The images that make up the contents of the project, which are saved
+    // periodically as checkpoints in the undo history. Projects that don't
+    // return any images don't have checkpoints.
+    virtual QVector<QImage*> undoCheckpointImages();
+    // Called after the images have been restored from a checkpoint.
+    virtual void undoCheckpointRestored(const QSize &previousSize);
+    void updateUndoCheckpoints();
+    void removeUndoCheckpoint(int index);
+    void remeasureSharedUndoImages();
+    QSet<qint64> projectImageCacheKeys() const;
+    void clearUndoCheckpoints();
+    void setImageCommandsSkipped(int fromIndex, int toIndex, bool skipped);
+
     ApplicationSettings *mSettings;
 
     bool mFromNew;
@@ -188,10 +236,48 @@ protected:
     QJsonObject mCachedProjectJson;
 
     QUndoStack mUndoStack;
+    // Created when undo history first needs to be moved out of memory.
+    QSharedPointer<UndoSwapFile> mUndoSwapFile;
+    // The size of each command in the stack as of when it was last measured, which
+    // mUndoMemoryUsage is the sum of. Only the commands that are pushed, undone, redone
+    // or shrunk need to be measured again, rather than the whole stack.
+    struct UndoCommandMemoryUsage
+    {
+        const QUndoCommand *command;
+        qint64 byteSize;
+        // Whether any of the command's images were shared with the project's when it was measured,
+        // in which case it needs measuring again whenever the project's images could have changed.
+        bool sharesProjectImages;
+    };
+    QVector<UndoCommandMemoryUsage> mUndoCommandMemoryUsages;
+    qint64 mUndoMemoryUsage;
+    qint64 mPeakUndoMemoryUsage;
+    // The usage as of when undoMemoryUsageChanged() was last emitted.
+    qint64 mReportedUndoMemoryUsage;
+    // The undo index as of when the commands were last measured.
+    int mMeasuredUndoIndex;
+    // The undo index that the macro being composed was begun at.
+    int mMacroUndoIndex;
+    bool mAddingChange;
     bool mComposingMacro;
     QString mCurrentlyComposingMacroText;
     bool mHadUnsavedChangesBeforeMacroBegan;
 
+    struct UndoCheckpoint
+    {
+        // The index in the undo stack that the images belong to.
+        int index;
+        // The command before index, used to check that the history leading
+        // up to the checkpoint hasn't changed since it was made.
+        const QUndoCommand *previousCommand;
+        // The project's images as of the checkpoint. They share their data with the
+        // project's until those are edited, after which they count towards the undo memory usage.
+        QVector<QPair<QImage*, QImage>> images;
+        // The size of the images that are no longer shared with the project's, as of when it was last measured.
+        qint64 byteSize;
+    };
+    QVector<UndoCheckpoint> mUndoCheckpoints;
+
     QVector<Guide> mGuides;
 
     Swatch mSwatch;
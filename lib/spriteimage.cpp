@@ -24,13 +24,16 @@
 #include <QPainter>
 
 #include "animationplayback.h"
+#include "imagecanvas.h"
 #include "project.h"
 
 Q_LOGGING_CATEGORY(lcSpriteImage, "app.spriteImage")
 
 SpriteImage::SpriteImage() :
     mProject(nullptr),
-    mAnimationPlayback(nullptr)
+    mAnimationPlayback(nullptr),
+    mCanvas(nullptr),
+    mContentCacheKey(0)
 {
 }
 
@@ -39,30 +42,72 @@ void SpriteImage::paint(QPainter *painter)
     if (!mProject || !mAnimationPlayback)
         return;
 
+    const QImage image = frameImage(mAnimationPlayback->currentFrameIndex());
+    if (image.isNull())
+        return;
+
+    painter->drawImage(0, 0, image);
+}
+
+QImage SpriteImage::frameImage(int frameIndex)
+{
+    if (!mProject || !mAnimationPlayback)
+        return QImage();
+
+    if (!mCanvas) {
+        // Without a canvas to tell us which areas changed, the best we can do is check the whole image.
+        const qint64 contentCacheKey = mProject->exportedImage().cacheKey();
+        if (contentCacheKey != mContentCacheKey) {
+            mFrameImages.clear();
+            mContentCacheKey = contentCacheKey;
+        }
+    }
+
+    const auto it = mFrameImages.constFind(frameIndex);
+    if (it != mFrameImages.constEnd())
+        return it.value();
+
+    const QRect sourceRect = frameSourceRect(frameIndex);
+    if (sourceRect.isEmpty())
+        return QImage();
+
     const QImage exportedImage = mProject->exportedImage();
     if (exportedImage.isNull())
-        return;
+        return QImage();
+
+    qCDebug(lcSpriteImage) << "extracting sprite frame" << frameIndex << "with"
+        << mAnimationPlayback->frameX() << mAnimationPlayback->frameY() << mAnimationPlayback->frameWidth() << mAnimationPlayback->frameHeight()
+        << "at" << sourceRect;
 
-    QImage copy;
-    // The defaults...
+    const QImage image = exportedImage.copy(sourceRect);
+    mFrameImages.insert(frameIndex, image);
+    return image;
+}
+
+int SpriteImage::cachedFrameCount() const
+{
+    return mFrameImages.size();
+}
+
+QRect SpriteImage::frameSourceRect(int frameIndex) const
+{
     const int frameWidth = mAnimationPlayback->frameWidth();
     const int frameHeight = mAnimationPlayback->frameHeight();
-    const int framesWide = exportedImage.width() / frameWidth;
+    if (frameWidth <= 0 || frameHeight <= 0)
+        return QRect();
+
+    const int framesWide = mProject->widthInPixels() / frameWidth;
+    if (framesWide <= 0)
+        return QRect();
+
     const int startColumn = mAnimationPlayback->frameX() / frameWidth;
     const int startRow = mAnimationPlayback->frameY() / frameHeight;
     const int xOffset = startColumn;
     const int yOffset = startRow * framesWide;
 
-    const int column = (xOffset + mAnimationPlayback->currentFrameIndex()) % framesWide;
-    const int row = (yOffset + mAnimationPlayback->currentFrameIndex()) / framesWide;
-    copy = exportedImage.copy(column * frameWidth, row * frameHeight, frameWidth, frameHeight);
-    Q_ASSERT(!copy.isNull());
-
-    qCDebug(lcSpriteImage) << "painting sprite frame with"
-        << mAnimationPlayback->frameX() << mAnimationPlayback->frameY() << mAnimationPlayback->frameWidth() << mAnimationPlayback->frameHeight()
-        << "at" << column * frameWidth << row * frameHeight << frameWidth << frameHeight;
-
-    painter->drawImage(0, 0, copy);
+    const int column = (xOffset + frameIndex) % framesWide;
+    const int row = (yOffset + frameIndex) / framesWide;
+    return QRect(column * frameWidth, row * frameHeight, frameWidth, frameHeight);
 }
 
 Project *SpriteImage::project() const
@@ -76,7 +121,7 @@ void SpriteImage::setProject(Project *project)
         return;
 
     mProject = project;
-    update();
+    invalidateFrames();
     emit projectChanged();
 }
 
@@ -99,6 +144,8 @@ void SpriteImage::setAnimationPlayback(AnimationPlayback *animationPlayback)
         connect(mAnimationPlayback, &AnimationPlayback::currentFrameIndexChanged, [=]{ update(); });
         connect(mAnimationPlayback, &AnimationPlayback::frameWidthChanged, this, &SpriteImage::onFrameSizeChanged);
         connect(mAnimationPlayback, &AnimationPlayback::frameHeightChanged, this, &SpriteImage::onFrameSizeChanged);
+        connect(mAnimationPlayback, &AnimationPlayback::frameXChanged, this, &SpriteImage::invalidateFrames);
+        connect(mAnimationPlayback, &AnimationPlayback::frameYChanged, this, &SpriteImage::invalidateFrames);
     }
 
     // Force implicit size change & repaint.
@@ -107,9 +154,61 @@ void SpriteImage::setAnimationPlayback(AnimationPlayback *animationPlayback)
     emit animationPlaybackChanged();
 }
 
+ImageCanvas *SpriteImage::canvas() const
+{
+    return mCanvas;
+}
+
+void SpriteImage::setCanvas(ImageCanvas *canvas)
+{
+    if (canvas == mCanvas)
+        return;
+
+    if (mCanvas)
+        mCanvas->disconnect(this);
+
+    mCanvas = canvas;
+
+    if (mCanvas)
+        connect(mCanvas, &ImageCanvas::contentChanged, this, &SpriteImage::onContentChanged);
+
+    // We may have missed changes while we didn't have a canvas.
+    invalidateFrames();
+    emit canvasChanged();
+}
+
 void SpriteImage::onFrameSizeChanged()
 {
     setImplicitWidth(mAnimationPlayback ? mAnimationPlayback->frameWidth() : 0);
     setImplicitHeight(mAnimationPlayback ? mAnimationPlayback->frameHeight() : 0);
+    invalidateFrames();
+}
+
+void SpriteImage::invalidateFrames()
+{
+    mFrameImages.clear();
+    mContentCacheKey = 0;
     update();
 }
+
+void SpriteImage::onContentChanged(const QRect &sceneArea)
+{
+    if (sceneArea.isNull()) {
+        invalidateFrames();
+        return;
+    }
+
+    if (!mProject || !mAnimationPlayback)
+        return;
+
+    // Only re-extract the frames that overlap the area that changed.
+    for (auto it = mFrameImages.begin(); it != mFrameImages.end(); ) {
+        if (frameSourceRect(it.key()).intersects(sceneArea))
+            it = mFrameImages.erase(it);
+        else
+            ++it;
+    }
+
+    if (frameSourceRect(mAnimationPlayback->currentFrameIndex()).intersects(sceneArea))
+        update();
+}
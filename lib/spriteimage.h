@@ -20,11 +20,15 @@
 #ifndef SPRITEIMAGE_H
 #define SPRITEIMAGE_H
 
+#include <QHash>
+#include <QImage>
+#include <QPointer>
 #include <QQuickPaintedItem>
 
 #include "slate-global.h"
 
 class AnimationPlayback;
+class ImageCanvas;
 class Project;
 
 class SLATE_EXPORT SpriteImage : public QQuickPaintedItem
@@ -32,6 +36,7 @@ class SLATE_EXPORT SpriteImage : public QQuickPaintedItem
     Q_OBJECT
     Q_PROPERTY(Project *project READ project WRITE setProject NOTIFY projectChanged)
     Q_PROPERTY(AnimationPlayback *animationPlayback READ animationPlayback WRITE setAnimationPlayback NOTIFY animationPlaybackChanged)
+    Q_PROPERTY(ImageCanvas *canvas READ canvas WRITE setCanvas NOTIFY canvasChanged)
 
 public:
     SpriteImage();
@@ -44,16 +49,37 @@ public:
     AnimationPlayback *animationPlayback() const;
     void setAnimationPlayback(AnimationPlayback *animationPlayback);
 
+    ImageCanvas *canvas() const;
+    void setCanvas(ImageCanvas *canvas);
+
+    // Returns the image for the frame at frameIndex, extracting it from
+    // the project's exported image if it hasn't already been.
+    // Public for auto test access.
+    QImage frameImage(int frameIndex);
+    int cachedFrameCount() const;
+
 signals:
     void projectChanged();
     void animationPlaybackChanged();
+    void canvasChanged();
 
 private slots:
     void onFrameSizeChanged();
+    void invalidateFrames();
+    void onContentChanged(const QRect &sceneArea);
 
 private:
+    QRect frameSourceRect(int frameIndex) const;
+
     Project *mProject;
     AnimationPlayback *mAnimationPlayback;
+    // The canvas can be destroyed before us when switching between project types.
+    QPointer<ImageCanvas> mCanvas;
+    // Frames are extracted once and then reused until the area of the project that they
+    // came from changes (which the canvas tells us about), or the frame geometry changes.
+    QHash<int, QImage> mFrameImages;
+    // Used to detect changes to the project's content when there's no canvas to tell us about them.
+    qint64 mContentCacheKey;
 };
 
 #endif // SPRITEIMAGE_H
@@ -0,0 +1,368 @@
+/*
+    Copyright 2018, Mitch Curtis
+
+    This file is part of Slate.
+
+    Slate is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Slate is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Slate. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "texturecanvaspaneitem.h"
+
+#include <QLoggingCategory>
+#include <QPainter>
+#include <QQuickWindow>
+#include <QSGClipNode>
+#include <QSGSimpleTextureNode>
+#include <QSGTransformNode>
+
+#include "canvaspane.h"
+#include "imagecanvas.h"
+#include "panedrawinghelper.h"
+#include "project.h"
+
+Q_LOGGING_CATEGORY(lcTextureCanvasPaneItem, "app.textureCanvasPaneItem")
+
+namespace {
+
+/*
+    The node tree for a pane looks like this:
+
+    PaneNode (clips to the pane)
+        QSGTransformNode (pane translation)
+            QSGSimpleTextureNode (checkered transparency indicator)
+            QSGTransformNode (zoom level)
+                QSGSimpleTextureNode (one per tile of the canvas image)
+            QSGNode (content overlays)
+                QSGSimpleTextureNode (checkered background of the overlay)
+                QSGSimpleTextureNode (overlay image)
+*/
+class PaneNode : public QSGClipNode
+{
+public:
+    PaneNode() :
+        clipGeometry(new QSGGeometry(QSGGeometry::defaultAttributes_Point2D(), 4)),
+        translateNode(new QSGTransformNode),
+        checkerNode(new QSGSimpleTextureNode),
+        zoomNode(new QSGTransformNode),
+        overlaysNode(new QSGNode)
+    {
+        setIsRectangular(true);
+        setGeometry(clipGeometry);
+        setFlag(OwnsGeometry);
+
+        checkerNode->setOwnsTexture(true);
+        checkerNode->setFiltering(QSGTexture::Nearest);
+
+        appendChildNode(translateNode);
+        translateNode->appendChildNode(zoomNode);
+        translateNode->appendChildNode(overlaysNode);
+    }
+
+    ~PaneNode() override
+    {
+        // Nodes that are in the tree are deleted by their parent.
+        if (!checkerNode->parent())
+            delete checkerNode;
+        for (QSGSimpleTextureNode *tileNode : qAsConst(tileNodes)) {
+            if (!tileNode->parent())
+                delete tileNode;
+        }
+    }
+
+    QSGGeometry *clipGeometry;
+    QSGTransformNode *translateNode;
+    // Not added to the tree until it has a texture.
+    QSGSimpleTextureNode *checkerNode;
+    QSGTransformNode *zoomNode;
+    QSGNode *overlaysNode;
+    QVector<QSGSimpleTextureNode*> tileNodes;
+    int tilesWide = 0;
+
+    QSize imageSize;
+    qint64 imageCacheKey = 0;
+    QSize checkerTextureSize;
+    qint64 checkerImageCacheKey = 0;
+};
+
+void setMatrixIfChanged(QSGTransformNode *node, const QMatrix4x4 &matrix)
+{
+    // setMatrix() always marks the node as dirty.
+    if (node->matrix() != matrix)
+        node->setMatrix(matrix);
+}
+
+// Uploads the parts of image that have changed since the last call, returning the number of tiles uploaded.
+int updateTileNodes(PaneNode *paneNode, QQuickWindow *window, const QImage &image,
+    const QRegion &dirtyRegion, bool allDirty)
+{
+    const int tileSize = TextureCanvasPaneItem::textureTileSize();
+
+    if (image.size() != paneNode->imageSize) {
+        qDeleteAll(paneNode->tileNodes);
+        paneNode->tileNodes.clear();
+
+        paneNode->tilesWide = (image.width() + tileSize - 1) / tileSize;
+        const int tilesHigh = (image.height() + tileSize - 1) / tileSize;
+        for (int i = 0; i < paneNode->tilesWide * tilesHigh; ++i) {
+            QSGSimpleTextureNode *tileNode = new QSGSimpleTextureNode;
+            tileNode->setOwnsTexture(true);
+            tileNode->setFiltering(QSGTexture::Nearest);
+            paneNode->tileNodes.append(tileNode);
+        }
+
+        paneNode->imageSize = image.size();
+        allDirty = true;
+    } else if (image.cacheKey() == paneNode->imageCacheKey) {
+        // The image hasn't changed, so whatever caused us to be updated
+        // (e.g. panning or zooming) only needed the transform to change.
+        return 0;
+    }
+
+    int uploadedTileCount = 0;
+    for (int i = 0; i < paneNode->tileNodes.size(); ++i) {
+        const QRect tileRect = QRect((i % paneNode->tilesWide) * tileSize, (i / paneNode->tilesWide) * tileSize,
+            tileSize, tileSize) & image.rect();
+        if (!allDirty && !dirtyRegion.intersects(tileRect))
+            continue;
+
+        QSGSimpleTextureNode *tileNode = paneNode->tileNodes.at(i);
+        tileNode->setTexture(window->createTextureFromImage(image.copy(tileRect)));
+        tileNode->setRect(tileRect);
+        // Nodes are only added to the tree once they have a texture.
+        if (!tileNode->parent())
+            paneNode->zoomNode->appendChildNode(tileNode);
+        ++uploadedTileCount;
+    }
+
+    paneNode->imageCacheKey = image.cacheKey();
+    return uploadedTileCount;
+}
+
+}
+
+/*
+    This class is a purely visual respresentation of a canvas pane;
+    ImageCanvas contains all of the state that will be rendered, and this class renders it.
+*/
+
+TextureCanvasPaneItem::TextureCanvasPaneItem(QQuickItem *parent) :
+    QQuickItem(parent)
+{
+    setObjectName("TextureCanvasPaneItem");
+    setFlag(ItemHasContents);
+}
+
+TextureCanvasPaneItem::~TextureCanvasPaneItem()
+{
+}
+
+ImageCanvas *TextureCanvasPaneItem::canvas() const
+{
+    return mCanvas;
+}
+
+void TextureCanvasPaneItem::setCanvas(ImageCanvas *canvas)
+{
+    if (canvas == mCanvas)
+        return;
+
+    if (mCanvas)
+        disconnectFromCanvas();
+
+    mCanvas = canvas;
+
+    if (mCanvas)
+        connectToCanvas();
+
+    mAllDirty = true;
+    update();
+    emit canvasChanged();
+}
+
+CanvasPane *TextureCanvasPaneItem::pane() const
+{
+    return mPane;
+}
+
+void TextureCanvasPaneItem::setPane(CanvasPane *pane)
+{
+    if (pane == mPane)
+        return;
+
+    mPane = pane;
+    update();
+    emit paneChanged();
+}
+
+int TextureCanvasPaneItem::paneIndex() const
+{
+    return mPaneIndex;
+}
+
+void TextureCanvasPaneItem::setPaneIndex(int paneIndex)
+{
+    if (paneIndex == mPaneIndex)
+        return;
+
+    mPaneIndex = paneIndex;
+    update();
+    emit paneIndexChanged();
+}
+
+int TextureCanvasPaneItem::textureTileSize()
+{
+    return 256;
+}
+
+void TextureCanvasPaneItem::itemChange(QQuickItem::ItemChange change, const QQuickItem::ItemChangeData &value)
+{
+    if (change == ItemVisibleHasChanged && mCanvas) {
+        if (value.boolValue) {
+            connectToCanvas();
+            // We don't know what happened while we were hidden.
+            mAllDirty = true;
+            update();
+        } else {
+            disconnectFromCanvas();
+        }
+    }
+
+    QQuickItem::itemChange(change, value);
+}
+
+void TextureCanvasPaneItem::geometryChanged(const QRectF &newGeometry, const QRectF &oldGeometry)
+{
+    QQuickItem::geometryChanged(newGeometry, oldGeometry);
+    update();
+}
+
+void TextureCanvasPaneItem::connectToCanvas()
+{
+    connect(mCanvas, &ImageCanvas::contentPaintRequested,
+        this, &TextureCanvasPaneItem::onContentPaintRequested, Qt::UniqueConnection);
+}
+
+void TextureCanvasPaneItem::disconnectFromCanvas()
+{
+    mCanvas->disconnect(this);
+}
+
+void TextureCanvasPaneItem::onContentPaintRequested(int paneIndex, const QRect &sceneArea)
+{
+    // Only schedule a re-paint if we were the pane it was requested for.
+    if (paneIndex != -1 && paneIndex != mPaneIndex)
+        return;
+
+    if (sceneArea.isNull())
+        mAllDirty = true;
+    else
+        mDirtyRegion += sceneArea;
+
+    update();
+}
+
+QSGNode *TextureCanvasPaneItem::updatePaintNode(QSGNode *oldNode, QQuickItem::UpdatePaintNodeData *)
+{
+    if (!mCanvas || !mPane || !mCanvas->project() || !mCanvas->project()->hasLoaded()) {
+        delete oldNode;
+        return nullptr;
+    }
+
+    PaneNode *paneNode = static_cast<PaneNode*>(oldNode);
+    if (!paneNode)
+        paneNode = new PaneNode;
+
+    // Clip and translate in the same way that PaneDrawingHelper does when painting.
+    const QPoint translation = PaneDrawingHelper::paneTranslation(mCanvas, mPane, mPaneIndex);
+    const int paneWidth = mCanvas->width() * mPane->size();
+    const QRect paneRect(mPaneIndex == 0 ? 0 : translation.x() - mPane->integerOffset().x(), 0,
+        paneWidth, mCanvas->height());
+    if (paneNode->clipRect() != paneRect) {
+        paneNode->setClipRect(paneRect);
+        QSGGeometry::updateRectGeometry(paneNode->clipGeometry, paneRect);
+        paneNode->markDirty(QSGNode::DirtyGeometry);
+    }
+
+    QMatrix4x4 translateMatrix;
+    translateMatrix.translate(translation.x(), translation.y());
+    setMatrixIfChanged(paneNode->translateNode, translateMatrix);
+
+    const int zoomLevel = mPane->integerZoomLevel();
+    QMatrix4x4 zoomMatrix;
+    zoomMatrix.scale(zoomLevel, zoomLevel);
+    setMatrixIfChanged(paneNode->zoomNode, zoomMatrix);
+
+    // Draw the checkered texture that acts as an indicator for transparency.
+    // We use the unbounded canvas size here, otherwise the drawn area is too small past a certain zoom level.
+    // The pattern doesn't scale with the zoom level, so only the part of it that's in view is drawn.
+    const QImage &checkerImage = mCanvas->mCheckerImage;
+    const QSize zoomedCanvasSize = mPane->zoomedSize(mCanvas->currentProjectImage()->size());
+    const QRect checkerArea = QRect(QPoint(0, 0), zoomedCanvasSize) & paneRect.translated(-translation);
+    // The texture has an extra repetition of the pattern in each direction so that
+    // the part of it that we use can start at any offset within the pattern.
+    const QSize checkerTextureSize(
+        (paneRect.width() / checkerImage.width() + 2) * checkerImage.width(),
+        (paneRect.height() / checkerImage.height() + 2) * checkerImage.height());
+    if (checkerTextureSize != paneNode->checkerTextureSize || checkerImage.cacheKey() != paneNode->checkerImageCacheKey) {
+        QImage checkerTextureImage(checkerTextureSize, QImage::Format_ARGB32_Premultiplied);
+        QPainter painter(&checkerTextureImage);
+        painter.fillRect(checkerTextureImage.rect(), QBrush(checkerImage));
+        painter.end();
+
+        if (!paneNode->checkerNode->parent())
+            paneNode->translateNode->prependChildNode(paneNode->checkerNode);
+        paneNode->checkerNode->setTexture(window()->createTextureFromImage(checkerTextureImage));
+        paneNode->checkerTextureSize = checkerTextureSize;
+        paneNode->checkerImageCacheKey = checkerImage.cacheKey();
+    }
+    paneNode->checkerNode->setRect(checkerArea);
+    paneNode->checkerNode->setSourceRect(checkerArea.left() % checkerImage.width(),
+        checkerArea.top() % checkerImage.height(), checkerArea.width(), checkerArea.height());
+
+    const int uploadedTileCount = updateTileNodes(paneNode, window(), mCanvas->baseContentImage(), mDirtyRegion, mAllDirty);
+    if (uploadedTileCount > 0)
+        qCDebug(lcTextureCanvasPaneItem) << "uploaded" << uploadedTileCount << "of" << paneNode->tileNodes.size() << "tiles";
+
+    // Overlays are small and short-lived, so they're recreated each time.
+    while (QSGNode *overlayNode = paneNode->overlaysNode->firstChild())
+        delete overlayNode;
+
+    const QVector<ImageCanvas::ContentOverlay> overlays = mCanvas->contentOverlays();
+    for (const ImageCanvas::ContentOverlay &overlay : overlays) {
+        const QRect zoomedOverlayRect(overlay.sceneArea.topLeft() * zoomLevel, overlay.sceneArea.size() * zoomLevel);
+
+        // Overlays replace the content beneath them, so they need their own checkered background.
+        const QRect checkerRect = zoomedOverlayRect & checkerArea;
+        if (!checkerRect.isEmpty()) {
+            QSGSimpleTextureNode *overlayCheckerNode = new QSGSimpleTextureNode;
+            overlayCheckerNode->setFiltering(QSGTexture::Nearest);
+            overlayCheckerNode->setTexture(paneNode->checkerNode->texture());
+            overlayCheckerNode->setRect(checkerRect);
+            overlayCheckerNode->setSourceRect(checkerRect.left() % checkerImage.width(),
+                checkerRect.top() % checkerImage.height(), checkerRect.width(), checkerRect.height());
+            paneNode->overlaysNode->appendChildNode(overlayCheckerNode);
+        }
+
+        QSGSimpleTextureNode *overlayImageNode = new QSGSimpleTextureNode;
+        overlayImageNode->setOwnsTexture(true);
+        overlayImageNode->setFiltering(QSGTexture::Nearest);
+        overlayImageNode->setTexture(window()->createTextureFromImage(overlay.image));
+        overlayImageNode->setRect(zoomedOverlayRect);
+        paneNode->overlaysNode->appendChildNode(overlayImageNode);
+    }
+
+    mDirtyRegion = QRegion();
+    mAllDirty = false;
+    return paneNode;
+}
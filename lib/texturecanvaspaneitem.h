@@ -0,0 +1,87 @@
+/*
+    Copyright 2018, Mitch Curtis
+
+    This file is part of Slate.
+
+    Slate is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Slate is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Slate. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TEXTURECANVASPANEITEM_H
+#define TEXTURECANVASPANEITEM_H
+
+#include <QQuickItem>
+#include <QRegion>
+
+#include "slate-global.h"
+
+class CanvasPane;
+class ImageCanvas;
+
+/*
+    An alternative to CanvasPaneItem that renders through the scene graph.
+
+    The canvas image is kept as a grid of textures, and only the textures
+    that contain changed pixels are re-uploaded. Zooming and panning only
+    change the transform that the textures are drawn with.
+*/
+class SLATE_EXPORT TextureCanvasPaneItem : public QQuickItem
+{
+    Q_OBJECT
+    Q_PROPERTY(ImageCanvas *canvas READ canvas WRITE setCanvas NOTIFY canvasChanged)
+    Q_PROPERTY(CanvasPane *pane READ pane WRITE setPane NOTIFY paneChanged)
+    Q_PROPERTY(int paneIndex READ paneIndex WRITE setPaneIndex NOTIFY paneIndexChanged)
+
+public:
+    explicit TextureCanvasPaneItem(QQuickItem *parent = nullptr);
+    ~TextureCanvasPaneItem() override;
+
+    ImageCanvas *canvas() const;
+    void setCanvas(ImageCanvas *canvas);
+
+    CanvasPane *pane() const;
+    void setPane(CanvasPane *pane);
+
+    int paneIndex() const;
+    void setPaneIndex(int paneIndex);
+
+    static int textureTileSize();
+
+signals:
+    void canvasChanged();
+    void paneChanged();
+    void paneIndexChanged();
+
+protected:
+    QSGNode *updatePaintNode(QSGNode *oldNode, UpdatePaintNodeData *) override;
+    void itemChange(QQuickItem::ItemChange change, const QQuickItem::ItemChangeData &value) override;
+    void geometryChanged(const QRectF &newGeometry, const QRectF &oldGeometry) override;
+
+    void connectToCanvas();
+    void disconnectFromCanvas();
+
+protected slots:
+    void onContentPaintRequested(int paneIndex, const QRect &sceneArea);
+
+private:
+    ImageCanvas *mCanvas = nullptr;
+    CanvasPane *mPane = nullptr;
+    int mPaneIndex = -1;
+    // The area of the image (in scene coordinates) that has changed since the last time
+    // the textures were updated. Only used if the image itself has changed since then;
+    // repaints requested for other reasons (e.g. panning) don't cause any uploads.
+    QRegion mDirtyRegion;
+    bool mAllDirty = true;
+};
+
+#endif // TEXTURECANVASPANEITEM_H
@@ -26,9 +26,18 @@
 #include "project.h"
 #include "texturedfillparameters.h"
 
+// The same seed is used every time so that the preview doesn't flicker as it's regenerated.
+static const quint32 previewSeed = 0;
+
 TexturedFillPreviewItem::TexturedFillPreviewItem() :
     mCanvas(nullptr)
 {
+    const TexturedFillParameter *parameters[] = { mParameters.hue(), mParameters.saturation(), mParameters.lightness() };
+    for (const TexturedFillParameter *parameter : parameters) {
+        connect(parameter, &TexturedFillParameter::enabledChanged, this, &TexturedFillPreviewItem::invalidatePreviewImage);
+        connect(parameter, &TexturedFillParameter::varianceLowerBoundChanged, this, &TexturedFillPreviewItem::invalidatePreviewImage);
+        connect(parameter, &TexturedFillParameter::varianceUpperBoundChanged, this, &TexturedFillPreviewItem::invalidatePreviewImage);
+    }
 }
 
 void TexturedFillPreviewItem::paint(QPainter *painter)
@@ -36,21 +45,30 @@ void TexturedFillPreviewItem::paint(QPainter *painter)
     if (!mCanvas)
         return;
 
-    // Ensure that the target colour is not the same as the pen colour
-    // by inverting it.
-    QColor targetColour;
-    if (mCanvas->penForegroundColour() == QColor(Qt::black)) {
-        // Can't invert black, apparently.
-        targetColour = Qt::white;
-    } else {
-        targetColour = ImageCanvas::invertedColour(mCanvas->penForegroundColour());
-    }
+    const QSize size(int(width()), int(height()));
+    if (size.isEmpty())
+        return;
 
-    QImage image(width(), height(), QImage::Format_ARGB32_Premultiplied);
-    image.fill(targetColour);
-    image = texturedFill(&image, QPoint(0, 0), targetColour, mCanvas->penForegroundColour(), mParameters);
+    if (mPreviewImage.size() != size)
+        updatePreviewImage(size);
+
+    painter->drawImage(0, 0, mPreviewImage);
+}
+
+void TexturedFillPreviewItem::invalidatePreviewImage()
+{
+    mPreviewImage = QImage();
+    update();
+}
 
-    painter->drawImage(0, 0, image);
+void TexturedFillPreviewItem::updatePreviewImage(const QSize &size)
+{
+    // Every pixel would be filled anyway, so skip the flood fill and generate the spans directly.
+    mPreviewImage = QImage(size, QImage::Format_ARGB32_Premultiplied);
+    TexturedFillColourProvider fillColourProvider(mParameters, previewSeed);
+    fillColourProvider.begin(mCanvas->penForegroundColour(), mPreviewImage.format());
+    for (int y = 0; y < mPreviewImage.height(); ++y)
+        fillColourProvider.fillSpan(reinterpret_cast<QRgb*>(mPreviewImage.scanLine(y)), mPreviewImage.width());
 }
 
 ImageCanvas *TexturedFillPreviewItem::canvas() const
@@ -68,21 +86,10 @@ void TexturedFillPreviewItem::setCanvas(ImageCanvas *canvas)
 
     mCanvas = canvas;
 
-    if (mCanvas) {
-        connect(mParameters.hue(), &TexturedFillParameter::enabledChanged, [=]{ update(); });
-        connect(mParameters.hue(), &TexturedFillParameter::varianceLowerBoundChanged, [=]{ update(); });
-        connect(mParameters.hue(), &TexturedFillParameter::varianceUpperBoundChanged, [=]{ update(); });
-
-        connect(mParameters.saturation(), &TexturedFillParameter::enabledChanged, [=]{ update(); });
-        connect(mParameters.saturation(), &TexturedFillParameter::varianceLowerBoundChanged, [=]{ update(); });
-        connect(mParameters.saturation(), &TexturedFillParameter::varianceUpperBoundChanged, [=]{ update(); });
-
-        connect(mParameters.lightness(), &TexturedFillParameter::enabledChanged, [=]{ update(); });
-        connect(mParameters.lightness(), &TexturedFillParameter::varianceLowerBoundChanged, [=]{ update(); });
-        connect(mParameters.lightness(), &TexturedFillParameter::varianceUpperBoundChanged, [=]{ update(); });
-    }
+    if (mCanvas)
+        connect(mCanvas, &ImageCanvas::penForegroundColourChanged, this, &TexturedFillPreviewItem::invalidatePreviewImage);
 
-    update();
+    invalidatePreviewImage();
 
     emit canvasChanged();
 }
@@ -20,6 +20,7 @@
 #ifndef TEXTUREDFILLPREVIEWITEM_H
 #define TEXTUREDFILLPREVIEWITEM_H
 
+#include <QImage>
 #include <QQuickPaintedItem>
 
 #include "slate-global.h"
@@ -46,9 +47,16 @@ public:
 signals:
     void canvasChanged();
 
+private slots:
+    void invalidatePreviewImage();
+
 private:
+    void updatePreviewImage(const QSize &size);
+
     ImageCanvas *mCanvas;
     TexturedFillParameters mParameters;
+    // Only regenerated when the parameters, pen colour or size change, rather than on every paint.
+    QImage mPreviewImage;
 };
 
 #endif // TEXTUREDFILLPREVIEWITEM_H
@@ -228,9 +228,11 @@ bool TileCanvas::supportsSelectionTool() const
     return false;
 }
 
-TileCanvas::PixelCandidateData TileCanvas::penEraserPixelCandidates(Tool tool) const
+PixelSpans TileCanvas::penEraserPixelCandidates(Tool tool) const
 {
-    PixelCandidateData candidateData;
+    // Neighbouring scene pixels can belong to different tiles, so unlike ImageCanvas,
+    // each pixel is looked up separately. Consecutive pixels are still merged into spans.
+    PixelSpans candidates;
 
     const QPoint topLeft(qRound(mCursorSceneFX - mToolSize / 2.0), qRound(mCursorSceneFY - mToolSize / 2.0));
     const QPoint bottomRight(qRound(mCursorSceneFX + mToolSize / 2.0), qRound(mCursorSceneFY + mToolSize / 2.0));
@@ -245,49 +247,56 @@ TileCanvas::PixelCandidateData TileCanvas::penEraserPixelCandidates(Tool tool) c
                 // with undos not undoing everything across tiles.
                 const bool hasEffect = tool == PenTool ? penColour() != previousColour : previousColour != QColor(Qt::transparent);
                 if (hasEffect) {
-                    candidateData.scenePositions.append(scenePos);
-                    candidateData.previousColours.append(previousColour);
+                    const QRgb previousRgba = previousColour.rgba();
+                    candidates.append(scenePos.y(), scenePos.x(), &previousRgba, 1);
                 }
             }
         }
     }
 
-    return candidateData;
+    return candidates;
 }
 
-TileCanvas::PixelCandidateData TileCanvas::fillPixelCandidates() const
+TileCanvas::PixelFillCandidateData TileCanvas::fillPixelCandidates() const
 {
-    PixelCandidateData candidateData;
+    PixelFillCandidateData candidateData;
 
-    const QPoint tilePos = QPoint(mCursorSceneX, mCursorSceneY);
-    Tile *tile = mTilesetProject->tileAt(tilePos);
+    const QPoint scenePos = QPoint(mCursorSceneX, mCursorSceneY);
+    const Tile *tile = mTilesetProject->tileAt(scenePos);
     if (!tile) {
         return candidateData;
     }
 
-    const QPoint tilePixelPos = scenePosToTilePixelPos(tilePos);
-    const QPoint tileTopLeftScenePos = tilePos - tilePixelPos;
+    const QPoint tilePixelPos = scenePosToTilePixelPos(scenePos);
     const QColor previousColour = tile->pixelColor(tilePixelPos);
     // Don't do anything if the colours are the same.
     if (previousColour == penColour()) {
         return candidateData;
     }
 
-    QVector<QPoint> tilePixelPositions;
-    tilesetPixelFloodFill(tile, tilePixelPos, previousColour, penColour(), tilePixelPositions);
-
-    for (const QPoint &pixelPos : tilePixelPositions) {
-        candidateData.scenePositions.append(tileTopLeftScenePos + pixelPos);
-    }
-
-    candidateData.previousColours.append(previousColour);
+    candidateData.mask = tilesetPixelFloodFill(tile, tilePixelPos, previousColour);
+    candidateData.previousColour = previousColour;
     return candidateData;
 }
 
-ImageCanvas::PixelCandidateData TileCanvas::greedyFillPixelCandidates() const
+TileCanvas::PixelFillCandidateData TileCanvas::greedyFillPixelCandidates() const
 {
-    // TODO
-    return PixelCandidateData();
+    PixelFillCandidateData candidateData;
+
+    const QPoint scenePos = QPoint(mCursorSceneX, mCursorSceneY);
+    const Tile *tile = mTilesetProject->tileAt(scenePos);
+    if (!tile) {
+        return candidateData;
+    }
+
+    const QColor previousColour = tile->pixelColor(scenePosToTilePixelPos(scenePos));
+    if (previousColour == penColour()) {
+        return candidateData;
+    }
+
+    candidateData.mask = tilesetGreedyPixelFill(tile, previousColour);
+    candidateData.previousColour = previousColour;
+    return candidateData;
 }
 
 TileCanvas::TileCandidateData TileCanvas::fillTileCandidates() const
@@ -305,7 +314,7 @@ TileCanvas::TileCandidateData TileCanvas::fillTileCandidates() const
 
     const int xTile = scenePos.x() / mTilesetProject->tileWidth();
     const int yTile = scenePos.y() / mTilesetProject->tileHeight();
-    tilesetTileFloodFill(mTilesetProject, tile, QPoint(xTile, yTile), previousTileId, newTileId, candidateData.tilePositions);
+    candidateData.tileRuns = tilesetTileFloodFill(mTilesetProject, QPoint(xTile, yTile), previousTileId, newTileId);
 
     candidateData.previousTile = previousTileId;
     candidateData.newTileId = newTileId;
@@ -317,13 +326,13 @@ void TileCanvas::applyCurrentTool()
     switch (mTool) {
     case PenTool: {
         if (mMode == PixelMode) {
-//            const PixelCandidateData candidateData = penEraserPixelCandidates(mTool);
-//            if (candidateData.scenePositions.isEmpty()) {
+//            const PixelSpans candidates = penEraserPixelCandidates(mTool);
+//            if (candidates.isEmpty()) {
 //                return;
 //            }
 
 //            mTilesetProject->beginMacro(QLatin1String("PixelPenTool"));
-//            mTilesetProject->addChange(new ApplyPixelPenCommand(this, -1, candidateData.scenePositions, candidateData.previousColours, penColour()));
+//            mTilesetProject->addChange(new ApplyPixelPenCommand(this, -1, candidates, penColour()));
             mProject->beginMacro(QLatin1String("PixelLineTool"));
             // Draw the line on top of what has already been painted using a special composition mode.
             // This ensures that e.g. a translucent red overwrites whatever pixels it
@@ -362,13 +371,13 @@ void TileCanvas::applyCurrentTool()
     }
     case EraserTool: {
         if (mMode == PixelMode) {
-            const PixelCandidateData candidateData = penEraserPixelCandidates(mTool);
-            if (candidateData.scenePositions.isEmpty()) {
+            const PixelSpans candidates = penEraserPixelCandidates(mTool);
+            if (candidates.isEmpty()) {
                 return;
             }
 
             mTilesetProject->beginMacro(QLatin1String("PixelEraserTool"));
-            mTilesetProject->addChange(new ApplyPixelEraserCommand(this, -1, candidateData.scenePositions, candidateData.previousColours));
+            mTilesetProject->addChange(new ApplyPixelEraserCommand(this, -1, candidates));
         } else {
             const QPoint scenePos = QPoint(mCursorSceneX, mCursorSceneY);
             const Tile *tile = mTilesetProject->tileAt(scenePos);
@@ -386,22 +395,24 @@ void TileCanvas::applyCurrentTool()
     }
     case FillTool: {
         if (mMode == PixelMode) {
-            const PixelCandidateData candidateData = fillPixelCandidates();
-            if (candidateData.scenePositions.isEmpty()) {
+            const PixelFillCandidateData candidateData = !mShiftPressed
+                ? fillPixelCandidates() : greedyFillPixelCandidates();
+            if (candidateData.mask.isEmpty()) {
                 return;
             }
 
-            mTilesetProject->beginMacro(QLatin1String("PixelFillTool"));
-            mTilesetProject->addChange(new ApplyTileCanvasPixelFillCommand(this, candidateData.scenePositions,
-                candidateData.previousColours.first(), penColour()));
+            mTilesetProject->beginMacro(!mShiftPressed
+                ? QLatin1String("PixelFillTool") : QLatin1String("GreedyPixelFillTool"));
+            mTilesetProject->addChange(new ApplyTileCanvasPixelFillCommand(this, candidateData.mask,
+                candidateData.previousColour, penColour()));
         } else {
             const TileCandidateData candidateData = fillTileCandidates();
-            if (candidateData.tilePositions.isEmpty()) {
+            if (candidateData.tileRuns.isEmpty()) {
                 return;
             }
 
             mTilesetProject->beginMacro(QLatin1String("TileFillTool"));
-            mTilesetProject->addChange(new ApplyTileFillCommand(this, candidateData.tilePositions,
+            mTilesetProject->addChange(new ApplyTileFillCommand(this, candidateData.tileRuns,
                 candidateData.previousTile, candidateData.newTileId));
         }
         break;
@@ -452,12 +463,55 @@ void TileCanvas::applyPixelPenTool(int layerIndex, const QPoint &scenePos, const
     if (markAsLastRelease)
         mLastPixelPenPressScenePosition = scenePos;
     requestContentPaint();
+    emit contentChanged(QRect());
+}
+
+void TileCanvas::applyPixelSpans(int layerIndex, const PixelSpans &spans, const QColor &colour, bool markAsLastRelease)
+{
+    for (const PixelSpans::Span &span : spans.spans()) {
+        for (int x = span.x; x < span.x + span.length; ++x)
+            applyPixelPenTool(layerIndex, QPoint(x, span.y), colour);
+    }
+    if (markAsLastRelease && !spans.isEmpty())
+        mLastPixelPenPressScenePosition = spans.lastPosition();
+}
+
+void TileCanvas::restorePixelSpans(int layerIndex, const PixelSpans &spans, bool markAsLastRelease)
+{
+    const QVector<PixelSpans::Span> &spanList = spans.spans();
+    for (auto it = spanList.crbegin(); it != spanList.crend(); ++it) {
+        const QRgb *colours = spans.colours(*it);
+        for (int i = it->length - 1; i >= 0; --i)
+            applyPixelPenTool(layerIndex, QPoint(it->x + i, it->y), QColor::fromRgba(colours[i]));
+    }
+    if (markAsLastRelease && !spans.isEmpty())
+        mLastPixelPenPressScenePosition = spans.lastPosition();
 }
 
 void TileCanvas::applyTilePenTool(const QPoint &tilePos, int id)
 {
     mTilesetProject->setTileAtPixelPos(tilePos, id);
     requestContentPaint();
+    emit contentChanged(QRect());
+}
+
+void TileCanvas::applyPixelFillTool(const FillMask &mask, const QColor &colour)
+{
+    Tileset *tileset = mTilesetProject->tileset();
+    applyFillMask(tileset->image(), mask, colour);
+    tileset->notifyImageChanged(mask.dirtyRect());
+    requestContentPaint();
+    emit contentChanged(QRect());
+}
+
+void TileCanvas::applyTileFillTool(const QVector<TileFillRun> &tileRuns, int id)
+{
+    for (const TileFillRun &run : tileRuns) {
+        for (int x = run.x; x < run.x + run.length; ++x)
+            mTilesetProject->setTileAtPixelPos(QPoint(x, run.y), id);
+    }
+    requestContentPaint();
+    emit contentChanged(QRect());
 }
 
 void TileCanvas::applyPixelLineTool(int, const QImage &lineImage, const QRect &lineRect, const QPointF &lastPixelPenReleaseScenePosition)
@@ -467,7 +521,8 @@ void TileCanvas::applyPixelLineTool(int, const QImage &lineImage, const QRect &l
     painter.setCompositionMode(QPainter::CompositionMode_Source);
     painter.drawImage(lineRect, lineImage);
     requestContentPaint();
-    mTilesetProject->tileset()->notifyImageChanged();
+    emit contentChanged(QRect());
+    mTilesetProject->tileset()->notifyImageChanged(lineRect);
 }
 
 void TileCanvas::updateCursorPos(const QPoint &eventPos)
@@ -28,6 +28,7 @@
 
 #include <QUndoStack>
 
+#include "fillalgorithms.h"
 #include "imagecanvas.h"
 #include "slate-global.h"
 
@@ -106,13 +107,20 @@ private:
     friend class ApplyTileFillCommand;
     friend class ApplyTileCanvasPixelFillCommand;
 
-    PixelCandidateData penEraserPixelCandidates(Tool tool) const override;
-    PixelCandidateData fillPixelCandidates() const;
-    PixelCandidateData greedyFillPixelCandidates() const;
+    PixelSpans penEraserPixelCandidates(Tool tool) const override;
+
+    struct PixelFillCandidateData
+    {
+        // In tileset image coordinates.
+        FillMask mask;
+        QColor previousColour;
+    };
+    PixelFillCandidateData fillPixelCandidates() const;
+    PixelFillCandidateData greedyFillPixelCandidates() const;
 
     struct TileCandidateData
     {
-        QVector<QPoint> tilePositions;
+        QVector<TileFillRun> tileRuns;
         int previousTile;
         int newTileId;
 
@@ -122,7 +130,11 @@ private:
 
     void applyCurrentTool() override;
     void applyPixelPenTool(int layerIndex, const QPoint &scenePos, const QColor &colour, bool markAsLastRelease = false) override;
+    void applyPixelSpans(int layerIndex, const PixelSpans &spans, const QColor &colour, bool markAsLastRelease = false) override;
+    void restorePixelSpans(int layerIndex, const PixelSpans &spans, bool markAsLastRelease = false) override;
     void applyTilePenTool(const QPoint &tilePos, int id);
+    void applyTileFillTool(const QVector<TileFillRun> &tileRuns, int id);
+    void applyPixelFillTool(const FillMask &mask, const QColor &colour);
     void applyPixelLineTool(int layerIndex, const QImage &lineImage, const QRect &lineRect, const QPointF &lastPixelPenReleaseScenePosition) override;
 
     void updateCursorPos(const QPoint &eventPos) override;
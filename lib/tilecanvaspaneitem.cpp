@@ -25,6 +25,7 @@
 #include "tilesetproject.h"
 
 #include <QPainter>
+#include <QtMath>
 
 /*
     This class is a purely visual respresentation of a canvas pane;
@@ -55,59 +56,90 @@ void TileCanvasPaneItem::paint(QPainter *painter)
     Q_ASSERT(tilesetProject);
 
     const QSize zoomedTileSize = mPane->zoomedSize(tilesetProject->tileSize());
-    // Try to only draw as much as could possibly fit within the pane.
-//    const int horizontalStartTile = pane.offset().x() < 0 ? qFloor(qAbs(pane.offset().x()) / zoomedTileSize.width()) : 0;
-//    const int verticalStartTile = pane.offset().y() < 0 ? qFloor(qAbs(pane.offset().y()) / zoomedTileSize.height()) : 0;
-    const int tilesAcross = tilesetProject->tilesWide();//qMin(mProject->tilesWide(), qCeil(paneWidth / zoomedTileSize.width()) + 1);
-    const int tilesDown = tilesetProject->tilesHigh();//qMin(mProject->tilesHigh(), qCeil(height() / zoomedTileSize.width()) + 1);
+    const int tileWidth = tilesetProject->tileWidth();
+    const int tileHeight = tilesetProject->tileHeight();
+
+    // Only draw the tiles that are within the pane.
+    const QRect visibleTiles = visibleTileArea();
+    if (visibleTiles.isEmpty()) {
+        tilesetProject->setVisibleChunks(mPaneIndex, QRect());
+        return;
+    }
+
+    const int firstTileX = visibleTiles.left();
+    const int firstTileY = visibleTiles.top();
+    const int lastTileX = visibleTiles.right();
+    const int lastTileY = visibleTiles.bottom();
+
+    const QRect zoomedVisibleTilesRect(firstTileX * zoomedTileSize.width(), firstTileY * zoomedTileSize.height(),
+        (lastTileX - firstTileX + 1) * zoomedTileSize.width(), (lastTileY - firstTileY + 1) * zoomedTileSize.height());
 
     // Draw the checkered pixmap that acts as an indicator for transparency.
-    // We use the unbounded canvas size here, otherwise the drawn area is too small past a certain zoom level.
-    painter->drawTiledPixmap(0, 0, zoomedTileSize.width() * tilesAcross, zoomedTileSize.height() * tilesDown, mCanvas->mCheckerPixmap);
+    // The pattern is offset so that it lines up with where it would be if the whole map was drawn.
+    const QPixmap &checkerPixmap = mCanvas->mCheckerPixmap;
+    painter->drawTiledPixmap(zoomedVisibleTilesRect, checkerPixmap,
+        QPoint(zoomedVisibleTilesRect.x() % checkerPixmap.width(), zoomedVisibleTilesRect.y() % checkerPixmap.height()));
+
+    // Draw the tiles from pre-rendered chunks, which is much cheaper than drawing each tile
+    // when lots of them are visible.
+    const int chunkSize = tilesetProject->chunkSizeInTiles();
+    const QRect visibleChunks(QPoint(firstTileX / chunkSize, firstTileY / chunkSize),
+        QPoint(lastTileX / chunkSize, lastTileY / chunkSize));
+    // If the visible chunks don't all fit in the cache, they'd be rendered again on every paint.
+    tilesetProject->setVisibleChunks(mPaneIndex, visibleChunks);
+    for (int chunkY = visibleChunks.top(); chunkY <= visibleChunks.bottom(); ++chunkY) {
+        for (int chunkX = visibleChunks.left(); chunkX <= visibleChunks.right(); ++chunkX) {
+            const QImage chunkImage = tilesetProject->chunkImage(QPoint(chunkX, chunkY));
+            const QPoint zoomedTopLeft(chunkX * chunkSize * zoomedTileSize.width(), chunkY * chunkSize * zoomedTileSize.height());
+            painter->drawImage(QRect(zoomedTopLeft, mPane->zoomedSize(chunkImage.size())), chunkImage);
+        }
+    }
 
-    for (int y = 0; y < tilesDown; ++y) {
-        for (int x = 0; x < tilesAcross; ++x) {
-            const QPoint topLeftInScene(x * tilesetProject->tileWidth(), y * tilesetProject->tileHeight());
-            const QRect rect(x * zoomedTileSize.width(), y * zoomedTileSize.height(),
+    // If the tile pen is in use, draw the tile that it would place over the tile under the cursor.
+    if (tileCanvas->mTilePenPreview) {
+        const QPoint cursorScenePos(tileCanvas->cursorSceneX(), tileCanvas->cursorSceneY());
+        const QPoint cursorTilePos(cursorScenePos.x() / tileWidth, cursorScenePos.y() / tileHeight);
+        if (cursorScenePos.x() >= 0 && cursorScenePos.y() >= 0 && tilesetProject->isTilePosWithinBounds(cursorTilePos)) {
+            const QRect rect(cursorTilePos.x() * zoomedTileSize.width(), cursorTilePos.y() * zoomedTileSize.height(),
                 zoomedTileSize.width(), zoomedTileSize.height());
+            // The tile in the chunk is replaced rather than drawn over.
+            painter->drawTiledPixmap(rect, checkerPixmap,
+                QPoint(rect.x() % checkerPixmap.width(), rect.y() % checkerPixmap.height()));
+            painter->drawImage(rect, *tileCanvas->mPenTile->tileset()->image(), tileCanvas->mPenTile->sourceRect());
+        }
+    }
 
-            // If the tile pen is in use and it's over this tile, draw it, otherwise draw the current tile
-            // at that location as usual.
-            bool previewTile = false;
-            if (tileCanvas->mTilePenPreview) {
-                QRect tileSceneRect(topLeftInScene.x(), topLeftInScene.y(), tilesetProject->tileWidth(), tilesetProject->tileHeight());
-                previewTile = tileSceneRect.contains(tileCanvas->cursorSceneX(), tileCanvas->cursorSceneY());
-            }
-
-            if (previewTile) {
-                painter->drawImage(rect, *tileCanvas->mPenTile->tileset()->image(), tileCanvas->mPenTile->sourceRect());
-            } else {
-                const Tile *tile = tilesetProject->tileAt(topLeftInScene);
-                if (tile) {
-                    painter->drawImage(rect, *tile->tileset()->image(), tile->sourceRect());
-                }
-            }
-
-            if (tileCanvas->mGridVisible) {
-                QPen pen(tileCanvas->mGridColour);
-                painter->setPen(pen);
-
-                painter->drawLine(rect.x(), rect.y(), rect.x(), rect.y() + rect.height() - 1);
-
-                if (x == tilesAcross - 1) {
-                    // If this is the right-most edge tile, draw a line on the outside of it.
-                    painter->drawLine(rect.x() + zoomedTileSize.width(), rect.y(),
-                        rect.x() + zoomedTileSize.width(), rect.y() + rect.height() - 1);
-                }
-
-                painter->drawLine(rect.x() + 1, rect.y(), rect.x() + rect.width() - 1, rect.y());
-
-                if (y == tilesDown - 1) {
-                    // If this is the bottom-most edge tile, draw a line on the outside of it.
-                    painter->drawLine(rect.x(), rect.y() + zoomedTileSize.height(),
-                        rect.x() + rect.width(), rect.y() + zoomedTileSize.width());
-                }
-            }
+    if (tileCanvas->mGridVisible) {
+        // Draw each grid line across all of the visible tiles at once. The lines are filled as one path
+        // so that the pixels where they cross aren't drawn twice, as the grid colour is translucent.
+        QPainterPath gridPath;
+        gridPath.setFillRule(Qt::WindingFill);
+        for (int x = firstTileX; x <= lastTileX + 1; ++x) {
+            gridPath.addRect(x * zoomedTileSize.width(), zoomedVisibleTilesRect.y(),
+                1, zoomedVisibleTilesRect.height() + 1);
+        }
+        for (int y = firstTileY; y <= lastTileY + 1; ++y) {
+            gridPath.addRect(zoomedVisibleTilesRect.x(), y * zoomedTileSize.height(),
+                zoomedVisibleTilesRect.width() + 1, 1);
         }
+        painter->fillPath(gridPath, tileCanvas->mGridColour);
     }
 }
+
+QRect TileCanvasPaneItem::visibleTileArea() const
+{
+    const TilesetProject *tilesetProject = qobject_cast<TilesetProject*>(mCanvas->project());
+    if (!tilesetProject || !tilesetProject->hasLoaded())
+        return QRect();
+
+    // This is worked out in zoomed pixels rather than from the pane's visible scene area,
+    // as that is rounded down and so would miss partially visible tiles at the right and bottom.
+    const QSize zoomedTileSize = mPane->zoomedSize(tilesetProject->tileSize());
+    const QPoint zoomedTopLeft = -mPane->integerOffset();
+    const QPoint zoomedBottomRight = zoomedTopLeft + QPoint(mCanvas->paneWidth(mPaneIndex), mCanvas->height());
+    const int firstTileX = qMax(0, qFloor(qreal(zoomedTopLeft.x()) / zoomedTileSize.width()));
+    const int firstTileY = qMax(0, qFloor(qreal(zoomedTopLeft.y()) / zoomedTileSize.height()));
+    const int lastTileX = qMin(tilesetProject->tilesWide() - 1, qCeil(qreal(zoomedBottomRight.x()) / zoomedTileSize.width()) - 1);
+    const int lastTileY = qMin(tilesetProject->tilesHigh() - 1, qCeil(qreal(zoomedBottomRight.y()) / zoomedTileSize.height()) - 1);
+    return QRect(QPoint(firstTileX, firstTileY), QPoint(lastTileX, lastTileY));
+}
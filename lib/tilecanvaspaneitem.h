@@ -32,6 +32,10 @@ public:
     ~TileCanvasPaneItem() override;
 
     void paint(QPainter *painter) override;
+
+    // Returns the tiles (in tile coordinates) that are at least partially
+    // within the pane, and hence are drawn. Public for auto test access.
+    QRect visibleTileArea() const;
 };
 
 #endif
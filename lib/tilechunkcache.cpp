@@ -0,0 +1,172 @@
+/*
+    Copyright 2018, Mitch Curtis
+
+    This file is part of Slate.
+
+    Slate is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Slate is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Slate. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "tilechunkcache.h"
+
+#include <QLoggingCategory>
+
+#include <limits>
+
+Q_LOGGING_CATEGORY(lcTileChunkCache, "app.tileChunkCache")
+
+TileChunkCache::TileChunkCache(int chunkSizeInTiles, int defaultCapacityInBytes) :
+    mChunkSizeInTiles(chunkSizeInTiles),
+    mTilesWide(0),
+    mTilesHigh(0),
+    mChunksWide(0),
+    mChunksHigh(0),
+    mDefaultCapacityInBytes(defaultCapacityInBytes),
+    // Chunks that aren't in view are thrown away once this is exceeded,
+    // which can happen when panning around very large maps.
+    mChunkImages(defaultCapacityInBytes)
+{
+    Q_ASSERT(mChunkSizeInTiles > 0);
+}
+
+int TileChunkCache::chunkSizeInTiles() const
+{
+    return mChunkSizeInTiles;
+}
+
+int TileChunkCache::chunksWide() const
+{
+    return mChunksWide;
+}
+
+int TileChunkCache::chunksHigh() const
+{
+    return mChunksHigh;
+}
+
+void TileChunkCache::reset(int tilesWide, int tilesHigh, const QVector<int> &tiles)
+{
+    Q_ASSERT(tiles.size() == tilesWide * tilesHigh);
+
+    mTilesWide = tilesWide;
+    mTilesHigh = tilesHigh;
+    mChunksWide = (tilesWide + mChunkSizeInTiles - 1) / mChunkSizeInTiles;
+    mChunksHigh = (tilesHigh + mChunkSizeInTiles - 1) / mChunkSizeInTiles;
+    mChunkImages.clear();
+
+    mCellsUsingTile.clear();
+    for (int cellIndex = 0; cellIndex < tiles.size(); ++cellIndex) {
+        const int tileId = tiles.at(cellIndex);
+        if (tileId != -1)
+            mCellsUsingTile[tileId].insert(cellIndex);
+    }
+
+    qCDebug(lcTileChunkCache) << "reset to" << mChunksWide << "x" << mChunksHigh << "chunks with"
+        << mCellsUsingTile.size() << "unique tiles";
+}
+
+void TileChunkCache::cellChanged(int cellIndex, int oldTileId, int newTileId)
+{
+    if (newTileId == oldTileId)
+        return;
+
+    if (oldTileId != -1) {
+        auto it = mCellsUsingTile.find(oldTileId);
+        if (it != mCellsUsingTile.end()) {
+            it.value().remove(cellIndex);
+            if (it.value().isEmpty())
+                mCellsUsingTile.erase(it);
+        }
+    }
+
+    if (newTileId != -1)
+        mCellsUsingTile[newTileId].insert(cellIndex);
+
+    mChunkImages.remove(chunkIndexForCell(cellIndex));
+}
+
+void TileChunkCache::tileImageChanged(int tileId)
+{
+    const auto it = mCellsUsingTile.constFind(tileId);
+    if (it == mCellsUsingTile.constEnd())
+        return;
+
+    for (const int cellIndex : it.value())
+        mChunkImages.remove(chunkIndexForCell(cellIndex));
+}
+
+void TileChunkCache::invalidateAll()
+{
+    mChunkImages.clear();
+}
+
+QImage TileChunkCache::chunkImage(const QPoint &chunkPos)
+{
+    const QImage *image = mChunkImages.object(chunkPos.y() * mChunksWide + chunkPos.x());
+    return image ? *image : QImage();
+}
+
+void TileChunkCache::insertChunkImage(const QPoint &chunkPos, const QImage &image)
+{
+    mChunkImages.insert(chunkPos.y() * mChunksWide + chunkPos.x(), new QImage(image), image.sizeInBytes());
+}
+
+QRect TileChunkCache::chunkTileRect(const QPoint &chunkPos) const
+{
+    return QRect(chunkPos.x() * mChunkSizeInTiles, chunkPos.y() * mChunkSizeInTiles,
+        mChunkSizeInTiles, mChunkSizeInTiles) & QRect(0, 0, mTilesWide, mTilesHigh);
+}
+
+void TileChunkCache::setVisibleChunkBytes(int viewIndex, qint64 bytes)
+{
+    if (mVisibleChunkBytes.value(viewIndex, -1) == bytes)
+        return;
+
+    mVisibleChunkBytes.insert(viewIndex, bytes);
+
+    qint64 totalVisibleChunkBytes = 0;
+    for (const qint64 viewBytes : qAsConst(mVisibleChunkBytes))
+        totalVisibleChunkBytes += viewBytes;
+
+    // QCache can't hold more than INT_MAX bytes, in which case some chunks
+    // will have to be rendered on every paint.
+    const int capacity = int(qBound<qint64>(mDefaultCapacityInBytes, totalVisibleChunkBytes,
+        std::numeric_limits<int>::max()));
+    if (capacity == mChunkImages.maxCost())
+        return;
+
+    qCDebug(lcTileChunkCache) << "changing capacity from" << mChunkImages.maxCost() << "to" << capacity << "bytes";
+    mChunkImages.setMaxCost(capacity);
+}
+
+int TileChunkCache::capacityInBytes() const
+{
+    return mChunkImages.maxCost();
+}
+
+QSet<int> TileChunkCache::cellsUsingTile(int tileId) const
+{
+    return mCellsUsingTile.value(tileId);
+}
+
+int TileChunkCache::cachedChunkCount() const
+{
+    return mChunkImages.count();
+}
+
+int TileChunkCache::chunkIndexForCell(int cellIndex) const
+{
+    const int chunkX = (cellIndex % mTilesWide) / mChunkSizeInTiles;
+    const int chunkY = (cellIndex / mTilesWide) / mChunkSizeInTiles;
+    return chunkY * mChunksWide + chunkX;
+}
@@ -0,0 +1,88 @@
+/*
+    Copyright 2018, Mitch Curtis
+
+    This file is part of Slate.
+
+    Slate is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Slate is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Slate. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TILECHUNKCACHE_H
+#define TILECHUNKCACHE_H
+
+#include <QCache>
+#include <QHash>
+#include <QImage>
+#include <QPoint>
+#include <QRect>
+#include <QSet>
+#include <QVector>
+
+#include "slate-global.h"
+
+// Caches pre-rendered images of square chunks of a tile map, so that large maps
+// can be drawn with a few images instead of one image per tile.
+//
+// A reverse index from each tile id to the cells that use it is kept so that
+// changing the image of a tile only invalidates the chunks that contain it.
+class SLATE_EXPORT TileChunkCache
+{
+public:
+    explicit TileChunkCache(int chunkSizeInTiles = 16, int defaultCapacityInBytes = 64 * 1024 * 1024);
+
+    int chunkSizeInTiles() const;
+    int chunksWide() const;
+    int chunksHigh() const;
+
+    // Throws away every chunk and rebuilds the index. tiles contains the
+    // id of the tile in each cell of a map that is tilesWide x tilesHigh.
+    void reset(int tilesWide, int tilesHigh, const QVector<int> &tiles);
+
+    // Should be called when the cell at cellIndex changes from oldTileId to newTileId.
+    void cellChanged(int cellIndex, int oldTileId, int newTileId);
+    // Should be called when the image of the tile with the given id changes.
+    void tileImageChanged(int tileId);
+    void invalidateAll();
+
+    // Returns the image for the chunk at chunkPos (in chunks), or a null
+    // image if it hasn't been rendered since it was last invalidated.
+    QImage chunkImage(const QPoint &chunkPos);
+    void insertChunkImage(const QPoint &chunkPos, const QImage &image);
+    // Returns the area (in tiles) that the chunk at chunkPos covers.
+    QRect chunkTileRect(const QPoint &chunkPos) const;
+
+    // Should be called with the size of the chunks that the view with the given
+    // index is about to draw. The capacity grows to fit every view's chunks, so that
+    // zooming out on a large map doesn't evict chunks that are still visible.
+    void setVisibleChunkBytes(int viewIndex, qint64 bytes);
+    int capacityInBytes() const;
+
+    QSet<int> cellsUsingTile(int tileId) const;
+    int cachedChunkCount() const;
+
+private:
+    int chunkIndexForCell(int cellIndex) const;
+
+    int mChunkSizeInTiles;
+    int mTilesWide;
+    int mTilesHigh;
+    int mChunksWide;
+    int mChunksHigh;
+    int mDefaultCapacityInBytes;
+    QHash<int, qint64> mVisibleChunkBytes;
+    // The cost of each chunk is its size in bytes.
+    QCache<int, QImage> mChunkImages;
+    QHash<int, QSet<int>> mCellsUsingTile;
+};
+
+#endif // TILECHUNKCACHE_H
@@ -64,7 +64,7 @@ QImage *Tileset::image()
 void Tileset::setPixelColor(int x, int y, const QColor &colour)
 {
     mImage.setPixelColor(x, y, colour);
-    emit imageChanged();
+    notifyImageChanged(QRect(x, y, 1, 1));
 }
 
 void Tileset::copy(const QPoint &sourceTopLeft, const QPoint &targetTopLeft)
@@ -82,7 +82,7 @@ void Tileset::copy(const QPoint &sourceTopLeft, const QPoint &targetTopLeft)
             mImage.setPixelColor(targetTopLeft.x() + x, targetTopLeft.y() + y, sourceColour);
         }
     }
-    emit imageChanged();
+    notifyImageChanged(QRect(targetTopLeft, QSize(tileW, tileH)));
 }
 
 void Tileset::rotateCounterClockwise(const QPoint &tileTopLeft)
@@ -108,8 +108,9 @@ int Tileset::tilesHigh() const
 // It's easier to just allow calling code to modify the tileset image through
 // the pointer (e.g. by painting with QPainter) and then call this than force
 // them to use setPixelColour().
-void Tileset::notifyImageChanged()
+void Tileset::notifyImageChanged(const QRect &area)
 {
+    emit imageAreaChanged(area);
     emit imageChanged();
 }
 
@@ -158,5 +159,5 @@ void Tileset::rotate(const QPoint &tileTopLeft, int angle)
         }
     }
     painter.drawImage(tileTopLeft, rotatedImage);
-    emit imageChanged();
+    notifyImageChanged(QRect(tileTopLeft, tileImage.size()) | QRect(tileTopLeft, rotatedImage.size()));
 }
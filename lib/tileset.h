@@ -23,6 +23,7 @@
 #include <QObject>
 #include <QString>
 #include <QImage>
+#include <QRect>
 
 #include "slate-global.h"
 
@@ -47,12 +48,15 @@ public:
     int tilesWide() const;
     int tilesHigh() const;
 
-    void notifyImageChanged();
+    // area is in image coordinates; a null area means that the whole image may have changed.
+    void notifyImageChanged(const QRect &area = QRect());
 
 public slots:
 
 signals:
     void imageChanged();
+    // Emitted before imageChanged() with the area that changed, or a null area if it's not known.
+    void imageAreaChanged(const QRect &area);
 
 private:
     int tileWidth() const;
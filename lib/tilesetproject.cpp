@@ -26,6 +26,7 @@
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QLoggingCategory>
+#include <QPainter>
 #include <QUndoStack>
 
 #include "changetilecanvassizecommand.h"
@@ -123,6 +124,7 @@ void TilesetProject::createNew(QUrl tilesetUrl, int tileWidth, int tileHeight,
 
     mTiles.clear();
     mTiles.fill(-1, mTilesWide * mTilesHigh);
+    mChunkCache.reset(mTilesWide, mTilesHigh, mTiles);
 
     setUrl(QUrl());
     setNewProject(true);
@@ -181,6 +183,7 @@ void TilesetProject::doLoad(const QUrl &url)
             Q_ASSERT(mTileDatabase.contains(tileId));
         }
     }
+    mChunkCache.reset(mTilesWide, mTilesHigh, mTiles);
 
     readGuides(projectObject);
     // Allow older project files without swatch support (saved with version <= 0.2.1) to still be loaded.
@@ -201,6 +204,7 @@ void TilesetProject::doClose()
     mTileDatabase.clear();
     setTileset(nullptr);
     mUndoStack.clear();
+    clearUndoCheckpoints();
     emit projectClosed();
 }
 
@@ -397,6 +401,7 @@ void TilesetProject::changeSize(const QSize &newSize, const QVector<int> &tiles)
         mTiles = tiles;
     }
 
+    mChunkCache.reset(newSize.width(), newSize.height(), mTiles);
     setTilesWide(newSize.width());
     setTilesHigh(newSize.height());
 }
@@ -528,7 +533,15 @@ void TilesetProject::setTileset(Tileset *tileset)
         return;
 
     Tileset *old = mTileset;
+    if (old)
+        disconnect(old, &Tileset::imageAreaChanged, this, &TilesetProject::onTilesetImageAreaChanged);
+
     mTileset = tileset;
+
+    if (mTileset)
+        connect(mTileset, &Tileset::imageAreaChanged, this, &TilesetProject::onTilesetImageAreaChanged);
+
+    mChunkCache.invalidateAll();
     emit tilesetChanged(old, mTileset);
 }
 
@@ -578,6 +591,7 @@ void TilesetProject::setTileAtPixelPos(const QPoint &tilePos, int id)
 
     const int tileIndex = tilePos.y() * mTilesWide + tilePos.x();
     Q_ASSERT(tileIndex < mTiles.size());
+    mChunkCache.cellChanged(tileIndex, mTiles.at(tileIndex), id);
     mTiles[tileIndex] = id;
     qCDebug(lcProject) << "set tile at tile pos" << tilePos << "and index" << tileIndex << "to id" << id;
 }
@@ -708,6 +722,68 @@ void TilesetProject::clearTiles()
     if (mTiles.isEmpty())
         return;
 
-    mTiles.fill(mTiles.size(), -1);
+    mTiles.fill(-1);
+    mChunkCache.reset(mTilesWide, mTilesHigh, mTiles);
     emit tilesCleared();
 }
+
+int TilesetProject::chunkSizeInTiles() const
+{
+    return mChunkCache.chunkSizeInTiles();
+}
+
+QImage TilesetProject::chunkImage(const QPoint &chunkPos)
+{
+    QImage image = mChunkCache.chunkImage(chunkPos);
+    if (!image.isNull())
+        return image;
+
+    const QRect chunkTileRect = mChunkCache.chunkTileRect(chunkPos);
+    image = QImage(chunkTileRect.width() * mTileWidth, chunkTileRect.height() * mTileHeight,
+        QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::transparent);
+
+    QPainter painter(&image);
+    for (int y = chunkTileRect.top(); y <= chunkTileRect.bottom(); ++y) {
+        for (int x = chunkTileRect.left(); x <= chunkTileRect.right(); ++x) {
+            const int tileId = mTiles.at(y * mTilesWide + x);
+            const Tile *tile = tileId != -1 ? mTileDatabase.value(tileId) : nullptr;
+            if (!tile)
+                continue;
+
+            const QPoint topLeftInChunk((x - chunkTileRect.left()) * mTileWidth, (y - chunkTileRect.top()) * mTileHeight);
+            painter.drawImage(topLeftInChunk, *mTileset->image(), tile->sourceRect());
+        }
+    }
+    painter.end();
+
+    mChunkCache.insertChunkImage(chunkPos, image);
+    return image;
+}
+
+void TilesetProject::setVisibleChunks(int viewIndex, const QRect &chunks)
+{
+    const qint64 chunkSizeInTiles = mChunkCache.chunkSizeInTiles();
+    const qint64 bytesPerChunk = chunkSizeInTiles * mTileWidth * chunkSizeInTiles * mTileHeight * 4;
+    mChunkCache.setVisibleChunkBytes(viewIndex, chunks.isEmpty() ? 0 : chunks.width() * chunks.height() * bytesPerChunk);
+}
+
+void TilesetProject::onTilesetImageAreaChanged(const QRect &area)
+{
+    if (area.isNull()) {
+        mChunkCache.invalidateAll();
+        return;
+    }
+
+    // Only the chunks containing the tiles whose image changed need to be re-rendered.
+    const QRect tilesetArea = area & mTileset->image()->rect();
+    if (tilesetArea.isEmpty())
+        return;
+
+    const int lastColumn = qMin(tilesetArea.right() / mTileWidth, mTileset->tilesWide() - 1);
+    const int lastRow = qMin(tilesetArea.bottom() / mTileHeight, mTileset->tilesHigh() - 1);
+    for (int row = tilesetArea.top() / mTileHeight; row <= lastRow; ++row) {
+        for (int column = tilesetArea.left() / mTileWidth; column <= lastColumn; ++column)
+            mChunkCache.tileImageChanged(tileIdFromTilePosInTileset(column, row));
+    }
+}
@@ -30,6 +30,7 @@
 #include "project.h"
 #include "slate-global.h"
 #include "tile.h"
+#include "tilechunkcache.h"
 #include "tileset.h"
 
 class SLATE_EXPORT TilesetProject : public Project
@@ -88,6 +89,15 @@ public:
     // Sets all tiles to -1.
     void clearTiles();
 
+    // The map is drawn in square chunks of this many tiles.
+    int chunkSizeInTiles() const;
+    // Returns an image of the tiles in the chunk at chunkPos (in chunks),
+    // rendering it if it's not already cached.
+    QImage chunkImage(const QPoint &chunkPos);
+    // Makes room in the chunk cache for the chunks (in chunks) that the view with
+    // the given index is about to draw.
+    void setVisibleChunks(int viewIndex, const QRect &chunks);
+
 signals:
     void tilesWideChanged();
     void tilesHighChanged();
@@ -103,6 +113,9 @@ public slots:
         int canvasTilesWide, int canvasTilesHigh,
         bool transparentBackground);
 
+protected slots:
+    void onTilesetImageAreaChanged(const QRect &area);
+
 protected:
     void doLoad(const QUrl &url) override;
     void doClose() override;
@@ -131,6 +144,7 @@ private:
     QVector<int> mTiles;
     QHash<int, Tile*> mTileDatabase;
     Tileset* mTileset;
+    TileChunkCache mChunkCache;
 };
 
 #endif // TILSEETPROJECT_H
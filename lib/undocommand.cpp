@@ -0,0 +1,106 @@
+/*
+    Copyright 2018, Mitch Curtis
+
+    This file is part of Slate.
+
+    Slate is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Slate is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Slate. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "undocommand.h"
+
+#include "undoimage.h"
+
+UndoCommand::UndoCommand(QUndoCommand *parent) :
+    QUndoCommand(parent),
+    mDiscarded(false),
+    mSkipped(false)
+{
+}
+
+qint64 UndoCommand::byteSize() const
+{
+    qint64 size = 0;
+    // imagePayloads() isn't const because compress() and discard() need to
+    // modify the images; nothing is modified here.
+    const auto images = const_cast<UndoCommand*>(this)->imagePayloads();
+    for (const UndoImage *image : images)
+        size += image->byteSize();
+    return size;
+}
+
+qint64 UndoCommand::sharedImageByteSize(const QSet<qint64> &sharedCacheKeys) const
+{
+    if (sharedCacheKeys.isEmpty())
+        return 0;
+
+    qint64 size = 0;
+    const auto images = const_cast<UndoCommand*>(this)->imagePayloads();
+    for (const UndoImage *image : images) {
+        if (image->isSharedWith(sharedCacheKeys))
+            size += image->byteSize();
+    }
+    return size;
+}
+
+void UndoCommand::compress(const QSet<qint64> &sharedCacheKeys)
+{
+    const auto images = imagePayloads();
+    for (UndoImage *image : images) {
+        if (!image->isSharedWith(sharedCacheKeys))
+            image->compress();
+    }
+}
+
+void UndoCommand::spill(const QSharedPointer<UndoSwapFile> &swapFile, const QSet<qint64> &sharedCacheKeys)
+{
+    const auto images = imagePayloads();
+    for (UndoImage *image : images) {
+        if (!image->isSharedWith(sharedCacheKeys))
+            image->spill(swapFile);
+    }
+}
+
+void UndoCommand::discard()
+{
+    const auto images = imagePayloads();
+    for (UndoImage *image : images)
+        image->discard();
+    mDiscarded = true;
+    setObsolete(true);
+}
+
+bool UndoCommand::isDiscarded() const
+{
+    return mDiscarded;
+}
+
+bool UndoCommand::changesOnlyImages() const
+{
+    return false;
+}
+
+void UndoCommand::setSkipped(bool skipped)
+{
+    mSkipped = skipped;
+}
+
+bool UndoCommand::isSkipped() const
+{
+    return mSkipped;
+}
+
+QVector<UndoImage*> UndoCommand::imagePayloads()
+{
+    return QVector<UndoImage*>();
+}
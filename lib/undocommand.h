@@ -0,0 +1,83 @@
+/*
+    Copyright 2018, Mitch Curtis
+
+    This file is part of Slate.
+
+    Slate is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Slate is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Slate. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef UNDOCOMMAND_H
+#define UNDOCOMMAND_H
+
+#include <QSet>
+#include <QSharedPointer>
+#include <QUndoCommand>
+#include <QVector>
+
+#include "slate-global.h"
+
+class UndoImage;
+class UndoSwapFile;
+
+// The base class of undo commands whose memory usage is accounted for,
+// so that Project can keep the undo history within its memory budget.
+class SLATE_EXPORT UndoCommand : public QUndoCommand
+{
+public:
+    explicit UndoCommand(QUndoCommand *parent = nullptr);
+
+    // The approximate number of bytes of memory used by this command,
+    // not including its children.
+    virtual qint64 byteSize() const;
+
+    // The number of bytes that byteSize() includes for images that share their data
+    // with one of the images whose cache keys are given (e.g. the project's layers).
+    // Those images don't use any memory of their own until the ones they share with are edited.
+    qint64 sharedImageByteSize(const QSet<qint64> &sharedCacheKeys) const;
+
+    // Compresses the images held by this command. They are decompressed
+    // on demand when the command is undone or redone. Images that share their
+    // data with one of sharedCacheKeys are left alone, as compressing them would
+    // only add the compressed copy to the memory that's in use.
+    void compress(const QSet<qint64> &sharedCacheKeys = QSet<qint64>());
+
+    // Moves the images held by this command out of memory and into swapFile.
+    // They are read back in on demand when the command is undone or redone.
+    // As with compress(), images that share their data with one of sharedCacheKeys are left alone.
+    void spill(const QSharedPointer<UndoSwapFile> &swapFile, const QSet<qint64> &sharedCacheKeys = QSet<qint64>());
+
+    // Releases the images held by this command and marks it obsolete,
+    // so that the stack removes it instead of undoing it.
+    void discard();
+    bool isDiscarded() const;
+
+    // Returns true if undoing or redoing this command changes nothing
+    // but the project's images (including their size), in which case it can be
+    // skipped when the images are about to be restored from a checkpoint anyway.
+    virtual bool changesOnlyImages() const;
+
+    // Skipped commands do nothing when undone or redone.
+    void setSkipped(bool skipped);
+    bool isSkipped() const;
+
+protected:
+    // Returns the images held by this command.
+    virtual QVector<UndoImage*> imagePayloads();
+
+private:
+    bool mDiscarded;
+    bool mSkipped;
+};
+
+#endif // UNDOCOMMAND_H
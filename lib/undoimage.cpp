@@ -0,0 +1,144 @@
+/*
+    Copyright 2018, Mitch Curtis
+
+    This file is part of Slate.
+
+    Slate is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Slate is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Slate. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "undoimage.h"
+
+#include <cstring>
+
+#include "undoswapfile.h"
+
+UndoImage::UndoImage() :
+    mFormat(QImage::Format_Invalid)
+{
+}
+
+UndoImage::UndoImage(const QImage &image) :
+    mImage(image),
+    mSize(image.size()),
+    mFormat(image.format())
+{
+}
+
+bool UndoImage::isNull() const
+{
+    return mImage.isNull() && mCompressedData.isEmpty() && !mSwapRegion;
+}
+
+QSize UndoImage::size() const
+{
+    return mSize;
+}
+
+QImage UndoImage::image() const
+{
+    if (!isCompressed())
+        return mImage;
+
+    // Images with the same size and format have the same stride,
+    // so the bits can be restored in one go.
+    QImage image(mSize, mFormat);
+    const QByteArray data = qUncompress(isSpilled() ? mSwapRegion->read() : mCompressedData);
+    std::memcpy(image.bits(), data.constData(), qMin<qsizetype>(data.size(), image.sizeInBytes()));
+    image.setColorTable(mColourTable);
+    return image;
+}
+
+bool UndoImage::isCompressed() const
+{
+    return !mCompressedData.isEmpty() || isSpilled();
+}
+
+void UndoImage::compress()
+{
+    if (mImage.isNull())
+        return;
+
+    // Level 1 is much faster than the default and compresses the large
+    // uniform areas typical of pixel art nearly as well.
+    mCompressedData = qCompress(mImage.constBits(), int(mImage.sizeInBytes()), 1);
+    mColourTable = mImage.colorTable();
+    mImage = QImage();
+}
+
+bool UndoImage::isSpilled() const
+{
+    return !mSwapRegion.isNull();
+}
+
+void UndoImage::spill(const QSharedPointer<UndoSwapFile> &swapFile)
+{
+    compress();
+    if (mCompressedData.isEmpty())
+        return;
+
+    mSwapRegion = UndoSwapRegion::write(swapFile, mCompressedData);
+    if (mSwapRegion)
+        mCompressedData.clear();
+}
+
+void UndoImage::discard()
+{
+    mImage = QImage();
+    mCompressedData.clear();
+    mSwapRegion.reset();
+    mColourTable.clear();
+}
+
+qint64 UndoImage::byteSize() const
+{
+    if (isCompressed())
+        return mCompressedData.size() + mColourTable.size() * qint64(sizeof(QRgb));
+    // Images that share data with the canvas or another command are still
+    // counted in full here; see isSharedWith().
+    return mImage.sizeInBytes();
+}
+
+bool UndoImage::isSharedWith(const QSet<qint64> &cacheKeys) const
+{
+    return !isCompressed() && !mImage.isNull() && cacheKeys.contains(mImage.cacheKey());
+}
+
+QVector<UndoImage> UndoImage::fromImages(const QVector<QImage> &images)
+{
+    QVector<UndoImage> undoImages;
+    undoImages.reserve(images.size());
+    for (const QImage &image : images)
+        undoImages.append(UndoImage(image));
+    return undoImages;
+}
+
+QVector<QImage> UndoImage::toImages(const QVector<UndoImage> &undoImages)
+{
+    QVector<QImage> images;
+    images.reserve(undoImages.size());
+    for (const UndoImage &undoImage : undoImages)
+        images.append(undoImage.image());
+    return images;
+}
+
+QDebug operator<<(QDebug debug, const UndoImage &image)
+{
+    QDebugStateSaver saver(debug);
+    debug.nospace() << "(UndoImage size=" << image.size()
+        << " compressed=" << image.isCompressed()
+        << " spilled=" << image.isSpilled()
+        << " bytes=" << image.byteSize()
+        << ")";
+    return debug;
+}
@@ -0,0 +1,82 @@
+/*
+    Copyright 2018, Mitch Curtis
+
+    This file is part of Slate.
+
+    Slate is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Slate is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Slate. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef UNDOIMAGE_H
+#define UNDOIMAGE_H
+
+#include <QByteArray>
+#include <QDebug>
+#include <QImage>
+#include <QSet>
+#include <QSharedPointer>
+#include <QVector>
+
+#include "slate-global.h"
+
+class UndoSwapFile;
+class UndoSwapRegion;
+
+// An image held by an undo command. It can be compressed to save memory
+// while it's not needed, or moved out of memory altogether into a swap file,
+// and is brought back on demand.
+class SLATE_EXPORT UndoImage
+{
+public:
+    UndoImage();
+    UndoImage(const QImage &image);
+
+    bool isNull() const;
+    QSize size() const;
+
+    // Returns the image, decompressing a copy of it if it's compressed or spilled.
+    QImage image() const;
+
+    bool isCompressed() const;
+    void compress();
+
+    bool isSpilled() const;
+    // Compresses the image and writes it to swapFile.
+    // If writing fails, the image stays compressed in memory.
+    void spill(const QSharedPointer<UndoSwapFile> &swapFile);
+
+    // Releases the image for good. image() returns a null image afterwards.
+    void discard();
+
+    // The number of bytes of memory used by the image in its current form.
+    qint64 byteSize() const;
+
+    // Returns true if the image is uncompressed and shares its data with
+    // one of the images whose cache keys are given (e.g. the project's).
+    bool isSharedWith(const QSet<qint64> &cacheKeys) const;
+
+    static QVector<UndoImage> fromImages(const QVector<QImage> &images);
+    static QVector<QImage> toImages(const QVector<UndoImage> &images);
+
+private:
+    QImage mImage;
+    QByteArray mCompressedData;
+    QSharedPointer<UndoSwapRegion> mSwapRegion;
+    QSize mSize;
+    QImage::Format mFormat;
+    QVector<QRgb> mColourTable;
+};
+
+SLATE_EXPORT QDebug operator<<(QDebug debug, const UndoImage &image);
+
+#endif // UNDOIMAGE_H
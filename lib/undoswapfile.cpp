@@ -0,0 +1,167 @@
+/*
+    Copyright 2018, Mitch Curtis
+
+    This file is part of Slate.
+
+    Slate is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Slate is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Slate. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "undoswapfile.h"
+
+#include <QLoggingCategory>
+
+Q_LOGGING_CATEGORY(lcUndoSwapFile, "app.undo.swapFile")
+
+UndoSwapFile::UndoSwapFile(const QString &fileName) :
+    mFile(fileName),
+    mUsedBytes(0)
+{
+    if (!mFile.open(QIODevice::ReadWrite | QIODevice::Truncate))
+        qWarning() << "Failed to open undo swap file" << fileName << ":" << mFile.errorString();
+}
+
+UndoSwapFile::~UndoSwapFile()
+{
+    mFile.close();
+    mFile.remove();
+}
+
+bool UndoSwapFile::isOpen() const
+{
+    return mFile.isOpen();
+}
+
+QString UndoSwapFile::fileName() const
+{
+    return mFile.fileName();
+}
+
+qint64 UndoSwapFile::usedBytes() const
+{
+    return mUsedBytes;
+}
+
+qint64 UndoSwapFile::store(const QByteArray &data)
+{
+    if (!mFile.isOpen())
+        return -1;
+
+    // Use the smallest free region that the data fits in, if there is one.
+    auto freeRegion = mFreeRegions.end();
+    for (auto it = mFreeRegions.begin(); it != mFreeRegions.end(); ++it) {
+        if (it.value() >= data.size() && (freeRegion == mFreeRegions.end() || it.value() < freeRegion.value()))
+            freeRegion = it;
+    }
+
+    const qint64 fileSize = mFile.size();
+    const qint64 offset = freeRegion != mFreeRegions.end() ? freeRegion.key() : fileSize;
+    if (!mFile.seek(offset) || mFile.write(data) != data.size() || !mFile.flush()) {
+        qWarning() << "Failed to write to undo swap file" << mFile.fileName() << ":" << mFile.errorString();
+        // Don't leave a partially written payload behind.
+        if (offset == fileSize)
+            mFile.resize(offset);
+        return -1;
+    }
+
+    if (freeRegion != mFreeRegions.end()) {
+        const qint64 remainingSize = freeRegion.value() - data.size();
+        mFreeRegions.erase(freeRegion);
+        if (remainingSize > 0)
+            mFreeRegions.insert(offset + data.size(), remainingSize);
+    }
+
+    mUsedBytes += data.size();
+    qCDebug(lcUndoSwapFile) << "wrote" << data.size() << "bytes at offset" << offset
+        << "- bytes in use:" << mUsedBytes;
+    return offset;
+}
+
+QByteArray UndoSwapFile::read(qint64 offset, qint64 size)
+{
+    uchar *mapped = mFile.map(offset, size);
+    if (mapped) {
+        const QByteArray data(reinterpret_cast<const char*>(mapped), int(size));
+        mFile.unmap(mapped);
+        return data;
+    }
+
+    // Some file systems don't support mapping, so fall back to reading.
+    if (!mFile.seek(offset))
+        return QByteArray();
+    return mFile.read(size);
+}
+
+void UndoSwapFile::release(qint64 offset, qint64 size)
+{
+    mUsedBytes -= size;
+    Q_ASSERT(mUsedBytes >= 0);
+
+    if (!mFile.isOpen())
+        return;
+
+    // Merge the region with the free regions on either side of it.
+    auto next = mFreeRegions.lowerBound(offset);
+    if (next != mFreeRegions.end() && offset + size == next.key()) {
+        size += next.value();
+        next = mFreeRegions.erase(next);
+    }
+    if (next != mFreeRegions.begin()) {
+        auto previous = next;
+        --previous;
+        if (previous.key() + previous.value() == offset) {
+            offset = previous.key();
+            size += previous.value();
+            mFreeRegions.erase(previous);
+        }
+    }
+
+    if (offset + size == mFile.size()) {
+        qCDebug(lcUndoSwapFile) << "truncating" << mFile.fileName() << "to" << offset << "bytes"
+            << "- bytes in use:" << mUsedBytes;
+        mFile.resize(offset);
+    } else {
+        mFreeRegions.insert(offset, size);
+    }
+}
+
+QSharedPointer<UndoSwapRegion> UndoSwapRegion::write(const QSharedPointer<UndoSwapFile> &file, const QByteArray &data)
+{
+    const qint64 offset = file->store(data);
+    if (offset == -1)
+        return QSharedPointer<UndoSwapRegion>();
+
+    return QSharedPointer<UndoSwapRegion>(new UndoSwapRegion(file, offset, data.size()));
+}
+
+UndoSwapRegion::UndoSwapRegion(const QSharedPointer<UndoSwapFile> &file, qint64 offset, qint64 size) :
+    mFile(file),
+    mOffset(offset),
+    mSize(size)
+{
+}
+
+UndoSwapRegion::~UndoSwapRegion()
+{
+    mFile->release(mOffset, mSize);
+}
+
+qint64 UndoSwapRegion::size() const
+{
+    return mSize;
+}
+
+QByteArray UndoSwapRegion::read() const
+{
+    return mFile->read(mOffset, mSize);
+}
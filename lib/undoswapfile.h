@@ -0,0 +1,87 @@
+/*
+    Copyright 2018, Mitch Curtis
+
+    This file is part of Slate.
+
+    Slate is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Slate is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Slate. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef UNDOSWAPFILE_H
+#define UNDOSWAPFILE_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QMap>
+#include <QSharedPointer>
+
+#include "slate-global.h"
+
+// A file that holds undo payloads that have been moved out of memory.
+// Payloads are read back by mapping the region they occupy into memory.
+// The space of payloads that are no longer needed is reused for new ones,
+// so the file only grows when none of the free space is big enough.
+class SLATE_EXPORT UndoSwapFile
+{
+public:
+    explicit UndoSwapFile(const QString &fileName);
+    ~UndoSwapFile();
+
+    bool isOpen() const;
+    QString fileName() const;
+
+    // The number of bytes in the file that are still in use.
+    qint64 usedBytes() const;
+
+private:
+    Q_DISABLE_COPY(UndoSwapFile)
+
+    friend class UndoSwapRegion;
+
+    // Returns the offset that data was written at, or -1 if it couldn't be written.
+    qint64 store(const QByteArray &data);
+    QByteArray read(qint64 offset, qint64 size);
+    // Free space at the end of the file is truncated to reclaim the disk space.
+    void release(qint64 offset, qint64 size);
+
+    QFile mFile;
+    qint64 mUsedBytes;
+    // The size of each free region of the file, keyed by offset.
+    // Adjacent free regions are merged.
+    QMap<qint64, qint64> mFreeRegions;
+};
+
+// Data that was written to an UndoSwapFile. Its space in the file is
+// released when the region is destroyed.
+class SLATE_EXPORT UndoSwapRegion
+{
+public:
+    // Returns a null pointer if the data couldn't be written.
+    static QSharedPointer<UndoSwapRegion> write(const QSharedPointer<UndoSwapFile> &file, const QByteArray &data);
+
+    ~UndoSwapRegion();
+
+    qint64 size() const;
+    QByteArray read() const;
+
+private:
+    Q_DISABLE_COPY(UndoSwapRegion)
+
+    UndoSwapRegion(const QSharedPointer<UndoSwapFile> &file, qint64 offset, qint64 size);
+
+    QSharedPointer<UndoSwapFile> mFile;
+    qint64 mOffset;
+    qint64 mSize;
+};
+
+#endif // UNDOSWAPFILE_H
@@ -20,34 +20,89 @@
 #include "utils.h"
 
 #include <QDebug>
+#include <QHash>
 #include <QPainter>
+#include <QThread>
+#include <QVector>
+#include <QtConcurrentMap>
+
+namespace {
+    // Below this many pixels, the overhead of threading outweighs the benefits.
+    static const int hslThreadingThreshold = 256 * 256;
+
+    // Goes through QImage::pixelColor() and QImage::setPixelColor() (using a 1x1 image of the same format)
+    // so that the result is identical to adjusting the pixel in the image itself.
+    QRgb modifiedHslPixel(QImage *scratchImage, QRgb pixel, qreal hue, qreal saturation, qreal lightness)
+    {
+        *reinterpret_cast<QRgb*>(scratchImage->scanLine(0)) = pixel;
+        const QColor rgb = scratchImage->pixelColor(0, 0);
+        QColor hsl = rgb.toHsl();
+        hsl.setHslF(
+            qBound(0.0, hsl.hueF() + hue, 1.0),
+            qBound(0.0, hsl.saturationF() + saturation, 1.0),
+            qBound(0.0, hsl.lightnessF() + lightness, 1.0),
+            rgb.alphaF());
+        scratchImage->setPixelColor(0, 0, hsl.toRgb());
+        return *reinterpret_cast<const QRgb*>(scratchImage->constScanLine(0));
+    }
+}
 
 QImage Utils::paintImageOntoPortionOfImage(const QImage &image, const QRect &portion, const QImage &replacementImage)
 {
     QImage newImage = image;
-    QPainter painter(&newImage);
-    painter.drawImage(portion.topLeft(), replacementImage);
+    paintImageOntoPortionOfImage(&newImage, portion, replacementImage);
     return newImage;
 }
 
 QImage Utils::replacePortionOfImage(const QImage &image, const QRect &portion, const QImage &replacementImage)
 {
     QImage newImage = image;
-    QPainter painter(&newImage);
-    painter.setCompositionMode(QPainter::CompositionMode_Source);
-    painter.drawImage(portion.topLeft(), replacementImage);
+    replacePortionOfImage(&newImage, portion, replacementImage);
     return newImage;
 }
 
 QImage Utils::erasePortionOfImage(const QImage &image, const QRect &portion)
 {
     QImage newImage = image;
-    QPainter painter(&newImage);
-    painter.setCompositionMode(QPainter::CompositionMode_Clear);
-    painter.fillRect(portion, Qt::transparent);
+    erasePortionOfImage(&newImage, portion);
     return newImage;
 }
 
+QRect Utils::paintImageOntoPortionOfImage(QImage *image, const QRect &portion, const QImage &replacementImage)
+{
+    const QRect changedArea = QRect(portion.topLeft(), replacementImage.size()) & image->rect();
+    if (changedArea.isEmpty())
+        return QRect();
+
+    QPainter painter(image);
+    painter.drawImage(portion.topLeft(), replacementImage);
+    return changedArea;
+}
+
+QRect Utils::replacePortionOfImage(QImage *image, const QRect &portion, const QImage &replacementImage)
+{
+    const QRect changedArea = QRect(portion.topLeft(), replacementImage.size()) & image->rect();
+    if (changedArea.isEmpty())
+        return QRect();
+
+    QPainter painter(image);
+    painter.setCompositionMode(QPainter::CompositionMode_Source);
+    painter.drawImage(portion.topLeft(), replacementImage);
+    return changedArea;
+}
+
+QRect Utils::erasePortionOfImage(QImage *image, const QRect &portion)
+{
+    const QRect changedArea = portion & image->rect();
+    if (changedArea.isEmpty())
+        return QRect();
+
+    QPainter painter(image);
+    painter.setCompositionMode(QPainter::CompositionMode_Clear);
+    painter.fillRect(changedArea, Qt::transparent);
+    return changedArea;
+}
+
 QImage Utils::rotate(const QImage &image, int angle)
 {
     const QPoint center = image.rect().center();
@@ -58,17 +113,17 @@ QImage Utils::rotate(const QImage &image, int angle)
 }
 
 /*!
-    1. Copies \a area in \a image.
-    2. Erases \a area in \a image, filling it with transparency.
-    3. Pastes the rotated image from step 1 at the centre of \a area.
-    4. Tries to move the rotated area within the bounds of the image if it's outside.
-    5. Crops the the rotated image if it's too large.
-    6. Returns the final rotated image portion and sets \a inRotatedArea as the area
+    1. Copies \a area in \a image and rotates the copy.
+    2. Centres the rotated copy over the centre of \a area.
+    3. Tries to move the rotated area within the bounds of the image if it's outside.
+    4. Crops the rotated image if it's too large.
+    5. Returns the final rotated image portion and sets \a inRotatedArea as the area
        representing the newly rotated \a area.
+
+    \a image itself is left untouched.
 */
 QImage Utils::rotateAreaWithinImage(const QImage &image, const QRect &area, int angle, QRect &inRotatedArea)
 {
-    QImage result = image;
     const QPoint areaCentre = area.center();
 
     // Create an image from the target area and then rotate it.
@@ -79,9 +134,6 @@ QImage Utils::rotateAreaWithinImage(const QImage &image, const QRect &area, int
     matrix.rotate(angle);
     rotatedImagePortion = rotatedImagePortion.transformed(matrix);
 
-    // Remove what was behind the area and replace it with transparency.
-    result = erasePortionOfImage(result, area);
-
     // Centre the rotated image over the target area's centre...
     QRect rotatedArea = rotatedImagePortion.rect();
     rotatedArea.moveCenter(areaCentre);
@@ -161,6 +213,60 @@ QRect Utils::ensureWithinArea(const QRect &rect, const QSize &boundsSize)
 
 void Utils::modifyHsl(QImage &image, qreal hue, qreal saturation, qreal lightness)
 {
+    if (image.isNull())
+        return;
+
+    if (image.depth() == 32) {
+        uchar *bits = image.bits();
+        const int bytesPerLine = image.bytesPerLine();
+        const int width = image.width();
+        const QImage::Format format = image.format();
+
+        struct RowBand
+        {
+            int top;
+            int bottom;
+        };
+
+        const int bandCount = width * image.height() >= hslThreadingThreshold
+            ? qBound(1, QThread::idealThreadCount(), image.height()) : 1;
+        const int rowsPerBand = (image.height() + bandCount - 1) / bandCount;
+        QVector<RowBand> bands;
+        for (int top = 0; top < image.height(); top += rowsPerBand)
+            bands.append({ top, qMin(top + rowsPerBand, image.height()) - 1 });
+
+        // Converting to HSL and back is expensive, but pixel art tends to use a handful of colours,
+        // so each band converts every distinct pixel value once and looks the rest up.
+        auto modifyBand = [=](RowBand &band) {
+            QHash<QRgb, QRgb> modifiedPixels;
+            QImage scratchImage(1, 1, format);
+            QRgb lastPixel = 0;
+            QRgb lastModifiedPixel = 0;
+            bool haveLastPixel = false;
+            for (int y = band.top; y <= band.bottom; ++y) {
+                QRgb *line = reinterpret_cast<QRgb*>(bits + y * bytesPerLine);
+                for (int x = 0; x < width; ++x) {
+                    const QRgb pixel = line[x];
+                    if (!haveLastPixel || pixel != lastPixel) {
+                        auto it = modifiedPixels.find(pixel);
+                        if (it == modifiedPixels.end())
+                            it = modifiedPixels.insert(pixel, modifiedHslPixel(&scratchImage, pixel, hue, saturation, lightness));
+                        lastPixel = pixel;
+                        lastModifiedPixel = it.value();
+                        haveLastPixel = true;
+                    }
+                    line[x] = lastModifiedPixel;
+                }
+            }
+        };
+
+        if (bands.size() == 1)
+            modifyBand(bands.first());
+        else
+            QtConcurrent::blockingMap(bands, modifyBand);
+        return;
+    }
+
     for (int y = 0; y < image.height(); ++y) {
         for (int x = 0; x < image.width(); ++x) {
             const QColor rgb = image.pixelColor(x, y);
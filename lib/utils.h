@@ -31,6 +31,13 @@ namespace Utils {
 
     QImage erasePortionOfImage(const QImage &image, const QRect &portion);
 
+    // In-place versions of the functions above. These only touch the pixels of the image
+    // that are within the portion, and return that area (clipped to the image's bounds)
+    // so that callers can e.g. repaint only what changed.
+    QRect paintImageOntoPortionOfImage(QImage *image, const QRect &portion, const QImage &replacementImage);
+    QRect replacePortionOfImage(QImage *image, const QRect &portion, const QImage &replacementImage);
+    QRect erasePortionOfImage(QImage *image, const QRect &portion);
+
     QImage rotate(const QImage &image, int angle);
     QImage rotateAreaWithinImage(const QImage &image, const QRect &area, int angle, QRect &inRotatedArea);
 
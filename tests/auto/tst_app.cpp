@@ -22,20 +22,35 @@
 #include <QGuiApplication>
 #include <QPainter>
 #include <QQmlEngine>
+#include <QRandomGenerator>
+#include <QScopeGuard>
 #include <QSharedPointer>
 #include <QtTest>
 #include <QQuickItemGrabResult>
 #include <QQuickWindow>
 
+#include "animationplayback.h"
 #include "application.h"
 #include "applypixelpencommand.h"
+#include "applytilefillcommand.h"
+#include "canvaspane.h"
+#include "canvaspaneitem.h"
+#include "fillalgorithms.h"
 #include "imagelayer.h"
+#include "layercompositor.h"
+#include "pixelkernels.h"
+#include "pixelspans.h"
 #include "tilecanvas.h"
+#include "tilecanvaspaneitem.h"
+#include "tilechunkcache.h"
 #include "project.h"
 #include "projectmanager.h"
+#include "spriteimage.h"
 #include "swatch.h"
+#include "texturecanvaspaneitem.h"
 #include "testhelper.h"
 #include "tileset.h"
+#include "undoswapfile.h"
 #include "utils.h"
 
 class tst_App : public TestHelper
@@ -62,6 +77,8 @@ private Q_SLOTS:
 
     void animationPlayback_data();
     void animationPlayback();
+    void animationPlaybackFrameCache_data();
+    void animationPlaybackFrameCache();
     void keyboardShortcuts();
     void optionsShortcutCancelled();
     void optionsTransparencyCancelled();
@@ -76,8 +93,11 @@ private Q_SLOTS:
     void undoLayeredImageSizeChange();
     void undoPixelFill();
     void undoTileFill();
+    void tileFloodFillLargeMap();
     void undoThickSquarePen();
     void undoThickRoundPen();
+    void pixelSpans_data();
+    void pixelSpans();
     void penSubpixelPosition();
     void penSubpixelPositionWithThickBrush_data();
     void penSubpixelPositionWithThickBrush();
@@ -142,12 +162,50 @@ private Q_SLOTS:
     void fillImageCanvas_data();
     void fillImageCanvas();
     void fillLayeredImageCanvas();
+    void fillEnclosedArea_data();
+    void fillEnclosedArea();
+    void fillWithTolerance_data();
+    void fillWithTolerance();
+    void pixelKernelsMatchScalarReference_data();
+    void pixelKernelsMatchScalarReference();
+    void greedyPixelFillInPlaceAcrossBands_data();
+    void greedyPixelFillInPlaceAcrossBands();
+    void undoHistoryStaysWithinMemoryBudget_data();
+    void undoHistoryStaysWithinMemoryBudget();
+    void undoHistorySpillsToDisk_data();
+    void undoHistorySpillsToDisk();
+    void undoSwapFileReusesFreeSpace();
+    void undoHistoryJumpsViaCheckpoints_data();
+    void undoHistoryJumpsViaCheckpoints();
+    void undoMemoryUsage();
+    void undoMemoryUsageOfSharedImages();
+    void penRequestsAreaRepaint_data();
+    void penRequestsAreaRepaint();
+    void layeredContentImageMatchesFlattenedImage();
+    void layerCompositorRecompositesDirtyBlocks();
+    void textureCanvasRendering();
+    void tileChunkCacheInvalidation();
+    void tileChunkCacheCapacity();
+    void tilesetProjectChunkImages();
+    void tileCanvasDrawsPartiallyVisibleTiles();
+    void linePreviewOverlay_data();
+    void linePreviewOverlay();
+    void selectionPreviewOverlays_data();
+    void selectionPreviewOverlays();
+    void inPlaceImagePortionOperations();
+    void modifyHslMatchesPixelColourConversion_data();
+    void modifyHslMatchesPixelColourConversion();
+    void modifySelectionHslOnWorkerThread_data();
+    void modifySelectionHslOnWorkerThread();
     void greedyPixelFillImageCanvas_data();
     void greedyPixelFillImageCanvas();
+    void greedyPixelFillTileCanvas();
     void texturedFill_data();
     void texturedFill();
     void pixelLineToolImageCanvas_data();
     void pixelLineToolImageCanvas();
+    void penStrokeIsOneCommand_data();
+    void penStrokeIsOneCommand();
     void pixelLineToolTransparent_data();
     void pixelLineToolTransparent();
     void rulersAndGuides_data();
@@ -171,6 +229,9 @@ private Q_SLOTS:
     void disableToolsWhenLayerHidden();
     void undoMoveContents();
     void undoMoveContentsOfVisibleLayers();
+    void undoLayeredImageCanvasSizeChange();
+    void undoMoveContentsOffCanvas_data();
+    void undoMoveContentsOffCanvas();
 };
 
 typedef QVector<Project::Type> ProjectTypeVector;
@@ -584,6 +645,71 @@ void tst_App::loadLayeredImageProjectAfterTilesetProject()
     QCOMPARE(layersLoader->y(), swatchesPanel->y() + swatchesPanel->height() + 5);
 }
 
+void tst_App::animationPlaybackFrameCache_data()
+{
+    addImageProjectTypes();
+}
+
+void tst_App::animationPlaybackFrameCache()
+{
+    QFETCH(Project::Type, projectType);
+
+    QVERIFY2(createNewProject(projectType), failureMessage);
+    QVERIFY2(setAnimationPlayback(true), failureMessage);
+
+    SpriteImage *spriteImage = window->findChild<SpriteImage*>("animationPanelSpriteImage");
+    QVERIFY(spriteImage);
+    QCOMPARE(spriteImage->canvas(), canvas);
+
+    // Frames are 32x32 by default.
+    const QImage firstFrameImage = spriteImage->frameImage(0);
+    QCOMPARE(firstFrameImage.size(), QSize(32, 32));
+    QVERIFY(!spriteImage->frameImage(1).isNull());
+    QCOMPARE(spriteImage->cachedFrameCount(), 2);
+
+    // Drawing within the second frame should only cause that frame to be extracted again.
+    setCursorPosInScenePixels(40, 4);
+    QVERIFY2(drawPixelAtCursorPos(), failureMessage);
+    QCOMPARE(spriteImage->cachedFrameCount(), 1);
+    QCOMPARE(spriteImage->frameImage(0).cacheKey(), firstFrameImage.cacheKey());
+    QCOMPARE(spriteImage->frameImage(1).pixelColor(8, 4), QColor(Qt::black));
+
+    // Repainting the canvas without changing its content (e.g. for previews) shouldn't invalidate anything.
+    QCOMPARE(spriteImage->cachedFrameCount(), 2);
+    canvas->setGridVisible(!canvas->gridVisible());
+    canvas->setGridVisible(!canvas->gridVisible());
+    QTest::keyPress(window, Qt::Key_Shift);
+    setCursorPosInScenePixels(10, 20);
+    QTest::mouseMove(window, cursorWindowPos);
+    QVERIFY(canvas->isLineVisible());
+    QTest::keyRelease(window, Qt::Key_Shift);
+    QVERIFY(!canvas->isLineVisible());
+    QCOMPARE(spriteImage->cachedFrameCount(), 2);
+
+    // Changing the frame geometry invalidates every frame.
+    spriteImage->animationPlayback()->setFrameWidth(16);
+    QCOMPARE(spriteImage->cachedFrameCount(), 0);
+    QCOMPARE(spriteImage->frameImage(2).size(), QSize(16, 32));
+    QCOMPARE(spriteImage->frameImage(2).pixelColor(8, 4), QColor(Qt::black));
+
+    if (projectType != Project::LayeredImageType)
+        return;
+
+    // Moving the contents of the layers (and undoing and redoing it) invalidates every frame too.
+    const QColor colourBeforeMove = spriteImage->frameImage(2).pixelColor(8, 4);
+    QVERIFY2(moveContents(1, 0, false), failureMessage);
+    QCOMPARE(spriteImage->cachedFrameCount(), 0);
+    QCOMPARE(spriteImage->frameImage(2).pixelColor(9, 4), colourBeforeMove);
+
+    mouseEventOnCentre(undoButton, MouseClick);
+    QCOMPARE(spriteImage->cachedFrameCount(), 0);
+    QCOMPARE(spriteImage->frameImage(2).pixelColor(8, 4), colourBeforeMove);
+
+    mouseEventOnCentre(redoButton, MouseClick);
+    QCOMPARE(spriteImage->cachedFrameCount(), 0);
+    QCOMPARE(spriteImage->frameImage(2).pixelColor(9, 4), colourBeforeMove);
+}
+
 void tst_App::animationPlayback_data()
 {
     addImageProjectTypes();
@@ -1554,6 +1680,74 @@ void tst_App::undoTileFill()
     QCOMPARE(tilesetProject->tileAtTilePos(QPoint(1, 0)), targetTile);
 }
 
+void tst_App::tileFloodFillLargeMap()
+{
+    QVERIFY2(createNewTilesetProject(), failureMessage);
+
+    // Before the fill was made iterative, a map this size would overflow the stack.
+    const int tilesWide = 512;
+    const int tilesHigh = 512;
+    tilesetProject->setSize(QSize(tilesWide, tilesHigh));
+    QCOMPARE(tilesetProject->size(), QSize(tilesWide, tilesHigh));
+
+    // Build a maze that winds back and forth across the whole map: every odd row is a wall,
+    // with a gap at alternating ends. This is the worst case for a recursive fill.
+    const Tile *wallTile = tilesetProject->tilesetTileAtTilePos(QPoint(0, 0));
+    QVERIFY(wallTile);
+    const Tile *replacementTile = tilesetProject->tilesetTileAtTilePos(QPoint(1, 0));
+    QVERIFY(replacementTile);
+    for (int y = 1; y < tilesHigh; y += 2) {
+        const int gapX = (y / 2) % 2 == 0 ? tilesWide - 1 : 0;
+        for (int x = 0; x < tilesWide; ++x) {
+            if (x != gapX)
+                tilesetProject->setTileAtPixelPos(QPoint(x, y), wallTile->id());
+        }
+    }
+    const QVector<int> tilesBeforeFill = tilesetProject->tiles();
+    const int targetTile = tilesetProject->tileIdAtTilePos(QPoint(0, 0));
+
+    const QVector<TileFillRun> runs = tilesetTileFloodFill(tilesetProject, QPoint(0, 0), targetTile, replacementTile->id());
+    // One run for each empty row and one for the gap in each wall.
+    const int emptyRows = tilesHigh / 2;
+    const int wallRows = tilesHigh / 2;
+    QCOMPARE(runs.size(), emptyRows + wallRows);
+
+    QVector<int> expectedTiles = tilesBeforeFill;
+    for (const TileFillRun &run : runs) {
+        for (int x = run.x; x < run.x + run.length; ++x) {
+            const int index = run.y * tilesWide + x;
+            // Runs must only cover the target tile, and must not overlap.
+            QCOMPARE(expectedTiles.at(index), targetTile);
+            expectedTiles[index] = replacementTile->id();
+        }
+    }
+    QCOMPARE(expectedTiles.count(replacementTile->id()), emptyRows * tilesWide + wallRows);
+
+    // The command stores the runs rather than every tile, and undoing and redoing it
+    // should restore exactly the tiles it covers.
+    tilesetProject->beginMacro(QLatin1String("TileFillTool"));
+    tilesetProject->addChange(new ApplyTileFillCommand(tileCanvas, runs, targetTile, replacementTile->id()));
+    tilesetProject->endMacro();
+    QCOMPARE(tilesetProject->tiles(), expectedTiles);
+
+    QUndoStack *undoStack = tilesetProject->undoStack();
+    const QUndoCommand *fillMacro = undoStack->command(undoStack->index() - 1);
+    QVERIFY(fillMacro);
+    QCOMPARE(fillMacro->childCount(), 1);
+    const UndoCommand *fillCommand = dynamic_cast<const UndoCommand*>(fillMacro->child(0));
+    QVERIFY(fillCommand);
+    QCOMPARE(fillCommand->byteSize(), runs.size() * qint64(sizeof(TileFillRun)));
+
+    undoStack->undo();
+    QCOMPARE(tilesetProject->tiles(), tilesBeforeFill);
+
+    undoStack->redo();
+    QCOMPARE(tilesetProject->tiles(), expectedTiles);
+
+    undoStack->undo();
+    QCOMPARE(tilesetProject->tiles(), tilesBeforeFill);
+}
+
 void tst_App::undoThickSquarePen()
 {
     QVERIFY2(createNewImageProject(), failureMessage);
@@ -1637,6 +1831,89 @@ void tst_App::undoThickRoundPen()
     QCOMPARE(canvas->currentProjectImage()->copy(QRect(0, 0, 5, 5)), undoneImage);
 }
 
+void tst_App::pixelSpans_data()
+{
+    QTest::addColumn<int>("format");
+
+    // The first three are accessed directly; the last goes through QImage::pixel() and setPixel().
+    QTest::newRow("ARGB32_Premultiplied") << int(QImage::Format_ARGB32_Premultiplied);
+    QTest::newRow("ARGB32") << int(QImage::Format_ARGB32);
+    QTest::newRow("RGB32") << int(QImage::Format_RGB32);
+    QTest::newRow("RGB888") << int(QImage::Format_RGB888);
+}
+
+void tst_App::pixelSpans()
+{
+    QFETCH(int, format);
+
+    // Opaque colours, so that every format can store them exactly.
+    QImage image(8, 4, QImage::Format(format));
+    for (int y = 0; y < image.height(); ++y) {
+        for (int x = 0; x < image.width(); ++x)
+            image.setPixel(x, y, qRgb(x * 30, y * 60, 100));
+    }
+    const QImage originalImage = image;
+    const QRgb penColour = qRgb(255, 0, 0);
+
+    // Record each segment of a stroke before drawing it, as the pen does;
+    // the last segment overlaps the pixels drawn by an earlier one.
+    struct Segment
+    {
+        int y;
+        int x;
+        int length;
+    };
+    const QVector<Segment> segments = {
+        { 1, 1, 2 },
+        // Continues on from the first, so it should be merged into it.
+        { 1, 3, 1 },
+        { 2, 2, 3 },
+        // On the same row as the first, but not adjacent to it.
+        { 1, 5, 1 },
+        { 2, 3, 2 }
+    };
+    PixelSpans spans;
+    for (const Segment &segment : segments) {
+        QVector<QRgb> colours(segment.length);
+        PixelSpans::readPixels(image, segment.y, segment.x, segment.length, colours.data());
+        spans.append(segment.y, segment.x, colours.constData(), segment.length);
+        PixelSpans::fillPixels(&image, segment.y, segment.x, segment.length, penColour);
+    }
+
+    QCOMPARE(spans.spans().size(), 4);
+    QCOMPARE(spans.pixelCount(), 9);
+    QCOMPARE(spans.byteSize(), 4 * qint64(sizeof(PixelSpans::Span)) + 9 * qint64(sizeof(QRgb)));
+    QCOMPARE(spans.lastPosition(), QPoint(4, 2));
+    QCOMPARE(spans.bounds(), QRect(1, 1, 5, 2));
+    QVERIFY(spans.contains(QPoint(3, 1)));
+    QVERIFY(!spans.contains(QPoint(4, 1)));
+    QVERIFY(spans.contains(QPoint(5, 1)));
+
+    const PixelSpans::Span &firstSpan = spans.spans().first();
+    QCOMPARE(firstSpan.length, 3);
+    for (int i = 0; i < firstSpan.length; ++i)
+        QCOMPARE(spans.colours(firstSpan)[i], originalImage.pixel(firstSpan.x + i, firstSpan.y));
+    QCOMPARE(image.pixel(3, 1), penColour);
+
+    // The overlapping span recorded the pen's colour, not the original one.
+    const PixelSpans::Span &lastSpan = spans.spans().last();
+    QCOMPARE(spans.colours(lastSpan)[0], penColour);
+
+    // Appending another set of spans should keep its positions and colours.
+    PixelSpans appended;
+    appended.append(spans);
+    QVERIFY(appended.hasSamePositions(spans));
+    QCOMPARE(appended.pixelCount(), spans.pixelCount());
+    appended.append(3, 0, &penColour, 1);
+    QVERIFY(!appended.hasSamePositions(spans));
+
+    // Restoring the spans in reverse order, as undoing does, should give back the original image.
+    const QVector<PixelSpans::Span> &spanList = spans.spans();
+    for (auto it = spanList.crbegin(); it != spanList.crend(); ++it)
+        PixelSpans::writePixels(&image, it->y, it->x, it->length, spans.colours(*it));
+    QCOMPARE(image, originalImage);
+}
+
 void tst_App::penSubpixelPosition()
 {
     QVERIFY2(createNewImageProject(), failureMessage);
@@ -3813,6 +4090,1058 @@ void tst_App::fillLayeredImageCanvas()
     QCOMPARE(layer2->image()->pixelColor(0, 0), QColor(Qt::transparent));
 }
 
+void tst_App::fillEnclosedArea_data()
+{
+    addImageProjectTypes();
+}
+
+void tst_App::fillEnclosedArea()
+{
+    QFETCH(Project::Type, projectType);
+
+    QVERIFY2(createNewProject(projectType), failureMessage);
+
+    QVERIFY2(changeCanvasSize(40, 40), failureMessage);
+
+    // Draw a black square outline with a white interior.
+    QImage *image = canvas->currentProjectImage();
+    image->fill(Qt::white);
+    {
+        QPainter painter(image);
+        painter.fillRect(10, 10, 21, 21, Qt::black);
+        painter.fillRect(11, 11, 19, 19, Qt::white);
+    }
+
+    // Fill inside the outline. Only the interior should be filled.
+    QVERIFY2(switchTool(ImageCanvas::FillTool), failureMessage);
+    canvas->setPenForegroundColour(Qt::red);
+    setCursorPosInScenePixels(20, 20);
+    mouseEvent(canvas, cursorWindowPos, MouseClick);
+    QCOMPARE(image->pixelColor(11, 11), QColor(Qt::red));
+    QCOMPARE(image->pixelColor(29, 29), QColor(Qt::red));
+    QCOMPARE(image->pixelColor(10, 10), QColor(Qt::black));
+    QCOMPARE(image->pixelColor(30, 30), QColor(Qt::black));
+    QCOMPARE(image->pixelColor(0, 0), QColor(Qt::white));
+    QCOMPARE(image->pixelColor(39, 39), QColor(Qt::white));
+
+    // Undo it.
+    mouseEventOnCentre(undoButton, MouseClick);
+    image = canvas->currentProjectImage();
+    QCOMPARE(image->pixelColor(11, 11), QColor(Qt::white));
+    QCOMPARE(image->pixelColor(29, 29), QColor(Qt::white));
+    QCOMPARE(image->pixelColor(10, 10), QColor(Qt::black));
+}
+
+void tst_App::fillWithTolerance_data()
+{
+    QTest::addColumn<Project::Type>("projectType");
+    QTest::addColumn<ImageCanvas::Tool>("tool");
+    QTest::addColumn<bool>("greedy");
+
+    const QVector<QPair<Project::Type, QString>> projectTypes = {
+        { Project::ImageType, QLatin1String("ImageType") },
+        { Project::LayeredImageType, QLatin1String("LayeredImageType") }
+    };
+    for (const auto &projectType : projectTypes) {
+        QTest::newRow(qPrintable(projectType.second + QLatin1String(", FillTool")))
+            << projectType.first << ImageCanvas::FillTool << false;
+        QTest::newRow(qPrintable(projectType.second + QLatin1String(", FillTool, greedy")))
+            << projectType.first << ImageCanvas::FillTool << true;
+        QTest::newRow(qPrintable(projectType.second + QLatin1String(", TexturedFillTool")))
+            << projectType.first << ImageCanvas::TexturedFillTool << false;
+        QTest::newRow(qPrintable(projectType.second + QLatin1String(", TexturedFillTool, greedy")))
+            << projectType.first << ImageCanvas::TexturedFillTool << true;
+    }
+}
+
+void tst_App::fillWithTolerance()
+{
+    QFETCH(Project::Type, projectType);
+    QFETCH(ImageCanvas::Tool, tool);
+    QFETCH(bool, greedy);
+
+    QVERIFY2(createNewProject(projectType), failureMessage);
+
+    QVERIFY2(changeCanvasSize(40, 40), failureMessage);
+
+    // From the left: white, off-white, a black wall, and then white and off-white again,
+    // which only a greedy fill can reach.
+    QImage *image = canvas->currentProjectImage();
+    image->fill(Qt::white);
+    {
+        QPainter painter(image);
+        painter.fillRect(10, 0, 10, 40, QColor(248, 248, 248));
+        painter.fillRect(20, 0, 10, 40, Qt::black);
+        painter.fillRect(35, 0, 5, 40, QColor(248, 248, 248));
+    }
+    const QImage originalImage = *image;
+
+    if (tool == ImageCanvas::FillTool) {
+        QVERIFY2(switchTool(ImageCanvas::FillTool), failureMessage);
+    } else {
+        // TODO: switch tools via the popup menu
+        canvas->setTool(tool);
+    }
+    QCOMPARE(canvas->fillTolerance(), 0);
+    const auto restoreFillTolerance = qScopeGuard([&]() {
+        canvas->setFillTolerance(0);
+    });
+    canvas->setPenForegroundColour(Qt::red);
+    setCursorPosInScenePixels(0, 0);
+
+    for (const int tolerance : { 0, 10 }) {
+        canvas->setFillTolerance(tolerance);
+        if (greedy) {
+            QTest::mouseMove(window, cursorWindowPos);
+            QTest::keyPress(window, Qt::Key_Shift);
+            // For some reason there must be a delay in order for the shift modifier to work.
+            QTest::mouseClick(window, Qt::LeftButton, Qt::NoModifier, cursorWindowPos, 100);
+            QTest::keyRelease(window, Qt::Key_Shift);
+        } else {
+            mouseEvent(canvas, cursorWindowPos, MouseClick);
+        }
+
+        // Without any tolerance, only the white pixels should be filled. With enough tolerance,
+        // the off-white pixels should be filled too, but never the black ones.
+        image = canvas->currentProjectImage();
+        for (int y = 0; y < image->height(); ++y) {
+            for (int x = 0; x < image->width(); ++x) {
+                const bool reachable = x < 20 || greedy;
+                const bool wall = x >= 20 && x < 30;
+                const bool offWhite = (x >= 10 && x < 20) || x >= 35;
+                const bool filled = reachable && !wall && (!offWhite || tolerance > 0);
+                const QColor colour = image->pixelColor(x, y);
+                const QColor originalColour = originalImage.pixelColor(x, y);
+                if (!filled) {
+                    QVERIFY2(colour == originalColour, qPrintable(QString::fromLatin1(
+                        "Expected pixel at %1, %2 to be unchanged with tolerance %3").arg(x).arg(y).arg(tolerance)));
+                } else if (tool == ImageCanvas::FillTool) {
+                    QVERIFY2(colour == QColor(Qt::red), qPrintable(QString::fromLatin1(
+                        "Expected pixel at %1, %2 to be filled with tolerance %3").arg(x).arg(y).arg(tolerance)));
+                } else {
+                    // Textured fills vary the colour, so just check that something was drawn.
+                    QVERIFY2(colour != originalColour, qPrintable(QString::fromLatin1(
+                        "Expected pixel at %1, %2 to be filled with tolerance %3").arg(x).arg(y).arg(tolerance)));
+                }
+            }
+        }
+
+        mouseEventOnCentre(undoButton, MouseClick);
+        QCOMPARE(*canvas->currentProjectImage(), originalImage);
+    }
+}
+
+namespace {
+
+bool pixelWithinTolerance(QRgb pixel, QRgb target, int tolerance)
+{
+    return qAbs(qRed(pixel) - qRed(target)) <= tolerance
+        && qAbs(qGreen(pixel) - qGreen(target)) <= tolerance
+        && qAbs(qBlue(pixel) - qBlue(target)) <= tolerance
+        && qAbs(qAlpha(pixel) - qAlpha(target)) <= tolerance;
+}
+
+// Fills every pixel of the image with an opaque colour that is unique
+// within the image, so that any misplaced pixel shows up in comparisons.
+void fillWithUniquePattern(QImage *image, int layerIndex)
+{
+    for (int y = 0; y < image->height(); ++y) {
+        for (int x = 0; x < image->width(); ++x)
+            image->setPixelColor(x, y, QColor(x * 8 % 256, y * 8 % 256, 64 + layerIndex * 64));
+    }
+}
+
+}
+
+void tst_App::pixelKernelsMatchScalarReference_data()
+{
+    QTest::addColumn<int>("instructionSet");
+    QTest::addColumn<int>("tolerance");
+
+    const QVector<QPair<PixelKernels::InstructionSet, QString>> instructionSets = {
+        { PixelKernels::ScalarInstructionSet, QLatin1String("Scalar") },
+        { PixelKernels::Sse2InstructionSet, QLatin1String("SSE2") },
+        { PixelKernels::Avx2InstructionSet, QLatin1String("AVX2") }
+    };
+    for (const auto &instructionSet : instructionSets) {
+        for (const int tolerance : { 0, 3 }) {
+            QTest::newRow(qPrintable(QString::fromLatin1("%1, tolerance %2").arg(instructionSet.second).arg(tolerance)))
+                << int(instructionSet.first) << tolerance;
+        }
+    }
+}
+
+void tst_App::pixelKernelsMatchScalarReference()
+{
+    QFETCH(int, instructionSet);
+    QFETCH(int, tolerance);
+
+    const PixelKernels::InstructionSet oldInstructionSet = PixelKernels::instructionSet();
+    if (!PixelKernels::setInstructionSet(PixelKernels::InstructionSet(instructionSet)))
+        QSKIP("The CPU doesn't support this instruction set");
+    const auto restoreInstructionSet = qScopeGuard([=]() {
+        PixelKernels::setInstructionSet(oldInstructionSet);
+    });
+
+    const QRgb target = qRgba(100, 150, 200, 128);
+    // Within a tolerance of 3, but not identical.
+    const QRgb nearTarget = qRgba(102, 147, 201, 129);
+    const QRgb farFromTarget = qRgba(100, 150, 210, 128);
+    const QRgb replacement = qRgba(255, 0, 0, 255);
+
+    // Every count up to a few blocks of the widest kernel, so that each possible
+    // length of the scalar tail is covered, and the different pixel at every position within them.
+    for (int count = 1; count <= 41; ++count) {
+        for (int differentIndex = 0; differentIndex <= count; ++differentIndex) {
+            for (const bool matching : { true, false }) {
+                // Look for the one pixel that differs from the rest (or none, if differentIndex is count).
+                QVector<QRgb> pixels(count, matching ? farFromTarget : nearTarget);
+                if (differentIndex < count)
+                    pixels[differentIndex] = matching ? nearTarget : farFromTarget;
+
+                int expectedIndex = count;
+                for (int i = 0; i < count; ++i) {
+                    if (pixelWithinTolerance(pixels.at(i), target, tolerance) == matching) {
+                        expectedIndex = i;
+                        break;
+                    }
+                }
+                QCOMPARE(PixelKernels::findPixel(pixels.constData(), count, target, tolerance, matching), expectedIndex);
+            }
+        }
+
+        QRandomGenerator generator(count);
+        const QRgb choices[] = { target, nearTarget, farFromTarget, replacement };
+        QVector<QRgb> pixels(count);
+        for (int i = 0; i < count; ++i)
+            pixels[i] = choices[generator.bounded(4)];
+
+        QVector<QRgb> expectedPixels = pixels;
+        int expectedReplaced = 0;
+        int expectedFirstIndex = -1;
+        int expectedLastIndex = -1;
+        for (int i = 0; i < count; ++i) {
+            if (pixelWithinTolerance(expectedPixels.at(i), target, tolerance)) {
+                expectedPixels[i] = replacement;
+                ++expectedReplaced;
+                if (expectedFirstIndex == -1)
+                    expectedFirstIndex = i;
+                expectedLastIndex = i;
+            }
+        }
+
+        int firstIndex = -1;
+        int lastIndex = -1;
+        QCOMPARE(PixelKernels::replacePixels(pixels.data(), count, target, tolerance, replacement,
+            &firstIndex, &lastIndex), expectedReplaced);
+        QCOMPARE(pixels, expectedPixels);
+        QCOMPARE(firstIndex, expectedFirstIndex);
+        QCOMPARE(lastIndex, expectedLastIndex);
+    }
+}
+
+void tst_App::greedyPixelFillInPlaceAcrossBands_data()
+{
+    QTest::addColumn<int>("tolerance");
+
+    QTest::newRow("exact") << 0;
+    QTest::newRow("tolerance") << 3;
+}
+
+void tst_App::greedyPixelFillInPlaceAcrossBands()
+{
+    QFETCH(int, tolerance);
+
+    // Large enough to be split into bands of rows that are filled on separate threads.
+    QImage image(600, 600, QImage::Format_ARGB32_Premultiplied);
+    const QColor targetColour(100, 150, 200);
+    const QColor nearTargetColour(102, 147, 201);
+    const QColor otherColour(Qt::black);
+    const QColor replacementColour(Qt::red);
+    image.fill(otherColour);
+
+    // Keep the matching pixels away from the edges so that the returned rect is meaningful.
+    const QRect patternArea(20, 30, 500, 400);
+    QRandomGenerator generator(1);
+    const QColor choices[] = { targetColour, nearTargetColour, otherColour };
+    for (int y = patternArea.top(); y <= patternArea.bottom(); ++y) {
+        for (int x = patternArea.left(); x <= patternArea.right(); ++x)
+            image.setPixelColor(x, y, choices[generator.bounded(3)]);
+    }
+
+    // Leave a margin on each side so that the bounds are honoured too.
+    const QRect bounds(25, 10, 550, 580);
+    QImage expectedImage = image;
+    QRect expectedDirtyRect;
+    for (int y = bounds.top(); y <= bounds.bottom(); ++y) {
+        for (int x = bounds.left(); x <= bounds.right(); ++x) {
+            if (pixelWithinTolerance(expectedImage.pixel(x, y), targetColour.rgba(), tolerance)) {
+                expectedImage.setPixelColor(x, y, replacementColour);
+                expectedDirtyRect |= QRect(x, y, 1, 1);
+            }
+        }
+    }
+
+    const QRect dirtyRect = imageGreedyPixelFillInPlace(&image, bounds, targetColour, replacementColour, tolerance);
+    QCOMPARE(dirtyRect, expectedDirtyRect);
+    QCOMPARE(image, expectedImage);
+}
+
+void tst_App::undoHistoryStaysWithinMemoryBudget_data()
+{
+    addImageProjectTypes();
+}
+
+void tst_App::undoHistoryStaysWithinMemoryBudget()
+{
+    QFETCH(Project::Type, projectType);
+
+    QVERIFY2(createNewProject(projectType), failureMessage);
+
+    // Each fill below keeps a copy of the whole 1 MB image for undoing.
+    QVERIFY2(changeCanvasSize(512, 512), failureMessage);
+    const QImage imageBeforeFills = *canvas->currentProjectImage();
+
+    const int oldUndoMemoryBudget = app.settings()->undoMemoryBudget();
+    app.settings()->setUndoMemoryBudget(1);
+    const auto restoreSettings = qScopeGuard([&]() {
+        app.settings()->setUndoMemoryBudget(oldUndoMemoryBudget);
+    });
+
+    QVERIFY2(switchTool(ImageCanvas::FillTool), failureMessage);
+    setCursorPosInScenePixels(0, 0);
+    const QVector<QColor> colours = { Qt::red, Qt::blue, Qt::red, Qt::blue };
+    for (const QColor &colour : colours) {
+        canvas->setPenForegroundColour(colour);
+        mouseEvent(canvas, cursorWindowPos, MouseClick);
+        QCOMPARE(canvas->currentProjectImage()->pixelColor(511, 511), colour);
+        QVERIFY(project->undoMemoryUsage() <= 1024 * 1024);
+    }
+
+    // The history should have been compressed rather than dropped,
+    // so undoing every fill should get back the original image.
+    for (int i = 0; i < colours.size(); ++i)
+        mouseEventOnCentre(undoButton, MouseClick);
+    QCOMPARE(*canvas->currentProjectImage(), imageBeforeFills);
+}
+
+void tst_App::undoHistorySpillsToDisk_data()
+{
+    addImageProjectTypes();
+}
+
+void tst_App::undoHistorySpillsToDisk()
+{
+    QFETCH(Project::Type, projectType);
+
+    QVERIFY2(createNewProject(projectType), failureMessage);
+
+    // Noise doesn't compress, so the only way to stay within the budget
+    // without dropping history is to move it to disk.
+    QVERIFY2(changeCanvasSize(600, 600), failureMessage);
+    QImage *image = canvas->currentProjectImage();
+    QRandomGenerator generator(1);
+    for (int y = 0; y < image->height(); ++y) {
+        for (int x = 0; x < image->width(); ++x)
+            image->setPixel(x, y, generator.generate() | 0xff000000);
+    }
+    const QImage noiseImage = *image;
+
+    const int oldUndoMemoryBudget = app.settings()->undoMemoryBudget();
+    const bool oldUndoSpillEnabled = app.settings()->isUndoSpillEnabled();
+    app.settings()->setUndoMemoryBudget(1);
+    app.settings()->setUndoSpillEnabled(true);
+    const auto restoreSettings = qScopeGuard([&]() {
+        app.settings()->setUndoSpillEnabled(oldUndoSpillEnabled);
+        app.settings()->setUndoMemoryBudget(oldUndoMemoryBudget);
+    });
+
+    QVERIFY2(changeCanvasSize(700, 700), failureMessage);
+    QVERIFY(project->undoMemoryUsage() <= 1024 * 1024);
+
+    // The previous image should be read back from disk.
+    mouseEventOnCentre(undoButton, MouseClick);
+    QCOMPARE(*canvas->currentProjectImage(), noiseImage);
+}
+
+void tst_App::undoSwapFileReusesFreeSpace()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    QSharedPointer<UndoSwapFile> file(new UndoSwapFile(tempDir.filePath(QLatin1String("undo.swap"))));
+    QVERIFY(file->isOpen());
+    const auto fileSize = [&]() { return QFileInfo(file->fileName()).size(); };
+
+    QSharedPointer<UndoSwapRegion> a = UndoSwapRegion::write(file, QByteArray(100, 'a'));
+    QSharedPointer<UndoSwapRegion> b = UndoSwapRegion::write(file, QByteArray(100, 'b'));
+    QSharedPointer<UndoSwapRegion> c = UndoSwapRegion::write(file, QByteArray(100, 'c'));
+    QCOMPARE(fileSize(), qint64(300));
+
+    // A smaller payload should go into the space that a freed one leaves behind.
+    a.reset();
+    QCOMPARE(file->usedBytes(), qint64(200));
+    QCOMPARE(fileSize(), qint64(300));
+    QSharedPointer<UndoSwapRegion> d = UndoSwapRegion::write(file, QByteArray(60, 'd'));
+    QCOMPARE(fileSize(), qint64(300));
+
+    // Adjacent free regions are merged, so the 40 bytes left over
+    // from the first region and b's 100 bytes can hold 140 bytes.
+    b.reset();
+    QSharedPointer<UndoSwapRegion> e = UndoSwapRegion::write(file, QByteArray(140, 'e'));
+    QCOMPARE(fileSize(), qint64(300));
+    QCOMPARE(d->read(), QByteArray(60, 'd'));
+    QCOMPARE(e->read(), QByteArray(140, 'e'));
+    QCOMPARE(c->read(), QByteArray(100, 'c'));
+
+    // Free space at the end of the file is given back.
+    c.reset();
+    QCOMPARE(fileSize(), qint64(200));
+    d.reset();
+    e.reset();
+    QCOMPARE(file->usedBytes(), qint64(0));
+    QCOMPARE(fileSize(), qint64(0));
+}
+
+void tst_App::undoHistoryJumpsViaCheckpoints_data()
+{
+    addImageProjectTypes();
+}
+
+void tst_App::undoHistoryJumpsViaCheckpoints()
+{
+    QFETCH(Project::Type, projectType);
+
+    QVERIFY2(createNewProject(projectType), failureMessage);
+
+    // Make enough history for several checkpoints, keeping track of
+    // what the image should look like at each index.
+    QMap<int, QImage> imagesAtIndex;
+    imagesAtIndex.insert(project->undoStack()->index(), *canvas->currentProjectImage());
+    QVERIFY2(changeCanvasSize(50, 50), failureMessage);
+    imagesAtIndex.insert(project->undoStack()->index(), *canvas->currentProjectImage());
+    const auto checkpointUsage = [&]() -> qint64 {
+        qint64 commandUsage = 0;
+        for (const QVariant &command : project->undoMemoryBreakdown())
+            commandUsage += command.toMap().value(QLatin1String("byteSize")).toLongLong();
+        return project->undoMemoryUsage() - commandUsage;
+    };
+    const qint64 imageByteSize = canvas->currentProjectImage()->sizeInBytes();
+    for (int i = 0; i < 50; ++i) {
+        setCursorPosInScenePixels(i, i);
+        QVERIFY2(drawPixelAtCursorPos(), failureMessage);
+        const int index = project->undoStack()->index();
+        imagesAtIndex.insert(index, *canvas->currentProjectImage());
+
+        // A checkpoint is made every 16 commands. Each one shares the image with the project
+        // until it's edited, after which its copy of the image counts towards the memory usage.
+        QCOMPARE(checkpointUsage(), qMax(0, (index - 1) / 16) * imageByteSize);
+    }
+
+    const QVector<int> indices = { 0, imagesAtIndex.lastKey(), 5, 40, 17, 33, 1, 48 };
+    for (const int index : indices) {
+        project->setUndoIndex(index);
+        QCOMPARE(project->undoStack()->index(), index);
+        QCOMPARE(*canvas->currentProjectImage(), imagesAtIndex.value(index));
+    }
+}
+
+void tst_App::undoMemoryUsage()
+{
+    QVERIFY2(createNewLayeredImageProject(100, 100), failureMessage);
+    QVERIFY2(togglePanel("layerPanel", true), failureMessage);
+    QCOMPARE(project->undoMemoryUsage(), qint64(0));
+    QCOMPARE(project->peakUndoMemoryUsage(), qint64(0));
+    QVERIFY(project->undoMemoryBreakdown().isEmpty());
+
+    // Adding a layer costs nothing until it's undone, at which point the command owns it.
+    mouseEventOnCentre(newLayerButton, MouseClick);
+    QCOMPARE(layeredImageProject->layerCount(), 2);
+    QCOMPARE(project->undoMemoryUsage(), qint64(0));
+
+    const qint64 layerByteSize = layeredImageProject->layerAt(0)->image()->sizeInBytes();
+    QSignalSpy usageChangedSpy(project, SIGNAL(undoMemoryUsageChanged()));
+    mouseEventOnCentre(undoButton, MouseClick);
+    QCOMPARE(layeredImageProject->layerCount(), 1);
+    QCOMPARE(usageChangedSpy.count(), 1);
+    QCOMPARE(project->undoMemoryUsage(), layerByteSize);
+    QCOMPARE(project->peakUndoMemoryUsage(), layerByteSize);
+
+    const QVariantList breakdown = project->undoMemoryBreakdown();
+    QCOMPARE(breakdown.size(), 1);
+    QCOMPARE(breakdown.first().toMap().value(QLatin1String("byteSize")).toLongLong(), layerByteSize);
+
+    // Redoing gives the layer back to the project, but the peak should remain.
+    mouseEventOnCentre(redoButton, MouseClick);
+    QCOMPARE(layeredImageProject->layerCount(), 2);
+    QCOMPARE(project->undoMemoryUsage(), qint64(0));
+    QCOMPARE(project->peakUndoMemoryUsage(), layerByteSize);
+
+    // The running total should match the sum of the commands after pushes, merges and undos.
+    setCursorPosInScenePixels(0, 0);
+    QTest::mouseClick(window, Qt::LeftButton, Qt::NoModifier, cursorWindowPos);
+    setCursorPosInScenePixels(10, 10);
+    QTest::mouseClick(window, Qt::LeftButton, Qt::NoModifier, cursorWindowPos);
+    mouseEventOnCentre(undoButton, MouseClick);
+    mouseEventOnCentre(undoButton, MouseClick);
+    mouseEventOnCentre(newLayerButton, MouseClick);
+    mouseEventOnCentre(undoButton, MouseClick);
+    qint64 breakdownUsage = 0;
+    for (const QVariant &command : project->undoMemoryBreakdown())
+        breakdownUsage += command.toMap().value(QLatin1String("byteSize")).toLongLong();
+    QCOMPARE(project->undoMemoryUsage(), breakdownUsage);
+}
+
+void tst_App::undoMemoryUsageOfSharedImages()
+{
+    QVERIFY2(createNewImageProject(100, 100), failureMessage);
+    const qint64 previousByteSize = canvas->currentProjectImage()->sizeInBytes();
+    const auto commandUsage = [&]() {
+        const QVariantList breakdown = project->undoMemoryBreakdown();
+        return breakdown.isEmpty() ? qint64(0) : breakdown.last().toMap().value(QLatin1String("byteSize")).toLongLong();
+    };
+
+    // The resize command's new image is the project's image, so it doesn't cost anything extra...
+    QVERIFY2(changeCanvasSize(200, 200), failureMessage);
+    const qint64 newByteSize = canvas->currentProjectImage()->sizeInBytes();
+    QCOMPARE(project->undoMemoryBreakdown().size(), 1);
+    QCOMPARE(commandUsage(), previousByteSize);
+    QCOMPARE(project->undoMemoryUsage(), previousByteSize);
+
+    // ... until the project's image is edited, at which point the command holds a copy of its own.
+    setCursorPosInScenePixels(0, 0);
+    QVERIFY2(drawPixelAtCursorPos(), failureMessage);
+    QCOMPARE(project->undoMemoryBreakdown().first().toMap().value(QLatin1String("byteSize")).toLongLong(),
+        previousByteSize + newByteSize);
+
+    // Undoing both gives the previous image back to the project, so then it's the one that isn't counted.
+    mouseEventOnCentre(undoButton, MouseClick);
+    mouseEventOnCentre(undoButton, MouseClick);
+    QCOMPARE(canvas->currentProjectImage()->size(), QSize(100, 100));
+    QCOMPARE(project->undoMemoryBreakdown().first().toMap().value(QLatin1String("byteSize")).toLongLong(), newByteSize);
+
+    qint64 breakdownUsage = 0;
+    for (const QVariant &command : project->undoMemoryBreakdown())
+        breakdownUsage += command.toMap().value(QLatin1String("byteSize")).toLongLong();
+    QCOMPARE(project->undoMemoryUsage(), breakdownUsage);
+}
+
+void tst_App::penRequestsAreaRepaint_data()
+{
+    addImageProjectTypes();
+}
+
+void tst_App::penRequestsAreaRepaint()
+{
+    QFETCH(Project::Type, projectType);
+
+    QVERIFY2(createNewProject(projectType), failureMessage);
+    QVERIFY2(changeCanvasSize(100, 100), failureMessage);
+
+    QSignalSpy paintRequestedSpy(canvas, SIGNAL(contentPaintRequested(int,QRect)));
+    setCursorPosInScenePixels(50, 50);
+    QVERIFY2(drawPixelAtCursorPos(), failureMessage);
+    QCOMPARE(canvas->currentProjectImage()->pixelColor(50, 50), QColor(Qt::black));
+
+    // Drawing a pixel should only cause the area around it to be repainted.
+    bool requestedAreaRepaint = false;
+    for (const QList<QVariant> &arguments : qAsConst(paintRequestedSpy)) {
+        const QRect sceneArea = arguments.at(1).toRect();
+        if (!sceneArea.isNull()) {
+            QVERIFY(sceneArea.contains(50, 50));
+            QVERIFY(sceneArea.width() < 100 && sceneArea.height() < 100);
+            requestedAreaRepaint = true;
+        }
+    }
+    QVERIFY(requestedAreaRepaint);
+}
+
+void tst_App::layeredContentImageMatchesFlattenedImage()
+{
+    QVERIFY2(createNewLayeredImageProject(12, 12), failureMessage);
+    QVERIFY2(togglePanel("layerPanel", true), failureMessage);
+
+    mouseEventOnCentre(newLayerButton, MouseClick);
+    mouseEventOnCentre(newLayerButton, MouseClick);
+    QCOMPARE(layeredImageProject->layerCount(), 3);
+
+    // Give each layer a pixel of its own, and one that overlaps with the others.
+    const QStringList layerNames = { "Layer 3", "Layer 2", "Layer 1" };
+    const QVector<QColor> colours = { Qt::red, Qt::green, Qt::blue };
+    for (int layerIndex = 0; layerIndex < layerNames.size(); ++layerIndex) {
+        QVERIFY2(selectLayer(layerNames.at(layerIndex), layerIndex), failureMessage);
+        canvas->setPenForegroundColour(colours.at(layerIndex));
+        setCursorPosInScenePixels(layerIndex, layerIndex);
+        QVERIFY2(drawPixelAtCursorPos(), failureMessage);
+        setCursorPosInScenePixels(5, 5);
+        QVERIFY2(drawPixelAtCursorPos(), failureMessage);
+    }
+    QCOMPARE(canvas->contentImage(), layeredImageProject->flattenedImage());
+    QCOMPARE(canvas->contentImage().pixelColor(5, 5), QColor(Qt::red));
+
+    // Draw on the middle layer, which is between the cached layers.
+    QVERIFY2(selectLayer("Layer 2", 1), failureMessage);
+    canvas->setPenForegroundColour(Qt::black);
+    setCursorPosInScenePixels(6, 6);
+    QVERIFY2(drawPixelAtCursorPos(), failureMessage);
+    QCOMPARE(canvas->contentImage(), layeredImageProject->flattenedImage());
+
+    // Hide the top layer.
+    layeredImageProject->layerAt(0)->setVisible(false);
+    QCOMPARE(canvas->contentImage().pixelColor(5, 5), QColor(Qt::green));
+    QCOMPARE(canvas->contentImage(), layeredImageProject->flattenedImage());
+    layeredImageProject->layerAt(0)->setVisible(true);
+    QCOMPARE(canvas->contentImage(), layeredImageProject->flattenedImage());
+
+    // Undoing the drawing on the middle layer while another layer is current
+    // changes one of the cached layers.
+    QVERIFY2(selectLayer("Layer 3", 0), failureMessage);
+    mouseEventOnCentre(undoButton, MouseClick);
+    QCOMPARE(canvas->contentImage().pixelColor(6, 6), QColor(Qt::white));
+    QCOMPARE(canvas->contentImage(), layeredImageProject->flattenedImage());
+}
+
+void tst_App::layerCompositorRecompositesDirtyBlocks()
+{
+    QImage bottomImage(300, 300, QImage::Format_ARGB32_Premultiplied);
+    bottomImage.fill(Qt::white);
+    QImage topImage(300, 300, QImage::Format_ARGB32_Premultiplied);
+    topImage.fill(Qt::transparent);
+    topImage.setPixelColor(10, 10, Qt::red);
+
+    auto flatten = [&]() -> QImage {
+        QImage image(300, 300, QImage::Format_ARGB32_Premultiplied);
+        image.fill(Qt::transparent);
+        QPainter painter(&image);
+        painter.drawImage(0, 0, bottomImage);
+        painter.drawImage(0, 0, topImage);
+        return image;
+    };
+
+    // 300x300 with a block size of 128 gives 3x3 blocks.
+    LayerCompositor compositor(128);
+    const QVector<const QImage*> images = { &bottomImage, &topImage };
+    QCOMPARE(compositor.composite(images, bottomImage.size()), flatten());
+    QCOMPARE(compositor.lastRecompositedBlockCount(), 9);
+
+    // Nothing changed.
+    QCOMPARE(compositor.composite(images, bottomImage.size()), flatten());
+    QCOMPARE(compositor.lastRecompositedBlockCount(), 0);
+
+    // Only the block containing the change should be recomposited.
+    qint64 cacheKeyBeforeChange = topImage.cacheKey();
+    topImage.setPixelColor(200, 200, Qt::blue);
+    compositor.markDirty(&topImage, QRect(200, 200, 1, 1), cacheKeyBeforeChange);
+    QCOMPARE(compositor.composite(images, bottomImage.size()), flatten());
+    QCOMPARE(compositor.lastRecompositedBlockCount(), 1);
+
+    // An area that straddles blocks.
+    cacheKeyBeforeChange = topImage.cacheKey();
+    topImage.setPixelColor(127, 127, Qt::green);
+    topImage.setPixelColor(128, 128, Qt::green);
+    compositor.markDirty(&topImage, QRect(127, 127, 2, 2), cacheKeyBeforeChange);
+    QCOMPARE(compositor.composite(images, bottomImage.size()), flatten());
+    QCOMPARE(compositor.lastRecompositedBlockCount(), 4);
+
+    // A change that we weren't told about should cause everything to be recomposited.
+    bottomImage.setPixelColor(299, 0, Qt::black);
+    QCOMPARE(compositor.composite(images, bottomImage.size()), flatten());
+    QCOMPARE(compositor.lastRecompositedBlockCount(), 9);
+
+    // Even if a change that we are told about comes after it.
+    topImage.setPixelColor(0, 299, Qt::black);
+    cacheKeyBeforeChange = topImage.cacheKey();
+    topImage.setPixelColor(10, 10, Qt::red);
+    compositor.markDirty(&topImage, QRect(10, 10, 1, 1), cacheKeyBeforeChange);
+    QCOMPARE(compositor.composite(images, bottomImage.size()), flatten());
+    QCOMPARE(compositor.lastRecompositedBlockCount(), 9);
+
+    // As should a change in the set of images.
+    QCOMPARE(compositor.composite({ &bottomImage }, bottomImage.size()).pixelColor(10, 10), QColor(Qt::white));
+    QCOMPARE(compositor.lastRecompositedBlockCount(), 9);
+}
+
+void tst_App::textureCanvasRendering()
+{
+    const bool oldTextureCanvasRenderingEnabled = app.settings()->isTextureCanvasRenderingEnabled();
+    app.settings()->setTextureCanvasRenderingEnabled(true);
+    const auto restoreSettings = qScopeGuard([&]() {
+        app.settings()->setTextureCanvasRenderingEnabled(oldTextureCanvasRenderingEnabled);
+    });
+
+    QVERIFY2(createNewProject(Project::ImageType), failureMessage);
+    QVERIFY2(changeCanvasSize(100, 100), failureMessage);
+    QVERIFY(canvas->findChild<TextureCanvasPaneItem*>());
+    QVERIFY(!canvas->findChild<CanvasPaneItem*>());
+
+    canvas->setPenForegroundColour(Qt::red);
+    setCursorPosInScenePixels(60, 10);
+    QVERIFY2(drawPixelAtCursorPos(), failureMessage);
+
+    // The pixel should end up on screen where the pane says it is.
+    const CanvasPane *pane = canvas->firstPane();
+    const int zoomLevel = pane->integerZoomLevel();
+    const QPoint pixelCentreInCanvas = pane->integerOffset()
+        + QPoint(60 * zoomLevel + zoomLevel / 2, 10 * zoomLevel + zoomLevel / 2);
+    const QImage grabbedImage = window->grabWindow();
+    const QPoint pixelCentreInWindow = canvas->mapToScene(pixelCentreInCanvas).toPoint();
+    QCOMPARE(grabbedImage.pixelColor(pixelCentreInWindow * grabbedImage.devicePixelRatio()), QColor(Qt::red));
+}
+
+void tst_App::tileChunkCacheInvalidation()
+{
+    // 40x20 tiles with chunks of 16x16 tiles gives 3x2 chunks.
+    QVector<int> tiles(40 * 20, -1);
+    tiles[0] = 1;
+    tiles[5] = 2;
+    tiles[18 * 40 + 35] = 1;
+
+    TileChunkCache cache(16);
+    cache.reset(40, 20, tiles);
+    QCOMPARE(cache.chunksWide(), 3);
+    QCOMPARE(cache.chunksHigh(), 2);
+    QCOMPARE(cache.cellsUsingTile(1), (QSet<int> { 0, 18 * 40 + 35 }));
+    QCOMPARE(cache.cellsUsingTile(2), QSet<int> { 5 });
+
+    QImage chunkImage(16, 16, QImage::Format_ARGB32_Premultiplied);
+    chunkImage.fill(Qt::red);
+    for (int chunkY = 0; chunkY < cache.chunksHigh(); ++chunkY) {
+        for (int chunkX = 0; chunkX < cache.chunksWide(); ++chunkX)
+            cache.insertChunkImage(QPoint(chunkX, chunkY), chunkImage);
+    }
+    QCOMPARE(cache.cachedChunkCount(), 6);
+
+    // Changing the image of a tile should only invalidate the chunks that use it.
+    cache.tileImageChanged(1);
+    QCOMPARE(cache.cachedChunkCount(), 4);
+    QVERIFY(cache.chunkImage(QPoint(0, 0)).isNull());
+    QVERIFY(cache.chunkImage(QPoint(2, 1)).isNull());
+    QCOMPARE(cache.chunkImage(QPoint(1, 0)), chunkImage);
+
+    // Tiles that aren't used shouldn't invalidate anything.
+    cache.tileImageChanged(3);
+    QCOMPARE(cache.cachedChunkCount(), 4);
+
+    // Changing a cell should update the index and invalidate the chunk that it's in.
+    cache.insertChunkImage(QPoint(0, 0), chunkImage);
+    cache.cellChanged(20, -1, 2);
+    QVERIFY(cache.chunkImage(QPoint(1, 0)).isNull());
+    QCOMPARE(cache.cellsUsingTile(2), (QSet<int> { 5, 20 }));
+
+    cache.cellChanged(5, 2, -1);
+    QVERIFY(cache.chunkImage(QPoint(0, 0)).isNull());
+    QCOMPARE(cache.cellsUsingTile(2), QSet<int> { 20 });
+}
+
+void tst_App::tileChunkCacheCapacity()
+{
+    // 64x64 tiles with chunks of 16x16 tiles gives 4x4 chunks.
+    TileChunkCache cache(16, 4 * 16 * 16 * 4);
+    cache.reset(64, 64, QVector<int>(64 * 64, -1));
+
+    QImage chunkImage(16, 16, QImage::Format_ARGB32_Premultiplied);
+    chunkImage.fill(Qt::red);
+    const QVector<QPoint> visibleChunks = { QPoint(0, 0), QPoint(1, 0), QPoint(2, 0),
+        QPoint(0, 1), QPoint(1, 1), QPoint(2, 1) };
+
+    // With only the default capacity, not every visible chunk fits.
+    for (const QPoint &chunkPos : visibleChunks)
+        cache.insertChunkImage(chunkPos, chunkImage);
+    QCOMPARE(cache.cachedChunkCount(), 4);
+
+    // Once the cache knows how much is visible, every visible chunk should stay cached.
+    cache.setVisibleChunkBytes(0, visibleChunks.size() * chunkImage.sizeInBytes());
+    QCOMPARE(qint64(cache.capacityInBytes()), visibleChunks.size() * chunkImage.sizeInBytes());
+    for (const QPoint &chunkPos : visibleChunks)
+        cache.insertChunkImage(chunkPos, chunkImage);
+    QCOMPARE(cache.cachedChunkCount(), visibleChunks.size());
+    for (const QPoint &chunkPos : visibleChunks)
+        QCOMPARE(cache.chunkImage(chunkPos), chunkImage);
+
+    // A second view (e.g. in split screen) shouldn't take room from the first.
+    cache.setVisibleChunkBytes(1, 2 * chunkImage.sizeInBytes());
+    QCOMPARE(qint64(cache.capacityInBytes()), (visibleChunks.size() + 2) * chunkImage.sizeInBytes());
+    cache.insertChunkImage(QPoint(3, 3), chunkImage);
+    cache.insertChunkImage(QPoint(3, 2), chunkImage);
+    QCOMPARE(cache.cachedChunkCount(), visibleChunks.size() + 2);
+    for (const QPoint &chunkPos : visibleChunks)
+        QCOMPARE(cache.chunkImage(chunkPos), chunkImage);
+
+    // The capacity should never drop below the default.
+    cache.setVisibleChunkBytes(0, 0);
+    cache.setVisibleChunkBytes(1, 0);
+    QCOMPARE(qint64(cache.capacityInBytes()), 4 * chunkImage.sizeInBytes());
+    QCOMPARE(cache.cachedChunkCount(), 4);
+}
+
+void tst_App::tilesetProjectChunkImages()
+{
+    QVERIFY2(createNewTilesetProject(), failureMessage);
+
+    const int tileWidth = tilesetProject->tileWidth();
+    const QImage blankChunkImage = tilesetProject->chunkImage(QPoint(0, 0));
+    QCOMPARE(blankChunkImage.pixelColor(tileWidth, 0), QColor(Qt::transparent));
+
+    // Placing a tile should cause its chunk to be re-rendered.
+    Tile *tile = tilesetProject->tilesetTileAtTilePos(QPoint(0, 0));
+    QVERIFY(tile);
+    tilesetProject->setTileAtPixelPos(QPoint(1, 0), tile->id());
+    QCOMPARE(tilesetProject->chunkImage(QPoint(0, 0)).pixelColor(tileWidth, 0), tile->pixelColor(0, 0));
+
+    // As should changing the image of a tile that's in it.
+    tilesetProject->tileset()->setPixelColor(tile->sourceRect().x(), tile->sourceRect().y(), Qt::red);
+    QCOMPARE(tilesetProject->chunkImage(QPoint(0, 0)).pixelColor(tileWidth, 0), QColor(Qt::red));
+}
+
+void tst_App::tileCanvasDrawsPartiallyVisibleTiles()
+{
+    QVERIFY2(createNewTilesetProject(), failureMessage);
+    TileCanvasPaneItem *paneItem = canvas->findChild<TileCanvasPaneItem*>();
+    QVERIFY(paneItem);
+
+    // Fractional zoom levels are rounded down when drawing.
+    CanvasPane *pane = canvas->firstPane();
+    pane->setZoomLevel(7.5);
+    const int zoomedTileWidth = tilesetProject->tileWidth() * pane->integerZoomLevel();
+    const int zoomedTileHeight = tilesetProject->tileHeight() * pane->integerZoomLevel();
+    const int paneWidth = canvas->paneWidth(0);
+    const int paneHeight = canvas->height();
+    // The map needs to extend past the pane for the edges to cut through tiles.
+    QVERIFY(tilesetProject->tilesWide() * zoomedTileWidth > paneWidth + zoomedTileWidth);
+    QVERIFY(tilesetProject->tilesHigh() * zoomedTileHeight > paneHeight + zoomedTileHeight);
+
+    // Scroll through a whole tile so that the right and bottom edges of the pane
+    // cut through tiles at every point, including right on their boundaries.
+    for (int offset = 0; offset <= zoomedTileWidth; ++offset) {
+        pane->setIntegerOffset(QPoint(-offset, -offset));
+        const QRect visibleTiles = paneItem->visibleTileArea();
+        QCOMPARE(visibleTiles.topLeft(), QPoint(offset / zoomedTileWidth, offset / zoomedTileHeight));
+        // The tile under the last pixel of the pane should be drawn, but nothing after it.
+        QCOMPARE(visibleTiles.right(), (offset + paneWidth - 1) / zoomedTileWidth);
+        QCOMPARE(visibleTiles.bottom(), (offset + paneHeight - 1) / zoomedTileHeight);
+    }
+}
+
+void tst_App::linePreviewOverlay_data()
+{
+    addImageProjectTypes();
+}
+
+void tst_App::linePreviewOverlay()
+{
+    QFETCH(Project::Type, projectType);
+
+    QVERIFY2(createNewProject(projectType), failureMessage);
+    QVERIFY2(changeCanvasSize(100, 100), failureMessage);
+
+    setCursorPosInScenePixels(10, 10);
+    QVERIFY2(drawPixelAtCursorPos(), failureMessage);
+    const QImage contentImageBeforeLine = canvas->contentImage();
+
+    QTest::keyPress(window, Qt::Key_Shift);
+    setCursorPosInScenePixels(20, 10);
+    QTest::mouseMove(window, cursorWindowPos);
+    QVERIFY(canvas->isLineVisible());
+
+    // The line should be drawn in an overlay that only covers it, rather than in the base content image.
+    QCOMPARE(canvas->baseContentImage(), contentImageBeforeLine);
+    QCOMPARE(canvas->contentImage().pixelColor(15, 10), QColor(Qt::black));
+    const QVector<ImageCanvas::ContentOverlay> overlays = canvas->contentOverlays();
+    QCOMPARE(overlays.size(), 1);
+    const ImageCanvas::ContentOverlay overlay = overlays.first();
+    QVERIFY(overlay.sceneArea.contains(QRect(10, 10, 11, 1)));
+    QVERIFY(overlay.sceneArea.width() < 50);
+    QVERIFY(overlay.sceneArea.height() < 50);
+    QCOMPARE(overlay.image.size(), overlay.sceneArea.size());
+    const QPoint overlayTopLeft = overlay.sceneArea.topLeft();
+    QCOMPARE(overlay.image.pixelColor(QPoint(15, 10) - overlayTopLeft), QColor(Qt::black));
+    QCOMPARE(overlay.image.pixelColor(QPoint(15, 12) - overlayTopLeft), contentImageBeforeLine.pixelColor(15, 12));
+
+    QTest::keyRelease(window, Qt::Key_Shift);
+    QVERIFY(canvas->contentOverlays().isEmpty());
+    QCOMPARE(canvas->contentImage().pixelColor(15, 10), contentImageBeforeLine.pixelColor(15, 10));
+}
+
+void tst_App::selectionPreviewOverlays_data()
+{
+    addImageProjectTypes();
+}
+
+void tst_App::selectionPreviewOverlays()
+{
+    QFETCH(Project::Type, projectType);
+
+    QVariantMap args;
+    args.insert("imageWidth", QVariant(100));
+    args.insert("imageHeight", QVariant(100));
+    args.insert("transparentImageBackground", QVariant(true));
+    QVERIFY2(createNewProject(projectType, args), failureMessage);
+
+    setCursorPosInScenePixels(2, 2);
+    QVERIFY2(drawPixelAtCursorPos(), failureMessage);
+    const QImage originalImage = *canvas->currentProjectImage();
+
+    // Select the pixel and move it to the right.
+    QVERIFY2(selectArea(QRect(0, 0, 5, 5)), failureMessage);
+    for (int i = 0; i < 10; ++i)
+        QTest::keyClick(window, Qt::Key_Right);
+    QCOMPARE(canvas->selectionArea(), QRect(10, 0, 5, 5));
+
+    // The layer shouldn't be touched until the move has been confirmed;
+    // the preview is drawn in overlays that only cover the area left behind and the area moved to.
+    QCOMPARE(*canvas->currentProjectImage(), originalImage);
+    const QVector<ImageCanvas::ContentOverlay> overlays = canvas->contentOverlays();
+    QCOMPARE(overlays.size(), 2);
+    QCOMPARE(overlays.at(0).sceneArea, QRect(0, 0, 5, 5));
+    QCOMPARE(overlays.at(0).image.pixelColor(2, 2), QColor(Qt::transparent));
+    QCOMPARE(overlays.at(1).sceneArea, QRect(10, 0, 5, 5));
+    QCOMPARE(overlays.at(1).image.pixelColor(2, 2), QColor(Qt::black));
+    const QImage contentImage = canvas->contentImage();
+    QCOMPARE(contentImage.pixelColor(2, 2), QColor(Qt::transparent));
+    QCOMPARE(contentImage.pixelColor(12, 2), QColor(Qt::black));
+
+    // Confirm the move.
+    QTest::keyClick(window, Qt::Key_Escape);
+    QCOMPARE(canvas->hasSelection(), false);
+    QVERIFY(canvas->contentOverlays().isEmpty());
+    QCOMPARE(canvas->currentProjectImage()->pixelColor(2, 2), QColor(Qt::transparent));
+    QCOMPARE(canvas->currentProjectImage()->pixelColor(12, 2), QColor(Qt::black));
+}
+
+void tst_App::inPlaceImagePortionOperations()
+{
+    QImage image(10, 10, QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::red);
+    const uchar *bits = image.constBits();
+
+    // The portion is partially outside of the image, so the changed area should be clipped.
+    QImage replacementImage(3, 3, QImage::Format_ARGB32_Premultiplied);
+    replacementImage.fill(Qt::blue);
+    QCOMPARE(Utils::paintImageOntoPortionOfImage(&image, QRect(8, 8, 3, 3), replacementImage), QRect(8, 8, 2, 2));
+    QCOMPARE(image.pixelColor(9, 9), QColor(Qt::blue));
+    QCOMPARE(image.pixelColor(7, 7), QColor(Qt::red));
+
+    QCOMPARE(Utils::erasePortionOfImage(&image, QRect(0, 0, 2, 2)), QRect(0, 0, 2, 2));
+    QCOMPARE(image.pixelColor(1, 1), QColor(Qt::transparent));
+    QCOMPARE(image.pixelColor(2, 2), QColor(Qt::red));
+
+    replacementImage.fill(Qt::transparent);
+    QCOMPARE(Utils::replacePortionOfImage(&image, QRect(4, 4, 3, 3), replacementImage), QRect(4, 4, 3, 3));
+    QCOMPARE(image.pixelColor(5, 5), QColor(Qt::transparent));
+    QCOMPARE(image.pixelColor(7, 5), QColor(Qt::red));
+
+    // Nothing should change if the portion is completely outside of the image.
+    QCOMPARE(Utils::erasePortionOfImage(&image, QRect(20, 20, 2, 2)), QRect());
+
+    // The image was never shared, so it should have been modified in place rather than copied.
+    QCOMPARE(image.constBits(), bits);
+}
+
+void tst_App::modifyHslMatchesPixelColourConversion_data()
+{
+    QTest::addColumn<int>("format");
+
+    QTest::newRow("ARGB32") << int(QImage::Format_ARGB32);
+    QTest::newRow("ARGB32_Premultiplied") << int(QImage::Format_ARGB32_Premultiplied);
+    QTest::newRow("RGB32") << int(QImage::Format_RGB32);
+}
+
+void tst_App::modifyHslMatchesPixelColourConversion()
+{
+    QFETCH(int, format);
+
+    // Big enough to be split up into bands that are adjusted on separate threads.
+    QImage image(400, 400, QImage::Format(format));
+    const QVector<QColor> colours = { QColor(Qt::red), QColor(10, 200, 30, 128), QColor(Qt::transparent), QColor(250, 250, 5) };
+    for (int y = 0; y < image.height(); ++y) {
+        for (int x = 0; x < image.width(); ++x)
+            image.setPixelColor(x, y, colours.at((x / 7 + y) % colours.size()));
+    }
+
+    const qreal hue = 0.1;
+    const qreal saturation = -0.2;
+    const qreal lightness = 0.05;
+
+    // The adjusted pixels should be exactly what adjusting each one via QColor would give.
+    QImage expectedImage = image;
+    for (int y = 0; y < expectedImage.height(); ++y) {
+        for (int x = 0; x < expectedImage.width(); ++x) {
+            const QColor rgb = expectedImage.pixelColor(x, y);
+            QColor hsl = rgb.toHsl();
+            hsl.setHslF(
+                qBound(0.0, hsl.hueF() + hue, 1.0),
+                qBound(0.0, hsl.saturationF() + saturation, 1.0),
+                qBound(0.0, hsl.lightnessF() + lightness, 1.0),
+                rgb.alphaF());
+            expectedImage.setPixelColor(x, y, hsl.toRgb());
+        }
+    }
+
+    QImage actualImage = image;
+    Utils::modifyHsl(actualImage, hue, saturation, lightness);
+    QCOMPARE(actualImage, expectedImage);
+    // The original shouldn't be touched.
+    QCOMPARE(image.pixelColor(0, 0), QColor(Qt::red));
+}
+
+void tst_App::modifySelectionHslOnWorkerThread_data()
+{
+    addImageProjectTypes();
+}
+
+void tst_App::modifySelectionHslOnWorkerThread()
+{
+    QFETCH(Project::Type, projectType);
+
+    QVERIFY2(createNewProject(projectType), failureMessage);
+
+    // Big enough that each adjustment takes a while on the worker thread.
+    const QRect area(0, 0, 200, 200);
+    QImage *image = canvas->currentProjectImage();
+    for (int y = area.top(); y <= area.bottom(); ++y) {
+        for (int x = area.left(); x <= area.right(); ++x)
+            image->setPixelColor(x, y, QColor::fromHsl((x + y) % 360, 200, 100));
+    }
+    const QImage originalContents = image->copy(area).convertToFormat(QImage::Format_ARGB32);
+    const auto adjustedContents = [&](qreal hue, qreal saturation, qreal lightness) {
+        QImage contents = originalContents;
+        Utils::modifyHsl(contents, hue, saturation, lightness);
+        return contents;
+    };
+    const auto selectionContents = [&]() {
+        return canvas->contentImage().copy(area).convertToFormat(QImage::Format_ARGB32);
+    };
+
+    QVERIFY2(selectArea(area), failureMessage);
+
+    // Rapid adjustments are coalesced, but the committed result should be that of the last one.
+    canvas->beginModifyingSelectionHsl();
+    QVERIFY(canvas->isAdjustingImage());
+    canvas->modifySelectionHsl(0.1, 0, 0);
+    canvas->modifySelectionHsl(0.2, 0.1, 0);
+    canvas->modifySelectionHsl(0.3, -0.1, 0.05);
+    canvas->endModifyingSelectionHsl(ImageCanvas::CommitAdjustment);
+    QVERIFY(!canvas->isAdjustingImage());
+    QCOMPARE(selectionContents(), adjustedContents(0.3, -0.1, 0.05));
+
+    // Committing while an adjustment is still running should wait for it to be applied.
+    const QImage contentsBeforeSecondAdjustment = selectionContents();
+    canvas->beginModifyingSelectionHsl();
+    canvas->modifySelectionHsl(-0.2, 0, 0);
+    canvas->endModifyingSelectionHsl(ImageCanvas::CommitAdjustment);
+    QImage expectedContents = contentsBeforeSecondAdjustment;
+    Utils::modifyHsl(expectedContents, -0.2, 0, 0);
+    QCOMPARE(selectionContents(), expectedContents);
+
+    // Rolling back while an adjustment is still running should leave the contents as they were,
+    // even once the worker thread finishes with it.
+    canvas->beginModifyingSelectionHsl();
+    canvas->modifySelectionHsl(0.5, 0.5, 0.5);
+    canvas->endModifyingSelectionHsl(ImageCanvas::RollbackAdjustment);
+    QCOMPARE(selectionContents(), expectedContents);
+    QTest::qWait(100);
+    QCOMPARE(selectionContents(), expectedContents);
+}
+
 void tst_App::greedyPixelFillImageCanvas_data()
 {
     addImageProjectTypes();
@@ -3852,6 +5181,19 @@ void tst_App::greedyPixelFillImageCanvas()
     QCOMPARE(canvas->currentProjectImage()->pixelColor(35, 35), QColor(Qt::blue));
     QCOMPARE(canvas->currentProjectImage()->pixelColor(4, 35), QColor(Qt::blue));
 
+    // Only the area that the fill touched should be kept for undoing, not the whole layer.
+    QUndoStack *undoStack = project->undoStack();
+    const QUndoCommand *fillMacro = undoStack->command(undoStack->index() - 1);
+    QVERIFY(fillMacro);
+    QCOMPARE(fillMacro->childCount(), 1);
+    const UndoCommand *fillCommand = dynamic_cast<const UndoCommand*>(fillMacro->child(0));
+    QVERIFY(fillCommand);
+    const QRect filledArea(QPoint(4, 4), QPoint(35, 35));
+    const int bytesPerPixel = canvas->currentProjectImage()->depth() / 8;
+    QVERIFY2(fillCommand->byteSize() <= filledArea.width() * filledArea.height() * bytesPerPixel,
+        qPrintable(QString::fromLatin1("Expected at most %1 bytes for undoing the fill, but got %2")
+            .arg(filledArea.width() * filledArea.height() * bytesPerPixel).arg(fillCommand->byteSize())));
+
     // Undo it.
     mouseEventOnCentre(undoButton, MouseClick);
     QCOMPARE(canvas->currentProjectImage()->pixelColor(4, 4), QColor(Qt::black));
@@ -3860,6 +5202,60 @@ void tst_App::greedyPixelFillImageCanvas()
     QCOMPARE(canvas->currentProjectImage()->pixelColor(4, 35), QColor(Qt::black));
 }
 
+void tst_App::greedyPixelFillTileCanvas()
+{
+    QVERIFY2(createNewTilesetProject(), failureMessage);
+    QVERIFY2(togglePanel("tilesetSwatchPanel", true), failureMessage);
+
+    QVERIFY2(switchMode(TileCanvas::TileMode), failureMessage);
+
+    // Select a blank tile to draw on.
+    QTest::mouseMove(window, tilesetTileSceneCentre(1, 0));
+    QTest::mouseClick(window, Qt::LeftButton, Qt::NoModifier, tilesetTileSceneCentre(1, 0));
+
+    // Draw the tile on so that we can operate on its pixels.
+    setCursorPosInTiles(0, 0);
+    QTest::mouseMove(window, cursorWindowPos);
+    QTest::mousePress(window, Qt::LeftButton, Qt::NoModifier, cursorWindowPos);
+    QTest::mouseRelease(window, Qt::LeftButton, Qt::NoModifier, cursorWindowPos);
+    QVERIFY(tilesetProject->tileAt(cursorPos));
+
+    // Draw two separate pixels.
+    setCursorPosInScenePixels(0, 0);
+    QVERIFY2(drawPixelAtCursorPos(), failureMessage);
+
+    setCursorPosInScenePixels(4, 4);
+    QVERIFY2(drawPixelAtCursorPos(), failureMessage);
+
+    const Tile *targetTile = tilesetProject->tileAt(cursorPos);
+    QVERIFY(targetTile);
+    const QColor black = QColor(Qt::black);
+    const QColor backgroundColour = targetTile->pixelColor(2, 2);
+    QCOMPARE(targetTile->pixelColor(0, 0), black);
+    QCOMPARE(targetTile->pixelColor(4, 4), black);
+    QVERIFY(backgroundColour != black);
+
+    // Greedy-fill one of them. Both should be filled, but nothing else.
+    QVERIFY2(switchTool(TileCanvas::FillTool), failureMessage);
+    setCursorPosInScenePixels(0, 0);
+    const QColor red = QColor(Qt::red);
+    tileCanvas->setPenForegroundColour(red);
+    QTest::mouseMove(window, cursorWindowPos);
+    QTest::keyPress(window, Qt::Key_Shift);
+    // For some reason there must be a delay in order for the shift modifier to work.
+    QTest::mouseClick(window, Qt::LeftButton, Qt::NoModifier, cursorWindowPos, 100);
+    QTest::keyRelease(window, Qt::Key_Shift);
+    QCOMPARE(targetTile->pixelColor(0, 0), red);
+    QCOMPARE(targetTile->pixelColor(4, 4), red);
+    QCOMPARE(targetTile->pixelColor(2, 2), backgroundColour);
+
+    // Undo it.
+    mouseEventOnCentre(undoButton, MouseClick);
+    QCOMPARE(targetTile->pixelColor(0, 0), black);
+    QCOMPARE(targetTile->pixelColor(4, 4), black);
+    QCOMPARE(targetTile->pixelColor(2, 2), backgroundColour);
+}
+
 void tst_App::texturedFill_data()
 {
     addImageProjectTypes();
@@ -3942,6 +5338,13 @@ void tst_App::texturedFill()
         }
     }
     QVERIFY(hasVariation);
+
+    // Undoing and then redoing the fill should produce exactly the same texture.
+    const QImage texturedImage = *canvas->currentProjectImage();
+    mouseEventOnCentre(undoButton, MouseClick);
+    QVERIFY(*canvas->currentProjectImage() != texturedImage);
+    mouseEventOnCentre(redoButton, MouseClick);
+    QCOMPARE(*canvas->currentProjectImage(), texturedImage);
 }
 
 void tst_App::pixelLineToolImageCanvas_data()
@@ -4018,6 +5421,50 @@ void tst_App::pixelLineToolImageCanvas()
     QCOMPARE(project->hasUnsavedChanges(), false);
 }
 
+void tst_App::penStrokeIsOneCommand_data()
+{
+    addImageProjectTypes();
+}
+
+void tst_App::penStrokeIsOneCommand()
+{
+    QFETCH(Project::Type, projectType);
+
+    QVERIFY2(createNewProject(projectType), failureMessage);
+
+    QVERIFY2(changeCanvasSize(200, 200), failureMessage);
+
+    QVERIFY2(switchTool(ImageCanvas::PenTool), failureMessage);
+
+    const QImage imageBeforeStroke = *canvas->currentProjectImage();
+    QUndoStack *undoStack = project->undoStack();
+    const int commandCountBeforeStroke = undoStack->count();
+
+    // Draw a long stroke that crosses several blocks.
+    setCursorPosInScenePixels(0, 0);
+    QTest::mouseMove(window, cursorWindowPos);
+    QTest::mousePress(window, Qt::LeftButton, Qt::NoModifier, cursorWindowPos);
+    for (int i = 10; i < 200; i += 10) {
+        setCursorPosInScenePixels(i, i);
+        QTest::mouseMove(window, cursorWindowPos);
+    }
+    QTest::mouseRelease(window, Qt::LeftButton, Qt::NoModifier, cursorWindowPos);
+    QCOMPARE(canvas->currentProjectImage()->pixelColor(0, 0), QColor(Qt::black));
+    QCOMPARE(canvas->currentProjectImage()->pixelColor(100, 100), QColor(Qt::black));
+    QCOMPARE(canvas->currentProjectImage()->pixelColor(190, 190), QColor(Qt::black));
+
+    // The whole stroke should be one macro containing one command.
+    QCOMPARE(undoStack->count(), commandCountBeforeStroke + 1);
+    QCOMPARE(undoStack->command(undoStack->count() - 1)->childCount(), 1);
+    const QImage imageAfterStroke = *canvas->currentProjectImage();
+
+    // Undoing it should restore every pixel, and redoing it should restore the stroke.
+    mouseEventOnCentre(undoButton, MouseClick);
+    QCOMPARE(*canvas->currentProjectImage(), imageBeforeStroke);
+    mouseEventOnCentre(redoButton, MouseClick);
+    QCOMPARE(*canvas->currentProjectImage(), imageAfterStroke);
+}
+
 void tst_App::pixelLineToolTransparent_data()
 {
     addImageProjectTypes();
@@ -5216,6 +6663,104 @@ void tst_App::undoMoveContentsOfVisibleLayers()
     QCOMPARE(layer2->image()->pixelColor(1, 0), QColor(Qt::blue));
 }
 
+void tst_App::undoLayeredImageCanvasSizeChange()
+{
+    QVERIFY2(createNewLayeredImageProject(20, 20), failureMessage);
+    QVERIFY2(togglePanel("layerPanel", true), failureMessage);
+
+    mouseEventOnCentre(newLayerButton, MouseClick);
+    mouseEventOnCentre(newLayerButton, MouseClick);
+    QCOMPARE(layeredImageProject->layerCount(), 3);
+
+    QVector<QImage> originalImages;
+    for (int i = 0; i < layeredImageProject->layerCount(); ++i) {
+        fillWithUniquePattern(layeredImageProject->layerAt(i)->image(), i);
+        originalImages.append(*layeredImageProject->layerAt(i)->image());
+    }
+
+    // Shrink the canvas so that pixels are cropped from the right and bottom of every layer.
+    QVERIFY2(changeCanvasSize(12, 9), failureMessage);
+    for (int i = 0; i < layeredImageProject->layerCount(); ++i)
+        QCOMPARE(*layeredImageProject->layerAt(i)->image(), originalImages.at(i).copy(0, 0, 12, 9));
+
+    // Undoing should restore every cropped pixel of every layer.
+    mouseEventOnCentre(undoButton, MouseClick);
+    QCOMPARE(layeredImageProject->size(), QSize(20, 20));
+    for (int i = 0; i < layeredImageProject->layerCount(); ++i)
+        QCOMPARE(*layeredImageProject->layerAt(i)->image(), originalImages.at(i));
+
+    mouseEventOnCentre(redoButton, MouseClick);
+    QCOMPARE(layeredImageProject->size(), QSize(12, 9));
+    for (int i = 0; i < layeredImageProject->layerCount(); ++i)
+        QCOMPARE(*layeredImageProject->layerAt(i)->image(), originalImages.at(i).copy(0, 0, 12, 9));
+
+    mouseEventOnCentre(undoButton, MouseClick);
+    for (int i = 0; i < layeredImageProject->layerCount(); ++i)
+        QCOMPARE(*layeredImageProject->layerAt(i)->image(), originalImages.at(i));
+}
+
+void tst_App::undoMoveContentsOffCanvas_data()
+{
+    QTest::addColumn<bool>("onlyVisibleLayers");
+
+    QTest::newRow("all layers") << false;
+    QTest::newRow("only visible layers") << true;
+}
+
+void tst_App::undoMoveContentsOffCanvas()
+{
+    QFETCH(bool, onlyVisibleLayers);
+
+    QVERIFY2(createNewLayeredImageProject(20, 20), failureMessage);
+    QVERIFY2(togglePanel("layerPanel", true), failureMessage);
+
+    mouseEventOnCentre(newLayerButton, MouseClick);
+    mouseEventOnCentre(newLayerButton, MouseClick);
+    QCOMPARE(layeredImageProject->layerCount(), 3);
+
+    QVector<QImage> originalImages;
+    for (int i = 0; i < layeredImageProject->layerCount(); ++i) {
+        fillWithUniquePattern(layeredImageProject->layerAt(i)->image(), i);
+        originalImages.append(*layeredImageProject->layerAt(i)->image());
+    }
+
+    // Hide the middle layer.
+    ImageLayer *hiddenLayer = layeredImageProject->layerAt(1);
+    hiddenLayer->setVisible(false);
+
+    // Move the contents so that pixels go off the right and top edges of each layer.
+    const int xOffset = 5;
+    const int yOffset = -3;
+    QVERIFY2(moveContents(xOffset, yOffset, onlyVisibleLayers), failureMessage);
+
+    QVector<QImage> movedImages;
+    for (int i = 0; i < layeredImageProject->layerCount(); ++i) {
+        const ImageLayer *layer = layeredImageProject->layerAt(i);
+        QImage expectedImage = originalImages.at(i);
+        if (layer->isVisible() || !onlyVisibleLayers) {
+            expectedImage.fill(Qt::transparent);
+            QPainter painter(&expectedImage);
+            painter.setCompositionMode(QPainter::CompositionMode_Source);
+            painter.drawImage(xOffset, yOffset, originalImages.at(i));
+        }
+        QCOMPARE(*layer->image(), expectedImage);
+        movedImages.append(expectedImage);
+    }
+
+    // Undoing should restore the pixels that were moved off the canvas.
+    mouseEventOnCentre(undoButton, MouseClick);
+    for (int i = 0; i < layeredImageProject->layerCount(); ++i)
+        QCOMPARE(*layeredImageProject->layerAt(i)->image(), originalImages.at(i));
+
+    mouseEventOnCentre(redoButton, MouseClick);
+    for (int i = 0; i < layeredImageProject->layerCount(); ++i)
+        QCOMPARE(*layeredImageProject->layerAt(i)->image(), movedImages.at(i));
+
+    mouseEventOnCentre(undoButton, MouseClick);
+    for (int i = 0; i < layeredImageProject->layerCount(); ++i)
+        QCOMPARE(*layeredImageProject->layerAt(i)->image(), originalImages.at(i));
+}
+
 int main(int argc, char *argv[])
 {
     tst_App test(argc, argv);